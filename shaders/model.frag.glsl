@@ -2,8 +2,6 @@
 #define COMPAT_TEXTURE texture
 #define COMPAT_TEXTURE_CUBE texture
 #define COMPAT_TEXTURE_CUBE_LOD textureLod
-#define COMPAT_SHADOW_MAP_TEXTURE(index) texture(shadowCubeMap,vec4(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0),index)).r
-#define COMPAT_SHADOW_CUBE_MAP_TEXTURE(index) texture(shadowCubeMap,vec4(xyz,index)).r
 struct Light
 {
     vec3 direction;
@@ -27,6 +25,8 @@ layout(binding = 0) uniform EnvironmentUniform {
 	layout(offset = 688) vec3 cameraPosition;
 	layout(offset = 700) float environmentIntensity;
 	layout(offset = 704) int mipCount;
+	layout(offset = 720) vec4 shadowAtlasRects[24];
+	layout(offset = 1104) vec4 shadowCascades[16];
 };
 layout(binding = 1) uniform MaterialUniform {
 	mat3 texTransform,normalMapTransform,metallicRoughnessMapTransform,ambientOcclusionMapTransform,emissionMapTransform;
@@ -63,7 +63,7 @@ layout(binding = 9) uniform sampler2D normalMap;
 layout(binding = 10) uniform sampler2D metallicRoughnessMap;
 layout(binding = 11) uniform sampler2D ambientOcclusionMap;
 layout(binding = 12) uniform sampler2D emissionMap;
-layout(binding = 13) uniform samplerCubeArray shadowCubeMap;
+layout(binding = 13) uniform sampler2D shadowAtlas;
 
 layout(location = 0) in vec3 normal;
 layout(location = 1) in vec3 tangent;
@@ -75,24 +75,10 @@ layout(location = 6) in vec4 lightSpacePos[4];
 layout(location = 0) out vec4 FragColor;
 #else
 #if __VERSION__ >= 130
-// For desktop OpenGL 130+, use the cube map array extension
-#if !defined(GL_ES) && defined(GL_ARB_texture_cube_map_array)
-#extension GL_ARB_texture_cube_map_array : enable
-#endif
 #define COMPAT_VARYING in
 #define COMPAT_TEXTURE texture
 #define COMPAT_TEXTURE_CUBE texture
 #define COMPAT_TEXTURE_CUBE_LOD textureLod
-#ifdef ENABLE_SHADOW
-#if defined(GL_ES) || __VERSION__ < 400
-// For OpenGL ES, use separate samplerCube arrays instead of samplerCubeArray
-#define COMPAT_SHADOW_MAP_TEXTURE(index) (index == 0 ? texture(shadowCubeMaps[0], vec3(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0))).r : index == 1 ? texture(shadowCubeMaps[1], vec3(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0))).r : index == 2 ? texture(shadowCubeMaps[2], vec3(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0))).r : texture(shadowCubeMaps[3], vec3(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0))).r)
-#define COMPAT_SHADOW_CUBE_MAP_TEXTURE(index) (index == 0 ? texture(shadowCubeMaps[0], xyz).r : index == 1 ? texture(shadowCubeMaps[1], xyz).r : index == 2 ? texture(shadowCubeMaps[2], xyz).r : texture(shadowCubeMaps[3], xyz).r)
-#else
-#define COMPAT_SHADOW_MAP_TEXTURE(index) texture(shadowCubeMap,vec4(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0),index)).r
-#define COMPAT_SHADOW_CUBE_MAP_TEXTURE(index) texture(shadowCubeMap,vec4(xyz,index)).r
-#endif
-#endif
 #else
 // OpenGL ES or legacy OpenGL
 #if __VERSION__ >= 300
@@ -103,10 +89,6 @@ layout(location = 0) out vec4 FragColor;
 #define COMPAT_TEXTURE texture
 #define COMPAT_TEXTURE_CUBE texture
 #define COMPAT_TEXTURE_CUBE_LOD textureLod
-#ifdef ENABLE_SHADOW
-#define COMPAT_SHADOW_MAP_TEXTURE(index) (index == 0 ? texture(shadowCubeMaps[0], vec3(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0))).r : index == 1 ? texture(shadowCubeMaps[1], vec3(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0))).r : index == 2 ? texture(shadowCubeMaps[2], vec3(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0))).r : texture(shadowCubeMaps[3], vec3(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0))).r)
-#define COMPAT_SHADOW_CUBE_MAP_TEXTURE(index) (index == 0 ? texture(shadowCubeMaps[0], xyz).r : index == 1 ? texture(shadowCubeMaps[1], xyz).r : index == 2 ? texture(shadowCubeMaps[2], xyz).r : texture(shadowCubeMaps[3], xyz).r)
-#endif
 #else
 // Legacy GLSL
 #extension GL_EXT_gpu_shader4 : enable
@@ -116,22 +98,13 @@ layout(location = 0) out vec4 FragColor;
 #define COMPAT_TEXTURE texture2D
 #define COMPAT_TEXTURE_CUBE textureCube
 #define COMPAT_TEXTURE_CUBE_LOD textureCubeLod
-#ifdef ENABLE_SHADOW
-#define COMPAT_SHADOW_MAP_TEXTURE(index) textureCube(shadowCubeMaps[index], vec3(1.0, -(xy.y*2.0-1.0),-(xy.x*2.0-1.0))).r
-#define COMPAT_SHADOW_CUBE_MAP_TEXTURE(index) textureCube(shadowCubeMaps[index], xyz).r
-#endif
 #endif
 #endif
 
 // Uniform declarations must come after version directives but before struct definitions
 #ifdef ENABLE_SHADOW
-#if defined(GL_ES) || __VERSION__ < 400
-// For OpenGL ES or older desktop OpenGL, use separate samplerCube arrays
-uniform samplerCube shadowCubeMaps[4];
-#else
-// For modern desktop OpenGL, use samplerCubeArray
-uniform samplerCubeArray shadowCubeMap;
-#endif
+// Every light's shadow maps, one tile per view (ShadowAtlas.h)
+uniform sampler2D shadowAtlas;
 #endif
 
 struct Light
@@ -154,18 +127,59 @@ struct Light
 
 // Now declare all uniforms
 uniform sampler2D tex;
-uniform mat3 texTransform;
 uniform sampler2D normalMap;
-uniform mat3 normalMapTransform;
 uniform sampler2D metallicRoughnessMap;
-uniform mat3 metallicRoughnessMapTransform;
 uniform sampler2D ambientOcclusionMap;
-uniform mat3 ambientOcclusionMapTransform;
 uniform sampler2D emissionMap;
-uniform mat3 emissionMapTransform;
 uniform samplerCube lambertianEnvSampler;
 uniform samplerCube GGXEnvSampler;
 uniform sampler2D GGXLUT;
+
+#ifdef USE_UBO
+// Uploaded once per frame
+layout(std140) uniform EnvironmentUniform {
+	mat4 view, projection;
+	mat4 lightMatrices[4];
+	Light lights[4];
+	mat3 environmentRotation;
+	vec3 cameraPosition;
+	float environmentIntensity;
+	int mipCount;
+#ifdef ENABLE_SHADOW
+	vec4 shadowAtlasRects[24];
+	vec4 shadowCascades[16];
+#endif
+};
+// Uploaded per draw
+layout(std140) uniform MeshUniform {
+	mat4 model, normalMatrix;
+	vec4 morphTargetWeight[2];
+	vec4 morphTargetOffset;
+	int numJoints, numTargets, morphTargetTextureDimension, numVertices;
+	vec3 add;
+	float meshOutline;
+	vec3 mult;
+	float gray;
+	float hue;
+};
+// Uploaded per draw
+layout(std140) uniform MaterialUniform {
+	mat3 texTransform, normalMapTransform, metallicRoughnessMapTransform, ambientOcclusionMapTransform, emissionMapTransform;
+	vec4 baseColorFactor;
+	vec3 emission;
+	float ambientOcclusionStrength;
+	vec2 metallicRoughness;
+	float alphaThreshold;
+	bool unlit;
+	bool enableAlpha;
+	bool useTexture, useNormalMap, useMetallicRoughnessMap, useEmissionMap, neg;
+};
+#else
+uniform mat3 texTransform;
+uniform mat3 normalMapTransform;
+uniform mat3 metallicRoughnessMapTransform;
+uniform mat3 ambientOcclusionMapTransform;
+uniform mat3 emissionMapTransform;
 uniform float environmentIntensity;
 uniform mat3 environmentRotation;
 uniform int mipCount;
@@ -179,6 +193,10 @@ uniform vec3 emission;
 uniform bool unlit;
 
 uniform Light lights[4];
+#ifdef ENABLE_SHADOW
+uniform vec4 shadowAtlasRects[24];
+uniform vec4 shadowCascades[16];
+#endif
 
 uniform vec3 add, mult;
 uniform float gray, hue;
@@ -190,6 +208,17 @@ uniform bool neg;
 uniform bool enableAlpha;
 uniform float alphaThreshold;
 uniform float meshOutline;
+#endif
+
+#ifdef PERMUTATION
+// Specialized program (see ShaderPermutation.h): the material switches
+// become constants, so the untaken branches compile away
+#define useTexture (PERM_TEXTURE != 0)
+#define useNormalMap (PERM_NORMAL_MAP != 0)
+#define useMetallicRoughnessMap (PERM_METALLIC_ROUGHNESS_MAP != 0)
+#define useEmissionMap (PERM_EMISSION_MAP != 0)
+#define unlit (PERM_UNLIT != 0)
+#endif
 
 COMPAT_VARYING vec2 texcoord;
 COMPAT_VARYING vec4 vColor;
@@ -221,6 +250,58 @@ float clampedDot(vec3 x, vec3 y)
     return clamp(dot(x, y), 0.0, 1.0);
 }
 
+#ifdef ENABLE_SHADOW
+// View v of light i is the atlas tile shadowAtlasRects[i * 6 + v]: offset
+// in xy, size in zw. Lights without a tile have zero size and stay lit.
+float SampleShadowAtlas(int view, vec2 uv)
+{
+    vec4 rect = shadowAtlasRects[view];
+    if(rect.z <= 0.0){
+        return 1.0;
+    }
+    float epsilon = 1.0 / 1024.0;
+    return COMPAT_TEXTURE(shadowAtlas, rect.xy + rect.zw * clamp(uv, epsilon, 1.0 - epsilon)).r;
+}
+
+// Finest cascade covering uv; shadowCascades[i * 4 + c] maps the light's
+// 0..1 area into cascade c as uv * xy + zw
+float SampleShadowCascades(int index, vec2 uv)
+{
+    for(int c = 0; c < 4; ++c){
+        vec4 cascade = shadowCascades[index * 4 + c];
+        vec2 local = uv * cascade.xy + cascade.zw;
+        if(cascade.x > 0.0 && all(greaterThanEqual(local, vec2(0.0))) && all(lessThan(local, vec2(1.0)))){
+            return SampleShadowAtlas(index * 6 + c, local);
+        }
+    }
+    return 1.0;
+}
+
+// Cube face views 0..5 are +X, -X, +Y, -Y, +Z, -Z, rendered with the up
+// vectors of ShadowCubeFaceMatrix
+float SampleShadowCube(int index, vec3 d)
+{
+    vec3 a = abs(d);
+    int face;
+    vec3 forward;
+    if(a.x >= a.y && a.x >= a.z){
+        face = d.x > 0.0 ? 0 : 1;
+        forward = vec3(d.x > 0.0 ? 1.0 : -1.0, 0.0, 0.0);
+    }else if(a.y >= a.z){
+        face = d.y > 0.0 ? 2 : 3;
+        forward = vec3(0.0, d.y > 0.0 ? 1.0 : -1.0, 0.0);
+    }else{
+        face = d.z > 0.0 ? 4 : 5;
+        forward = vec3(0.0, 0.0, d.z > 0.0 ? 1.0 : -1.0);
+    }
+    vec3 up = forward.y != 0.0 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(forward, up));
+    up = cross(right, forward);
+    vec2 ndc = vec2(dot(d, right), dot(d, up)) / dot(d, forward);
+    return SampleShadowAtlas(index * 6 + face, ndc * 0.5 + 0.5);
+}
+#endif
+
 float DirectionalLightShadowCalculation(int index, vec4 lightSpacePos,float NdotL,float shadowBias)
 {
     #ifdef ENABLE_SHADOW
@@ -232,9 +313,7 @@ float DirectionalLightShadowCalculation(int index, vec4 lightSpacePos,float Ndot
     // transform to [0,1] range
     projCoords = projCoords * 0.5 + 0.5;
     // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-    float epsilon = 1.0 / 1024.0;
-    vec2 xy = vec2(clamp(projCoords.x,epsilon,1.0-epsilon),clamp(projCoords.y,epsilon,1.0-epsilon));
-    float closestDepth = COMPAT_SHADOW_MAP_TEXTURE(index);
+    float closestDepth = SampleShadowCascades(index, projCoords.xy);
     // get depth of current fragment from light's perspective
     float currentDepth = projCoords.z;
     // check whether current frag pos is in shadow
@@ -252,9 +331,8 @@ float SpotLightShadowCalculation(int index, vec3 pointToLight, vec4 lightSpacePo
     if(!useShadowMap){
         return 1.0;
     }
-    float epsilon = 1.0 / 1024.0;
-    vec2 xy = vec2(clamp(lightSpacePos.x,epsilon,1.0-epsilon),clamp(lightSpacePos.y,epsilon,1.0-epsilon));
-    float closestDepth = COMPAT_SHADOW_MAP_TEXTURE(index);
+    vec2 xy = lightSpacePos.xy / lightSpacePos.w * 0.5 + 0.5;
+    float closestDepth = SampleShadowAtlas(index * 6, xy);
     // it is currently in linear range between [0,1]. Re-transform back to original value
     closestDepth *= farPlane;
     // get depth of current fragment from light's perspective
@@ -273,8 +351,7 @@ float PointLightShadowCalculation(int index, vec3 pointToLight,float NdotL,float
     if(!useShadowMap){
         return 1.0;
     }
-    vec3 xyz = -pointToLight;
-    float closestDepth = COMPAT_SHADOW_CUBE_MAP_TEXTURE(index);
+    float closestDepth = SampleShadowCube(index, -pointToLight);
     // it is currently in linear range between [0,1]. Re-transform back to original value
     closestDepth *= farPlane;
     // now get current linear depth as the length between the fragment and light position
@@ -568,7 +645,9 @@ void main(void) {
             FragColor.rgb += emission;
         }
     }
-    FragColor.rgb = pow(FragColor.rgb, vec3(1.0/2.2));
+    // Under MSAA an edge pixel's center may lie outside the triangle, and
+    // the extrapolated vColor can go negative there; pow() is undefined for it
+    FragColor.rgb = pow(max(FragColor.rgb, vec3(0.0)), vec3(1.0/2.2));
     FragColor.rgb *= vColor.a;
 	if(!enableAlpha){
 		if(FragColor.a < alphaThreshold){
@@ -53,12 +53,57 @@ layout(location = 6) out vec4 lightSpacePos[4];
 #define COMPAT_ATTRIBUTE attribute 
 #define COMPAT_TEXTURE texture2D
 #endif
-uniform mat4 model, view, projection;
-uniform mat4 normalMatrix;
-uniform mat4 lightMatrices[4];
 uniform sampler2D jointMatrices;
 //uniform highp sampler2D morphTargetValues;
 uniform sampler2D morphTargetValues;
+#ifdef USE_UBO
+struct Light
+{
+    vec3 direction;
+    float range;
+
+    vec3 color;
+    float intensity;
+
+    vec3 position;
+    float innerConeCos;
+
+    float outerConeCos;
+    int type;
+
+    float shadowBias;
+    float shadowMapFar;
+};
+// Uploaded once per frame
+layout(std140) uniform EnvironmentUniform {
+	mat4 view, projection;
+	mat4 lightMatrices[4];
+	Light lights[4];
+	mat3 environmentRotation;
+	vec3 cameraPosition;
+	float environmentIntensity;
+	int mipCount;
+#ifdef ENABLE_SHADOW
+	vec4 shadowAtlasRects[24];
+	vec4 shadowCascades[16];
+#endif
+};
+// Uploaded per draw
+layout(std140) uniform MeshUniform {
+	mat4 model, normalMatrix;
+	vec4 morphTargetWeight[2];
+	vec4 morphTargetOffset;
+	int numJoints, numTargets, morphTargetTextureDimension, numVertices;
+	vec3 add;
+	float meshOutline;
+	vec3 mult;
+	float gray;
+	float hue;
+};
+#else
+uniform mat4 model, view, projection;
+uniform mat4 normalMatrix;
+uniform mat4 lightMatrices[4];
 uniform int numJoints;
 uniform int numTargets;
 uniform int morphTargetTextureDimension;
@@ -67,6 +112,7 @@ uniform vec4 morphTargetOffset;
 uniform int numVertices;
 uniform float meshOutline;
 uniform vec3 cameraPosition;
+#endif
 //gl_VertexID is not available in 1.2
 COMPAT_ATTRIBUTE float vertexId;
 COMPAT_ATTRIBUTE vec3 position;
@@ -88,6 +134,23 @@ COMPAT_VARYING vec3 worldSpacePos;
 COMPAT_VARYING vec4 lightSpacePos[4];
 
 
+#ifdef PERMUTATION
+// Specialized program (see ShaderPermutation.h): the switches are constants
+const bool useJoint0 = PERM_JOINT0 != 0;
+const bool useJoint1 = PERM_JOINT1 != 0;
+const bool useNormal = PERM_NORMAL != 0;
+const bool useTangent = PERM_TANGENT != 0;
+const bool useVertColor = PERM_VERT_COLOR != 0;
+const bool useOutlineAttribute = PERM_OUTLINE_ATTRIBUTE != 0;
+#if PERM_MULTI_DRAW
+// Per-draw transform of RenderElementsMultiDraw, see ModelDraw; it replaces
+// the model and normal matrices of the uniforms
+COMPAT_ATTRIBUTE mat4 drawModel;
+mat4 drawNormalMatrix;
+#define model drawModel
+#define normalMatrix drawNormalMatrix
+#endif
+#else
 #define useJoint0 (weights_0.x+weights_0.y+weights_0.z+weights_0.w+weights_1.x+weights_1.y+weights_1.z+weights_1.w>0.0)
 const bool useJoint1 = true;
 const bool useNormal = true;
@@ -95,6 +158,7 @@ const bool useTangent = true;
 const bool useVertColor = true;
 const bool useOutlineAttribute = true;
 #endif
+#endif
 
 
 mat4 getMatrixFromTexture(float index){
@@ -167,7 +231,14 @@ mat3 getJointNormalMatrix(){
 }
 
 void main(void) {
+#ifdef PERMUTATION
+#if PERM_MULTI_DRAW
+	drawNormalMatrix = mat4(transpose(inverse(mat3(drawModel))));
+#endif
+	texcoord = PERM_UV != 0 ? uv : vec2(0.0);
+#else
 	texcoord = uv;
+#endif
 	vColor = useVertColor?vertColor:vec4(1.0,1.0,1.0,1.0);
 	vec4 pos = vec4(position, 1.0);
 	normal = useNormal?normalIn:vec3(0.0,0.0,0.0);
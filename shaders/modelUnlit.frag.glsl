@@ -0,0 +1,98 @@
+// Stand-in for model.frag while its permutations are still compiling:
+// base color, vertex color and the palette effects, without lighting
+#if __VERSION__ >= 130
+#define COMPAT_VARYING in
+#define COMPAT_TEXTURE texture
+#else
+#define COMPAT_VARYING varying
+#define FragColor gl_FragColor
+#define COMPAT_TEXTURE texture2D
+#endif
+
+uniform sampler2D tex;
+
+#ifdef USE_UBO
+// Uploaded per draw; must match model.frag
+layout(std140) uniform MeshUniform {
+	mat4 model, normalMatrix;
+	vec4 morphTargetWeight[2];
+	vec4 morphTargetOffset;
+	int numJoints, numTargets, morphTargetTextureDimension, numVertices;
+	vec3 add;
+	float meshOutline;
+	vec3 mult;
+	float gray;
+	float hue;
+};
+// Uploaded per draw; must match model.frag
+layout(std140) uniform MaterialUniform {
+	mat3 texTransform, normalMapTransform, metallicRoughnessMapTransform, ambientOcclusionMapTransform, emissionMapTransform;
+	vec4 baseColorFactor;
+	vec3 emission;
+	float ambientOcclusionStrength;
+	vec2 metallicRoughness;
+	float alphaThreshold;
+	bool unlit;
+	bool enableAlpha;
+	bool useTexture, useNormalMap, useMetallicRoughnessMap, useEmissionMap, neg;
+};
+#else
+uniform mat3 texTransform;
+uniform vec4 baseColorFactor;
+uniform vec3 add, mult;
+uniform float gray, hue;
+uniform bool useTexture;
+uniform bool neg;
+uniform bool enableAlpha;
+uniform float alphaThreshold;
+uniform float meshOutline;
+#endif
+
+COMPAT_VARYING vec2 texcoord;
+COMPAT_VARYING vec4 vColor;
+
+#if __VERSION__ >= 130
+out vec4 FragColor;
+#endif
+
+vec3 hue_shift(vec3 color, float dhue) {
+	float s = sin(dhue);
+	float c = cos(dhue);
+	return (color * c) + (color * s) * mat3(
+		vec3(0.167444, 0.329213, -0.496657),
+		vec3(-0.327948, 0.035669, 0.292279),
+		vec3(1.250268, -1.047561, -0.202707)
+	) + dot(vec3(0.299, 0.587, 0.114), color) * (1.0 - c);
+}
+
+void main(void) {
+	FragColor = vec4(1.0);
+	if(useTexture){
+		FragColor = COMPAT_TEXTURE(tex, vec2(texTransform*vec3(texcoord,1.0)));
+		FragColor.rgb = pow(FragColor.rgb,vec3(2.2));
+	}
+	FragColor *= baseColorFactor;
+	FragColor *= vColor;
+	if(meshOutline > 0.0) {
+		FragColor.rgb = vec3(0.0,0.0,0.0);
+	}
+	FragColor.rgb = pow(FragColor.rgb, vec3(1.0/2.2));
+	FragColor.rgb *= vColor.a;
+	if(!enableAlpha){
+		if(FragColor.a < alphaThreshold){
+			discard;
+		}else{
+			FragColor.a = 1.0;
+		}
+	}else if(FragColor.a<=0.0){
+		discard;
+	}
+	vec3 neg_base = vec3(1.0);
+	neg_base *= FragColor.a;
+	if (hue != 0.0) {
+		FragColor.rgb = hue_shift(FragColor.rgb,hue);
+	}
+	if (neg) FragColor.rgb = neg_base - FragColor.rgb;
+	FragColor.rgb = mix(FragColor.rgb, vec3((FragColor.r + FragColor.g + FragColor.b) / 3.0), gray) + add*FragColor.a;
+	FragColor.rgb *= mult;
+}
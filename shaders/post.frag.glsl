@@ -0,0 +1,137 @@
+#if __VERSION__ >= 450
+#define COMPAT_TEXTURE texture
+layout(push_constant, std430) uniform u {
+	vec2 TextureSize;
+	vec2 InputScale;
+	vec2 SceneSize;
+};
+layout(binding = 0) uniform sampler2D Texture;
+
+layout(location = 0) in vec2 texcoord;
+layout(location = 0) out vec4 FragColor;
+#else
+#if __VERSION__ >= 130
+#define COMPAT_VARYING in
+#define COMPAT_TEXTURE texture
+out vec4 FragColor;
+#else
+#define COMPAT_VARYING varying
+#define FragColor gl_FragColor
+#define COMPAT_TEXTURE texture2D
+#endif
+uniform sampler2D Texture;
+uniform vec2 TextureSize;	// size of the input region in texels
+uniform vec2 InputScale;	// input region over the size of Texture
+uniform vec2 SceneSize;		// render size of the scene, in texels
+
+COMPAT_VARYING vec2 texcoord;
+#endif
+
+// One pass of the post-processing chain (PostChain.h). POST_STAGES effects
+// run in order; POST_STAGE0..3 hold their PostEffect values. Only stage 0
+// reads Texture, later stages remap the coordinate and shade the color.
+#define POST_SCANLINES 1
+#define POST_CRT 2
+#define POST_SCALE2X 3
+
+#ifndef POST_STAGES
+#define POST_STAGES 1
+#define POST_STAGE0 0
+#endif
+
+#define CRT_CURVATURE 0.04
+#define SCANLINE_DEPTH 0.35
+
+// Coordinate in the stage input for a coordinate in its output
+vec2 Warp(int effect, vec2 uv) {
+	if (effect == POST_CRT) {
+		vec2 c = uv * 2.0 - 1.0;
+		c *= 1.0 + CRT_CURVATURE * dot(c, c);
+		return c * 0.5 + 0.5;
+	}
+	return uv;
+}
+
+vec4 Texel(vec2 cell) {
+	cell = clamp(cell, vec2(0.0), TextureSize - 1.0);
+	return COMPAT_TEXTURE(Texture, (cell + 0.5) / TextureSize * InputScale);
+}
+
+bool Same(vec4 a, vec4 b) {
+	return dot(abs(a.rgb - b.rgb), vec3(1.0)) < 0.01;
+}
+
+// EPX: each source texel becomes four; a corner takes the color of its two
+// neighbours when they agree and the opposite ones do not
+vec4 Scale2x(vec2 uv) {
+	vec2 p = uv * TextureSize;
+	vec2 cell = floor(p);
+	vec2 dir = step(0.5, p - cell) * 2.0 - 1.0;
+
+	vec4 center = Texel(cell);
+	vec4 h = Texel(cell + vec2(dir.x, 0.0));
+	vec4 v = Texel(cell + vec2(0.0, dir.y));
+	vec4 hOpposite = Texel(cell - vec2(dir.x, 0.0));
+	vec4 vOpposite = Texel(cell - vec2(0.0, dir.y));
+	if (Same(h, v) && !Same(h, vOpposite) && !Same(v, hOpposite)) {
+		return h;
+	}
+	return center;
+}
+
+vec4 Fetch(int effect, vec2 uv) {
+	if (effect == POST_SCALE2X) {
+		return Scale2x(uv);
+	}
+	return COMPAT_TEXTURE(Texture, uv * InputScale);
+}
+
+// uv is the stage input coordinate
+vec4 Shade(int effect, vec4 color, vec2 uv) {
+	if (effect == POST_SCANLINES) {
+		// Lower half of every scene row, whatever the passes before scaled
+		if (fract(uv.y * SceneSize.y) < 0.5) {
+			color.rgb *= 1.0 - SCANLINE_DEPTH;
+		}
+	} else if (effect == POST_CRT) {
+		if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) {
+			return vec4(0.0, 0.0, 0.0, 1.0);
+		}
+		// Aperture grille over output pixels and a vignette
+		float column = mod(floor(gl_FragCoord.x), 3.0);
+		vec3 mask = vec3(0.8);
+		mask[int(column)] = 1.1;
+		vec2 edge = uv * (1.0 - uv);
+		float vignette = clamp(pow(edge.x * edge.y * 16.0, 0.2), 0.0, 1.0);
+		color.rgb *= mask * vignette;
+	}
+	return color;
+}
+
+void main(void) {
+	// Input coordinate of every stage, walked back from the output
+	vec2 uv[POST_STAGES];
+	vec2 coord = texcoord;
+#if POST_STAGES > 3
+	coord = uv[3] = Warp(POST_STAGE3, coord);
+#endif
+#if POST_STAGES > 2
+	coord = uv[2] = Warp(POST_STAGE2, coord);
+#endif
+#if POST_STAGES > 1
+	coord = uv[1] = Warp(POST_STAGE1, coord);
+#endif
+	uv[0] = Warp(POST_STAGE0, coord);
+
+	vec4 color = Shade(POST_STAGE0, Fetch(POST_STAGE0, uv[0]), uv[0]);
+#if POST_STAGES > 1
+	color = Shade(POST_STAGE1, color, uv[1]);
+#endif
+#if POST_STAGES > 2
+	color = Shade(POST_STAGE2, color, uv[2]);
+#endif
+#if POST_STAGES > 3
+	color = Shade(POST_STAGE3, color, uv[3]);
+#endif
+	FragColor = color;
+}
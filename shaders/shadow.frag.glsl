@@ -1,51 +1,22 @@
-#ifdef GL_ES
-layout(location = 0) out vec4 FragColor;
+#if __VERSION__ >= 130
+#define COMPAT_VARYING in
 #else
-out vec4 FragColor;
+#define COMPAT_VARYING varying
 #endif
+uniform int lightType;
+uniform vec3 lightPosition;
+uniform float farPlane;
 
-#ifdef GL_ES
-// GLES path: geometry shader disabled => inputs come directly from vertex shader
-in vec2 texcoord;
-in vec4 vColor;
-in vec3 fragPos;
-in vec4 fragPosLight;
-#else
-// Desktop path: geometry shader active
-in vec2 g_texcoord;
-in vec4 g_vColor;
-in vec3 g_fragPos;
-in vec4 g_fragPosLight;
-#endif
-
-#ifdef GL_ES
-uniform bool debugOutputColor;
-#else
-uniform bool debugOutputColor = false;
-#endif
+COMPAT_VARYING vec3 fragPos;
 
-void main()
-{
-#ifdef GL_ES
-    float ndcZ = fragPosLight.z / fragPosLight.w;
-#else
-    float ndcZ = g_fragPosLight.z / g_fragPosLight.w;
-#endif
-
-    float depth01 = clamp(ndcZ * 0.5 + 0.5, 0.0, 1.0);
-    gl_FragDepth = depth01;
+#define LIGHT_DIRECTIONAL 0
 
-#ifdef GL_ES
-    if (debugOutputColor) {
-        FragColor = vec4(vec3(depth01), 1.0);
-    } else {
-        FragColor = vColor;
-    }
-#else
-    if (debugOutputColor) {
-        FragColor = vec4(vec3(depth01), 1.0);
-    } else {
-        FragColor = g_vColor;
-    }
-#endif
+// Depth as model.frag reads it back: window depth for directional lights,
+// distance to the light over farPlane for point and spot lights
+void main(void) {
+	if (lightType == LIGHT_DIRECTIONAL) {
+		gl_FragDepth = gl_FragCoord.z;
+	} else {
+		gl_FragDepth = clamp(length(fragPos - lightPosition) / farPlane, 0.0, 1.0);
+	}
 }
@@ -1,31 +1,21 @@
-// Inputs
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec2 inTexcoord;
-layout(location = 3) in vec4 inColor;
-
-// Uniforms
+#if __VERSION__ >= 130
+#define COMPAT_VARYING out
+#define COMPAT_ATTRIBUTE in
+#else
+#define COMPAT_VARYING varying
+#define COMPAT_ATTRIBUTE attribute
+#endif
 uniform mat4 model;
-uniform mat4 lightVP;
-
-// Outputs to next stage
-out vec2 texcoord;
-out vec4 vColor;
-out vec3 fragPos;
-out vec4 fragPosLight;
+uniform mat4 lightVP;	// light view of the atlas tile being rendered
 
-void main()
-{
-    vec4 worldPos = model * vec4(inPosition, 1.0);
+COMPAT_ATTRIBUTE vec3 position;
+COMPAT_VARYING vec3 fragPos;
 
-    fragPos = worldPos.xyz;
-    fragPosLight = lightVP * worldPos;
-
-    texcoord = inTexcoord;
-    vColor = inColor;
-
-#ifdef GL_ES
-    // GLES uses gl_Position the same way OpenGL 3.3 does
-#endif
-    gl_Position = fragPosLight;
+// One light view per draw. Every view has its own tile in the shadow atlas
+// (ShadowAtlas.h), so the six faces of a point light are six plain passes
+// rather than geometry shader amplification.
+void main(void) {
+	vec4 worldPos = model * vec4(position, 1.0);
+	fragPos = worldPos.xyz;
+	gl_Position = lightVP * worldPos;
 }
@@ -30,17 +30,50 @@ out vec4 FragColor;
 uniform sampler2D tex;
 uniform sampler2DArray pal;
 
+#ifdef USE_UBO
+layout(std140) uniform SpriteUniform {
+	mat4 modelview, projection;
+	vec4 uvRect;
+	vec4 x1x2x4x3;
+	vec4 tint;
+	vec3 add;
+	float alpha;
+	vec3 mult;
+	float gray;
+	float hue;
+	int mask;
+	int useUV;
+	bool isFlat, isRgba, isTrapez, neg;
+};
+#else
 uniform vec4 x1x2x4x3;
 uniform vec4 tint;
 uniform vec3 add, mult;
 uniform float alpha, gray, hue;
 uniform int mask;
 uniform bool isFlat, isRgba, isTrapez, neg;
+#endif
 
 COMPAT_VARYING vec2 texcoord;
 flat COMPAT_VARYING float v_PalIndex;
 #endif
 
+#ifdef INSTANCED
+// Color effects come per instance from the vertex stage
+flat COMPAT_VARYING vec4 v_Tint;
+flat COMPAT_VARYING vec4 v_AddAlpha;
+flat COMPAT_VARYING vec3 v_Mult;
+#define TINT v_Tint
+#define ADD v_AddAlpha.rgb
+#define ALPHA v_AddAlpha.a
+#define MULT v_Mult
+#else
+#define TINT tint
+#define ADD add
+#define ALPHA alpha
+#define MULT mult
+#endif
+
 vec3 hue_shift(vec3 color, float dhue) {
 	float s = sin(dhue);
 	float c = cos(dhue);
@@ -53,7 +86,7 @@ vec3 hue_shift(vec3 color, float dhue) {
 
 void main(void) {
 	if (isFlat) {
-		FragColor = tint;
+		FragColor = TINT;
 	} else {
 		vec2 uv = texcoord;
 		if (isTrapez) {
@@ -65,8 +98,8 @@ void main(void) {
 
 		vec4 c = COMPAT_TEXTURE(tex, uv);
 		vec3 neg_base = vec3(1.0);
-		vec3 final_add = add;
-		vec4 final_mul = vec4(mult, alpha);
+		vec3 final_add = ADD;
+		vec4 final_mul = vec4(MULT, ALPHA);
 		if (isRgba) {
 			if (mask == -1) {
 				c.a = 1.0;
@@ -74,7 +107,7 @@ void main(void) {
 			// RGBA sprites use premultiplied alpha for transparency	
 			neg_base *= c.a;
 			final_add *= c.a;
-			final_mul.rgb *= alpha;
+			final_mul.rgb *= ALPHA;
 		} else {
 			#if __VERSION__ >= 450
 			c = COMPAT_TEXTURE(pal, vec3(palUV[0]+palUV[2]*c.r*0.9966, palUV[1], v_PalIndex));
@@ -93,7 +126,7 @@ void main(void) {
 		c *= final_mul;
 
 		// Add a final tint (used for shadows); make sure the result has premultiplied alpha
-		c.rgb = mix(c.rgb, tint.rgb * c.a, tint.a);
+		c.rgb = mix(c.rgb, TINT.rgb * c.a, TINT.a);
 
 		FragColor = c;
 	}
@@ -20,15 +20,43 @@ layout(location = 1) flat out float v_PalIndex;
 #define COMPAT_TEXTURE texture2D
 #endif
 
+#ifdef USE_UBO
+layout(std140) uniform SpriteUniform {
+	mat4 modelview, projection;
+	vec4 uvRect;
+	vec4 x1x2x4x3;
+	vec4 tint;
+	vec3 add;
+	float alpha;
+	vec3 mult;
+	float gray;
+	float hue;
+	int mask;
+	int useUV;
+	bool isFlat, isRgba, isTrapez, neg;
+};
+#else
 uniform mat4 modelview, projection;
+uniform vec4 uvRect;
+uniform int useUV;
+#endif
 
 COMPAT_ATTRIBUTE vec2 position;
 COMPAT_ATTRIBUTE vec2 uv;
 COMPAT_ATTRIBUTE float palIndex;
-uniform vec4 uvRect;
-uniform int useUV;
 COMPAT_VARYING vec2 texcoord;
 flat COMPAT_VARYING float v_PalIndex;
+
+#ifdef INSTANCED
+// Per-instance attributes, see SpriteInstance
+COMPAT_ATTRIBUTE mat4 i_modelview;
+COMPAT_ATTRIBUTE vec4 i_tint;
+COMPAT_ATTRIBUTE vec4 i_addAlpha;
+COMPAT_ATTRIBUTE vec4 i_multPalIndex;
+flat COMPAT_VARYING vec4 v_Tint;
+flat COMPAT_VARYING vec4 v_AddAlpha;
+flat COMPAT_VARYING vec3 v_Mult;
+#endif
 #endif
 
 void main(void) {
@@ -38,8 +66,16 @@ void main(void) {
 	} else {
 		texcoord = uv;
 	}
+	#ifdef INSTANCED
+	v_PalIndex = i_multPalIndex.w;
+	v_Tint = i_tint;
+	v_AddAlpha = i_addAlpha;
+	v_Mult = i_multPalIndex.rgb;
+	gl_Position = projection * (i_modelview * vec4(position, 0.0, 1.0));
+	#else
 	v_PalIndex = palIndex;
 	gl_Position = projection * (modelview * vec4(position, 0.0, 1.0));
+	#endif
 	#if __VERSION__ >= 450
 	gl_Position.y = -gl_Position.y;
 	#endif
@@ -0,0 +1,192 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// CPU Zone Profiler Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "CPUProfiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> CPUProfiler::enabledFlag(false);
+
+// ==========================================
+// Thread Buffers
+// ==========================================
+
+struct CPUProfileEvent {
+    const char* name;
+    uint64_t begin;     // nanoseconds since the profiler epoch
+    uint64_t end;       // begin for frame markers
+    uint64_t frame;     // frame markers only
+};
+
+// Ring of one thread's events. The owning thread writes events, written,
+// depth and open. The flusher (WriteChromeTrace, under registryMutex) only
+// reads events below written, and is the only one to touch flushed.
+struct CPUThreadBuffer {
+    static const size_t Capacity = 1 << 16;     // events, a power of two
+    static const int MaxDepth = 64;
+
+    std::vector<CPUProfileEvent> events;
+    std::atomic<uint64_t> written;
+    uint64_t flushed;
+    uint32_t id;
+    std::atomic<const char*> name;
+
+    struct {
+        const char* name;
+        uint64_t begin;
+    } open[MaxDepth];
+    int depth;      // may exceed MaxDepth; deeper zones are not recorded
+
+    CPUThreadBuffer() : events(Capacity), written(0), flushed(0), id(0), name(nullptr), depth(0) {}
+};
+
+static std::mutex registryMutex;
+static std::vector<std::shared_ptr<CPUThreadBuffer>> registry;
+static std::atomic<uint64_t> frameCounter(0);
+
+static uint64_t Now() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+// Registered on the thread's first zone. The registry owns the rings, so
+// a thread's events can still be flushed after it exits.
+static CPUThreadBuffer& ThisThreadBuffer() {
+    // The plain pointer skips the guarded thread_local initialization on
+    // every zone
+    thread_local CPUThreadBuffer* current = nullptr;
+    if (!current) {
+        auto buffer = std::make_shared<CPUThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->id = static_cast<uint32_t>(registry.size() + 1);
+        registry.push_back(buffer);
+        current = buffer.get();
+    }
+    return *current;
+}
+
+static void Push(CPUThreadBuffer& buffer, const CPUProfileEvent& event) {
+    uint64_t index = buffer.written.load(std::memory_order_relaxed);
+    buffer.events[index & (CPUThreadBuffer::Capacity - 1)] = event;
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+// ==========================================
+// Recording
+// ==========================================
+
+void CPUProfiler::BeginZone(const char* name) {
+    CPUThreadBuffer& buffer = ThisThreadBuffer();
+    if (buffer.depth < CPUThreadBuffer::MaxDepth) {
+        buffer.open[buffer.depth].name = name;
+        buffer.open[buffer.depth].begin = Now();
+    }
+    buffer.depth++;
+}
+
+void CPUProfiler::EndZone() {
+    CPUThreadBuffer& buffer = ThisThreadBuffer();
+    if (buffer.depth == 0) return;
+
+    buffer.depth--;
+    if (buffer.depth < CPUThreadBuffer::MaxDepth) {
+        Push(buffer, CPUProfileEvent{buffer.open[buffer.depth].name, buffer.open[buffer.depth].begin, Now(), 0});
+    }
+}
+
+void CPUProfiler::FrameMark() {
+    uint64_t frame = frameCounter.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (!IsEnabled()) return;
+
+    uint64_t now = Now();
+    Push(ThisThreadBuffer(), CPUProfileEvent{"Frame", now, now, frame});
+}
+
+void CPUProfiler::SetThreadName(const char* name) {
+    ThisThreadBuffer().name.store(name, std::memory_order_relaxed);
+}
+
+// ==========================================
+// Chrome Trace Export
+// ==========================================
+
+static std::string EscapeJSON(const char* text) {
+    std::string escaped;
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\') escaped += '\\';
+        escaped += static_cast<unsigned char>(*text) < 0x20 ? ' ' : *text;
+    }
+    return escaped;
+}
+
+bool CPUProfiler::WriteChromeTrace(const std::string& path) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to write CPU trace: " << path << std::endl;
+        return false;
+    }
+
+    // Complete ("X") zones and instant frame markers in microseconds
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}}";
+    char line[160];
+    std::vector<CPUProfileEvent> events;
+    for (const auto& buffer : registry) {
+        const char* name = buffer->name.load(std::memory_order_relaxed);
+        snprintf(line, sizeof(line), "Thread %u", buffer->id);
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->id
+             << ",\"args\":{\"name\":\"" << EscapeJSON(name ? name : line) << "\"}}";
+
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = std::max(buffer->flushed, end > CPUThreadBuffer::Capacity ? end - CPUThreadBuffer::Capacity : 0);
+        events.clear();
+        for (uint64_t i = begin; i < end; ++i) {
+            events.push_back(buffer->events[i & (CPUThreadBuffer::Capacity - 1)]);
+        }
+        // The owner keeps recording during the copy, so slots it wrapped
+        // around to meanwhile may be torn, including the one it is writing
+        // now (index after); those are skipped. This check is only best
+        // effort: the event fields are plain, so it relies on the owner's
+        // stores landing in order, as they do on x86. Elsewhere a ring that
+        // wraps during a flush may export an event with mixed-up times.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = buffer->written.load(std::memory_order_relaxed);
+        uint64_t valid = after + 1 > CPUThreadBuffer::Capacity ? after + 1 - CPUThreadBuffer::Capacity : 0;
+        size_t skip = valid > begin ? static_cast<size_t>(std::min(valid - begin, end - begin)) : 0;
+        buffer->flushed = end;
+
+        for (size_t i = skip; i < events.size(); ++i) {
+            const CPUProfileEvent& event = events[i];
+            if (event.frame != 0) {
+                snprintf(line, sizeof(line),
+                         ",\n{\"name\":\"Frame\",\"cat\":\"frame\",\"ph\":\"i\",\"s\":\"p\",\"pid\":0,\"tid\":%u,"
+                         "\"ts\":%.3f,\"args\":{\"frame\":%llu}}",
+                         buffer->id, event.begin / 1.0e3, (unsigned long long)event.frame);
+                file << line;
+                continue;
+            }
+            file << ",\n{\"name\":\"" << EscapeJSON(event.name) << "\",\"cat\":\"cpu\",\"ph\":\"X\"";
+            snprintf(line, sizeof(line), ",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", buffer->id,
+                     event.begin / 1.0e3, (event.end - event.begin) / 1.0e3);
+            file << line;
+        }
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        std::cerr << "Failed to write CPU trace: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// CPU Zone Profiler
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped CPU zones and frame markers, written as Chrome trace / Perfetto
+// JSON. Each thread records into its own fixed ring of events that only
+// it writes, so recording takes no lock; WriteChromeTrace collects every
+// thread's ring. While disabled a zone costs one relaxed atomic load.
+//
+// Zone and thread names are not copied and must outlive the profiler
+// (string literals).
+class CPUProfiler {
+public:
+    static void SetEnabled(bool enabled) { enabledFlag.store(enabled, std::memory_order_relaxed); }
+    static bool IsEnabled() { return enabledFlag.load(std::memory_order_relaxed); }
+
+    // Zones nest per thread; prefer ScopedCPUZone
+    static void BeginZone(const char* name);
+    static void EndZone();
+    // Closes the current frame (an instant event numbered by frame)
+    static void FrameMark();
+    // Labels the calling thread's track
+    static void SetThreadName(const char* name);
+
+    // Writes every event recorded since the last flush and drops them;
+    // events older than a ring's capacity are lost
+    static bool WriteChromeTrace(const std::string& path);
+
+private:
+    static std::atomic<bool> enabledFlag;
+};
+
+// Times the enclosing scope when the profiler is enabled at its start
+class ScopedCPUZone {
+public:
+    explicit ScopedCPUZone(const char* name) : active(CPUProfiler::IsEnabled()) {
+        if (active) CPUProfiler::BeginZone(name);
+    }
+    ~ScopedCPUZone() {
+        if (active) CPUProfiler::EndZone();
+    }
+
+    ScopedCPUZone(const ScopedCPUZone&) = delete;
+    ScopedCPUZone& operator=(const ScopedCPUZone&) = delete;
+
+private:
+    bool active;
+};
+
+#endif // CPU_PROFILER_H
@@ -0,0 +1,1379 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Headless Offscreen Runner Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "Headless.h"
+#include "CPUProfiler.h"
+
+// EGL first: glad's bundled khrplatform.h lacks the calling convention macros
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifdef USE_GLES
+#include <glad/gles2.h>
+#else
+#include <glad/gl.h>
+#endif
+#include "renderer/Renderer.h"
+#include "renderer/Environment.h"
+#include "renderer/ModelVertexLayout.h"
+#include "renderer/PostChain.h"
+#include "renderer/ShadowAtlas.h"
+#include "renderer/SpriteAtlas.h"
+#include "renderer/SpriteBatcher.h"
+
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+// The renderers draw into a fixed 1920x1080 framebuffer
+static const int HeadlessWidth = 1920;
+static const int HeadlessHeight = 1080;
+
+// ==========================================
+// Options
+// ==========================================
+
+bool ParseHeadlessOptions(int argc, char** argv, HeadlessOptions& options) {
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(arg, "--frames") == 0 && value) {
+            options.frames = std::max(1, atoi(value));
+            ++i;
+        } else if (strcmp(arg, "--scene") == 0 && value) {
+            options.scene = value;
+            ++i;
+        } else if (strcmp(arg, "--dump") == 0 && value) {
+            options.dumpDir = value;
+            ++i;
+        } else if (strcmp(arg, "--dump-every") == 0 && value) {
+            options.dumpEvery = std::max(1, atoi(value));
+            ++i;
+        } else if (strcmp(arg, "--ibl-precision") == 0 && value) {
+            options.iblFullPrecision = strcmp(value, "full") == 0;
+            ++i;
+        } else if (strcmp(arg, "--ibl-budget") == 0 && value) {
+            options.iblBudget = std::max(0.0f, static_cast<float>(atof(value)));
+            ++i;
+        } else if (strcmp(arg, "--gpu-trace") == 0 && value) {
+            options.gpuTrace = value;
+            ++i;
+        } else if (strcmp(arg, "--cpu-trace") == 0 && value) {
+            options.cpuTrace = value;
+            ++i;
+        } else if (strcmp(arg, "--validate-state") == 0) {
+            options.validateState = true;
+        } else if (strcmp(arg, "--render-scale") == 0 && value) {
+            options.renderScale = static_cast<float>(atof(value));
+            ++i;
+        } else if (strcmp(arg, "--msaa") == 0 && value) {
+            options.msaaSamples = std::max(0, atoi(value));
+            ++i;
+        } else if (strcmp(arg, "--post") == 0 && value) {
+            options.postChain = value;
+            ++i;
+        } else if (strcmp(arg, "--check-cold-cache") == 0) {
+            options.checkColdCache = true;
+        }
+    }
+    return headless;
+}
+
+// Unknown names are reported and skipped
+static std::vector<PostEffect> ParsePostChain(const std::string& list) {
+    std::vector<PostEffect> chain;
+    size_t begin = 0;
+    while (begin < list.size()) {
+        size_t end = std::min(list.find(',', begin), list.size());
+        std::string name = list.substr(begin, end - begin);
+        PostEffect effect;
+        if (ParsePostEffect(name, effect)) {
+            chain.push_back(effect);
+        } else if (!name.empty()) {
+            std::cerr << "Headless: unknown post effect '" << name << "'" << std::endl;
+        }
+        begin = end + 1;
+    }
+    return chain;
+}
+
+// ==========================================
+// EGL Context
+// ==========================================
+
+struct HeadlessContext {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+};
+
+static void DestroyHeadlessContext(HeadlessContext& ctx) {
+    if (ctx.display == EGL_NO_DISPLAY) return;
+
+    eglMakeCurrent(ctx.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (ctx.context != EGL_NO_CONTEXT) eglDestroyContext(ctx.display, ctx.context);
+    if (ctx.surface != EGL_NO_SURFACE) eglDestroySurface(ctx.display, ctx.surface);
+    eglTerminate(ctx.display);
+    ctx = HeadlessContext();
+}
+
+// Prefers Mesa's surfaceless platform, which needs neither a display server
+// nor a GPU. The pbuffer gives the renderer a default framebuffer to
+// present into and read back from.
+static bool CreateHeadlessContext(HeadlessContext& ctx, int width, int height) {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+        ctx.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (ctx.display == EGL_NO_DISPLAY) {
+        ctx.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major = 0, minor = 0;
+    if (ctx.display == EGL_NO_DISPLAY || !eglInitialize(ctx.display, &major, &minor)) {
+        std::cerr << "Headless: no EGL display" << std::endl;
+        ctx.display = EGL_NO_DISPLAY;
+        return false;
+    }
+
+#ifdef USE_GLES
+    const EGLint renderable = EGL_OPENGL_ES3_BIT;
+    eglBindAPI(EGL_OPENGL_ES_API);
+#else
+    const EGLint renderable = EGL_OPENGL_BIT;
+    eglBindAPI(EGL_OPENGL_API);
+#endif
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, renderable,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(ctx.display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        std::cerr << "Headless: no pbuffer EGL config" << std::endl;
+        DestroyHeadlessContext(ctx);
+        return false;
+    }
+
+    const EGLint surfaceAttribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    ctx.surface = eglCreatePbufferSurface(ctx.display, config, surfaceAttribs);
+    if (ctx.surface == EGL_NO_SURFACE) {
+        std::cerr << "Headless: eglCreatePbufferSurface failed (0x" << std::hex << eglGetError()
+                  << std::dec << ")" << std::endl;
+        DestroyHeadlessContext(ctx);
+        return false;
+    }
+
+    // Newest version first, down to what the renderer requires
+#ifdef USE_GLES
+    static const int versions[][2] = {{3, 2}, {3, 1}};
+#else
+    static const int versions[][2] = {{4, 6}, {4, 5}, {4, 3}, {4, 1}, {3, 3}};
+#endif
+    for (const auto& version : versions) {
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, version[0],
+            EGL_CONTEXT_MINOR_VERSION, version[1],
+#ifndef USE_GLES
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#endif
+            EGL_NONE
+        };
+        ctx.context = eglCreateContext(ctx.display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (ctx.context != EGL_NO_CONTEXT) break;
+    }
+    if (ctx.context == EGL_NO_CONTEXT) {
+        std::cerr << "Headless: eglCreateContext failed (0x" << std::hex << eglGetError()
+                  << std::dec << ")" << std::endl;
+        DestroyHeadlessContext(ctx);
+        return false;
+    }
+
+    if (!eglMakeCurrent(ctx.display, ctx.surface, ctx.surface, ctx.context)) {
+        std::cerr << "Headless: eglMakeCurrent failed" << std::endl;
+        DestroyHeadlessContext(ctx);
+        return false;
+    }
+
+#ifdef USE_GLES
+    if (!gladLoadGLES2(reinterpret_cast<GLADloadfunc>(eglGetProcAddress))) {
+#else
+    if (!gladLoadGL(reinterpret_cast<GLADloadfunc>(eglGetProcAddress))) {
+#endif
+        std::cerr << "Headless: failed to load GL entry points" << std::endl;
+        DestroyHeadlessContext(ctx);
+        return false;
+    }
+    return true;
+}
+
+// ==========================================
+// Scenes
+// ==========================================
+
+// Scenes are a pure function of the frame index, so dumps of the same
+// frame are comparable between runs and builds.
+class HeadlessScene {
+public:
+    virtual ~HeadlessScene() {}
+    virtual bool Setup(IRenderer& renderer) { return true; }
+    virtual void Draw(IRenderer& renderer, int frame) = 0;
+};
+
+static void SpriteProjection(IRenderer& renderer) {
+    static const UniformID projectionID = InternUniform("projection");
+    Mat4 projection = renderer.OrthographicProjectionMatrix(0.0f, HeadlessWidth, HeadlessHeight, 0.0f, -1.0f, 1.0f);
+    renderer.SetUniformMatrix(projectionID, &projection.data[0][0]);
+}
+
+// Unit quad as a triangle strip: position, uv, palIndex
+static const std::vector<float> UnitQuad = {
+    0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+    1.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
+    1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
+};
+
+static const int SpriteColumns = 48;
+static const int SpriteRows = 27;
+
+// Column-major translate * scale for sprite i of the grid
+static void SpriteTransform(int i, int frame, float* m) {
+    const float cellW = float(HeadlessWidth) / SpriteColumns;
+    const float cellH = float(HeadlessHeight) / SpriteRows;
+    float phase = frame * 0.05f + i * 0.37f;
+    memset(m, 0, 16 * sizeof(float));
+    m[0] = cellW * 0.8f;
+    m[5] = cellH * 0.8f;
+    m[10] = 1.0f;
+    m[12] = (i % SpriteColumns) * cellW + cellW * 0.1f * std::sin(phase);
+    m[13] = (i / SpriteColumns) * cellH + cellH * 0.1f * std::cos(phase);
+    m[15] = 1.0f;
+}
+
+static const int SpriteShades = 8;
+
+// Tints cycle through a few shades, as sprites share palettes and color
+// effects; neighbours differ so submission order alternates between them
+static void SpriteTint(int i, int frame, float* tint) {
+    int shade = (i * 3 + frame / 8) % SpriteShades;
+    float phase = shade * (6.283f / SpriteShades);
+    tint[0] = 0.5f + 0.5f * std::sin(phase);
+    tint[1] = 0.5f + 0.5f * std::sin(phase + 2.094f);
+    tint[2] = 0.5f + 0.5f * std::sin(phase + 4.189f);
+    tint[3] = 1.0f;
+}
+
+// One draw call per flat-colored sprite, as the character and stage code
+// issues them
+class SpriteScene : public HeadlessScene {
+public:
+    void Draw(IRenderer& renderer, int frame) override {
+        static const UniformID modelviewID = InternUniform("modelview");
+        static const UniformID tintID = InternUniform("tint");
+        static const UniformID alphaID = InternUniform("alpha");
+        static const UniformID multID = InternUniform("mult");
+        static const UniformID isFlatID = InternUniform("isFlat");
+
+        renderer.SetPipeline(BlendEquation::Add, BlendFunc::One, BlendFunc::OneMinusSrcAlpha);
+        renderer.SetVertexData(UnitQuad);
+        SpriteProjection(renderer);
+
+        const float one = 1.0f;
+        const float mult[3] = {1.0f, 1.0f, 1.0f};
+        renderer.SetUniformI(isFlatID, 1);
+        renderer.SetUniformF(alphaID, &one, 1);
+        renderer.SetUniformF(multID, mult, 3);
+
+        float modelview[16], tint[4];
+        for (int i = 0; i < SpriteColumns * SpriteRows; ++i) {
+            SpriteTransform(i, frame, modelview);
+            SpriteTint(i, frame, tint);
+            renderer.SetUniformMatrix(modelviewID, modelview);
+            renderer.SetUniformF(tintID, tint, 4);
+            renderer.RenderQuad();
+        }
+        renderer.ReleasePipeline();
+    }
+};
+
+// The same grid through RenderQuadInstanced
+class InstancedSpriteScene : public HeadlessScene {
+public:
+    void Draw(IRenderer& renderer, int frame) override {
+        static const UniformID isFlatID = InternUniform("isFlat");
+
+        renderer.SetPipelineInstanced(BlendEquation::Add, BlendFunc::One, BlendFunc::OneMinusSrcAlpha);
+        renderer.SetVertexData(UnitQuad);
+        SpriteProjection(renderer);
+        renderer.SetUniformI(isFlatID, 1);
+
+        instances.resize(SpriteColumns * SpriteRows);
+        for (int i = 0; i < static_cast<int>(instances.size()); ++i) {
+            SpriteInstance& instance = instances[i];
+            SpriteTransform(i, frame, instance.modelview);
+            SpriteTint(i, frame, instance.tint);
+            instance.add[0] = instance.add[1] = instance.add[2] = 0.0f;
+            instance.alpha = 1.0f;
+            instance.mult[0] = instance.mult[1] = instance.mult[2] = 1.0f;
+            instance.palIndex = 0.0f;
+        }
+        renderer.RenderQuadInstanced(instances.data(), static_cast<int32_t>(instances.size()));
+        renderer.ReleasePipeline();
+    }
+
+private:
+    std::vector<SpriteInstance> instances;
+};
+
+// The same grid through the SpriteBatcher, transforms baked into the
+// vertices; sprites of a shade merge into one draw. The first frame
+// reports the cost of drawing the sprites in submission order against
+// the batched cost.
+class BatchedSpriteScene : public HeadlessScene {
+public:
+    BatchedSpriteScene() : batcher(nullptr) {}
+    ~BatchedSpriteScene() { delete batcher; }
+
+    bool Setup(IRenderer& renderer) override {
+        batcher = new SpriteBatcher(&renderer);
+        return true;
+    }
+
+    void Draw(IRenderer& renderer, int frame) override {
+        renderer.SetPipeline(BlendEquation::Add, BlendFunc::One, BlendFunc::OneMinusSrcAlpha);
+        SpriteProjection(renderer);
+
+        SpriteParams params;
+        float modelview[16], vertices[20];
+        batcher->Begin();
+        for (int i = 0; i < SpriteColumns * SpriteRows; ++i) {
+            SpriteTransform(i, frame, modelview);
+            SpriteTint(i, frame, params.tint);
+            for (int v = 0; v < 4; ++v) {
+                const float* corner = &UnitQuad[v * 5];
+                vertices[v * 5 + 0] = modelview[0] * corner[0] + modelview[12];
+                vertices[v * 5 + 1] = modelview[5] * corner[1] + modelview[13];
+                vertices[v * 5 + 2] = corner[2];
+                vertices[v * 5 + 3] = corner[3];
+                vertices[v * 5 + 4] = corner[4];
+            }
+            batcher->Draw(0, BlendEquation::Add, BlendFunc::One, BlendFunc::OneMinusSrcAlpha,
+                          nullptr, nullptr, SpriteFlagFlat, params, vertices);
+        }
+        batcher->End();
+
+        if (frame == 0) {
+            const SpriteBatchStats& stats = batcher->GetStats();
+            printf("Headless: %u sprites, unbatched %u draw calls and %u state changes, "
+                   "batched %u draw calls and %u state changes\n", stats.quads, stats.quads,
+                   stats.submittedChanges, stats.drawCalls, stats.StateChanges());
+        }
+    }
+
+private:
+    SpriteBatcher* batcher;
+};
+
+static const int ModelColumns = 12;
+static const int ModelRows = 7;
+
+// Unlit vertex-colored cubes, one primitive each, through the model
+// pipeline; one RenderElements per cube, or all of them in a single
+// RenderElementsMultiDraw
+class ModelScene : public HeadlessScene {
+public:
+    explicit ModelScene(bool multiDraw) : multiDraw(multiDraw) {}
+
+    bool Setup(IRenderer& renderer) override {
+        if (renderer.InitModelShader() != 0) {
+            std::cerr << "Headless: model shaders failed to load" << std::endl;
+            return false;
+        }
+
+        // Planar layout (see ModelVertexAttributes): vertexId, position, vertColor
+        std::vector<int32_t> ids(CubeVertices);
+        std::vector<float> positions, colors;
+        for (int v = 0; v < CubeVertices; ++v) {
+            float x = (v & 1) ? 0.5f : -0.5f;
+            float y = (v & 2) ? 0.5f : -0.5f;
+            float z = (v & 4) ? 0.5f : -0.5f;
+            ids[v] = v;
+            positions.insert(positions.end(), {x, y, z});
+            colors.insert(colors.end(), {x + 0.5f, y + 0.5f, z + 0.5f, 1.0f});
+        }
+        std::vector<uint8_t> vertexData;
+        Append(vertexData, ids.data(), ids.size() * sizeof(int32_t));
+        Append(vertexData, positions.data(), positions.size() * sizeof(float));
+        Append(vertexData, colors.data(), colors.size() * sizeof(float));
+        renderer.SetModelVertexData(0, vertexData);
+
+        static const uint32_t faces[6][4] = {
+            {0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5}
+        };
+        std::vector<uint32_t> indices;
+        for (const auto& face : faces) {
+            indices.insert(indices.end(), {face[0], face[1], face[2], face[0], face[2], face[3]});
+        }
+        renderer.SetModelIndexData(0, indices);
+        indexCount = static_cast<int>(indices.size());
+        return true;
+    }
+
+    void Draw(IRenderer& renderer, int frame) override {
+        static const UniformID projectionID = InternUniform("projection");
+        static const UniformID viewID = InternUniform("view");
+        static const UniformID modelID = InternUniform("model");
+        static const UniformID normalMatrixID = InternUniform("normalMatrix");
+        static const UniformID baseColorFactorID = InternUniform("baseColorFactor");
+        static const UniformID multID = InternUniform("mult");
+        static const UniformID unlitID = InternUniform("unlit");
+
+        renderer.prepareModelPipeline(0, nullptr);
+
+        Mat4 projection = renderer.PerspectiveProjectionMatrix(0.8f, float(HeadlessWidth) / HeadlessHeight, 0.1f, 100.0f);
+        mat4x4 view;
+        vec3 eye = {0.0f, 0.0f, 14.0f}, center = {0.0f, 0.0f, 0.0f}, up = {0.0f, 1.0f, 0.0f};
+        mat4x4_look_at(view, eye, center, up);
+        renderer.SetModelUniformMatrix(projectionID, &projection.data[0][0]);
+        renderer.SetModelUniformMatrix(viewID, &view[0][0]);
+
+        mat4x4 identity;
+        mat4x4_identity(identity);
+        const float baseColor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        const float mult[3] = {1.0f, 1.0f, 1.0f};
+        renderer.SetModelUniformMatrix(normalMatrixID, &identity[0][0]);
+        renderer.SetModelUniformF(baseColorFactorID, baseColor, 4);
+        renderer.SetModelUniformF(multID, mult, 3);
+        renderer.SetModelUniformI(unlitID, 1);
+
+        draws.resize(ModelColumns * ModelRows);
+        for (int i = 0; i < ModelColumns * ModelRows; ++i) {
+            mat4x4 translate, model;
+            float angle = frame * 0.03f + i * 0.5f;
+            mat4x4_translate(translate, (i % ModelColumns - (ModelColumns - 1) * 0.5f) * 1.6f,
+                             (i / ModelColumns - (ModelRows - 1) * 0.5f) * 1.6f, 0.0f);
+            mat4x4_rotate_Y(model, translate, angle);
+            mat4x4_rotate_X(model, model, angle * 0.7f);
+            if (multiDraw) {
+                memcpy(draws[i].model, model, sizeof(draws[i].model));
+                draws[i].count = indexCount;
+                draws[i].offset = 0;
+                continue;
+            }
+            renderer.SetModelUniformMatrix(modelID, &model[0][0]);
+            SetPipeline(renderer);
+            renderer.RenderElements(PrimitiveMode::Triangles, indexCount, 0);
+        }
+        if (multiDraw) {
+            SetPipeline(renderer);
+            renderer.RenderElementsMultiDraw(PrimitiveMode::Triangles, draws.data(), static_cast<int32_t>(draws.size()));
+        }
+        renderer.ReleaseModelPipeline();
+    }
+
+private:
+    static const int CubeVertices = 8;
+    bool multiDraw;
+    int indexCount = 0;
+    std::vector<ModelDraw> draws;
+
+    static void SetPipeline(IRenderer& renderer) {
+        renderer.SetModelPipeline(BlendEquation::Add, BlendFunc::One, BlendFunc::Zero,
+                                  true, true, false, false,
+                                  false, false, false, true, false, false, false,
+                                  CubeVertices, 0);
+    }
+
+    static void Append(std::vector<uint8_t>& data, const void* src, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(src);
+        data.insert(data.end(), bytes, bytes + size);
+    }
+};
+
+static const int AtlasColumns = 40;
+static const int AtlasRows = 22;
+
+// Indexed sprites of mixed sizes packed into atlas pages and drawn through
+// the SpriteBatcher; sprites sharing a page merge into one draw. A third of
+// them are removed and the atlas defragmented before the first frame.
+class AtlasScene : public HeadlessScene {
+public:
+    AtlasScene() : atlas(nullptr), batcher(nullptr) {}
+    ~AtlasScene() {
+        delete batcher;
+        delete atlas;
+    }
+
+    bool Setup(IRenderer& renderer) override {
+        atlas = new SpriteAtlas(&renderer, 1024, 4);
+        batcher = new SpriteBatcher(&renderer);
+
+        handles.resize(AtlasColumns * AtlasRows);
+        std::vector<uint8_t> pixels;
+        for (int i = 0; i < static_cast<int>(handles.size()); ++i) {
+            // Concentric rings of palette indices
+            int width = 12 + (i * 37) % 36;
+            int height = 12 + (i * 53) % 36;
+            pixels.resize(width * height);
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    int dx = 2 * x - width, dy = 2 * y - height;
+                    pixels[y * width + x] = static_cast<uint8_t>(64 + (int(std::sqrt(float(dx * dx + dy * dy))) * 12 + i) % 192);
+                }
+            }
+            handles[i] = atlas->Add(pixels, width, height);
+            if (handles[i] == 0) return false;
+        }
+        for (size_t i = 0; i < handles.size(); i += 3) {
+            atlas->Remove(handles[i]);
+            handles[i] = 0;
+        }
+        atlas->Defragment();
+
+        SpriteAtlasStats stats = atlas->GetStats();
+        printf("Headless: atlas %u sprites on %u pages, %.1f%% of allocated texels live\n", stats.sprites,
+               stats.pages, 100.0 * stats.livePixels / std::max<int64_t>(stats.allocatedPixels, 1));
+        return true;
+    }
+
+    void Draw(IRenderer& renderer, int frame) override {
+        const float cellW = float(HeadlessWidth) / AtlasColumns;
+        const float cellH = float(HeadlessHeight) / AtlasRows;
+
+        renderer.SetPipeline(BlendEquation::Add, BlendFunc::One, BlendFunc::OneMinusSrcAlpha);
+        SpriteProjection(renderer);
+
+        // isRgba reads the palette index as red; the headless context has
+        // no palette loader
+        SpriteParams params;
+        batcher->Begin();
+        for (int i = 0; i < static_cast<int>(handles.size()); ++i) {
+            SpriteAtlasRegion region;
+            if (!atlas->Lookup(handles[i], region)) continue;
+            atlas->Touch(handles[i]);
+
+            float x = (i % AtlasColumns) * cellW + cellW * 0.1f * std::sin(frame * 0.05f + i);
+            float y = (i / AtlasColumns) * cellH;
+            float vertices[20];
+            for (int v = 0; v < 4; ++v) {
+                vertices[v * 5 + 0] = x + (v & 1) * region.width;
+                vertices[v * 5 + 1] = y + (v >> 1) * region.height;
+                vertices[v * 5 + 2] = float(v & 1);
+                vertices[v * 5 + 3] = float(v >> 1);
+                vertices[v * 5 + 4] = 0.0f;
+            }
+            SpriteAtlas::MapVertices(region, vertices);
+            batcher->Draw(0, BlendEquation::Add, BlendFunc::One, BlendFunc::OneMinusSrcAlpha,
+                          atlas->GetPage(region.page), nullptr, SpriteFlagRgba, params, vertices);
+        }
+        batcher->End();
+        atlas->NextFrame();
+
+        if (frame == 0) {
+            const SpriteBatchStats& stats = batcher->GetStats();
+            printf("Headless: %u atlas sprites in %u draw calls\n", stats.quads, stats.drawCalls);
+        }
+    }
+
+private:
+    SpriteAtlas* atlas;
+    SpriteBatcher* batcher;
+    std::vector<SpriteAtlasHandle> handles;
+};
+
+static const int NormalCubeVertices = 24;
+
+// Unit cube with flat normals, in the planar layout (see
+// ModelVertexAttributes): vertexId, position, normal
+static void BuildNormalCube(std::vector<uint8_t>& vertexData, std::vector<uint32_t>& indices) {
+    static const float axes[6][3][3] = {
+        {{1, 0, 0}, {0, 0, -1}, {0, 1, 0}}, {{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+        {{0, 1, 0}, {1, 0, 0}, {0, 0, -1}}, {{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+        {{0, 0, 1}, {1, 0, 0}, {0, 1, 0}}, {{0, 0, -1}, {-1, 0, 0}, {0, 1, 0}}
+    };
+    std::vector<int32_t> ids(NormalCubeVertices);
+    std::vector<float> positions, normals;
+    for (int face = 0; face < 6; ++face) {
+        const float* n = axes[face][0];
+        const float* u = axes[face][1];
+        const float* v = axes[face][2];
+        for (int corner = 0; corner < 4; ++corner) {
+            float su = (corner & 1) ? 0.5f : -0.5f;
+            float sv = (corner & 2) ? 0.5f : -0.5f;
+            for (int c = 0; c < 3; ++c) {
+                positions.push_back(n[c] * 0.5f + u[c] * su + v[c] * sv);
+                normals.push_back(n[c]);
+            }
+        }
+        uint32_t base = face * 4;
+        indices.insert(indices.end(), {base, base + 1, base + 3, base, base + 3, base + 2});
+    }
+    for (int v = 0; v < NormalCubeVertices; ++v) {
+        ids[v] = v;
+    }
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(ids.data());
+    vertexData.insert(vertexData.end(), bytes, bytes + ids.size() * sizeof(int32_t));
+    bytes = reinterpret_cast<const uint8_t*>(positions.data());
+    vertexData.insert(vertexData.end(), bytes, bytes + positions.size() * sizeof(float));
+    bytes = reinterpret_cast<const uint8_t*>(normals.data());
+    vertexData.insert(vertexData.end(), bytes, bytes + normals.size() * sizeof(float));
+}
+
+// Cubes lit only by an environment baked from a procedural sky at setup;
+// metallic rises along the columns and roughness down the rows. Setup
+// reports the bake time, the storage the prefiltered textures hold and
+// whether they came from the environment cache (a second run hits it).
+// With a filtering budget the bake is spread over the first frames.
+class IBLScene : public HeadlessScene {
+public:
+    explicit IBLScene(float budget) : budget(budget) {}
+
+    bool Setup(IRenderer& renderer) override {
+        if (renderer.InitModelShader() != 0) {
+            std::cerr << "Headless: model shaders failed to load" << std::endl;
+            return false;
+        }
+        // The IBL programs link in the background; these frames are not timed
+        for (int frame = 0; frame < 1000 && !renderer.IsIBLReady(); ++frame) {
+            renderer.BeginFrame(true);
+            renderer.EndFrame();
+        }
+
+        // Settings llvmpipe bakes in seconds; the defaults are for GPUs
+        env.cubeSize = 256;
+        env.lambertianSize = 32;
+        env.lambertianSamples = 128;
+        env.GGXSize = 128;
+        env.GGXSamples = 128;
+        env.LUTSize = 128;
+        env.LUTSamples = 128;
+
+        std::vector<float> panorama;
+        BuildPanorama(panorama);
+        auto start = std::chrono::steady_clock::now();
+        bool baked = budget > 0.0f ? env.BeginBake(renderer, panorama, PanoramaWidth, PanoramaHeight)
+                                   : env.Bake(renderer, panorama, PanoramaWidth, PanoramaHeight);
+        if (!baked) {
+            return false;
+        }
+        renderer.Await();
+        printf("Headless: %s precision environment ready in %.1f ms, %.2f MiB (cubemaps %s, LUT %s)\n",
+               renderer.GetIBLPrecision() == IBLPrecision::Half ? "half" : "full",
+               std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+               env.GetMemorySize() / (1024.0 * 1024.0),
+               env.IsCubeMapCached() ? "cached" : "filtered", env.IsLUTCached() ? "cached" : "filtered");
+
+        std::vector<uint8_t> vertexData;
+        std::vector<uint32_t> indices;
+        BuildNormalCube(vertexData, indices);
+        renderer.SetModelVertexData(0, vertexData);
+        renderer.SetModelIndexData(0, indices);
+        indexCount = static_cast<int>(indices.size());
+        return true;
+    }
+
+    void Draw(IRenderer& renderer, int frame) override {
+        static const UniformID projectionID = InternUniform("projection");
+        static const UniformID viewID = InternUniform("view");
+        static const UniformID modelID = InternUniform("model");
+        static const UniformID normalMatrixID = InternUniform("normalMatrix");
+        static const UniformID baseColorFactorID = InternUniform("baseColorFactor");
+        static const UniformID multID = InternUniform("mult");
+        static const UniformID unlitID = InternUniform("unlit");
+        static const UniformID cameraPositionID = InternUniform("cameraPosition");
+        static const UniformID metallicRoughnessID = InternUniform("metallicRoughness");
+
+        if (env.IsBaking()) {
+            ScopedGPURegion region(renderer, "IBL filter");
+            if (env.Update(renderer, budget)) {
+                printf("Headless: environment filtered by frame %d\n", frame);
+            }
+        }
+        renderer.prepareModelPipeline(0, &env);
+
+        Mat4 projection = renderer.PerspectiveProjectionMatrix(0.8f, float(HeadlessWidth) / HeadlessHeight, 0.1f, 100.0f);
+        mat4x4 view;
+        vec3 eye = {0.0f, 0.0f, 14.0f}, center = {0.0f, 0.0f, 0.0f}, up = {0.0f, 1.0f, 0.0f};
+        mat4x4_look_at(view, eye, center, up);
+        renderer.SetModelUniformMatrix(projectionID, &projection.data[0][0]);
+        renderer.SetModelUniformMatrix(viewID, &view[0][0]);
+        renderer.SetModelUniformF(cameraPositionID, eye, 3);
+
+        const float baseColor[4] = {0.9f, 0.7f, 0.5f, 1.0f};
+        const float mult[3] = {1.0f, 1.0f, 1.0f};
+        renderer.SetModelUniformF(baseColorFactorID, baseColor, 4);
+        renderer.SetModelUniformF(multID, mult, 3);
+        renderer.SetModelUniformI(unlitID, 0);
+
+        for (int i = 0; i < ModelColumns * ModelRows; ++i) {
+            int column = i % ModelColumns;
+            int row = i / ModelColumns;
+            mat4x4 translate, model;
+            float angle = frame * 0.03f + i * 0.5f;
+            mat4x4_translate(translate, (column - (ModelColumns - 1) * 0.5f) * 1.6f,
+                             (row - (ModelRows - 1) * 0.5f) * 1.6f, 0.0f);
+            mat4x4_rotate_Y(model, translate, angle);
+            mat4x4_rotate_X(model, model, angle * 0.7f);
+            renderer.SetModelUniformMatrix(modelID, &model[0][0]);
+            // Rotation only, so the model matrix transforms normals as well
+            renderer.SetModelUniformMatrix(normalMatrixID, &model[0][0]);
+
+            const float metallicRoughness[2] = {float(column) / (ModelColumns - 1), float(row) / (ModelRows - 1)};
+            renderer.SetModelUniformF(metallicRoughnessID, metallicRoughness, 2);
+
+            renderer.SetModelPipeline(BlendEquation::Add, BlendFunc::One, BlendFunc::Zero,
+                                      true, true, false, false,
+                                      false, true, false, false, false, false, false,
+                                      NormalCubeVertices, 0);
+            renderer.RenderElements(PrimitiveMode::Triangles, indexCount, 0);
+        }
+        renderer.ReleaseModelPipeline();
+    }
+
+private:
+    static const int PanoramaWidth = 256;
+    static const int PanoramaHeight = 128;
+    float budget;
+    Environment env;
+    int indexCount = 0;
+
+    // Blue sky over brown ground with a small bright sun, in linear HDR
+    static void BuildPanorama(std::vector<float>& panorama) {
+        panorama.resize(PanoramaWidth * PanoramaHeight * 3);
+        for (int y = 0; y < PanoramaHeight; ++y) {
+            float elevation = 1.0f - 2.0f * (y + 0.5f) / PanoramaHeight;
+            for (int x = 0; x < PanoramaWidth; ++x) {
+                float* texel = &panorama[(y * PanoramaWidth + x) * 3];
+                if (elevation > 0.0f) {
+                    texel[0] = 0.3f + 0.3f * (1.0f - elevation);
+                    texel[1] = 0.5f + 0.3f * (1.0f - elevation);
+                    texel[2] = 1.0f;
+                } else {
+                    texel[0] = 0.25f;
+                    texel[1] = 0.18f;
+                    texel[2] = 0.1f;
+                }
+                float dx = (x - PanoramaWidth * 0.3f) / 4.0f;
+                float dy = (y - PanoramaHeight * 0.25f) / 4.0f;
+                if (dx * dx + dy * dy < 1.0f) {
+                    texel[0] = texel[1] = 50.0f;
+                    texel[2] = 40.0f;
+                }
+            }
+        }
+    }
+
+};
+
+// A floor with a ring of spinning cubes and a still cluster in the middle,
+// lit by a directional light with two cascades, a point light over the
+// cluster and a spot light, all shadowed through one ShadowAtlas. Only the
+// ring moves and it stays out of the point light's reach, so the point
+// light's six views render once; Setup and the first frame report the plan.
+class ShadowScene : public HeadlessScene {
+public:
+    bool Setup(IRenderer& renderer) override {
+        renderer.SetShadowAtlasSize(2048);
+        if (renderer.InitModelShader() != 0) {
+            std::cerr << "Headless: model shaders failed to load" << std::endl;
+            return false;
+        }
+        // The shadow program links in the background; these frames are not timed
+        for (int frame = 0; frame < 1000 && !renderer.IsShadowReady(); ++frame) {
+            renderer.BeginFrame(true);
+            renderer.EndFrame();
+        }
+        if (!renderer.IsShadowReady()) {
+            std::cerr << "Headless: shadow atlas unavailable" << std::endl;
+            return false;
+        }
+        // The renderer clamps the size to what the driver supports
+        atlas = ShadowAtlas(renderer.GetShadowAtlasSize());
+
+        std::vector<uint8_t> vertexData;
+        std::vector<uint32_t> indices;
+        BuildNormalCube(vertexData, indices);
+        renderer.SetModelVertexData(0, vertexData);
+        renderer.SetModelIndexData(0, indices);
+        indexCount = static_cast<int>(indices.size());
+        return true;
+    }
+
+    void Draw(IRenderer& renderer, int frame) override {
+        static const UniformID projectionID = InternUniform("projection");
+        static const UniformID viewID = InternUniform("view");
+        static const UniformID modelID = InternUniform("model");
+        static const UniformID normalMatrixID = InternUniform("normalMatrix");
+        static const UniformID baseColorFactorID = InternUniform("baseColorFactor");
+        static const UniformID multID = InternUniform("mult");
+        static const UniformID unlitID = InternUniform("unlit");
+        static const UniformID cameraPositionID = InternUniform("cameraPosition");
+        static const UniformID metallicRoughnessID = InternUniform("metallicRoughness");
+
+        Mat4 projection = renderer.PerspectiveProjectionMatrix(0.8f, float(HeadlessWidth) / HeadlessHeight, 0.1f, 100.0f);
+        mat4x4 view;
+        vec3 eye = {0.0f, 9.0f, 15.0f}, center = {0.0f, 0.0f, 1.0f}, up = {0.0f, 1.0f, 0.0f};
+        mat4x4_look_at(view, eye, center, up);
+
+        Caster casters[CasterCount];
+        PlaceCasters(frame, casters);
+        LightView lights[LightCount];
+        PlaceLights(frame, view, projection.data, lights);
+
+        std::vector<ShadowLight> shadowLights(LightCount);
+        for (int i = 0; i < LightCount; ++i) {
+            shadowLights[i] = lights[i].shadow;
+        }
+        atlas.Update(shadowLights);
+        if (frame == 0) {
+            ShadowAtlasStats stats = atlas.GetStats();
+            printf("Headless: %d x %d shadow atlas, %u lights in %u views, %.0f%% used\n", atlas.GetSize(),
+                   atlas.GetSize(), stats.lights, stats.views,
+                   100.0 * stats.usedTexels / (double(atlas.GetSize()) * atlas.GetSize()));
+        }
+
+        {
+            ScopedGPURegion region(renderer, "Shadows");
+            renderer.prepareShadowMapPipeline(0);
+            for (int i = 0; i < LightCount; ++i) {
+                if (!atlas.NeedsRender(i)) continue;
+                const LightView& light = lights[i];
+                renderer.SetShadowMapUniformI("lightType", static_cast<int>(light.shadow.type));
+                renderer.SetShadowMapUniformF("lightPosition", {light.position[0], light.position[1], light.position[2]});
+                renderer.SetShadowMapUniformF("farPlane", {light.range});
+                for (int v = 0; v < atlas.GetViewCount(i); ++v) {
+                    const ShadowAtlasView& tile = atlas.GetView(i, v);
+                    renderer.SetShadowAtlasView(tile.x, tile.y, tile.size);
+                    mat4x4 lightVP;
+                    if (light.shadow.type == ShadowLightType::Point) {
+                        ShadowCubeFaceMatrix(lightVP, light.position, 0.1f, light.range, v);
+                    } else if (light.shadow.type == ShadowLightType::Directional) {
+                        ShadowCascadeMatrix(lightVP, light.matrix, atlas.GetCascade(i, v));
+                    } else {
+                        mat4x4_dup(lightVP, light.matrix);
+                    }
+                    renderer.SetShadowMapUniformMatrix("lightVP", std::vector<float>(&lightVP[0][0], &lightVP[0][0] + 16));
+                    for (const Caster& caster : casters) {
+                        renderer.SetShadowMapUniformMatrix("model", std::vector<float>(&caster.model[0][0], &caster.model[0][0] + 16));
+                        renderer.setShadowMapPipeline(false, false, false, true, false, false, false, false,
+                                                      NormalCubeVertices, 0);
+                        renderer.RenderShadowMapElements(PrimitiveMode::Triangles, indexCount, 0);
+                    }
+                }
+            }
+            renderer.ReleaseShadowPipeline();
+        }
+
+        renderer.prepareModelPipeline(0, nullptr);
+        renderer.SetModelUniformMatrix(projectionID, &projection.data[0][0]);
+        renderer.SetModelUniformMatrix(viewID, &view[0][0]);
+        renderer.SetModelUniformF(cameraPositionID, eye, 3);
+        for (int i = 0; i < LightCount; ++i) {
+            const LightView& light = lights[i];
+            std::string name = "lights[" + std::to_string(i) + "].";
+            renderer.SetModelUniformF(name + "direction", {light.direction[0], light.direction[1], light.direction[2]});
+            renderer.SetModelUniformF(name + "range", {light.range});
+            renderer.SetModelUniformF(name + "color", {light.color[0], light.color[1], light.color[2]});
+            renderer.SetModelUniformF(name + "intensity", {light.intensity});
+            renderer.SetModelUniformF(name + "position", {light.position[0], light.position[1], light.position[2]});
+            renderer.SetModelUniformF(name + "innerConeCos", {light.innerConeCos});
+            renderer.SetModelUniformF(name + "outerConeCos", {light.outerConeCos});
+            renderer.SetModelUniformI(name + "type", static_cast<int>(light.shadow.type));
+            renderer.SetModelUniformF(name + "shadowBias", {light.bias});
+            renderer.SetModelUniformF(name + "shadowMapFar", {light.range});
+            renderer.SetModelUniformMatrix("lightMatrices[" + std::to_string(i) + "]",
+                                           std::vector<float>(&light.matrix[0][0], &light.matrix[0][0] + 16));
+        }
+        renderer.SetModelUniformFv("shadowAtlasRects", atlas.GetRects());
+        renderer.SetModelUniformFv("shadowCascades", atlas.GetCascades());
+
+        const float mult[3] = {1.0f, 1.0f, 1.0f};
+        const float metallicRoughness[2] = {0.0f, 0.6f};
+        renderer.SetModelUniformF(multID, mult, 3);
+        renderer.SetModelUniformF(metallicRoughnessID, metallicRoughness, 2);
+        renderer.SetModelUniformI(unlitID, 0);
+        for (const Caster& caster : casters) {
+            renderer.SetModelUniformMatrix(modelID, &caster.model[0][0]);
+            renderer.SetModelUniformMatrix(normalMatrixID, &caster.normalMatrix[0][0]);
+            renderer.SetModelUniformF(baseColorFactorID, caster.color, 4);
+            renderer.SetModelPipeline(BlendEquation::Add, BlendFunc::One, BlendFunc::Zero,
+                                      true, true, false, false,
+                                      false, true, false, false, false, false, false,
+                                      NormalCubeVertices, 0);
+            renderer.RenderElements(PrimitiveMode::Triangles, indexCount, 0);
+        }
+        renderer.ReleaseModelPipeline();
+    }
+
+private:
+    static const int ClusterCount = 3;
+    static const int RingCount = 6;
+    static const int CasterCount = 1 + ClusterCount + RingCount;
+    static const int LightCount = 3;
+
+    struct Caster {
+        mat4x4 model;
+        mat4x4 normalMatrix;
+        float color[4];
+    };
+
+    struct LightView {
+        ShadowLight shadow;
+        float position[3];
+        float direction[3];
+        float color[3];
+        float intensity;
+        float range;
+        float innerConeCos;
+        float outerConeCos;
+        float bias;
+        mat4x4 matrix;      // lightMatrices: the whole light area; unused by point lights
+    };
+
+    ShadowAtlas atlas;
+    int indexCount = 0;
+
+    // Floor, cluster, then the ring
+    static void PlaceCasters(int frame, Caster* casters) {
+        static const float cluster[ClusterCount][4] = {
+            {1.2f, 0.5f, 0.3f, 1.0f}, {-1.0f, 0.4f, 1.0f, 0.8f}, {0.1f, 0.7f, -1.3f, 1.4f}
+        };
+        for (int i = 0; i < CasterCount; ++i) {
+            Caster& caster = casters[i];
+            mat4x4_identity(caster.model);
+            if (i == 0) {
+                mat4x4_translate(caster.model, 0.0f, -0.1f, 0.0f);
+                mat4x4_scale_aniso(caster.model, caster.model, 24.0f, 0.2f, 24.0f);
+                SetColor(caster.color, 0.8f, 0.8f, 0.75f);
+            } else if (i <= ClusterCount) {
+                const float* c = cluster[i - 1];
+                mat4x4_translate(caster.model, c[0], c[3] * 0.5f, c[2]);
+                mat4x4_rotate_Y(caster.model, caster.model, c[1]);
+                mat4x4_scale_aniso(caster.model, caster.model, c[3], c[3], c[3]);
+                SetColor(caster.color, 0.9f, 0.4f, 0.3f);
+            } else {
+                // Radius 7.5 keeps the ring outside the point light's range
+                float angle = frame * 0.02f + (i - 1 - ClusterCount) * 6.2831853f / RingCount;
+                mat4x4_translate(caster.model, 7.5f * std::sin(angle), 1.0f, 7.5f * std::cos(angle));
+                mat4x4_rotate_Y(caster.model, caster.model, frame * 0.05f + i);
+                mat4x4_scale_aniso(caster.model, caster.model, 1.0f, 2.0f, 1.0f);
+                SetColor(caster.color, 0.3f, 0.6f, 0.9f);
+            }
+            mat4x4 inverse;
+            mat4x4_invert(inverse, caster.model);
+            mat4x4_transpose(caster.normalMatrix, inverse);
+        }
+    }
+
+    static void PlaceLights(int frame, mat4x4 const view, mat4x4 const projection, LightView* lights) {
+        for (int i = 0; i < LightCount; ++i) {
+            lights[i] = LightView();
+            lights[i].innerConeCos = lights[i].outerConeCos = 0.0f;
+        }
+        vec3 up = {0.0f, 1.0f, 0.0f}, origin = {0.0f, 0.0f, 0.0f};
+
+        // Directional: ortho over the floor, cascades around the camera's target
+        LightView& sun = lights[0];
+        sun.shadow.type = ShadowLightType::Directional;
+        sun.shadow.importance = 1.0f;
+        sun.shadow.cascades = 2;
+        sun.shadow.casterVersion = frame;
+        SetVector(sun.direction, -0.4f, -1.0f, -0.5f);
+        vec3_norm(sun.direction, sun.direction);
+        SetVector(sun.color, 1.0f, 0.95f, 0.85f);
+        sun.intensity = 2.0f;
+        sun.range = 0.0f;
+        sun.bias = 0.002f;
+        {
+            vec3 eye;
+            vec3_scale(eye, sun.direction, -20.0f);
+            mat4x4 lightView, lightProjection;
+            mat4x4_look_at(lightView, eye, origin, up);
+            mat4x4_ortho(lightProjection, -13.0f, 13.0f, -13.0f, 13.0f, 1.0f, 45.0f);
+            mat4x4_mul(sun.matrix, lightProjection, lightView);
+            vec4 target = {0.0f, 0.0f, 1.0f, 1.0f}, projected;
+            mat4x4_mul_vec4(projected, sun.matrix, target);
+            sun.shadow.focus[0] = projected[0] * 0.5f + 0.5f;
+            sun.shadow.focus[1] = projected[1] * 0.5f + 0.5f;
+        }
+
+        // Point light over the cluster: nothing in its range ever moves
+        LightView& lamp = lights[1];
+        lamp.shadow.type = ShadowLightType::Point;
+        lamp.shadow.casterVersion = 0;
+        SetVector(lamp.position, 0.0f, 2.6f, 0.0f);
+        SetVector(lamp.color, 1.0f, 0.6f, 0.3f);
+        lamp.intensity = 25.0f;
+        lamp.range = 6.0f;
+        lamp.bias = 0.05f;
+        lamp.shadow.importance = ShadowImportance(lamp.position, lamp.range, view, projection);
+        mat4x4_identity(lamp.matrix);
+
+        // Spot light sweeping over the ring
+        LightView& spot = lights[2];
+        spot.shadow.type = ShadowLightType::Spot;
+        spot.shadow.casterVersion = frame;
+        SetVector(spot.position, -6.0f, 8.0f, 6.0f);
+        vec3 target = {4.0f * std::sin(frame * 0.01f), 0.0f, 0.0f};
+        vec3_sub(spot.direction, target, spot.position);
+        vec3_norm(spot.direction, spot.direction);
+        SetVector(spot.color, 0.4f, 0.6f, 1.0f);
+        spot.intensity = 150.0f;
+        spot.range = 25.0f;
+        spot.innerConeCos = std::cos(0.4f);
+        spot.outerConeCos = std::cos(0.5f);
+        spot.bias = 0.05f;
+        spot.shadow.importance = ShadowImportance(spot.position, spot.range, view, projection);
+        {
+            mat4x4 lightView, lightProjection;
+            mat4x4_look_at(lightView, spot.position, target, up);
+            mat4x4_perspective(lightProjection, 1.05f, 1.0f, 0.1f, spot.range);
+            mat4x4_mul(spot.matrix, lightProjection, lightView);
+        }
+    }
+
+    static void SetVector(float* v, float x, float y, float z) {
+        v[0] = x;
+        v[1] = y;
+        v[2] = z;
+    }
+
+    static void SetColor(float* color, float r, float g, float b) {
+        SetVector(color, r, g, b);
+        color[3] = 1.0f;
+    }
+};
+
+static HeadlessScene* CreateScene(const HeadlessOptions& options) {
+    const std::string& name = options.scene;
+    if (name == "sprites") return new SpriteScene();
+    if (name == "instanced") return new InstancedSpriteScene();
+    if (name == "batched") return new BatchedSpriteScene();
+    if (name == "models") return new ModelScene(false);
+    if (name == "multidraw") return new ModelScene(true);
+    if (name == "atlas") return new AtlasScene();
+    if (name == "ibl") return new IBLScene(options.iblBudget);
+    if (name == "shadows") return new ShadowScene();
+    return nullptr;
+}
+
+// ==========================================
+// Runner
+// ==========================================
+
+// GPU time per frame from GL_TIMESTAMP query pairs (GL_TIME_ELAPSED could
+// not nest with timer queries of the renderer); results are collected
+// after the run so the queries never stall the pipeline. GLES has no
+// timer queries without EXT_disjoint_timer_query and reports none.
+class FrameTimer {
+public:
+    explicit FrameTimer(int frames) {
+#ifndef USE_GLES
+        queries.resize(frames * 2);
+        glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+#endif
+    }
+    ~FrameTimer() {
+        if (!queries.empty()) glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+    }
+
+    void Begin(int frame) {
+#ifndef USE_GLES
+        glQueryCounter(queries[frame * 2], GL_TIMESTAMP);
+#endif
+    }
+    void End(int frame) {
+#ifndef USE_GLES
+        glQueryCounter(queries[frame * 2 + 1], GL_TIMESTAMP);
+#endif
+    }
+
+    // Milliseconds, or a negative value without timer queries
+    double Milliseconds(int frame) const {
+#ifndef USE_GLES
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(queries[frame * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[frame * 2 + 1], GL_QUERY_RESULT, &end);
+        return (end - begin) / 1.0e6;
+#else
+        return -1.0;
+#endif
+    }
+
+private:
+    std::vector<GLuint> queries;
+};
+
+static void PrintTimingSummary(const char* label, std::vector<double> times) {
+    if (times.empty() || times[0] < 0.0) {
+        printf("%s: n/a\n", label);
+        return;
+    }
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for (double t : times) sum += t;
+    printf("%s: avg %.3f ms, min %.3f ms, p95 %.3f ms, max %.3f ms\n", label, sum / times.size(),
+           times.front(), times[std::min(times.size() - 1, times.size() * 95 / 100)], times.back());
+}
+
+// GL calls issued and skipped as redundant by the state cache, per kind
+static void PrintStateCacheStats(const StateCacheStats& stats) {
+    uint64_t calls = 0, redundant = 0;
+    for (int i = 0; i < static_cast<int>(StateCall::Count); ++i) {
+        if (stats.calls[i] == 0) continue;
+        printf("state %-12s %10llu calls %10llu redundant (%.1f%%)\n", GetStateCallName(static_cast<StateCall>(i)),
+               (unsigned long long)stats.calls[i], (unsigned long long)stats.redundant[i],
+               100.0 * stats.redundant[i] / stats.calls[i]);
+        calls += stats.calls[i];
+        redundant += stats.redundant[i];
+    }
+    printf("state total: %llu calls, %llu redundant skipped\n", (unsigned long long)calls,
+           (unsigned long long)redundant);
+}
+
+static bool DumpFrame(IRenderer& renderer, const std::string& dir, int frame, std::vector<uint8_t>& pixels) {
+    renderer.ReadPixels(pixels, HeadlessWidth, HeadlessHeight);
+
+    char name[32];
+    snprintf(name, sizeof(name), "frame%05d.png", frame);
+    std::string path = (std::filesystem::path(dir) / name).string();
+    // GL rows start at the bottom
+    stbi_flip_vertically_on_write(1);
+    if (!stbi_write_png(path.c_str(), HeadlessWidth, HeadlessHeight, 4, pixels.data(), HeadlessWidth * 4)) {
+        std::cerr << "Headless: failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Renderer for the current context, configured from options. An empty
+// shaderCache keeps the renderer's default cache directory.
+static IRenderer* CreateHeadlessRenderer(const HeadlessOptions& options, const std::string& shaderCache) {
+    IRenderer* renderer = Renderer::Create();
+    renderer->SetProcLoader(reinterpret_cast<GLProcLoader>(eglGetProcAddress));
+    renderer->SetIBLPrecision(options.iblFullPrecision ? IBLPrecision::Full : IBLPrecision::Half);
+    renderer->SetGPUProfiling(!options.gpuTrace.empty());
+    CPUProfiler::SetEnabled(!options.cpuTrace.empty());
+    CPUProfiler::SetThreadName("Headless");
+    renderer->GetGPUProfiler().SetTraceFrames(options.frames);
+    renderer->Resize(HeadlessWidth, HeadlessHeight);
+    renderer->SetRenderScale(options.renderScale);
+    renderer->SetMSAASamples(options.msaaSamples);
+    renderer->SetPostChain(ParsePostChain(options.postChain));
+    if (!shaderCache.empty()) {
+        renderer->SetShaderCacheDirectory(shaderCache);
+    }
+    // Every frame starts with BeginFrame(true), so no scene color is kept
+    RenderPassPolicy scenePass = renderer->GetRenderPassPolicy(RenderPass::Scene);
+    scenePass.colorStore = AttachmentStore::DontCare;
+    renderer->SetRenderPassPolicy(RenderPass::Scene, scenePass);
+    renderer->Init();
+    renderer->SetStateValidation(options.validateState);
+    // A cold shader cache must render the frames of a warm one, so nothing
+    // draws with the unlit stand-in
+    renderer->FinishShaderJobs();
+    return renderer;
+}
+
+// ==========================================
+// Cold Shader Cache Check
+// ==========================================
+
+// Share of pixels allowed to differ per frame. Until its permutations are
+// linked, a cold start draws models with the generic program, which
+// rasterizes a few edge pixels differently.
+static const double ColdCacheTolerance = 0.001;
+
+// Reads back every frame of the scene, rendered with the given program
+// binary cache
+static bool CaptureFrames(const HeadlessOptions& options, const std::string& shaderCache,
+                          std::vector<std::vector<uint8_t>>& frames) {
+    HeadlessContext ctx;
+    if (!CreateHeadlessContext(ctx, HeadlessWidth, HeadlessHeight)) {
+        return false;
+    }
+    HeadlessScene* scene = CreateScene(options);
+    IRenderer* renderer = CreateHeadlessRenderer(options, shaderCache);
+
+    bool ok = scene->Setup(*renderer);
+    frames.assign(ok ? options.frames : 0, std::vector<uint8_t>());
+    for (int frame = 0; frame < static_cast<int>(frames.size()); ++frame) {
+        renderer->BeginFrame(true);
+        scene->Draw(*renderer, frame);
+        renderer->EndFrame();
+        renderer->ReadPixels(frames[frame], HeadlessWidth, HeadlessHeight);
+        renderer->FinishShaderJobs();
+    }
+
+    renderer->Close();
+    delete renderer;
+    delete scene;
+    DestroyHeadlessContext(ctx);
+    return ok;
+}
+
+// Renders the scene with an empty program binary cache, then again with the
+// cache that run filled, and compares the frames
+static int CheckColdShaderCache(const HeadlessOptions& options) {
+    std::error_code error;
+    std::filesystem::path cache = std::filesystem::temp_directory_path(error) / "ikemen-cold-shadercache";
+    std::filesystem::remove_all(cache, error);
+
+    std::vector<std::vector<uint8_t>> cold, warm;
+    if (!CaptureFrames(options, cache.string(), cold) || !CaptureFrames(options, cache.string(), warm)) {
+        std::filesystem::remove_all(cache, error);
+        return EXIT_FAILURE;
+    }
+    std::filesystem::remove_all(cache, error);
+
+    int status = EXIT_SUCCESS;
+    const size_t pixelCount = size_t(HeadlessWidth) * HeadlessHeight;
+    for (size_t frame = 0; frame < cold.size(); ++frame) {
+        size_t differing = 0;
+        for (size_t i = 0; i < pixelCount; ++i) {
+            differing += std::memcmp(&cold[frame][i * 4], &warm[frame][i * 4], 4) != 0;
+        }
+        bool match = differing <= pixelCount * ColdCacheTolerance;
+        printf("Headless: frame %zu, %zu pixels differ between cold and warm shader cache%s\n", frame, differing,
+               match ? "" : " (FAILED)");
+        if (!match) {
+            status = EXIT_FAILURE;
+        }
+    }
+    return status;
+}
+
+int RunHeadless(const HeadlessOptions& options) {
+    HeadlessScene* scene = CreateScene(options);
+    if (!scene) {
+        std::cerr << "Headless: unknown scene '" << options.scene << "' (sprites, instanced, batched, models, multidraw, atlas, ibl, shadows)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (options.checkColdCache) {
+        delete scene;
+        return CheckColdShaderCache(options);
+    }
+    if (!options.dumpDir.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(options.dumpDir, error);
+        if (error) {
+            std::cerr << "Headless: cannot create " << options.dumpDir << ": " << error.message() << std::endl;
+            delete scene;
+            return EXIT_FAILURE;
+        }
+    }
+
+    HeadlessContext ctx;
+    if (!CreateHeadlessContext(ctx, HeadlessWidth, HeadlessHeight)) {
+        delete scene;
+        return EXIT_FAILURE;
+    }
+
+    IRenderer* renderer = CreateHeadlessRenderer(options, "");
+    renderer->PrintInfo();
+
+    int status = EXIT_SUCCESS;
+    if (!scene->Setup(*renderer)) {
+        status = EXIT_FAILURE;
+    } else {
+        printf("Headless: scene '%s', %d frames at %dx%d (render %dx%d, %d samples)\n", options.scene.c_str(),
+               options.frames, HeadlessWidth, HeadlessHeight, renderer->GetRenderWidth(), renderer->GetRenderHeight(),
+               renderer->GetMSAASamples());
+
+        FrameTimer timer(options.frames);
+        std::vector<double> cpuTimes(options.frames);
+        std::vector<uint8_t> pixels;
+        int rendered = 0;
+        for (int frame = 0; frame < options.frames; ++frame) {
+            auto start = std::chrono::steady_clock::now();
+            timer.Begin(frame);
+            {
+                ScopedCPUZone zone("BeginFrame");
+                renderer->BeginFrame(true);
+            }
+            {
+                ScopedCPUZone zone("Draw");
+                scene->Draw(*renderer, frame);
+            }
+            {
+                ScopedCPUZone zone("EndFrame");
+                renderer->EndFrame();
+            }
+            timer.End(frame);
+            cpuTimes[frame] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            rendered++;
+            // Permutations first used by this frame are ready for the next,
+            // as they are on a warm cache
+            renderer->FinishShaderJobs();
+
+            if (!options.dumpDir.empty() && frame % options.dumpEvery == 0) {
+                ScopedCPUZone zone("Dump");
+                if (!DumpFrame(*renderer, options.dumpDir, frame, pixels)) {
+                    status = EXIT_FAILURE;
+                    break;
+                }
+            }
+            CPUProfiler::FrameMark();
+        }
+        renderer->Await();
+
+        cpuTimes.resize(rendered);
+        std::vector<double> gpuTimes(cpuTimes.size());
+        for (size_t frame = 0; frame < cpuTimes.size(); ++frame) {
+            gpuTimes[frame] = timer.Milliseconds(static_cast<int>(frame));
+            printf("frame %5zu  cpu %8.3f ms  gpu %8.3f ms\n", frame, cpuTimes[frame], gpuTimes[frame]);
+        }
+        PrintTimingSummary("CPU", cpuTimes);
+        PrintTimingSummary("GPU", gpuTimes);
+        if (renderer->IsGPUProfiling()) {
+            // Frames still in flight at the end are not resolved
+            for (const std::string& line : renderer->GetGPUProfiler().FormatLines()) {
+                printf("%s\n", line.c_str());
+            }
+            if (!renderer->GetGPUProfiler().WriteChromeTrace(options.gpuTrace)) {
+                status = EXIT_FAILURE;
+            }
+        }
+        if (CPUProfiler::IsEnabled() && !CPUProfiler::WriteChromeTrace(options.cpuTrace)) {
+            status = EXIT_FAILURE;
+        }
+        printf("Headless: %.2f MiB of texture storage, %.2f MiB of render targets\n",
+               renderer->GetTextureMemory() / (1024.0 * 1024.0), renderer->GetRenderTargetMemory() / (1024.0 * 1024.0));
+        StateCacheStats stateStats = renderer->GetStateCacheStats();
+        PrintStateCacheStats(stateStats);
+        if (stateStats.mismatches > 0) {
+            std::cerr << "Headless: " << stateStats.mismatches << " state cache mismatches" << std::endl;
+            status = EXIT_FAILURE;
+        }
+
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR) {
+            std::cerr << "Headless: GL error 0x" << std::hex << error << std::dec << std::endl;
+            status = EXIT_FAILURE;
+        }
+    }
+
+    renderer->Close();
+    delete renderer;
+    delete scene;
+    DestroyHeadlessContext(ctx);
+    return status;
+}
@@ -0,0 +1,46 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Headless Offscreen Runner
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <string>
+
+// Renders a scripted scene for a fixed number of frames without a window,
+// on an EGL pbuffer (Mesa llvmpipe works on GPU-less build servers).
+// Every frame prints its CPU and GPU time; selected frames are read back
+// and written as PNG for golden-image comparison.
+struct HeadlessOptions {
+    int frames;             // frames to render
+    std::string scene;      // "sprites", "instanced", "batched", "models", "multidraw", "atlas", "ibl" or "shadows"
+    std::string dumpDir;    // PNG output directory; empty disables dumps
+    int dumpEvery;          // dump every Nth frame, counted from frame 0
+    bool iblFullPrecision;  // 32-bit float IBL textures instead of half floats
+    float iblBudget;        // ms of GPU time per frame for IBL filtering; 0 bakes at setup
+    std::string gpuTrace;   // Chrome trace JSON of the GPU regions; empty disables profiling
+    std::string cpuTrace;   // Chrome trace JSON of the CPU zones; empty disables them
+    bool validateState;     // check the GL state cache against glGet* before every draw
+    float renderScale;      // render target size relative to the output
+    int msaaSamples;        // 0 disables multisampling
+    std::string postChain;  // comma-separated post effects, e.g. "scale2x,crt"; empty presents as is
+    bool checkColdCache;    // compare frames of an empty and a filled shader cache instead of benchmarking
+
+    HeadlessOptions()
+        : frames(300), scene("sprites"), dumpEvery(1), iblFullPrecision(false), iblBudget(0.0f), validateState(false),
+          renderScale(1.0f), msaaSamples(0), checkColdCache(false) {}
+};
+
+// Returns true when argv asks for headless mode (--headless) and fills
+// options from the flags that follow:
+//   --frames N  --scene NAME  --dump DIR  --dump-every N  --ibl-precision full|half
+//   --ibl-budget MS  --gpu-trace FILE  --cpu-trace FILE  --validate-state
+//   --render-scale S  --msaa N  --post LIST  --check-cold-cache
+bool ParseHeadlessOptions(int argc, char** argv, HeadlessOptions& options);
+
+// Process exit code: 0 on success
+int RunHeadless(const HeadlessOptions& options);
+
+#endif // HEADLESS_H
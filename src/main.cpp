@@ -15,8 +15,12 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include "embededFont.h"
+#include "CPUProfiler.h"
 #include "renderer/RendererInterfaces.h"
 #include "renderer/Renderer.h"
+#ifdef ENABLE_HEADLESS
+#include "Headless.h"
+#endif
 
 static void error_callback(int error, const char* description) {
 	std::cerr << "Error: " << description << std::endl;
@@ -25,6 +29,37 @@ static void error_callback(int error, const char* description) {
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GLFW_TRUE);
+
+	// F1 toggles the GPU profiler and its overlay
+	IRenderer* renderer = static_cast<IRenderer*>(glfwGetWindowUserPointer(window));
+	if (key == GLFW_KEY_F1 && action == GLFW_PRESS && renderer)
+		renderer->SetGPUProfiling(!renderer->IsGPUProfiling());
+
+	// F2 toggles CPU zone recording, F3 flushes the running profilers'
+	// traces to the working directory
+	if (key == GLFW_KEY_F2 && action == GLFW_PRESS)
+		CPUProfiler::SetEnabled(!CPUProfiler::IsEnabled());
+	if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+		if (CPUProfiler::IsEnabled() && CPUProfiler::WriteChromeTrace("cpu-trace.json"))
+			std::cout << "Wrote cpu-trace.json" << std::endl;
+		// GPU results resolve a few frames after profiling is switched on
+		if (renderer && renderer->IsGPUProfiling()) {
+			const GPUProfiler& profiler = renderer->GetGPUProfiler();
+			if (profiler.GetFrameCount() == 0)
+				std::cout << "No GPU frames resolved yet, gpu-trace.json not written" << std::endl;
+			else if (profiler.WriteChromeTrace("gpu-trace.json"))
+				std::cout << "Wrote gpu-trace.json" << std::endl;
+		}
+	}
+}
+
+// One line per GPU region: last, avg, min and max milliseconds
+static void DrawGPUProfile(EmbedFontCtx* font, const GPUProfiler& profiler, float x, float y) {
+	embedFontSetColor(font, 0.6f, 1.0f, 0.6f, 1.0f);
+	for (const std::string& line : profiler.FormatLines()) {
+		embedFontDrawText(font, line.c_str(), x, y, 8.0f, 8.0f);
+		y += 10.0f;
+	}
 }
 
 // Returns true and fills major/minor with max supported version
@@ -67,7 +102,15 @@ bool getMaxOpenGLVersion(int* major, int* minor) {
     return true;
 }
 
-int main(void) {
+int main(int argc, char** argv) {
+#ifdef ENABLE_HEADLESS
+	// Offscreen benchmark/image dump run; no window, no GLFW
+	HeadlessOptions headless;
+	if (ParseHeadlessOptions(argc, argv, headless)) {
+		return RunHeadless(headless);
+	}
+#endif
+
 	int width = 640, height = 480;
 	glfwSetErrorCallback(error_callback);
 
@@ -117,28 +160,62 @@ int main(void) {
 	glfwSwapInterval(1);
 
 	IRenderer* renderer = Renderer::Create();
+	renderer->SetProcLoader(glfwGetProcAddress);
+	int fbWidth, fbHeight;
+	glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+	renderer->Resize(fbWidth, fbHeight);
+	renderer->Init();
 	renderer->PrintInfo();
 	renderer->PrintCapabilities();
 	EmbedFontCtx* font = embedFontCreate(width, height);
+	glfwSetWindowUserPointer(window, renderer);
+
+	CPUProfiler::SetThreadName("Main");
 
 	while (!glfwWindowShouldClose(window)) {
 		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
-		glViewport(0, 0, width, height);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		embedFontBindState(font);
-		embedFontSetColor(font, 1.0f, 1.0f, 1.0f, 1.0f);
-		embedFontDrawText(font, "This is embededFont using OpenGL shader.", 10.0f, 10.0f, 12.0f, 12.0f);
-		embedFontSetColor(font, 0.2f, 0.8f, 1.0f, 1.0f);
-		embedFontDrawText(font, "Try me at any window size!", 10.0f, 50.0f, 18.0f, 18.0f);
-		embedFontSetColor(font, 1.0f, 1.0f, 0.1f, 1.0f);
-		embedFontDrawText(font, "Text scales: 8x8", 10.0f, 90.0f, 8.0f, 8.0f);
-		embedFontDrawText(font, "Text scales: 16x16", 10.0f, 110.0f, 16.0f, 16.0f);
-		embedFontDrawText(font, "Text scales: 32x32", 10.0f, 140.0f, 32.0f, 32.0f);
-
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		{
+			ScopedCPUZone zone("Update");
+			glfwGetFramebufferSize(window, &width, &height);
+			renderer->Resize(width, height);
+		}
+
+		{
+			ScopedCPUZone zone("Render");
+			// The frame bracket is what the GPU profiler times and resolves;
+			// EndFrame presents the scene to the window, the text goes on top
+			renderer->BeginFrame(true);
+			renderer->EndFrame();
+
+			// The text draws with whatever state EndFrame left behind
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_CULL_FACE);
+			glDisable(GL_SCISSOR_TEST);
+			glViewport(0, 0, width, height);
+			embedFontBindState(font);
+			embedFontSetColor(font, 1.0f, 1.0f, 1.0f, 1.0f);
+			embedFontDrawText(font, "This is embededFont using OpenGL shader.", 10.0f, 10.0f, 12.0f, 12.0f);
+			embedFontSetColor(font, 0.2f, 0.8f, 1.0f, 1.0f);
+			embedFontDrawText(font, "Try me at any window size!", 10.0f, 50.0f, 18.0f, 18.0f);
+			embedFontSetColor(font, 1.0f, 1.0f, 0.1f, 1.0f);
+			embedFontDrawText(font, "Text scales: 8x8", 10.0f, 90.0f, 8.0f, 8.0f);
+			embedFontDrawText(font, "Text scales: 16x16", 10.0f, 110.0f, 16.0f, 16.0f);
+			embedFontDrawText(font, "Text scales: 32x32", 10.0f, 140.0f, 32.0f, 32.0f);
+			if (renderer->IsGPUProfiling()) {
+				DrawGPUProfile(font, renderer->GetGPUProfiler(), 10.0f, 190.0f);
+			}
+			renderer->InvalidateState();
+		}
+
+		{
+			ScopedCPUZone zone("Swap");
+			glfwSwapBuffers(window);
+		}
+		{
+			ScopedCPUZone zone("Poll");
+			glfwPollEvents();
+		}
+		CPUProfiler::FrameMark();
 	}
 	renderer->Close();
 	embedFontDestroy(font);
@@ -0,0 +1,403 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Image-Based Lighting Environment Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "Environment.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// cubemapFiltering.frag distributions
+static const int32_t DistributionLambertian = 0;
+static const int32_t DistributionGGX = 1;
+
+// Stand-ins bound while an incremental bake runs
+static const int32_t StandInLambertianSize = 16;
+static const int32_t StandInLUTSize = 32;
+static const int32_t StandInSamples = 64;
+
+// GPU cost assumed before the first timer result, and throughout on
+// backends without timer queries
+static const double DefaultNanosecondsPerSample = 1.0;
+
+// Levels of a full mip chain down to 1x1
+static int32_t MipLevelCount(int32_t size) {
+    int32_t levels = 1;
+    while ((size >> levels) > 0) levels++;
+    return levels;
+}
+
+// ==========================================
+// Disk Cache
+// ==========================================
+
+// File layout: header, then per level a uint64 byte count and the texels
+// as ReadTextureLevel returned them
+struct EnvironmentCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t levelCount;
+    uint32_t reserved;      // zero; keeps the header free of padding
+};
+
+static const uint32_t EnvironmentCacheMagic = 0x56454B49;  // "IKEV"
+static const uint32_t EnvironmentCacheVersion = 1;  // bump when the filtering shader changes
+
+// FNV-1a, continued across calls
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Backend and precision decide the texel layout of every entry
+static uint64_t HashRenderer(const IRenderer& renderer) {
+    uint64_t hash = 14695981039346656037ull;
+    std::string name = renderer.GetName();
+    uint32_t tags[2] = {EnvironmentCacheVersion, static_cast<uint32_t>(renderer.GetIBLPrecision())};
+    hash = HashBytes(hash, name.data(), name.size());
+    return HashBytes(hash, tags, sizeof(tags));
+}
+
+// ==========================================
+// Environment Implementation
+// ==========================================
+
+Environment::Environment()
+    : cubeSize(1024), lambertianSize(64), lambertianSamples(2048), GGXSize(256), GGXLevels(6), GGXSamples(1024),
+      LUTSize(512), LUTSamples(512), intensity(1.0f), cacheDirectory("save/envcache/"),
+      mipCount(0), GGXMipCount(0), memorySize(0), cubeMapCached(false), lutCached(false),
+      passIndex(0), passFace(0), passRow(0), nanosecondsPerSample(0.0),
+      totalSamples(0.0), renderedSamples(0.0), cubeMapKey(0), lutKey(0) {
+    static const float identity[9] = {1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+    std::copy(identity, identity + 9, rotation);
+}
+
+bool Environment::Bake(IRenderer& renderer, const std::vector<float>& panorama, int32_t width, int32_t height) {
+    if (!BeginBake(renderer, panorama, width, height)) {
+        return false;
+    }
+    Update(renderer, 0.0f);
+    return true;
+}
+
+bool Environment::BeginBake(IRenderer& renderer, const std::vector<float>& panorama, int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0 || panorama.size() < static_cast<size_t>(width) * height * 3) {
+        std::cerr << "Environment: panorama data is smaller than " << width << "x" << height << " RGB" << std::endl;
+        return false;
+    }
+
+    // One roughness step per GGX level, 0 at the top and 1 at the last
+    const int32_t levelCount = std::max(1, std::min(GGXLevels, MipLevelCount(GGXSize)));
+
+    // Cached cubemap entries hold the lambertian level, then the GGX chain
+    const uint64_t newCubeMapKey = CubeMapKey(renderer, panorama, width, height);
+    const uint64_t newLUTKey = LUTKey(renderer);
+    std::vector<std::vector<uint8_t>> cubeMapLevels, lutLevels;
+    bool cubeMapHit = LoadLevels(PathFor("", newCubeMapKey), newCubeMapKey, cubeMapLevels) &&
+                      cubeMapLevels.size() == static_cast<size_t>(levelCount) + 1;
+    bool lutHit = LoadLevels(PathFor("lut-", newLUTKey), newLUTKey, lutLevels) && lutLevels.size() == 1;
+    if ((!cubeMapHit || !lutHit) && !renderer.IsIBLReady()) {
+        std::cerr << "Environment: IBL shaders are not ready" << std::endl;
+        return false;
+    }
+    Release();
+    cubeMapKey = newCubeMapKey;
+    lutKey = newLUTKey;
+    GGXMipCount = levelCount;
+
+    // Final textures first, so memorySize leaves out the transient ones
+    const size_t baseMemory = renderer.GetTextureMemory();
+    bakedLambertian = renderer.newCubeMapTexture(lambertianSize, false, 0);
+    bakedGGX = renderer.newCubeMapTexture(GGXSize, true, GGXMipCount - 1);
+    bakedLUT = renderer.newLUTTexture(LUTSize);
+    memorySize = renderer.GetTextureMemory() - baseMemory;
+
+    if (cubeMapHit) {
+        cubeMapCached = renderer.WriteTextureLevel(bakedLambertian, 0, cubeMapLevels[0]);
+        for (int32_t level = 0; cubeMapCached && level < GGXMipCount; ++level) {
+            cubeMapCached = renderer.WriteTextureLevel(bakedGGX, level, cubeMapLevels[level + 1]);
+        }
+    }
+    lutCached = lutHit && renderer.WriteTextureLevel(bakedLUT, 0, lutLevels[0]);
+    if ((!cubeMapCached || !lutCached) && !renderer.IsIBLReady()) {
+        std::cerr << "Environment: IBL shaders are not ready" << std::endl;
+        Release();
+        return false;
+    }
+
+    if (cubeMapCached) {
+        lambertianTexture = bakedLambertian;
+        GGXTexture = bakedGGX;
+        mipCount = GGXMipCount;
+    } else {
+        std::shared_ptr<ITexture> panoramaTexture = renderer.newHDRTexture(width, height);
+        renderer.SetTexturePixelData(panoramaTexture, panorama);
+
+        // The full mip chain of the source cube backs the filtered lookups
+        // and, box filtered, stands in for the GGX cube meanwhile
+        sourceCube = renderer.newCubeMapTexture(cubeSize, true, 0);
+        renderer.RenderCubeMap(panoramaTexture, sourceCube);
+        GGXTexture = sourceCube;
+        mipCount = MipLevelCount(cubeSize);
+
+        lambertianTexture = renderer.newCubeMapTexture(StandInLambertianSize, false, 0);
+        renderer.RenderFilteredCubeMap(DistributionLambertian, sourceCube, lambertianTexture, 0, StandInSamples, 0.0f);
+
+        passes.push_back({bakedLambertian, DistributionLambertian, 0, lambertianSamples, 0.0f, false});
+        for (int32_t level = 0; level < GGXMipCount; ++level) {
+            float roughness = GGXMipCount > 1 ? static_cast<float>(level) / (GGXMipCount - 1) : 0.0f;
+            passes.push_back({bakedGGX, DistributionGGX, level, GGXSamples, roughness, false});
+        }
+    }
+
+    if (lutCached) {
+        GGXLUT = bakedLUT;
+    } else {
+        // The LUT pass samples no cube; RenderLUT only wants a valid one
+        GGXLUT = renderer.newLUTTexture(StandInLUTSize);
+        renderer.RenderLUT(DistributionGGX, GGXTexture, GGXLUT, StandInSamples);
+        passes.push_back({bakedLUT, DistributionGGX, 0, LUTSamples, 0.0f, true});
+    }
+
+    for (const FilterPass& pass : passes) {
+        double size = std::max(pass.target->GetWidth() >> pass.level, 1);
+        totalSamples += size * size * (pass.lut ? 1 : 6) * pass.sampleCount;
+    }
+    if (passes.empty()) {
+        FinishBake(renderer);
+    }
+    return true;
+}
+
+bool Environment::Update(IRenderer& renderer, float budgetMilliseconds) {
+    if (!IsBaking()) {
+        return true;
+    }
+
+    // Fold in the timings the GPU has finished; the queries lag a frame or two
+    while (!timers.empty()) {
+        uint64_t nanoseconds = 0;
+        if (!renderer.ReadGPUTimer(timers.front().query, nanoseconds)) break;
+        if (timers.front().samples > 0.0) {
+            double measured = nanoseconds / timers.front().samples;
+            nanosecondsPerSample = nanosecondsPerSample > 0.0 ? (nanosecondsPerSample + measured) * 0.5 : measured;
+        }
+        timers.pop_front();
+    }
+
+    // Until a timer result is in, a budgeted Update renders a single row
+    // as a probe; without timer queries the default cost is all there is
+    const uint32_t query = renderer.BeginGPUTimer();
+    const double cost = nanosecondsPerSample > 0.0 ? nanosecondsPerSample : DefaultNanosecondsPerSample;
+    double budget = budgetMilliseconds > 0.0f ? budgetMilliseconds * 1.0e6 / cost : 1.0e300;
+    if (query != 0 && nanosecondsPerSample <= 0.0 && budgetMilliseconds > 0.0f) {
+        budget = 0.0;
+    }
+    double samples = 0.0;
+    while (IsBaking() && (samples == 0.0 || samples < budget)) {
+        const FilterPass& pass = passes[passIndex];
+        const int32_t size = std::max(pass.target->GetWidth() >> pass.level, 1);
+        const double rowSamples = static_cast<double>(size) * pass.sampleCount;
+        const int32_t rows = static_cast<int32_t>(std::max(1.0, std::min<double>((budget - samples) / rowSamples,
+                                                                                 size - passRow)));
+        if (pass.lut) {
+            renderer.RenderLUTRows(pass.distribution, lambertianTexture, pass.target, pass.sampleCount, passRow, rows);
+        } else {
+            renderer.RenderFilteredCubeMapRows(pass.distribution, sourceCube, pass.target, pass.level, passFace,
+                                               passRow, rows, pass.sampleCount, pass.roughness);
+        }
+        samples += rows * rowSamples;
+
+        passRow += rows;
+        if (passRow >= size) {
+            passRow = 0;
+            if (pass.lut || ++passFace == 6) {
+                passFace = 0;
+                passIndex++;
+            }
+        }
+    }
+    if (query != 0) {
+        renderer.EndGPUTimer();
+        timers.push_back({query, samples});
+    }
+    renderedSamples += samples;
+
+    if (IsBaking()) {
+        return false;
+    }
+    FinishBake(renderer);
+    return true;
+}
+
+float Environment::GetProgress() const {
+    return totalSamples > 0.0 ? static_cast<float>(renderedSamples / totalSamples) : 1.0f;
+}
+
+// Swaps the filtered textures in for the stand-ins and caches them
+void Environment::FinishBake(IRenderer& renderer) {
+    if (!cubeMapCached) {
+        lambertianTexture = bakedLambertian;
+        GGXTexture = bakedGGX;
+        mipCount = GGXMipCount;
+
+        if (!cacheDirectory.empty()) {
+            std::vector<std::vector<uint8_t>> levels(mipCount + 1);
+            bool read = renderer.ReadTextureLevel(lambertianTexture, 0, levels[0]);
+            for (int32_t level = 0; read && level < mipCount; ++level) {
+                read = renderer.ReadTextureLevel(GGXTexture, level, levels[level + 1]);
+            }
+            if (read) StoreLevels(PathFor("", cubeMapKey), cubeMapKey, levels);
+        }
+    }
+    if (!lutCached) {
+        GGXLUT = bakedLUT;
+
+        if (!cacheDirectory.empty()) {
+            std::vector<std::vector<uint8_t>> levels(1);
+            if (renderer.ReadTextureLevel(GGXLUT, 0, levels[0])) {
+                StoreLevels(PathFor("lut-", lutKey), lutKey, levels);
+            }
+        }
+    }
+
+    // The readbacks above waited for the GPU, so the last timers are done
+    uint64_t nanoseconds = 0;
+    for (const PendingTimer& timer : timers) {
+        renderer.ReadGPUTimer(timer.query, nanoseconds);
+    }
+    timers.clear();
+    passes.clear();
+    passIndex = 0;
+    sourceCube.reset();
+    bakedLambertian.reset();
+    bakedGGX.reset();
+    bakedLUT.reset();
+}
+
+void Environment::Release() {
+    lambertianTexture.reset();
+    GGXTexture.reset();
+    GGXLUT.reset();
+    mipCount = 0;
+    GGXMipCount = 0;
+    memorySize = 0;
+    cubeMapCached = false;
+    lutCached = false;
+
+    sourceCube.reset();
+    bakedLambertian.reset();
+    bakedGGX.reset();
+    bakedLUT.reset();
+    passes.clear();
+    passIndex = 0;
+    passFace = 0;
+    passRow = 0;
+    timers.clear();
+    totalSamples = 0.0;
+    renderedSamples = 0.0;
+}
+
+uint64_t Environment::CubeMapKey(const IRenderer& renderer, const std::vector<float>& panorama,
+                                 int32_t width, int32_t height) const {
+    const int32_t settings[] = {width, height, cubeSize, lambertianSize, lambertianSamples, GGXSize, GGXLevels, GGXSamples};
+    uint64_t hash = HashRenderer(renderer);
+    hash = HashBytes(hash, settings, sizeof(settings));
+    return HashBytes(hash, panorama.data(), static_cast<size_t>(width) * height * 3 * sizeof(float));
+}
+
+uint64_t Environment::LUTKey(const IRenderer& renderer) const {
+    const int32_t settings[] = {LUTSize, LUTSamples};
+    return HashBytes(HashRenderer(renderer), settings, sizeof(settings));
+}
+
+std::string Environment::PathFor(const char* prefix, uint64_t key) const {
+    char name[48];
+    snprintf(name, sizeof(name), "%s%016llx.bin", prefix, static_cast<unsigned long long>(key));
+    return cacheDirectory + name;
+}
+
+bool Environment::LoadLevels(const std::string& path, uint64_t key, std::vector<std::vector<uint8_t>>& levels) const {
+    if (cacheDirectory.empty()) {
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    EnvironmentCacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != EnvironmentCacheMagic || header.version != EnvironmentCacheVersion ||
+        header.key != key || header.levelCount == 0 || header.levelCount > 32) {
+        return false;
+    }
+
+    levels.assign(header.levelCount, {});
+    for (auto& level : levels) {
+        uint64_t size = 0;
+        if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)) || size == 0 || size > (1ull << 31)) {
+            return false;
+        }
+        level.resize(static_cast<size_t>(size));
+        if (!file.read(reinterpret_cast<char*>(level.data()), level.size())) {
+            std::cerr << "Environment: truncated cache entry " << path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Environment::StoreLevels(const std::string& path, uint64_t key, const std::vector<std::vector<uint8_t>>& levels) const {
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+    if (error) {
+        std::cerr << "Environment: failed to create cache directory " << cacheDirectory << ": "
+                  << error.message() << std::endl;
+        return false;
+    }
+
+    // Write to a temporary file first so a crash never leaves a torn entry
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Environment: failed to write cache entry " << tempPath << std::endl;
+            return false;
+        }
+
+        EnvironmentCacheHeader header;
+        header.magic = EnvironmentCacheMagic;
+        header.version = EnvironmentCacheVersion;
+        header.key = key;
+        header.levelCount = static_cast<uint32_t>(levels.size());
+        header.reserved = 0;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& level : levels) {
+            uint64_t size = level.size();
+            file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            file.write(reinterpret_cast<const char*>(level.data()), level.size());
+        }
+        if (!file) {
+            std::cerr << "Environment: failed to write cache entry " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
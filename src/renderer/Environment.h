@@ -0,0 +1,128 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Image-Based Lighting Environment
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef ENVIRONMENT_H
+#define ENVIRONMENT_H
+
+#include "RendererInterfaces.h"
+#include <deque>
+
+// Prefiltered lighting of an equirectangular HDR panorama, as read by
+// model.frag: a lambertian (irradiance) cubemap, a GGX cubemap whose mip
+// levels hold rising roughness, and the split-sum BRDF lookup table.
+// Texture formats follow the renderer's IBLPrecision at bake time.
+//
+// Pass the environment to prepareModelPipeline to light models with it;
+// the textures stay valid until the next Bake or Release.
+//
+// Filtered levels are cached on disk under cacheDirectory, keyed by the
+// panorama, the bake settings and the renderer's backend and precision, so
+// a stage seen before skips filtering. The BRDF table depends on neither
+// the panorama nor the cube settings and is cached once per LUTSize.
+//
+// On a cache miss BeginBake + Update spread the filtering over frames
+// instead: BeginBake renders only the source cube and cheap stand-ins
+// (its box-filtered mip chain for GGX, a tiny lambertian cube and LUT),
+// so IsReady holds at once, and each Update renders bands of rows for
+// about the given GPU time, measured with timer queries where the
+// backend has them. The filtered textures replace the stand-ins when the
+// last band is done.
+class Environment {
+public:
+    Environment();
+
+    // Bake settings; edge sizes in texels, sample counts per texel
+    int32_t cubeSize;           // panorama resampled to this cube first
+    int32_t lambertianSize;
+    int32_t lambertianSamples;
+    int32_t GGXSize;
+    int32_t GGXLevels;          // roughness 0..1 spread over these mip levels
+    int32_t GGXSamples;
+    int32_t LUTSize;
+    int32_t LUTSamples;
+
+    // Shading
+    float intensity;
+    float rotation[9];          // column-major mat3 applied to lookup directions
+
+    std::string cacheDirectory; // empty disables the disk cache
+
+    std::shared_ptr<ITexture> lambertianTexture;
+    std::shared_ptr<ITexture> GGXTexture;
+    std::shared_ptr<ITexture> GGXLUT;
+
+    // panorama holds width * height RGB floats, rows top first. Needs
+    // IsIBLReady unless everything comes from the cache; returns false and
+    // keeps the previous textures otherwise. Bake finishes before it
+    // returns; BeginBake leaves the filtering to Update.
+    bool Bake(IRenderer& renderer, const std::vector<float>& panorama, int32_t width, int32_t height);
+    bool BeginBake(IRenderer& renderer, const std::vector<float>& panorama, int32_t width, int32_t height);
+    // Filters for about budgetMilliseconds of GPU time (at least one band;
+    // 0 renders everything left). Returns true once nothing is left.
+    bool Update(IRenderer& renderer, float budgetMilliseconds);
+    void Release();
+
+    bool IsReady() const { return lambertianTexture && GGXTexture && GGXLUT; }
+    // Stand-ins are bound while Update still has bands to render
+    bool IsBaking() const { return passIndex < passes.size(); }
+    // Share of the filtering samples rendered so far, 1 when done
+    float GetProgress() const;
+    // GGX levels currently bound (mipCount of model.frag)
+    int32_t GetMipCount() const { return mipCount; }
+    // Bytes of texture storage held by the three final textures
+    size_t GetMemorySize() const { return memorySize; }
+    // Whether the last Bake restored the cubemaps / the LUT from disk
+    bool IsCubeMapCached() const { return cubeMapCached; }
+    bool IsLUTCached() const { return lutCached; }
+
+private:
+    // One filtered level (or the LUT), rendered face by face in row bands
+    struct FilterPass {
+        std::shared_ptr<ITexture> target;
+        int32_t distribution;
+        int32_t level;
+        int32_t sampleCount;
+        float roughness;
+        bool lut;
+    };
+    // Timer query around one Update, with the samples it covered
+    struct PendingTimer {
+        uint32_t query;
+        double samples;
+    };
+
+    int32_t mipCount;
+    int32_t GGXMipCount;        // mipCount once the GGX cube is swapped in
+    size_t memorySize;
+    bool cubeMapCached;
+    bool lutCached;
+
+    // Incremental bake state
+    std::shared_ptr<ITexture> sourceCube;
+    std::shared_ptr<ITexture> bakedLambertian;
+    std::shared_ptr<ITexture> bakedGGX;
+    std::shared_ptr<ITexture> bakedLUT;
+    std::vector<FilterPass> passes;
+    size_t passIndex;
+    int32_t passFace;
+    int32_t passRow;
+    std::deque<PendingTimer> timers;
+    double nanosecondsPerSample;    // measured GPU cost, 0 until the first timer; kept across bakes
+    double totalSamples;
+    double renderedSamples;
+    uint64_t cubeMapKey;
+    uint64_t lutKey;
+
+    void FinishBake(IRenderer& renderer);
+
+    uint64_t CubeMapKey(const IRenderer& renderer, const std::vector<float>& panorama, int32_t width, int32_t height) const;
+    uint64_t LUTKey(const IRenderer& renderer) const;
+    std::string PathFor(const char* prefix, uint64_t key) const;
+    bool LoadLevels(const std::string& path, uint64_t key, std::vector<std::vector<uint8_t>>& levels) const;
+    bool StoreLevels(const std::string& path, uint64_t key, const std::vector<std::vector<uint8_t>>& levels) const;
+};
+
+#endif // ENVIRONMENT_H
@@ -0,0 +1,142 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// GPU Region Profiler Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "GPUProfiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// ==========================================
+// Statistics
+// ==========================================
+
+void GPUProfiler::AddFrame(uint64_t frame, const std::vector<GPUProfileSpan>& spans) {
+    frames++;
+    for (Region& region : regions) {
+        region.calls = 0;
+        region.last = 0.0;
+    }
+
+    for (const GPUProfileSpan& span : spans) {
+        size_t index = 0;
+        while (index < regions.size() && regions[index].name != span.name) ++index;
+        if (index == regions.size()) {
+            regions.push_back(Region{span.name, span.depth, 0, 0.0, {}});
+        }
+        regions[index].calls++;
+        regions[index].last += (span.end - span.begin) / 1.0e6;
+    }
+    for (Region& region : regions) {
+        if (region.calls == 0) continue;
+        region.history.push_back(region.last);
+        while (region.history.size() > windowFrames) region.history.pop_front();
+    }
+
+    if (traceFrames > 0) {
+        trace.push_back(TraceFrame{frame, spans});
+        while (trace.size() > traceFrames) trace.pop_front();
+    }
+}
+
+void GPUProfiler::Reset() {
+    frames = 0;
+    droppedFrames = 0;
+    regions.clear();
+    trace.clear();
+}
+
+std::vector<GPUProfileStats> GPUProfiler::GetStats() const {
+    std::vector<GPUProfileStats> stats;
+    stats.reserve(regions.size());
+    for (const Region& region : regions) {
+        GPUProfileStats entry = {region.name, region.depth, region.calls, region.last, 0.0, 0.0, 0.0};
+        if (!region.history.empty()) {
+            entry.min = *std::min_element(region.history.begin(), region.history.end());
+            entry.max = *std::max_element(region.history.begin(), region.history.end());
+            double sum = 0.0;
+            for (double t : region.history) sum += t;
+            entry.avg = sum / region.history.size();
+        }
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+std::vector<std::string> GPUProfiler::FormatLines() const {
+    std::vector<std::string> lines;
+    if (regions.empty()) return lines;
+
+    char line[128];
+    snprintf(line, sizeof(line), "%-16s %7s %7s %7s %7s", "GPU ms", "last", "avg", "min", "max");
+    lines.push_back(line);
+    for (const GPUProfileStats& entry : GetStats()) {
+        std::string name = std::string(entry.depth * 2, ' ') + entry.name;
+        snprintf(line, sizeof(line), "%-16.16s %7.3f %7.3f %7.3f %7.3f", name.c_str(), entry.last, entry.avg,
+                 entry.min, entry.max);
+        lines.push_back(line);
+    }
+    if (droppedFrames > 0) {
+        snprintf(line, sizeof(line), "%llu of %llu frames dropped", (unsigned long long)droppedFrames,
+                 (unsigned long long)(frames + droppedFrames));
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// ==========================================
+// Chrome Trace Export
+// ==========================================
+
+static std::string EscapeJSON(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += ' ';
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+bool GPUProfiler::WriteChromeTrace(const std::string& path) const {
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to write GPU trace: " << path << std::endl;
+        return false;
+    }
+
+    // Complete ("X") events in microseconds from the first kept span
+    uint64_t origin = UINT64_MAX;
+    for (const TraceFrame& entry : trace) {
+        for (const GPUProfileSpan& span : entry.spans) origin = std::min(origin, span.begin);
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+    char number[64];
+    for (const TraceFrame& entry : trace) {
+        for (const GPUProfileSpan& span : entry.spans) {
+            file << ",\n{\"name\":\"" << EscapeJSON(span.name) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1";
+            snprintf(number, sizeof(number), ",\"ts\":%.3f", (span.begin - origin) / 1.0e3);
+            file << number;
+            snprintf(number, sizeof(number), ",\"dur\":%.3f", (span.end - span.begin) / 1.0e3);
+            file << number;
+            file << ",\"args\":{\"frame\":" << entry.frame << "}}";
+        }
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        std::cerr << "Failed to write GPU trace: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// GPU Region Profiler
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// GPU time of one named region, from timestamps in nanoseconds
+struct GPUProfileSpan {
+    std::string name;
+    int32_t depth;              // regions open around it
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Region times in milliseconds, summed per frame over every span of the
+// same name; min/avg/max cover the frames of the window it appeared in
+struct GPUProfileStats {
+    std::string name;
+    int32_t depth;
+    uint32_t calls;             // spans in the latest frame
+    double last;
+    double min;
+    double avg;
+    double max;
+};
+
+// Rolling statistics and trace export of the regions a renderer times
+// with BeginGPURegion / EndGPURegion. The backends resolve their timestamp
+// queries a few frames late and hand each finished frame to AddFrame.
+class GPUProfiler {
+public:
+    GPUProfiler() : windowFrames(120), traceFrames(300), frames(0), droppedFrames(0) {}
+
+    // Frames kept for min/avg/max and for WriteChromeTrace
+    void SetWindow(size_t frameCount) { windowFrames = frameCount ? frameCount : 1; }
+    void SetTraceFrames(size_t frameCount) { traceFrames = frameCount; }
+
+    void AddFrame(uint64_t frame, const std::vector<GPUProfileSpan>& spans);
+    // A frame whose results were lost (disjoint GPU timer, or still pending
+    // when its queries were reused)
+    void DropFrame() { droppedFrames++; }
+    void Reset();
+
+    // Regions in the order they first appeared
+    std::vector<GPUProfileStats> GetStats() const;
+    uint64_t GetFrameCount() const { return frames; }
+    uint64_t GetDroppedFrames() const { return droppedFrames; }
+
+    // A header and one line per region, indented by depth; empty before the
+    // first frame is resolved
+    std::vector<std::string> FormatLines() const;
+    // Chrome trace event JSON (chrome://tracing, Perfetto) of the frames kept
+    bool WriteChromeTrace(const std::string& path) const;
+
+private:
+    struct Region {
+        std::string name;
+        int32_t depth;
+        uint32_t calls;
+        double last;
+        std::deque<double> history;     // per-frame totals, newest last
+    };
+    struct TraceFrame {
+        uint64_t frame;
+        std::vector<GPUProfileSpan> spans;
+    };
+
+    size_t windowFrames;
+    size_t traceFrames;
+    uint64_t frames;
+    uint64_t droppedFrames;
+    std::vector<Region> regions;
+    std::deque<TraceFrame> trace;
+};
+
+#endif // GPU_PROFILER_H
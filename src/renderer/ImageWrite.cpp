@@ -0,0 +1,10 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// STB Image Write Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+// The one copy of stb_image_write, shared by the GLES screenshot path and
+// the headless frame dumps
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
@@ -0,0 +1,35 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Model Vertex Layout Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "ModelVertexLayout.h"
+
+// ==========================================
+// Vertex Attributes
+// ==========================================
+
+const ModelVertexAttribute ModelVertexAttributes[ModelVertexAttributeCount] = {
+    {"vertexId", 1, true, 0},
+    {"position", 3, false, 0},
+    {"uv", 2, false, ModelFeatureUV},
+    {"normalIn", 3, false, ModelFeatureNormal},
+    {"tangentIn", 4, false, ModelFeatureTangent},
+    {"vertColor", 4, false, ModelFeatureVertColor},
+    {"joints_0", 4, false, ModelFeatureJoint0},
+    {"weights_0", 4, false, ModelFeatureJoint0},
+    {"joints_1", 4, false, ModelFeatureJoint0 | ModelFeatureJoint1},
+    {"weights_1", 4, false, ModelFeatureJoint0 | ModelFeatureJoint1},
+    {"outlineAttributeIn", 4, false, ModelFeatureOutlineAttribute},
+};
+
+// ==========================================
+// Vertex Array Cache Key
+// ==========================================
+
+size_t ModelVertexArrayKeyHash::operator()(const ModelVertexArrayKey& key) const {
+    uint64_t hash = (uint64_t(key.vertAttrOffset) << 32) | key.numVertices;
+    hash ^= (uint64_t(key.features) << 8 | key.bufferIndex << 1 | (key.shadow ? 1 : 0)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash ^ (hash >> 29));
+}
@@ -0,0 +1,78 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Model Vertex Layout
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef MODEL_VERTEX_LAYOUT_H
+#define MODEL_VERTEX_LAYOUT_H
+
+#include "ShaderPermutation.h"
+#include <cstddef>
+#include <cstdint>
+
+// ==========================================
+// Vertex Attributes
+// ==========================================
+
+// Model vertex data is planar: starting at vertAttrOffset, each attribute
+// present in the mesh is stored for all numVertices before the next one.
+struct ModelVertexAttribute {
+    const char* name;
+    int32_t components;
+    bool integer;           // stored as int32 (converted to float by the shader)
+    uint32_t featureMask;   // ModelFeature bits that must all be set; 0 = always stored
+};
+
+static const int ModelVertexAttributeCount = 11;
+
+// In buffer order. Model programs bind attribute i to location i, so one
+// vertex array serves the generic program, its permutations and the unlit
+// stand-in alike.
+extern const ModelVertexAttribute ModelVertexAttributes[ModelVertexAttributeCount];
+
+// Locations of the model program inputs, matching ModelVertexAttributes
+enum ModelVertexLocation : uint32_t {
+    ModelLocationVertexId,
+    ModelLocationPosition,
+    ModelLocationUV,
+    ModelLocationNormal,
+    ModelLocationTangent,
+    ModelLocationVertColor,
+    ModelLocationJoint0,
+    ModelLocationWeight0,
+    ModelLocationJoint1,
+    ModelLocationWeight1,
+    ModelLocationOutlineAttribute,
+    ModelLocationDrawModel      // mat4 of the MULTI_DRAW permutation, four locations
+};
+
+inline bool ModelVertexAttributePresent(const ModelVertexAttribute& attr, uint32_t features) {
+    return (features & attr.featureMask) == attr.featureMask;
+}
+
+// ==========================================
+// Vertex Array Cache Key
+// ==========================================
+
+// A cached vertex array is valid for one buffer, one set of stored
+// attributes and one position of the mesh inside the buffer
+struct ModelVertexArrayKey {
+    uint32_t bufferIndex;
+    uint32_t features;      // vertex ModelFeature bits
+    uint32_t numVertices;
+    uint32_t vertAttrOffset;
+    bool shadow;            // laid out for the shadow program's locations
+
+    bool operator==(const ModelVertexArrayKey& other) const {
+        return bufferIndex == other.bufferIndex && features == other.features &&
+               numVertices == other.numVertices && vertAttrOffset == other.vertAttrOffset &&
+               shadow == other.shadow;
+    }
+};
+
+struct ModelVertexArrayKeyHash {
+    size_t operator()(const ModelVertexArrayKey& key) const;
+};
+
+#endif // MODEL_VERTEX_LAYOUT_H
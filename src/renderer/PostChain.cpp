@@ -0,0 +1,71 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Post-Processing Chain Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "PostChain.h"
+
+// ==========================================
+// Post Passes
+// ==========================================
+
+static const char* const PostEffectNames[] = {"identity", "scanlines", "crt", "scale2x"};
+
+// Effects that sample around their input coordinate; they need the
+// previous result in a texture
+static bool ReadsNeighbours(PostEffect effect) {
+    return effect == PostEffect::Scale2x;
+}
+
+std::vector<PostPass> PlanPostPasses(const std::vector<PostEffect>& chain) {
+    std::vector<PostPass> passes;
+    for (PostEffect effect : chain) {
+        if (effect == PostEffect::Identity) continue;
+
+        if (passes.empty() || ReadsNeighbours(effect) || passes.back().stageCount == MaxPostPassStages) {
+            PostPass pass;
+            pass.stageCount = 0;
+            pass.scale = 1;
+            passes.push_back(pass);
+        }
+        PostPass& pass = passes.back();
+        pass.stages[pass.stageCount++] = effect;
+        if (effect == PostEffect::Scale2x) {
+            pass.scale *= 2;
+        }
+    }
+    return passes;
+}
+
+std::string PostPassDefines(const PostPass& pass) {
+    std::string defines = "#define POST_STAGES " + std::to_string(pass.stageCount) + "\n";
+    for (int32_t i = 0; i < pass.stageCount; ++i) {
+        defines += "#define POST_STAGE" + std::to_string(i) + " " +
+                   std::to_string(static_cast<int>(pass.stages[i])) + "\n";
+    }
+    return defines;
+}
+
+std::string PostPassName(const PostPass& pass) {
+    std::string name;
+    for (int32_t i = 0; i < pass.stageCount; ++i) {
+        if (i > 0) name += "+";
+        name += PostEffectName(pass.stages[i]);
+    }
+    return name;
+}
+
+const char* PostEffectName(PostEffect effect) {
+    return PostEffectNames[static_cast<int>(effect)];
+}
+
+bool ParsePostEffect(const std::string& name, PostEffect& effect) {
+    for (int i = 0; i < static_cast<int>(sizeof(PostEffectNames) / sizeof(PostEffectNames[0])); ++i) {
+        if (name == PostEffectNames[i]) {
+            effect = static_cast<PostEffect>(i);
+            return true;
+        }
+    }
+    return false;
+}
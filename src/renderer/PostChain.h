@@ -0,0 +1,44 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Post-Processing Chain
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef POST_CHAIN_H
+#define POST_CHAIN_H
+
+#include "RendererInterfaces.h"
+#include <string>
+#include <vector>
+
+// ==========================================
+// Post Passes
+// ==========================================
+
+static const int MaxPostPassStages = 4;
+
+// One draw of the post-processing chain: post.frag.glsl runs the stages in
+// order. Stage 0 reads the pass input; later stages only remap coordinates
+// and shade the color, so they need no texture of their own.
+struct PostPass {
+    PostEffect stages[MaxPostPassStages];
+    int32_t stageCount;
+    int32_t scale;      // output size over input size
+};
+
+// Splits a chain into passes. Identity effects are dropped; an effect that
+// reads neighbouring texels (Scale2x) starts a new pass, every other one
+// fuses into the current pass.
+std::vector<PostPass> PlanPostPasses(const std::vector<PostEffect>& chain);
+
+// POST_STAGES and POST_STAGE0..n for post.frag.glsl
+std::string PostPassDefines(const PostPass& pass);
+
+// "scale2x+scanlines", for logs and shader ids
+std::string PostPassName(const PostPass& pass);
+
+// Lower-case effect name, as accepted by ParsePostEffect
+const char* PostEffectName(PostEffect effect);
+bool ParsePostEffect(const std::string& name, PostEffect& effect);
+
+#endif // POST_CHAIN_H
@@ -1,17 +1,24 @@
 #ifndef RENDERER_INTERFACES_H
 #define RENDERER_INTERFACES_H
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <vector>
 #include <map>
 #include <memory>
 #include "linmath.h"
+#include "GPUProfiler.h"
 
 struct Mat4 {
     mat4x4 data;
 };
 
+// Entry point resolver for GL functions glad does not load (extensions);
+// matches glfwGetProcAddress / eglGetProcAddress
+typedef void (*GLProc)(void);
+typedef GLProc (*GLProcLoader)(const char* name);
+
 // Forward declarations
 class ITexture;
 class IShaderProgram;
@@ -53,6 +60,131 @@ enum class TextureSamplingParam {
     WrapRepeat
 };
 
+// Storage of the image-based lighting textures. Half stores environment
+// cubemaps as packed or half floats and the BRDF LUT as RG16F; Full keeps
+// 32-bit floats throughout.
+enum class IBLPrecision {
+    Full,
+    Half
+};
+
+// Effects of the post-processing chain (IRenderer::SetPostChain)
+enum class PostEffect {
+    Identity,   // copies its input; dropped from the chain
+    Scanlines,  // darkens the lower half of every scene row
+    CRT,        // barrel curvature, aperture mask and vignette
+    Scale2x     // EPX pixel-art upscale to twice the resolution
+};
+
+// Passes described by IRenderer::SetRenderPassPolicy
+enum class RenderPass {
+    Scene,      // BeginFrame to EndFrame, into the scene target
+    Models,     // prepareModelPipeline to ReleaseModelPipeline; shares the Scene color
+    Shadows,    // prepareShadowMapPipeline to ReleaseShadowPipeline; depth only
+    Count
+};
+
+// What a pass does with an attachment's earlier contents when it starts.
+// Tile-based GPUs load only Load attachments into tile memory.
+enum class AttachmentLoad {
+    Load,
+    Clear,      // cleared right after the bind
+    DontCare    // invalidated; the pass must cover every pixel it reads
+};
+
+// Whether an attachment is kept when its pass ends. DontCare ones are
+// invalidated, so tile-based GPUs never write them back to memory.
+enum class AttachmentStore {
+    Store,
+    DontCare
+};
+
+struct RenderPassPolicy {
+    AttachmentLoad colorLoad;
+    AttachmentLoad depthLoad;
+    AttachmentStore colorStore;
+    AttachmentStore depthStore;
+};
+
+// ==========================================
+// Uniform Handles
+// ==========================================
+
+// Process-wide interned uniform/texture name. Resolve once, e.g. at startup,
+// and pass it to the handle-based SetUniform* / SetTexture overloads to skip
+// the per-call string lookup. Interning is not thread-safe; do it from the
+// render thread.
+typedef int32_t UniformID;
+
+inline UniformID InternUniform(const std::string& name) {
+    static std::map<std::string, UniformID> ids;
+    auto it = ids.find(name);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    UniformID id = static_cast<UniformID>(ids.size());
+    ids.emplace(name, id);
+    return id;
+}
+
+// ==========================================
+// Uniform Block Bindings
+// ==========================================
+
+// Binding points of the std140 blocks the shaders declare under USE_UBO.
+// Each block name gets a fixed point so ranges stay bound across programs.
+enum class UniformBlockBinding : uint32_t {
+    Environment = 0,    // EnvironmentUniform, uploaded once per frame
+    Mesh = 1,           // MeshUniform, per draw
+    Material = 2,       // MaterialUniform, per draw
+    Sprite = 3,         // SpriteUniform, per draw
+    Count = 4
+};
+
+inline int32_t GetUniformBlockBinding(const std::string& blockName) {
+    if (blockName == "EnvironmentUniform") return static_cast<int32_t>(UniformBlockBinding::Environment);
+    if (blockName == "MeshUniform") return static_cast<int32_t>(UniformBlockBinding::Mesh);
+    if (blockName == "MaterialUniform") return static_cast<int32_t>(UniformBlockBinding::Material);
+    if (blockName == "SpriteUniform") return static_cast<int32_t>(UniformBlockBinding::Sprite);
+    return -1;
+}
+
+// ==========================================
+// Sprite Instances
+// ==========================================
+
+// Per-instance data of RenderQuadInstanced, streamed as instanced vertex
+// attributes. The members are grouped into vec4s so the record can be
+// pointed at directly: i_modelview (4 columns), i_tint, i_addAlpha and
+// i_multPalIndex in sprite.vert.glsl under INSTANCED.
+struct SpriteInstance {
+    float modelview[16];
+    float tint[4];
+    float add[3];
+    float alpha;
+    float mult[3];
+    float palIndex;
+};
+
+// Per-draw data of RenderElementsMultiDraw. model is streamed as the
+// instanced drawModel attribute (four columns) of the MULTI_DRAW model
+// permutation; count and offset are the index range, as for RenderElements.
+struct ModelDraw {
+    float model[16];
+    int32_t count;
+    int32_t offset;     // bytes into the index buffer
+};
+
+// Command record glMultiDrawElementsIndirect and glDrawElementsIndirect
+// read from the draw indirect buffer
+struct DrawElementsIndirectCommand {
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;  // must be 0 on OpenGL ES
+};
+
 // ==========================================
 // IShaderProgram Interface
 // ==========================================
@@ -169,6 +301,44 @@ struct GLState {
     bool useOutlineAttribute;
 };
 
+// ==========================================
+// State Cache Statistics
+// ==========================================
+
+// Kinds of GL state calls the backends route through their state cache
+enum class StateCall {
+    Program,
+    VertexArray,
+    Buffer,
+    Texture,            // active unit and texture bindings
+    Framebuffer,
+    Viewport,
+    Scissor,
+    Capability,         // glEnable / glDisable
+    Blend,
+    Depth,
+    Face,               // cull and front face
+    Count
+};
+
+inline const char* GetStateCallName(StateCall kind) {
+    static const char* names[] = {"Program", "VertexArray", "Buffer", "Texture", "Framebuffer", "Viewport",
+                                  "Scissor", "Capability", "Blend", "Depth", "Face"};
+    return kind < StateCall::Count ? names[static_cast<int>(kind)] : "";
+}
+
+// Calls per kind since the last reset; redundant ones matched the cached
+// value and were not issued
+struct StateCacheStats {
+    uint64_t calls[static_cast<int>(StateCall::Count)];
+    uint64_t redundant[static_cast<int>(StateCall::Count)];
+    uint64_t mismatches;    // cached values validation found wrong
+};
+
+// Range of IRenderer::SetRenderScale
+static const float MinRenderScale = 0.5f;
+static const float MaxRenderScale = 2.0f;
+
 // ==========================================
 // IRenderer Interface
 // ==========================================
@@ -176,9 +346,21 @@ class IRenderer {
 public:
     // Constructor/Destructor
     IRenderer() : fbo(0), fbo_texture(0), rbo_depth(0), glVersionMajor(0), glVersionMinor(0),
-                   fbo_f(0), fbo_f_texture(nullptr), fbo_shadow(0), fbo_shadow_cube_texture(0), fbo_env(0),
+                   fbo_f(0), fbo_f_texture(nullptr), fbo_shadow(0), fbo_shadow_texture(0), fbo_env(0),
                    postVertBuffer(0), vertexBuffer(0), vertexBufferBatch(0), vao(0),
-                   enableModel(false), enableShadow(false) {}
+                   enableModel(false), enableShadow(false), procLoader(nullptr),
+                   iblPrecision(IBLPrecision::Half), gpuProfiling(false),
+                   outputWidth(1920), outputHeight(1080), renderScale(1.0f) {
+        // Scene color survives for BeginFrame(false); depth is rebuilt by
+        // every pass that tests it. The shadow atlas keeps its tiles between
+        // frames; SetShadowAtlasView clears the one about to be rendered.
+        passPolicies[static_cast<int>(RenderPass::Scene)] = {AttachmentLoad::Load, AttachmentLoad::Clear,
+                                                            AttachmentStore::Store, AttachmentStore::DontCare};
+        passPolicies[static_cast<int>(RenderPass::Models)] = {AttachmentLoad::Load, AttachmentLoad::Clear,
+                                                             AttachmentStore::Store, AttachmentStore::DontCare};
+        passPolicies[static_cast<int>(RenderPass::Shadows)] = {AttachmentLoad::DontCare, AttachmentLoad::Load,
+                                                              AttachmentStore::DontCare, AttachmentStore::Store};
+    }
     virtual ~IRenderer() {}
 
     // ===== Initialization & Lifecycle =====
@@ -186,12 +368,65 @@ public:
     virtual void Close() = 0;
     virtual std::string GetName() const = 0;
     virtual int InitModelShader() = 0;
+    // Set before Init; without it optional extensions are left unused
+    void SetProcLoader(GLProcLoader loader) { procLoader = loader; }
+    // Applies to IBL textures created afterwards
+    void SetIBLPrecision(IBLPrecision precision) { iblPrecision = precision; }
+    IBLPrecision GetIBLPrecision() const { return iblPrecision; }
+    // Set before Init; where linked program binaries are cached
+    virtual void SetShaderCacheDirectory(const std::string& dir) = 0;
+    // Model, shadow and IBL programs compile in the background after
+    // InitModelShader, models drawing unlit meanwhile. Blocks until every
+    // queued program is linked and swapped in.
+    virtual void FinishShaderJobs() = 0;
 
     // ===== Frame Management =====
     virtual void BeginFrame(bool clearColor) = 0;
     virtual void EndFrame() = 0;
     virtual void Await() = 0;
 
+    // ===== Render Targets =====
+    // Scenes render offscreen at the output size times the render scale;
+    // EndFrame scales the result to the output (the default framebuffer).
+    // Scissor rectangles stay in output pixels. Both setters recreate the
+    // targets when the render size changes, so call them between frames;
+    // before Init they only set the initial size.
+    virtual void Resize(int32_t width, int32_t height) = 0;
+    virtual void SetRenderScale(float scale) = 0;   // clamped to MinRenderScale..MaxRenderScale
+    int32_t GetOutputWidth() const { return outputWidth; }
+    int32_t GetOutputHeight() const { return outputHeight; }
+    float GetRenderScale() const { return renderScale; }
+    int32_t GetRenderWidth() const { return std::max(1, static_cast<int32_t>(outputWidth * renderScale + 0.5f)); }
+    int32_t GetRenderHeight() const { return std::max(1, static_cast<int32_t>(outputHeight * renderScale + 0.5f)); }
+    // Multisampled scene rendering; 0 or 1 disables it. The count is
+    // clamped to the driver maximum when the targets are created, which
+    // GetMSAASamples reports afterwards.
+    virtual void SetMSAASamples(int32_t samples) = 0;
+    virtual int32_t GetMSAASamples() const = 0;
+
+    // ===== Post-Processing =====
+    // Effects applied in order between the scene and the output. Effects
+    // that do not read neighbouring texels fuse into the previous pass,
+    // passes ping-pong between two targets and the last one draws straight
+    // to the output. Until every pass has linked, frames are presented as
+    // with an empty chain.
+    virtual void SetPostChain(const std::vector<PostEffect>& chain) = 0;
+    // Recompiles the post shaders from disk; the running programs stay in
+    // use until their replacements link
+    virtual void ReloadPostShaders() = 0;
+
+    // ===== Render Pass Load/Store =====
+    // Applied when the pass next begins and ends. Scene colorLoad is used
+    // by BeginFrame(false) (BeginFrame(true) always clears); Scene
+    // colorStore DontCare drops the multisampled color once EndFrame has
+    // resolved it. Models only uses the depth fields.
+    void SetRenderPassPolicy(RenderPass pass, const RenderPassPolicy& policy) {
+        passPolicies[static_cast<int>(pass)] = policy;
+    }
+    const RenderPassPolicy& GetRenderPassPolicy(RenderPass pass) const {
+        return passPolicies[static_cast<int>(pass)];
+    }
+
     // ===== Capabilities =====
     virtual bool IsModelEnabled() const = 0;
     virtual bool IsShadowEnabled() const = 0;
@@ -210,6 +445,9 @@ public:
     virtual void SetPipeline(BlendEquation eq, BlendFunc src, BlendFunc dst) = 0;
     virtual void SetPipelineBatch() = 0;
     virtual void ReleasePipeline() = 0;
+    // Binds the INSTANCED sprite program; sprite uniforms and textures set
+    // afterwards apply to it until ReleasePipeline
+    virtual void SetPipelineInstanced(BlendEquation eq, BlendFunc src, BlendFunc dst) = 0;
 
     // ===== Pipeline Setup - Models =====
     virtual void prepareModelPipeline(uint32_t bufferIndex, const Environment* env) = 0;
@@ -243,9 +481,41 @@ public:
     virtual std::shared_ptr<ITexture> newHDRTexture(int32_t width, int32_t height) = 0;
     virtual std::shared_ptr<ITexture> newCubeMapTexture(int32_t widthHeight, bool mipmap, int32_t lowestMipLevel) = 0;
 
+    // Uploads to a texture from newTexture; empty data allocates the level
+    // uninitialized. Texel data is staged and transferred asynchronously:
+    // IsTextureReady turns true once the GPU has consumed every upload to
+    // the texture. CopyTextureRegion copies texels between two such
+    // textures of the same depth without a CPU round trip.
+    virtual void SetTextureData(const std::shared_ptr<ITexture>& tex, const std::vector<uint8_t>& data) = 0;
+    virtual void SetTextureSubData(const std::shared_ptr<ITexture>& tex, const std::vector<uint8_t>& data,
+                                   int32_t x, int32_t y, int32_t width, int32_t height) = 0;
+    virtual void CopyTextureRegion(const std::shared_ptr<ITexture>& src, int32_t srcX, int32_t srcY,
+                                   const std::shared_ptr<ITexture>& dst, int32_t dstX, int32_t dstY,
+                                   int32_t width, int32_t height) = 0;
+    virtual bool IsTextureReady(const std::shared_ptr<ITexture>& tex) const = 0;
+    // Float texels for a texture from newHDRTexture (RGB) or newDataTexture (RGBA)
+    virtual void SetTexturePixelData(const std::shared_ptr<ITexture>& tex, const std::vector<float>& data) = 0;
+    // Raw texels of one mip level of a cubemap or 2D texture with storage,
+    // all six faces from +X on, in a layout private to the backend; only
+    // WriteTextureLevel of the same backend and precision reads it back.
+    // Both return false on textures they cannot transfer (or a size mismatch).
+    virtual bool ReadTextureLevel(const std::shared_ptr<ITexture>& tex, int32_t level, std::vector<uint8_t>& data) = 0;
+    virtual bool WriteTextureLevel(const std::shared_ptr<ITexture>& tex, int32_t level, const std::vector<uint8_t>& data) = 0;
+    // BRDF lookup table target for RenderLUT, storage allocated up front
+    virtual std::shared_ptr<ITexture> newLUTTexture(int32_t widthHeight) = 0;
+
+    // Bytes of GPU storage held by live textures, every mip level and face
+    // included (framebuffer attachments are not textures of this interface)
+    virtual size_t GetTextureMemory() const = 0;
+    // Bytes held by the renderer's own attachments: scene color and depth,
+    // multisampled samples, post-processing targets and the shadow atlas
+    virtual size_t GetRenderTargetMemory() const = 0;
+
     virtual void SetTexture(const std::string& name, const std::shared_ptr<ITexture>& tex) = 0;
     virtual void SetModelTexture(const std::string& name, const std::shared_ptr<ITexture>& tex) = 0;
     virtual void SetShadowMapTexture(const std::string& name, const std::shared_ptr<ITexture>& tex) = 0;
+    virtual void SetTexture(UniformID id, const std::shared_ptr<ITexture>& tex) = 0;
+    virtual void SetModelTexture(UniformID id, const std::shared_ptr<ITexture>& tex) = 0;
 
     // ===== Uniform Operations - Sprite Shader =====
     virtual void SetUniformI(const std::string& name, int val) = 0;
@@ -253,12 +523,20 @@ public:
     virtual void SetUniformFv(const std::string& name, const std::vector<float>& values) = 0;
     virtual void SetUniformMatrix(const std::string& name, const std::vector<float>& value) = 0;
 
+    // Handle-based variants; values points at count floats (1-4 components)
+    virtual void SetUniformI(UniformID id, int val) = 0;
+    virtual void SetUniformF(UniformID id, const float* values, int count) = 0;
+    virtual void SetUniformMatrix(UniformID id, const float* value) = 0;
+
     // ===== Uniform Operations - Model Shader =====
     virtual void SetModelUniformI(const std::string& name, int val) = 0;
     virtual void SetModelUniformF(const std::string& name, const std::vector<float>& values) = 0;
     virtual void SetModelUniformFv(const std::string& name, const std::vector<float>& values) = 0;
     virtual void SetModelUniformMatrix(const std::string& name, const std::vector<float>& value) = 0;
     virtual void SetModelUniformMatrix3(const std::string& name, const std::vector<float>& value) = 0;
+    virtual void SetModelUniformI(UniformID id, int val) = 0;
+    virtual void SetModelUniformF(UniformID id, const float* values, int count) = 0;
+    virtual void SetModelUniformMatrix(UniformID id, const float* value) = 0;
 
     // ===== Uniform Operations - Shadow Map Shader =====
     virtual void SetShadowMapUniformI(const std::string& name, int val) = 0;
@@ -267,20 +545,40 @@ public:
     virtual void SetShadowMapUniformMatrix(const std::string& name, const std::vector<float>& value) = 0;
     virtual void SetShadowMapUniformMatrix3(const std::string& name, const std::vector<float>& value) = 0;
 
-    // ===== Shadow Frame Operations =====
-    virtual void SetShadowFrameTexture(uint32_t i) = 0;
-    virtual void SetShadowFrameCubeTexture(uint32_t i) = 0;
+    // ===== Shadow Atlas =====
+    // Every light's shadow maps share one square depth texture of size
+    // texels (see ShadowAtlas.h); model programs sample it as shadowAtlas.
+    // Applied by the next InitModelShader; 0 turns shadows off.
+    virtual void SetShadowAtlasSize(int32_t size) = 0;
+    virtual int32_t GetShadowAtlasSize() const = 0;
+    // Directs the shadow pass at one tile of the atlas and clears its depth;
+    // call between prepareShadowMapPipeline and ReleaseShadowPipeline
+    virtual void SetShadowAtlasView(int32_t x, int32_t y, int32_t size) = 0;
+    // The shadow program links in the background after InitModelShader;
+    // the shadow pass does nothing until this turns true
+    virtual bool IsShadowReady() const = 0;
 
     // ===== Vertex Data Operations =====
-    virtual void SetVertexData(const std::vector<float>& values) = 0;
-    virtual void SetVertexDataArray(const std::vector<float>& values) = 0;
+    // Sprite vertices are appended to a per-frame stream; both calls return the
+    // first vertex of the upload, which RenderQuad/RenderQuadBatch draw from
+    virtual int32_t SetVertexData(const std::vector<float>& values) = 0;
+    virtual int32_t SetVertexDataArray(const std::vector<float>& values) = 0;
     virtual void SetModelVertexData(uint32_t bufferIndex, const std::vector<uint8_t>& values) = 0;
     virtual void SetModelIndexData(uint32_t bufferIndex, const std::vector<uint32_t>& values) = 0;
 
     // ===== Rendering Operations =====
     virtual void RenderQuad() = 0;
     virtual void RenderQuadBatch(int32_t vertexCount) = 0;
+    // Draws the quad of the last SetVertexData once per instance
+    virtual void RenderQuadInstanced(const SpriteInstance* instances, int32_t count) = 0;
     virtual void RenderElements(PrimitiveMode mode, int count, int offset) = 0;
+    // Draws several primitives of the current model pipeline (one vertex
+    // array, shader permutation and material) in one indirect submission,
+    // each with its own model matrix; the normal matrix is derived from it.
+    // Skinned and morphed primitives still go through RenderElements.
+    // Falls back to one RenderElements per draw without indirect draws or
+    // until the permutation has compiled.
+    virtual void RenderElementsMultiDraw(PrimitiveMode mode, const ModelDraw* draws, int32_t count) = 0;
     virtual void RenderShadowMapElements(PrimitiveMode mode, int count, int offset) = 0;
 
     // ===== CubeMap & IBL Rendering =====
@@ -290,6 +588,51 @@ public:
                               int32_t mipmapLevel, int32_t sampleCount, float roughness) = 0;
     virtual void RenderLUT(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
                    const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount) = 0;
+    // Rows [firstRow, firstRow + rowCount) of one face (0..5 from +X) of a
+    // RenderFilteredCubeMap level, and of a RenderLUT target, so a bake
+    // can be spread over several frames
+    virtual void RenderFilteredCubeMapRows(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                              const std::shared_ptr<ITexture>& filteredTex, int32_t mipmapLevel, int32_t face,
+                              int32_t firstRow, int32_t rowCount, int32_t sampleCount, float roughness) = 0;
+    virtual void RenderLUTRows(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                   const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount,
+                   int32_t firstRow, int32_t rowCount) = 0;
+    // The IBL programs link in the background after InitModelShader; the
+    // calls above do nothing until this turns true
+    virtual bool IsIBLReady() const = 0;
+
+    // ===== GPU Timer Queries =====
+    // GPU time of the commands between BeginGPUTimer and EndGPUTimer (spans
+    // do not nest). BeginGPUTimer returns 0 without timer queries (GLES without
+    // EXT_disjoint_timer_query).
+    // ReadGPUTimer never blocks: it is false until the result is available
+    // and recycles the query once read. Unread queries are freed by Close.
+    virtual uint32_t BeginGPUTimer() = 0;
+    virtual void EndGPUTimer() = 0;
+    virtual bool ReadGPUTimer(uint32_t query, uint64_t& nanoseconds) = 0;
+
+    // ===== GPU Profiling =====
+    // Named regions timed with timestamp queries while profiling is on
+    // (GLES needs EXT_disjoint_timer_query). Regions nest; each frame is
+    // wrapped in "Frame" and the backends time BeginFrame, the shadow, model
+    // and sprite passes and EndFrame themselves. Results reach the profiler
+    // a few frames late, from BeginFrame, without stalling.
+    virtual void BeginGPURegion(const char* name) = 0;
+    virtual void EndGPURegion() = 0;
+    void SetGPUProfiling(bool enabled) { gpuProfiling = enabled; }
+    bool IsGPUProfiling() const { return gpuProfiling; }
+    GPUProfiler& GetGPUProfiler() { return gpuProfiler; }
+    const GPUProfiler& GetGPUProfiler() const { return gpuProfiler; }
+
+    // ===== State Cache =====
+    // Every GL state change goes through a shadow copy of the context that
+    // drops redundant calls. Call InvalidateState after touching the
+    // context outside the renderer. Validation checks the copy against
+    // glGet* before every draw and prints each mismatch (debugging only).
+    virtual void InvalidateState() = 0;
+    virtual void SetStateValidation(bool enabled) = 0;
+    virtual StateCacheStats GetStateCacheStats() const = 0;
+    virtual void ResetStateCacheStats() = 0;
 
     // ===== Pixel Operations =====
     virtual void ReadPixels(std::vector<uint8_t>& data, int width, int height) = 0;
@@ -326,7 +669,7 @@ protected:
     
     // Shadow mapping
     uint32_t fbo_shadow;
-    uint32_t fbo_shadow_cube_texture;
+    uint32_t fbo_shadow_texture;
     uint32_t fbo_env;
     
     // Post-processing
@@ -353,6 +696,14 @@ protected:
     bool enableModel;
     bool enableShadow;
     GLState glState;
+    GLProcLoader procLoader;
+    IBLPrecision iblPrecision;
+    GPUProfiler gpuProfiler;
+    bool gpuProfiling;
+    int32_t outputWidth;
+    int32_t outputHeight;
+    float renderScale;
+    RenderPassPolicy passPolicies[static_cast<int>(RenderPass::Count)];
 
     // ===== Private Helper Methods =====
     std::shared_ptr<IShaderProgram> newShaderProgram(const std::string& vert, const std::string& frag,
@@ -367,4 +718,21 @@ protected:
     uint32_t MapPrimitiveMode(PrimitiveMode mode) const { return 0; }
 };
 
+// ==========================================
+// Scoped GPU Region
+// ==========================================
+
+// Times the enclosing scope as a GPU region of the renderer
+class ScopedGPURegion {
+public:
+    ScopedGPURegion(IRenderer& renderer, const char* name) : renderer(renderer) { renderer.BeginGPURegion(name); }
+    ~ScopedGPURegion() { renderer.EndGPURegion(); }
+
+    ScopedGPURegion(const ScopedGPURegion&) = delete;
+    ScopedGPURegion& operator=(const ScopedGPURegion&) = delete;
+
+private:
+    IRenderer& renderer;
+};
+
 #endif // RENDERER_INTERFACES_H
\ No newline at end of file
@@ -5,13 +5,27 @@
 #include <cmath>
 #include <algorithm>
 #include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <chrono>
+#include <cstdio>
 #include "RendererOpenGL.h"
+#include "Environment.h"
+
+// KHR_parallel_shader_compile (not in the bundled glad headers)
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 // ==========================================
 // ShaderProgram_GL Implementation
 // ==========================================
 
-ShaderProgram_GL::ShaderProgram_GL() : program(0) {
+ShaderProgram_GL::ShaderProgram_GL() : program(0), blocksReflected(false) {
 }
 
 ShaderProgram_GL::~ShaderProgram_GL() {
@@ -29,13 +43,22 @@ void ShaderProgram_GL::RegisterAttributes(const std::vector<std::string>& names)
 void ShaderProgram_GL::RegisterUniforms(const std::vector<std::string>& names) {
     for (const auto& name : names) {
         uniforms[name] = glGetUniformLocation(program, name.c_str());
+        StoreByID(uniformsByID, InternUniform(name), uniforms[name]);
+        if (uniforms[name] < 0) {
+            RegisterBlockMember(name);
+        }
     }
+#ifdef DEBUG
+    CheckBlockArrays(names);
+#endif
 }
 
 void ShaderProgram_GL::RegisterTextures(const std::vector<std::string>& names) {
     for (const auto& name : names) {
         uniforms[name] = glGetUniformLocation(program, name.c_str());
         textures[name] = static_cast<int>(textures.size());
+        StoreByID(uniformsByID, InternUniform(name), uniforms[name]);
+        StoreByID(texturesByID, InternUniform(name), textures[name]);
     }
 }
 
@@ -59,6 +82,163 @@ uint8_t* ShaderProgram_GL::glStr(const std::string& s) {
     return reinterpret_cast<uint8_t*>(const_cast<char*>(s.c_str()));
 }
 
+void ShaderProgram_GL::StoreByID(std::vector<int32_t>& table, UniformID id, int32_t value) {
+    if (id >= static_cast<int32_t>(table.size())) {
+        table.resize(id + 1, -1);
+    }
+    table[id] = value;
+}
+
+void ShaderProgram_GL::ReflectUniformBlocks() {
+    blocksReflected = true;
+
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        GLint nameLength = 0;
+        glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &nameLength);
+        std::vector<char> name(std::max(nameLength, 1));
+        glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(name.size()), nullptr, name.data());
+
+        int32_t binding = GetUniformBlockBinding(name.data());
+        if (binding < 0) {
+            std::cerr << "Unknown uniform block " << name.data() << std::endl;
+            continue;
+        }
+
+        GLint size = 0;
+        glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        glUniformBlockBinding(program, i, binding);
+
+        UniformBlock block;
+        block.index = i;
+        block.binding = binding;
+        block.data.assign(size, 0);
+        block.dirty = true;
+        block.uploadFrame = ~0ull;
+        block.uploadGeneration = 0;
+        block.uploadOffset = 0;
+        blocks.push_back(block);
+    }
+}
+
+void ShaderProgram_GL::RegisterBlockMember(const std::string& name) {
+    if (blockOwner) {
+        return;
+    }
+    if (!blocksReflected) {
+        ReflectUniformBlocks();
+    }
+    if (blocks.empty()) {
+        return;
+    }
+
+    const char* namePtr = name.c_str();
+    GLuint index = GL_INVALID_INDEX;
+    glGetUniformIndices(program, 1, &namePtr, &index);
+    if (index == GL_INVALID_INDEX) {
+        return;
+    }
+
+    GLint blockIndex = -1, offset = 0, arrayStride = 0, matrixStride = 0;
+    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &arrayStride);
+    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &matrixStride);
+    // "name[i]" resolves to the whole array, whose offset is element 0's
+    if (!name.empty() && name.back() == ']' && arrayStride > 0) {
+        size_t open = name.rfind('[');
+        offset += arrayStride * std::atoi(name.c_str() + open + 1);
+    }
+
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        if (static_cast<GLint>(blocks[b].index) != blockIndex) {
+            continue;
+        }
+        UniformID id = InternUniform(name);
+        if (id >= static_cast<int32_t>(blockMembersByID.size())) {
+            blockMembersByID.resize(id + 1, BlockMember{-1, 0, 0, 0});
+        }
+        blockMembersByID[id] = BlockMember{static_cast<int32_t>(b), offset, arrayStride, matrixStride};
+        return;
+    }
+}
+
+bool ShaderProgram_GL::WriteBlockUniform(UniformID id, const void* data, int elementSize, int count) {
+    if (blockOwner) {
+        return blockOwner->WriteBlockUniform(id, data, elementSize, count);
+    }
+    if (id < 0 || id >= static_cast<int32_t>(blockMembersByID.size()) || count <= 0) {
+        return false;
+    }
+    const BlockMember& member = blockMembersByID[id];
+    if (member.block < 0) {
+        return false;
+    }
+
+    // Matrix columns and array elements are padded out to their std140 stride
+    UniformBlock& block = blocks[member.block];
+    int stride = member.matrixStride > 0 ? member.matrixStride :
+                 (member.arrayStride > 0 ? member.arrayStride : elementSize);
+    size_t end = static_cast<size_t>(member.offset + stride * (count - 1) + elementSize);
+    if (end > block.data.size()) {
+        return false;
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    for (int i = 0; i < count; ++i) {
+        std::memcpy(&block.data[member.offset + i * stride], src + i * elementSize, elementSize);
+    }
+    block.dirty = true;
+    return true;
+}
+
+#ifdef DEBUG
+// Writes element 0 and element i of every "name[i]" block member and reads
+// both back, so array elements that alias in the block copy are reported
+void ShaderProgram_GL::CheckBlockArrays(const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+        size_t open = name.rfind('[');
+        if (name.empty() || name.back() != ']' || open == std::string::npos ||
+            std::atoi(name.c_str() + open + 1) == 0) {
+            continue;
+        }
+        UniformID first = InternUniform(name.substr(0, open) + "[0]");
+        UniformID element = InternUniform(name);
+        if (first >= static_cast<int32_t>(blockMembersByID.size()) ||
+            element >= static_cast<int32_t>(blockMembersByID.size()) ||
+            blockMembersByID[first].block < 0 || blockMembersByID[element].block < 0) {
+            continue;
+        }
+
+        const BlockMember& a = blockMembersByID[first];
+        const BlockMember& b = blockMembersByID[element];
+        float saved[2], read[2];
+        std::memcpy(&saved[0], &blocks[a.block].data[a.offset], sizeof(float));
+        std::memcpy(&saved[1], &blocks[b.block].data[b.offset], sizeof(float));
+        float values[2] = {1.0f, 2.0f};
+        WriteBlockUniform(first, &values[0], sizeof(float), 1);
+        WriteBlockUniform(element, &values[1], sizeof(float), 1);
+        std::memcpy(&read[0], &blocks[a.block].data[a.offset], sizeof(float));
+        std::memcpy(&read[1], &blocks[b.block].data[b.offset], sizeof(float));
+        if (read[0] != values[0] || read[1] != values[1]) {
+            std::cerr << "Uniform block member " << name << " aliases element 0" << std::endl;
+        }
+        WriteBlockUniform(first, &saved[0], sizeof(float), 1);
+        WriteBlockUniform(element, &saved[1], sizeof(float), 1);
+    }
+}
+#endif
+
+void ShaderProgram_GL::ShareUniformBlocks(const std::shared_ptr<ShaderProgram_GL>& base) {
+    // Reflection binds this program's blocks to the shared points; the
+    // copies it allocates are dropped in favour of the base program's
+    ReflectUniformBlocks();
+    blocks.clear();
+    blockMembersByID.clear();
+    blockOwner = base;
+}
+
 std::string ShaderProgram_GL::GetShaderInfoLog(uint32_t shader) {
     GLint logLength = 0;
     glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
@@ -80,32 +260,120 @@ std::string ShaderProgram_GL::GetProgramInfoLog(uint32_t program) {
     }
     return "";
 }
+// ==========================================
+// Texture Storage
+// ==========================================
+
+struct TextureFormatInfo {
+    GLenum internalFormat;
+    GLenum format;          // transfer format and type matching the storage
+    GLenum type;            // texel for texel (glTexImage fallback, readback)
+    int32_t bytesPerTexel;
+};
+
+static const TextureFormatInfo& LookupTextureFormat(GLenum internalFormat) {
+    static const TextureFormatInfo formats[] = {
+        {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4},
+        {GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1},
+        {GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, 3},
+        {GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, 4},
+        {GL_RG16F, GL_RG, GL_HALF_FLOAT, 4},
+        {GL_RGB16F, GL_RGB, GL_HALF_FLOAT, 6},
+        {GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8},
+        {GL_RGB32F, GL_RGB, GL_FLOAT, 12},
+        {GL_RGBA32F, GL_RGBA, GL_FLOAT, 16},
+        {GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4},
+    };
+
+    for (const TextureFormatInfo& info : formats) {
+        if (info.internalFormat == internalFormat) return info;
+    }
+    return formats[0];
+}
+
+// Levels of a full mip chain down to 1x1
+static int32_t MipLevelCount(int32_t width, int32_t height) {
+    int32_t levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+        levels++;
+    }
+    return levels;
+}
+
+// Allocates every level of the texture bound to target and returns its size
+// in bytes. Uses immutable storage on GL 4.2 / ARB_texture_storage, and one
+// glTexImage per level and face otherwise.
+static size_t AllocateTextureStorage(GLenum target, GLenum internalFormat, int32_t levels,
+                                     int32_t width, int32_t height, int32_t layers = 1) {
+    const TextureFormatInfo& info = LookupTextureFormat(internalFormat);
+    const int32_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+
+    if (target == GL_TEXTURE_2D_ARRAY && glTexStorage3D != nullptr) {
+        glTexStorage3D(target, levels, internalFormat, width, height, layers);
+    } else if (target != GL_TEXTURE_2D_ARRAY && glTexStorage2D != nullptr) {
+        glTexStorage2D(target, levels, internalFormat, width, height);
+    } else {
+        for (int32_t level = 0; level < levels; ++level) {
+            int32_t w = std::max(width >> level, 1);
+            int32_t h = std::max(height >> level, 1);
+            if (target == GL_TEXTURE_2D_ARRAY) {
+                glTexImage3D(target, level, internalFormat, w, h, layers, 0, info.format, info.type, nullptr);
+                continue;
+            }
+            for (int32_t face = 0; face < faces; ++face) {
+                GLenum image = faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+                glTexImage2D(image, level, internalFormat, w, h, 0, info.format, info.type, nullptr);
+            }
+        }
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    }
+
+    size_t size = 0;
+    for (int32_t level = 0; level < levels; ++level) {
+        size += static_cast<size_t>(std::max(width >> level, 1)) * std::max(height >> level, 1);
+    }
+    return size * info.bytesPerTexel * faces * layers;
+}
+
 // ==========================================
 // Texture_GL Implementation
 // ==========================================
 
+size_t Texture_GL::allocatedBytes = 0;
+
 Texture_GL::Texture_GL(int32_t width, int32_t height, int32_t depth, bool filter, uint32_t handle)
-    : ITexture(width, height, depth, filter, handle), width(width), height(height), depth(depth), filter(filter), handle(handle) {
+    : ITexture(width, height, depth, filter, handle), width(width), height(height), depth(depth), filter(filter), handle(handle),
+      textureTarget(GL_TEXTURE_2D), internalFormat(0), levels(0), memorySize(0) {
 }
 
 Texture_GL::~Texture_GL() {
     if (handle != 0) {
-        glDeleteTextures(1, &handle);
+        StateCache_GL::DeleteTextures(1, &handle);
     }
+    allocatedBytes -= memorySize;
+}
+
+void Texture_GL::Allocate(GLenum target, uint32_t internalFormat, int32_t levels, int32_t layers) {
+    if (this->levels != 0) return;
+
+    StateCache_GL::BindTexture(target, handle);
+    memorySize = AllocateTextureStorage(target, internalFormat, levels, width, height, layers);
+    allocatedBytes += memorySize;
+    this->levels = levels;
+    textureTarget = target;
+    this->internalFormat = internalFormat;
 }
 
 void Texture_GL::SetData(const std::vector<uint8_t>& data) {
     int32_t interp = filter ? GL_LINEAR : GL_NEAREST;
     uint32_t format = MapInternalFormat(std::max(depth, 8));
 
-    glBindTexture(GL_TEXTURE_2D, handle);
-    glFinish();
+    Allocate(GL_TEXTURE_2D, MapSizedFormat(std::max(depth, 8)), 1);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
     if (!data.empty()) {
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data.data());
-    } else {
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data.data());
     }
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, interp);
@@ -118,7 +386,7 @@ void Texture_GL::SetSubData(const std::vector<uint8_t>& data, int32_t x, int32_t
                             int32_t width, int32_t height) {
     uint32_t format = MapInternalFormat(std::max(depth, 8));
 
-    glBindTexture(GL_TEXTURE_2D, handle);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
     if (!data.empty()) {
@@ -128,13 +396,23 @@ void Texture_GL::SetSubData(const std::vector<uint8_t>& data, int32_t x, int32_t
     }
 }
 
+void Texture_GL::SetSubData(size_t offset, int32_t x, int32_t y, int32_t width, int32_t height) {
+    uint32_t format = MapInternalFormat(std::max(depth, 8));
+
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, GL_UNSIGNED_BYTE,
+                    reinterpret_cast<const void*>(offset));
+}
+
 void Texture_GL::SetDataG(const std::vector<uint8_t>& data, TextureSamplingParam mag,
                          TextureSamplingParam min, TextureSamplingParam ws, TextureSamplingParam wt) {
     uint32_t format = MapInternalFormat(std::max(depth, 8));
 
-    glBindTexture(GL_TEXTURE_2D, handle);
+    Allocate(GL_TEXTURE_2D, MapSizedFormat(std::max(depth, 8)), MipLevelCount(width, height));
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data.data());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data.data());
     glGenerateMipmap(GL_TEXTURE_2D);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, MapTextureSamplingParam(mag));
@@ -145,15 +423,15 @@ void Texture_GL::SetDataG(const std::vector<uint8_t>& data, TextureSamplingParam
 
 void Texture_GL::SetPixelData(const std::vector<float>& data) {
     uint32_t format = MapInternalFormat(std::max(depth / 4, 8));
-    uint32_t internalFormat = MapInternalFormat(std::max(depth, 8));
 
-    glBindTexture(GL_TEXTURE_2D, handle);
+    Allocate(GL_TEXTURE_2D, MapSizedFormat(std::max(depth, 8)), 1);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, data.data());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_FLOAT, data.data());
 }
 
 void Texture_GL::SetPaletteLayer(const std::vector<uint8_t>& data, int32_t layer) {
-    glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D_ARRAY, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
     // Upload to specific Z-slice (layer)
@@ -171,12 +449,13 @@ void Texture_GL::CopyData(const Texture_GL* src) {
         return;
     }
 
-    glBindTexture(GL_TEXTURE_2D, src->handle);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, src->handle);
     int pixelSize = width * height * (depth / 8);
     std::vector<uint8_t> data(pixelSize);
     glGetTexImage(GL_TEXTURE_2D, 0, src->MapInternalFormat(std::max(src->depth, 8)), GL_UNSIGNED_BYTE, data.data());
 
-    glBindTexture(GL_TEXTURE_2D, handle);
+    Allocate(GL_TEXTURE_2D, MapSizedFormat(std::max(depth, 8)), 1);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, MapInternalFormat(std::max(depth, 8)), GL_UNSIGNED_BYTE, data.data());
 }
 
@@ -197,6 +476,19 @@ uint32_t Texture_GL::MapInternalFormat(int32_t d) const {
     return (it != InternalFormatLUT.end()) ? it->second : GL_RGBA;
 }
 
+uint32_t Texture_GL::MapSizedFormat(int32_t d) const {
+    static const std::map<int32_t, uint32_t> SizedFormatLUT = {
+        {8, GL_R8},
+        {24, GL_RGB8},
+        {32, GL_RGBA8},
+        {96, GL_RGB32F},
+        {128, GL_RGBA32F}
+    };
+
+    auto it = SizedFormatLUT.find(d);
+    return (it != SizedFormatLUT.end()) ? it->second : GL_RGBA8;
+}
+
 int32_t Texture_GL::MapTextureSamplingParam(TextureSamplingParam param) const {
     static const std::map<TextureSamplingParam, int32_t> SamplingParamLUT = {
         {TextureSamplingParam::FilterNearest, GL_NEAREST},
@@ -220,7 +512,7 @@ int Texture_GL::SavePNG(const std::string& filename, const std::vector<uint32_t>
         return -1;
     }
 
-    glBindTexture(GL_TEXTURE_2D, handle);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
     int pixelSize = width * height * (depth / 8);
     std::vector<uint8_t> data(pixelSize);
     glGetTexImage(GL_TEXTURE_2D, 0, MapInternalFormat(std::max(depth, 8)), GL_UNSIGNED_BYTE, data.data());
@@ -241,378 +533,1492 @@ int Texture_GL::SavePNG(const std::string& filename, const std::vector<uint32_t>
 }
 
 // ==========================================
-// Renderer_GL Implementation
+// StreamBuffer_GL Implementation
 // ==========================================
 
-Renderer_GL::Renderer_GL()
-    : IRenderer() {
-    glState.depthTest = false;
-    glState.depthMask = false;
-    glState.invertFrontFace = false;
-    glState.doubleSided = false;
-    glState.blendEquation = BlendEquation::Add;
-    glState.blendSrc = BlendFunc::SrcAlpha;
-    glState.blendDst = BlendFunc::OneMinusSrcAlpha;
-    glState.useUV = false;
-    glState.useNormal = false;
-    glState.useTangent = false;
-    glState.useVertColor = false;
-    glState.useJoint0 = false;
-    glState.useJoint1 = false;
-    glState.useOutlineAttribute = false;
+StreamBuffer_GL::StreamBuffer_GL()
+    : handle(0), target(GL_ARRAY_BUFFER), segmentSize(0), cursor(0),
+      segment(0), generation(0), persistent(false), mapped(nullptr) {
+    for (int i = 0; i < SegmentCount; ++i) {
+        fences[i] = nullptr;
+    }
 }
 
-Renderer_GL::~Renderer_GL() {
-    Close();
+StreamBuffer_GL::~StreamBuffer_GL() {
+    Destroy();
 }
 
-void Renderer_GL::Init() {
-    // Query and store OpenGL version
-    glGetIntegerv(GL_MAJOR_VERSION, &glVersionMajor);
-    glGetIntegerv(GL_MINOR_VERSION, &glVersionMinor);
+bool StreamBuffer_GL::Init(GLenum target, size_t segmentSize, bool persistent) {
+    this->target = target;
+    this->segmentSize = segmentSize;
+    // The storage entry point is only loaded for GL 4.4+ contexts
+    this->persistent = persistent && glBufferStorage != nullptr;
+    segment = 0;
+    cursor = 0;
+    generation++;
+
+    const GLsizeiptr totalSize = static_cast<GLsizeiptr>(segmentSize * SegmentCount);
+    glGenBuffers(1, &handle);
+    StateCache_GL::BindBuffer(target, handle);
+
+    if (this->persistent) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, totalSize, nullptr, flags);
+        mapped = static_cast<uint8_t*>(glMapBufferRange(target, 0, totalSize, flags));
+        if (mapped == nullptr) {
+            std::cerr << "StreamBuffer: persistent mapping failed, using glMapBufferRange" << std::endl;
+            StateCache_GL::DeleteBuffers(1, &handle);
+            handle = 0;
+            return Init(target, segmentSize, false);
+        }
+    } else {
+        glBufferData(target, totalSize, nullptr, GL_STREAM_DRAW);
+    }
 
-    // Print GL information
-    std::cout << "Real GL Version: " << reinterpret_cast<const char*>(glGetString(GL_VERSION)) << std::endl;
-    std::cout << "Detected OpenGL: " << glVersionMajor << "." << glVersionMinor << std::endl;
-    std::cout << "Real GLSL Version: " << reinterpret_cast<const char*>(glGetString(GL_SHADING_LANGUAGE_VERSION)) << std::endl;
-    std::cout << "Real GL Renderer: " << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << std::endl;
-    std::cout << "Real GL Vendor: " << reinterpret_cast<const char*>(glGetString(GL_VENDOR)) << std::endl;
+    return true;
+}
 
-    // Configure based on OpenGL version
-    ConfigureForOpenGLVersion();
+void StreamBuffer_GL::Destroy() {
+    for (int i = 0; i < SegmentCount; ++i) {
+        if (fences[i] != nullptr) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
 
-    // Create VAO
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    if (handle != 0) {
+        if (mapped != nullptr) {
+            StateCache_GL::BindBuffer(target, handle);
+            glUnmapBuffer(target);
+            mapped = nullptr;
+        }
+        StateCache_GL::DeleteBuffers(1, &handle);
+        handle = 0;
+    }
+}
 
-    // Generate vertex buffers
-    glGenBuffers(1, &postVertBuffer);
-    glGenBuffers(1, &vertexBuffer);
-    glGenBuffers(2, &modelVertexBuffer[0]);
-    glGenBuffers(2, &modelIndexBuffer[0]);
-    glGenBuffers(1, &vertexBufferBatch);
+size_t StreamBuffer_GL::Append(const void* data, size_t size, size_t alignment) {
+    if (size > segmentSize) {
+        Grow(size + alignment);
+    }
 
-    // Create framebuffer texture
-    glGenTextures(1, &fbo_texture);
-    glBindTexture(GL_TEXTURE_2D, fbo_texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    size_t segmentEnd = (segment + 1) * segmentSize;
+    size_t offset = (cursor + alignment - 1) / alignment * alignment;
+    if (offset + size > segmentEnd) {
+        // Current segment is full; move on to the next one mid-frame
+        NextSegment();
+        segmentEnd = (segment + 1) * segmentSize;
+        offset = (cursor + alignment - 1) / alignment * alignment;
+    }
 
-    // Create FBO
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    if (persistent) {
+        std::memcpy(mapped + offset, data, size);
+    } else {
+        // One driver copy per append instead of a map/unmap round trip; the
+        // store was orphaned when the ring last wrapped, so nothing the GPU
+        // still reads is written
+        StateCache_GL::BindBuffer(target, handle);
+        glBufferSubData(target, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+    }
 
-    // Generate renderbuffer for depth
-    glGenRenderbuffers(1, &rbo_depth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo_depth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, 1920, 1080); // Default size
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    cursor = offset + size;
+    return offset;
+}
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbo_texture, 0);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo_depth);
+void StreamBuffer_GL::NextSegment() {
+    if (handle == 0) {
+        return;
+    }
 
-    // Post-processing FBOs
-    fbo_pp.resize(2);
-    fbo_pp_texture.resize(2);
-    
-    for (int i = 0; i < 2; ++i) {
-        glGenTextures(1, &fbo_pp_texture[i]);
-        glBindTexture(GL_TEXTURE_2D, fbo_pp_texture[i]);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        
-        glGenFramebuffers(1, &fbo_pp[i]);
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo_pp[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbo_pp_texture[i], 0);
+    // Without a persistent mapping, orphaning the store on wrap leaves the
+    // old one to pending draws, which makes fences unnecessary
+    if (!persistent) {
+        segment = (segment + 1) % SegmentCount;
+        cursor = segment * segmentSize;
+        if (segment == 0) {
+            StateCache_GL::BindBuffer(target, handle);
+            glBufferData(target, static_cast<GLsizeiptr>(segmentSize * SegmentCount), nullptr, GL_STREAM_DRAW);
+        }
+        return;
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    if (fences[segment] != nullptr) {
+        glDeleteSync(fences[segment]);
+    }
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
-    enableModel = false;
-    enableShadow = false;
+    segment = (segment + 1) % SegmentCount;
+    cursor = segment * segmentSize;
+    WaitSegment(segment);
 }
 
-void Renderer_GL::ConfigureForOpenGLVersion() {
-    std::cout << "\n=== OpenGL Configuration ===" << std::endl;
-    
-    // GL 4.3+: Advanced features
-    if (glVersionMajor > 4 || (glVersionMajor == 4 && glVersionMinor >= 3)) {
-        std::cout << "OpenGL 4.3+: Enabling Advanced Features" << std::endl;
-        // - Debug output callback
-        // - Compute shader support
-        // - Direct State Access (DSA)
-    }
-    // GL 4.0+: Tesselation and Direct State Access
-    else if (glVersionMajor > 4 || (glVersionMajor == 4 && glVersionMinor >= 0)) {
-        std::cout << "OpenGL 4.0+: Enabling Core Features" << std::endl;
-        // - Tesselation shaders
-        // - Indirect rendering
-        // - Transform feedback improvements
-    }
-    // GL 3.3+: Modern core profile
-    else if (glVersionMajor > 3 || (glVersionMajor == 3 && glVersionMinor >= 3)) {
-        std::cout << "OpenGL 3.3+: Standard Core Profile" << std::endl;
-        // - Instancing
-        // - Texture views
-        // - Immutable storage
-    }
-    // GL 3.0-3.2: Compatibility features
-    else if (glVersionMajor == 3 && glVersionMinor >= 0) {
-        std::cout << "OpenGL 3.0-3.2: Compatibility Mode" << std::endl;
-        // - Limited feature set
-        // - Fixed pipeline support may be needed
-    }
-    // GL 2.1 and below: Legacy rendering
-    else {
-        std::cout << "OpenGL 2.1 or lower: Legacy Mode" << std::endl;
-        // - Very limited feature set
-        // - May need alternative rendering paths
-    }
-    
-    // Query capabilities based on version
-    if (glVersionMajor >= 4) {
-        GLint maxSamples;
-        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
-        std::cout << "Max MSAA Samples: " << maxSamples << std::endl;
+void StreamBuffer_GL::WaitSegment(int index) {
+    if (fences[index] == nullptr) {
+        return;
     }
-    
-    if (glVersionMajor >= 3) {
-        GLint maxArrayTextureLayers;
-        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxArrayTextureLayers);
-        std::cout << "Max Array Texture Layers: " << maxArrayTextureLayers << std::endl;
+
+    GLenum result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(fences[index], 0, 1000000000);
     }
-    
-    GLint maxTextureSize;
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
-    std::cout << "Max Texture Size: " << maxTextureSize << std::endl;
-    
-    std::cout << "==========================\n" << std::endl;
+
+    glDeleteSync(fences[index]);
+    fences[index] = nullptr;
 }
 
-void Renderer_GL::Close() {
-    if (fbo != 0) glDeleteFramebuffers(1, &fbo);
-    if (fbo_texture != 0) glDeleteTextures(1, &fbo_texture);
-    if (rbo_depth != 0) glDeleteRenderbuffers(1, &rbo_depth);
-    
-    for (auto tex : fbo_pp_texture) {
-        if (tex != 0) glDeleteTextures(1, &tex);
+void StreamBuffer_GL::Grow(size_t minSegmentSize) {
+    size_t newSize = segmentSize;
+    while (newSize < minSegmentSize) {
+        newSize *= 2;
     }
-    for (auto buf : fbo_pp) {
-        if (buf != 0) glDeleteFramebuffers(1, &buf);
+
+    // Every segment may still be in flight, so drain them before reallocating
+    for (int i = 0; i < SegmentCount; ++i) {
+        WaitSegment(i);
     }
 
-    if (vao != 0) glDeleteVertexArrays(1, &vao);
-    if (postVertBuffer != 0) glDeleteBuffers(1, &postVertBuffer);
-    if (vertexBuffer != 0) glDeleteBuffers(1, &vertexBuffer);
-    if (vertexBufferBatch != 0) glDeleteBuffers(1, &vertexBufferBatch);
-    
-    glDeleteBuffers(2, &modelVertexBuffer[0]);
-    glDeleteBuffers(2, &modelIndexBuffer[0]);
+    bool wasPersistent = persistent;
+    Destroy();
+    Init(target, newSize, wasPersistent);
+}
 
-    spriteShader.reset();
-    modelShader.reset();
-    shadowMapShader.reset();
-    panoramaToCubeMapShader.reset();
-    cubemapFilteringShader.reset();
-    postShaderSelect.clear();
+// ==========================================
+// TextureUploadQueue_GL Implementation
+// ==========================================
+
+TextureUploadQueue_GL::TextureUploadQueue_GL() : recording(1), recorded(false) {
 }
 
-std::string Renderer_GL::GetName() const {
-    return "OpenGL";
+TextureUploadQueue_GL::~TextureUploadQueue_GL() {
+    Destroy();
 }
 
-int Renderer_GL::InitModelShader() {
-    // Placeholder implementation
-    // In a full implementation, you would compile and link shaders here
-    return 0;
+bool TextureUploadQueue_GL::Init(size_t segmentSize, bool persistent) {
+    bool ok = ring.Init(GL_PIXEL_UNPACK_BUFFER, segmentSize, persistent);
+    // Any other texture upload must keep reading from client memory
+    StateCache_GL::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return ok;
 }
 
-void Renderer_GL::BeginFrame(bool clearColor) {
-    glBindVertexArray(vao);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glViewport(0, 0, 1920, 1080); // Default viewport
-    
-    if (clearColor) {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    } else {
-        glClear(GL_DEPTH_BUFFER_BIT);
+void TextureUploadQueue_GL::Destroy() {
+    for (Batch& batch : inFlight) {
+        glDeleteSync(batch.fence);
     }
+    inFlight.clear();
+    pending.clear();
+    recorded = false;
+    ring.Destroy();
 }
 
-void Renderer_GL::EndFrame() {
-    if (fbo_pp.empty()) {
+void TextureUploadQueue_GL::Upload(Texture_GL& texture, const std::vector<uint8_t>& data,
+                                   int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0) return;
+
+    const size_t size = static_cast<size_t>(width) * height * texture.GetBytesPerPixel();
+    if (data.size() < size) {
+        std::cerr << "TextureUploadQueue: " << data.size() << " bytes given for a "
+                  << width << "x" << height << " upload of " << size << std::endl;
         return;
     }
 
-    glBindVertexArray(vao);
-
-    // Post-processing pass - simplified
-    glViewport(0, 0, 1920, 1080);
-    glDisable(GL_BLEND);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-}
+    // Before Init (or after Close) there is no ring to stage into
+    if (ring.GetHandle() == 0) {
+        texture.SetSubData(data, x, y, width, height);
+        return;
+    }
 
-void Renderer_GL::Await() {
-    glFinish();
-}
+    // The copy into the ring returns at once; the driver pulls the texels
+    // from the buffer when it executes the glTexSubImage2D
+    size_t offset = ring.Append(data.data(), size, 4);
+    StateCache_GL::BindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.GetHandle());
+    texture.SetSubData(offset, x, y, width, height);
+    StateCache_GL::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-bool Renderer_GL::IsModelEnabled() const {
-    return enableModel;
+    pending[texture.GetHandle()] = recording;
+    recorded = true;
 }
 
-bool Renderer_GL::IsShadowEnabled() const {
-    return enableShadow;
-}
+void TextureUploadQueue_GL::NextFrame() {
+    if (recorded) {
+        inFlight.push_back(Batch{recording, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+        recording++;
+        recorded = false;
+        ring.NextSegment();
+        StateCache_GL::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
 
-void Renderer_GL::BlendReset() {
-    glBlendEquation(MapBlendEquation(BlendEquation::Add));
-    glBlendFunc(MapBlendFunction(BlendFunc::SrcAlpha), MapBlendFunction(BlendFunc::OneMinusSrcAlpha));
-}
+    // Batches complete in order, so stop at the first unsignaled fence
+    uint64_t retired = 0;
+    while (!inFlight.empty()) {
+        GLenum result = glClientWaitSync(inFlight.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break;
 
-void Renderer_GL::SetBlending(BlendEquation eq, BlendFunc src, BlendFunc dst) {
-    if (eq != glState.blendEquation) {
-        glState.blendEquation = eq;
-        glBlendEquation(MapBlendEquation(eq));
-    }
-    if (src != glState.blendSrc || dst != glState.blendDst) {
-        glState.blendSrc = src;
-        glState.blendDst = dst;
-        glBlendFunc(MapBlendFunction(src), MapBlendFunction(dst));
+        retired = inFlight.front().serial;
+        glDeleteSync(inFlight.front().fence);
+        inFlight.erase(inFlight.begin());
     }
-}
+    if (retired == 0) return;
 
-void Renderer_GL::SetDepthTest(bool depthTest) {
-    if (depthTest != glState.depthTest) {
-        glState.depthTest = depthTest;
-        if (depthTest) {
-            glEnable(GL_DEPTH_TEST);
-            glDepthFunc(GL_LESS);
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (it->second <= retired) {
+            it = pending.erase(it);
         } else {
-            glDisable(GL_DEPTH_TEST);
+            ++it;
         }
     }
 }
 
-void Renderer_GL::SetDepthMask(bool depthMask) {
-    if (depthMask != glState.depthMask) {
-        glState.depthMask = depthMask;
-        glDepthMask(depthMask);
+// ==========================================
+// StateCache_GL Implementation
+// ==========================================
+
+StateCache_GL::State StateCache_GL::state;
+uint32_t StateCache_GL::usedUnits = 0;
+bool StateCache_GL::validation = false;
+StateCacheStats StateCache_GL::stats = {};
+const uint32_t StateCache_GL::Unknown;
+
+void StateCache_GL::Invalidate() {
+    state.program = Unknown;
+    state.vertexArray = Unknown;
+    std::fill(std::begin(state.buffers), std::end(state.buffers), Unknown);
+    state.activeUnit = Unknown;
+    for (auto& unit : state.textures) {
+        std::fill(std::begin(unit), std::end(unit), Unknown);
     }
+    state.readFramebuffer = Unknown;
+    state.drawFramebuffer = Unknown;
+    state.viewportKnown = false;
+    state.scissorKnown = false;
+    std::fill(std::begin(state.capabilities), std::end(state.capabilities), Unknown);
+    state.blendEquation = Unknown;
+    state.blendSrc = Unknown;
+    state.blendDst = Unknown;
+    state.depthFunc = Unknown;
+    state.depthMask = Unknown;
+    state.cullFace = Unknown;
+    state.frontFace = Unknown;
+    usedUnits = 0;
 }
 
-void Renderer_GL::SetFrontFace(bool invertFrontFace) {
-    if (invertFrontFace != glState.invertFrontFace) {
-        glState.invertFrontFace = invertFrontFace;
-        glFrontFace(invertFrontFace ? GL_CW : GL_CCW);
+void StateCache_GL::ResetStats() {
+    stats = StateCacheStats();
+}
+
+int StateCache_GL::BufferIndex(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return BufferArray;
+        case GL_ELEMENT_ARRAY_BUFFER: return BufferElementArray;
+        case GL_PIXEL_PACK_BUFFER: return BufferPixelPack;
+        case GL_PIXEL_UNPACK_BUFFER: return BufferPixelUnpack;
+        case GL_UNIFORM_BUFFER: return BufferUniform;
+        case GL_DRAW_INDIRECT_BUFFER: return BufferDrawIndirect;
+        default: return -1;
     }
 }
 
-void Renderer_GL::SetCullFace(bool doubleSided) {
-    if (doubleSided != glState.doubleSided) {
-        glState.doubleSided = doubleSided;
-        if (!doubleSided) {
-            glEnable(GL_CULL_FACE);
-            glCullFace(GL_BACK);
-        } else {
-            glDisable(GL_CULL_FACE);
+int StateCache_GL::TextureIndex(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return Texture2D;
+        case GL_TEXTURE_2D_ARRAY: return Texture2DArray;
+        case GL_TEXTURE_CUBE_MAP: return TextureCubeMap;
+        default: return -1;
+    }
+}
+
+int StateCache_GL::CapabilityIndex(GLenum capability) {
+    switch (capability) {
+        case GL_BLEND: return CapabilityBlend;
+        case GL_DEPTH_TEST: return CapabilityDepthTest;
+        case GL_CULL_FACE: return CapabilityCullFace;
+        case GL_SCISSOR_TEST: return CapabilityScissorTest;
+        default: return -1;
+    }
+}
+
+bool StateCache_GL::Redundant(StateCall kind, bool matches) {
+    stats.calls[static_cast<int>(kind)]++;
+    if (matches) stats.redundant[static_cast<int>(kind)]++;
+    return matches;
+}
+
+void StateCache_GL::UseProgram(uint32_t program) {
+    if (Redundant(StateCall::Program, state.program == program)) return;
+    state.program = program;
+    glUseProgram(program);
+}
+
+void StateCache_GL::BindVertexArray(uint32_t array) {
+    if (Redundant(StateCall::VertexArray, state.vertexArray == array)) return;
+    state.vertexArray = array;
+    state.buffers[BufferElementArray] = Unknown;
+    glBindVertexArray(array);
+}
+
+void StateCache_GL::BindBuffer(GLenum target, uint32_t buffer) {
+    int index = BufferIndex(target);
+    if (Redundant(StateCall::Buffer, index >= 0 && state.buffers[index] == buffer)) return;
+    if (index >= 0) state.buffers[index] = buffer;
+    glBindBuffer(target, buffer);
+}
+
+void StateCache_GL::BindBufferRange(GLenum target, uint32_t index, uint32_t buffer, GLintptr offset, GLsizeiptr size) {
+    // Indexed ranges are tracked by the callers (boundBlocks)
+    Redundant(StateCall::Buffer, false);
+    int generic = BufferIndex(target);
+    if (generic >= 0) state.buffers[generic] = buffer;
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void StateCache_GL::ActiveTexture(GLenum unit) {
+    uint32_t index = unit - GL_TEXTURE0;
+    if (Redundant(StateCall::Texture, state.activeUnit == index)) return;
+    state.activeUnit = index;
+    glActiveTexture(unit);
+}
+
+void StateCache_GL::BindTexture(GLenum target, uint32_t texture) {
+    int index = TextureIndex(target);
+    bool cached = index >= 0 && state.activeUnit < static_cast<uint32_t>(MaxTextureUnits);
+    if (Redundant(StateCall::Texture, cached && state.textures[state.activeUnit][index] == texture)) return;
+    if (cached) {
+        state.textures[state.activeUnit][index] = texture;
+        usedUnits = std::max(usedUnits, state.activeUnit + 1);
+    }
+    glBindTexture(target, texture);
+}
+
+void StateCache_GL::BindFramebuffer(GLenum target, uint32_t framebuffer) {
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    if (Redundant(StateCall::Framebuffer, (!read || state.readFramebuffer == framebuffer) &&
+                                          (!draw || state.drawFramebuffer == framebuffer))) {
+        return;
+    }
+    if (read) state.readFramebuffer = framebuffer;
+    if (draw) state.drawFramebuffer = framebuffer;
+    glBindFramebuffer(target, framebuffer);
+}
+
+uint32_t StateCache_GL::GetProgram() {
+    if (state.program == Unknown) {
+        GLint program = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        state.program = static_cast<uint32_t>(program);
+    }
+    return state.program;
+}
+
+uint32_t StateCache_GL::GetFramebuffer(GLenum target) {
+    uint32_t& cached = target == GL_READ_FRAMEBUFFER ? state.readFramebuffer : state.drawFramebuffer;
+    if (cached == Unknown) {
+        GLint framebuffer = 0;
+        glGetIntegerv(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING,
+                      &framebuffer);
+        cached = static_cast<uint32_t>(framebuffer);
+    }
+    return cached;
+}
+
+void StateCache_GL::GetViewport(int32_t viewport[4]) {
+    if (!state.viewportKnown) {
+        glGetIntegerv(GL_VIEWPORT, state.viewport);
+        state.viewportKnown = true;
+    }
+    std::copy(state.viewport, state.viewport + 4, viewport);
+}
+
+bool StateCache_GL::IsEnabled(GLenum capability) {
+    int index = CapabilityIndex(capability);
+    if (index < 0) return glIsEnabled(capability) == GL_TRUE;
+    if (state.capabilities[index] == Unknown) {
+        state.capabilities[index] = glIsEnabled(capability) == GL_TRUE ? 1 : 0;
+    }
+    return state.capabilities[index] == 1;
+}
+
+void StateCache_GL::Viewport(int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (Redundant(StateCall::Viewport, state.viewportKnown && state.viewport[0] == x && state.viewport[1] == y &&
+                                       state.viewport[2] == width && state.viewport[3] == height)) {
+        return;
+    }
+    state.viewport[0] = x;
+    state.viewport[1] = y;
+    state.viewport[2] = width;
+    state.viewport[3] = height;
+    state.viewportKnown = true;
+    glViewport(x, y, width, height);
+}
+
+void StateCache_GL::Scissor(int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (Redundant(StateCall::Scissor, state.scissorKnown && state.scissor[0] == x && state.scissor[1] == y &&
+                                      state.scissor[2] == width && state.scissor[3] == height)) {
+        return;
+    }
+    state.scissor[0] = x;
+    state.scissor[1] = y;
+    state.scissor[2] = width;
+    state.scissor[3] = height;
+    state.scissorKnown = true;
+    glScissor(x, y, width, height);
+}
+
+void StateCache_GL::SetCapability(GLenum capability, bool enabled) {
+    int index = CapabilityIndex(capability);
+    uint32_t value = enabled ? 1 : 0;
+    if (Redundant(StateCall::Capability, index >= 0 && state.capabilities[index] == value)) return;
+    if (index >= 0) state.capabilities[index] = value;
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+void StateCache_GL::Enable(GLenum capability) {
+    SetCapability(capability, true);
+}
+
+void StateCache_GL::Disable(GLenum capability) {
+    SetCapability(capability, false);
+}
+
+void StateCache_GL::BlendEquation(GLenum mode) {
+    if (Redundant(StateCall::Blend, state.blendEquation == mode)) return;
+    state.blendEquation = mode;
+    glBlendEquation(mode);
+}
+
+void StateCache_GL::BlendFunc(GLenum src, GLenum dst) {
+    if (Redundant(StateCall::Blend, state.blendSrc == src && state.blendDst == dst)) return;
+    state.blendSrc = src;
+    state.blendDst = dst;
+    glBlendFunc(src, dst);
+}
+
+void StateCache_GL::DepthFunc(GLenum func) {
+    if (Redundant(StateCall::Depth, state.depthFunc == func)) return;
+    state.depthFunc = func;
+    glDepthFunc(func);
+}
+
+void StateCache_GL::DepthMask(GLboolean mask) {
+    uint32_t value = mask ? 1 : 0;
+    if (Redundant(StateCall::Depth, state.depthMask == value)) return;
+    state.depthMask = value;
+    glDepthMask(mask);
+}
+
+void StateCache_GL::CullFace(GLenum mode) {
+    if (Redundant(StateCall::Face, state.cullFace == mode)) return;
+    state.cullFace = mode;
+    glCullFace(mode);
+}
+
+void StateCache_GL::FrontFace(GLenum mode) {
+    if (Redundant(StateCall::Face, state.frontFace == mode)) return;
+    state.frontFace = mode;
+    glFrontFace(mode);
+}
+
+void StateCache_GL::DeleteBuffers(GLsizei count, const uint32_t* buffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        for (uint32_t& bound : state.buffers) {
+            if (bound == buffers[i]) bound = 0;
         }
     }
+    glDeleteBuffers(count, buffers);
 }
 
-void Renderer_GL::SetPipeline(BlendEquation eq, BlendFunc src, BlendFunc dst) {
-    glBindVertexArray(vao);
-    glUseProgram(spriteShader->GetProgram());
+void StateCache_GL::DeleteTextures(GLsizei count, const uint32_t* textures) {
+    for (GLsizei i = 0; i < count; ++i) {
+        for (uint32_t unit = 0; unit < usedUnits; ++unit) {
+            for (uint32_t& bound : state.textures[unit]) {
+                if (bound == textures[i]) bound = 0;
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
 
-    glBlendEquation(MapBlendEquation(eq));
-    glBlendFunc(MapBlendFunction(src), MapBlendFunction(dst));
-    glEnable(GL_BLEND);
+void StateCache_GL::DeleteFramebuffers(GLsizei count, const uint32_t* framebuffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (state.readFramebuffer == framebuffers[i]) state.readFramebuffer = 0;
+        if (state.drawFramebuffer == framebuffers[i]) state.drawFramebuffer = 0;
+    }
+    glDeleteFramebuffers(count, framebuffers);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    const int stride = 20; // 5 floats * 4 bytes
+void StateCache_GL::DeleteVertexArrays(GLsizei count, const uint32_t* arrays) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (state.vertexArray == arrays[i]) {
+            state.vertexArray = 0;
+            state.buffers[BufferElementArray] = Unknown;
+        }
+    }
+    glDeleteVertexArrays(count, arrays);
+}
 
-    int32_t loc = spriteShader->GetAttributeLocation("position");
-    glEnableVertexAttribArray(loc);
-    glVertexAttribPointer(loc, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+// Prints a cached value that disagrees with GL; unknown values are skipped
+static bool CompareState(const char* where, const char* what, uint32_t cached, GLint actual) {
+    if (cached == 0xFFFFFFFFu || cached == static_cast<uint32_t>(actual)) return true;
+    std::cerr << "State cache mismatch at " << where << ": " << what << " is " << actual
+              << ", cached " << cached << std::endl;
+    return false;
+}
 
-    loc = spriteShader->GetAttributeLocation("uv");
-    glEnableVertexAttribArray(loc);
-    glVertexAttribPointer(loc, 2, GL_FLOAT, GL_FALSE, stride, (void*)8);
+bool StateCache_GL::Validate(const char* where) {
+    struct Query {
+        const char* name;
+        GLenum pname;
+        uint32_t cached;
+    };
+    const Query queries[] = {
+        {"program", GL_CURRENT_PROGRAM, state.program},
+        {"vertex array", GL_VERTEX_ARRAY_BINDING, state.vertexArray},
+        {"array buffer", GL_ARRAY_BUFFER_BINDING, state.buffers[BufferArray]},
+        {"element array buffer", GL_ELEMENT_ARRAY_BUFFER_BINDING, state.buffers[BufferElementArray]},
+        {"pixel pack buffer", GL_PIXEL_PACK_BUFFER_BINDING, state.buffers[BufferPixelPack]},
+        {"pixel unpack buffer", GL_PIXEL_UNPACK_BUFFER_BINDING, state.buffers[BufferPixelUnpack]},
+        {"uniform buffer", GL_UNIFORM_BUFFER_BINDING, state.buffers[BufferUniform]},
+        {"draw indirect buffer", GL_DRAW_INDIRECT_BUFFER_BINDING, state.buffers[BufferDrawIndirect]},
+        {"read framebuffer", GL_READ_FRAMEBUFFER_BINDING, state.readFramebuffer},
+        {"draw framebuffer", GL_DRAW_FRAMEBUFFER_BINDING, state.drawFramebuffer},
+        {"blend equation", GL_BLEND_EQUATION_RGB, state.blendEquation},
+        {"blend source", GL_BLEND_SRC_RGB, state.blendSrc},
+        {"blend destination", GL_BLEND_DST_RGB, state.blendDst},
+        {"depth func", GL_DEPTH_FUNC, state.depthFunc},
+        {"depth mask", GL_DEPTH_WRITEMASK, state.depthMask},
+        {"cull face", GL_CULL_FACE_MODE, state.cullFace},
+        {"front face", GL_FRONT_FACE, state.frontFace},
+    };
 
-    loc = spriteShader->GetAttributeLocation("palIndex");
-    glEnableVertexAttribArray(loc);
-    glVertexAttribPointer(loc, 1, GL_FLOAT, GL_FALSE, stride, (void*)16);
+    int mismatches = 0;
+    for (const Query& query : queries) {
+        // Also skips targets the context may not have (draw indirect)
+        if (query.cached == Unknown) continue;
+        GLint actual = 0;
+        glGetIntegerv(query.pname, &actual);
+        mismatches += !CompareState(where, query.name, query.cached, actual);
+    }
+
+    static const struct {
+        const char* name;
+        GLenum capability;
+    } capabilities[CapabilityCount] = {
+        {"blend", GL_BLEND}, {"depth test", GL_DEPTH_TEST}, {"cull face", GL_CULL_FACE},
+        {"scissor test", GL_SCISSOR_TEST},
+    };
+    for (int i = 0; i < CapabilityCount; ++i) {
+        mismatches += !CompareState(where, capabilities[i].name, state.capabilities[i],
+                              glIsEnabled(capabilities[i].capability) == GL_TRUE ? 1 : 0);
+    }
+
+    GLint rect[4];
+    const char* rectNames[4] = {"x", "y", "width", "height"};
+    glGetIntegerv(GL_VIEWPORT, rect);
+    for (int i = 0; i < 4 && state.viewportKnown; ++i) {
+        mismatches += !CompareState(where, (std::string("viewport ") + rectNames[i]).c_str(), state.viewport[i], rect[i]);
+    }
+    glGetIntegerv(GL_SCISSOR_BOX, rect);
+    for (int i = 0; i < 4 && state.scissorKnown; ++i) {
+        mismatches += !CompareState(where, (std::string("scissor ") + rectNames[i]).c_str(), state.scissor[i], rect[i]);
+    }
+
+    // Texture bindings are per unit, so each used unit is made active in turn
+    GLint activeTexture = GL_TEXTURE0;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+    mismatches += !CompareState(where, "active texture", state.activeUnit, activeTexture - GL_TEXTURE0);
+    static const GLenum textureBindings[TextureTargetCount] = {
+        GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP
+    };
+    static const char* textureNames[TextureTargetCount] = {"2D", "2D array", "cube map"};
+    for (uint32_t unit = 0; unit < usedUnits; ++unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        for (int target = 0; target < TextureTargetCount; ++target) {
+            GLint actual = 0;
+            glGetIntegerv(textureBindings[target], &actual);
+            std::string name = "unit " + std::to_string(unit) + " " + textureNames[target] + " texture";
+            mismatches += !CompareState(where, name.c_str(), state.textures[unit][target], actual);
+        }
+    }
+    glActiveTexture(activeTexture);
+
+    stats.mismatches += mismatches;
+    return mismatches == 0;
+}
+
+// Uniforms and textures the loader registers on each built-in program
+static const std::vector<std::string> SpriteUniformNames = {
+    "modelview", "projection", "x1x2x4x3", "alpha", "tint", "mask", "neg", "gray", "add", "mult",
+    "isFlat", "isRgba", "isTrapez", "hue", "uvRect", "useUV"
+};
+static const std::vector<std::string> SpriteTextureNames = {"pal", "tex"};
+
+static std::vector<std::string> ModelUniformNames() {
+    std::vector<std::string> names = {
+        "model", "view", "projection", "normalMatrix", "unlit", "baseColorFactor", "add", "mult",
+        "useTexture", "useNormalMap", "useMetallicRoughnessMap", "useEmissionMap", "neg", "gray", "hue",
+        "enableAlpha", "alphaThreshold", "numJoints", "morphTargetWeight", "morphTargetOffset",
+        "morphTargetTextureDimension", "numTargets", "numVertices", "metallicRoughness",
+        "ambientOcclusionStrength", "emission", "environmentIntensity", "mipCount", "meshOutline",
+        "cameraPosition", "environmentRotation", "texTransform", "normalMapTransform",
+        "metallicRoughnessMapTransform", "ambientOcclusionMapTransform", "emissionMapTransform",
+        "shadowAtlasRects", "shadowCascades"
+    };
+    static const char* lightFields[] = {
+        "direction", "range", "color", "intensity", "position", "innerConeCos", "outerConeCos",
+        "type", "shadowBias", "shadowMapFar"
+    };
+    for (int i = 0; i < 4; ++i) {
+        std::string light = "lights[" + std::to_string(i) + "].";
+        for (const char* field : lightFields) {
+            names.push_back(light + field);
+        }
+        names.push_back("lightMatrices[" + std::to_string(i) + "]");
+    }
+    return names;
+}
+
+// Points every sampler of the program at its unit once, so binding a
+// texture never has to touch the program (it may not be current)
+static void AssignTextureUnits(ShaderProgram_GL& shader) {
+    uint32_t current = StateCache_GL::GetProgram();
+    StateCache_GL::UseProgram(shader.GetProgram());
+    for (const auto& texture : shader.GetAllTextures()) {
+        glUniform1i(shader.GetUniformLocation(texture.first), texture.second);
+    }
+    StateCache_GL::UseProgram(current);
+}
+
+// Shared by the model program, its permutations and its unlit stand-in
+static void RegisterModelInterface(ShaderProgram_GL& shader) {
+    shader.RegisterAttributes({"vertexId", "position", "uv", "normalIn", "tangentIn", "vertColor",
+                               "joints_0", "joints_1", "weights_0", "weights_1", "outlineAttributeIn"});
+    shader.RegisterUniforms(ModelUniformNames());
+    shader.RegisterTextures({"tex", "morphTargetValues", "jointMatrices", "normalMap", "metallicRoughnessMap",
+                             "ambientOcclusionMap", "emissionMap", "lambertianEnvSampler", "GGXEnvSampler",
+                             "GGXLUT", "shadowAtlas"});
+
+    AssignTextureUnits(shader);
+}
+
+// One light view per draw into its atlas tile (SetShadowAtlasView)
+static void RegisterShadowInterface(ShaderProgram_GL& shader) {
+    shader.RegisterAttributes({"position"});
+    shader.RegisterUniforms({"model", "lightVP", "lightType", "lightPosition", "farPlane"});
+}
+
+static const uint32_t ShaderStages[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER};
+
+// Instanced attributes of the INSTANCED sprite program, laid out as SpriteInstance
+static const struct {
+    const char* name;
+    size_t offset;
+    int columns;    // vec4 columns; a mat4 spans four consecutive locations
+} SpriteInstanceAttributes[] = {
+    {"i_modelview", offsetof(SpriteInstance, modelview), 4},
+    {"i_tint", offsetof(SpriteInstance, tint), 1},
+    {"i_addAlpha", offsetof(SpriteInstance, add), 1},
+    {"i_multPalIndex", offsetof(SpriteInstance, mult), 1},
+};
+
+// ==========================================
+// Renderer_GL Implementation
+// ==========================================
+
+Renderer_GL::Renderer_GL()
+    : IRenderer(), postVAO(0), vertexFirst(0), instancedPipeline(false), activeSpriteShader(nullptr), useUniformBuffers(false), uniformBufferAlignment(256),
+      frameIndex(0), shaderDirectory("shaders/"), parallelShaderCompile(false), modelMaterialFeatures(0),
+      boundModelProgram(0), useModelPermutations(false), useMultiDrawIndirect(false), modelBufferIndex(0) {
+    for (auto& bound : boundBlocks) {
+        bound.generation = 0;
+        bound.offset = 0;
+    }
+    for (auto& slot : profileFrames) {
+        slot.used = 0;
+        slot.frame = 0;
+        slot.pending = false;
+    }
+    for (bool& open : profilePassOpen) {
+        open = false;
+    }
+    fbo = fbo_texture = rbo_depth = 0;
+    fbo_f = rbo_f_color = rbo_f_depth = 0;
+    fbo_f_texture = nullptr;
+    fbo_shadow = fbo_shadow_texture = 0;
+    shadowAtlasSize = 0;
+    enableShadow = false;
+    msaaLevel = 0;
+    viewport = {0, 0, 0, 0};
+    for (auto& size : postTargetSize) {
+        size[0] = size[1] = 0;
+    }
+    postGeneration = 0;
+    glState.depthTest = false;
+    glState.depthMask = false;
+    glState.invertFrontFace = false;
+    glState.doubleSided = false;
+    glState.blendEquation = BlendEquation::Add;
+    glState.blendSrc = BlendFunc::SrcAlpha;
+    glState.blendDst = BlendFunc::OneMinusSrcAlpha;
+    glState.useUV = false;
+    glState.useNormal = false;
+    glState.useTangent = false;
+    glState.useVertColor = false;
+    glState.useJoint0 = false;
+    glState.useJoint1 = false;
+    glState.useOutlineAttribute = false;
+}
+
+Renderer_GL::~Renderer_GL() {
+    Close();
+}
+
+void Renderer_GL::Init() {
+    // Nothing is known about the state the context was handed over in
+    StateCache_GL::Invalidate();
+
+    // Query and store OpenGL version
+    glGetIntegerv(GL_MAJOR_VERSION, &glVersionMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &glVersionMinor);
+
+    // Print GL information
+    std::cout << "Real GL Version: " << reinterpret_cast<const char*>(glGetString(GL_VERSION)) << std::endl;
+    std::cout << "Detected OpenGL: " << glVersionMajor << "." << glVersionMinor << std::endl;
+    std::cout << "Real GLSL Version: " << reinterpret_cast<const char*>(glGetString(GL_SHADING_LANGUAGE_VERSION)) << std::endl;
+    std::cout << "Real GL Renderer: " << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << std::endl;
+    std::cout << "Real GL Vendor: " << reinterpret_cast<const char*>(glGetString(GL_VENDOR)) << std::endl;
+
+    // Configure based on OpenGL version
+    ConfigureForOpenGLVersion();
+
+    // Create VAO
+    glGenVertexArrays(1, &vao);
+    StateCache_GL::BindVertexArray(vao);
+
+    // Generate vertex buffers
+    glGenBuffers(2, &modelVertexBuffer[0]);
+    glGenBuffers(2, &modelIndexBuffer[0]);
+
+    // Sprite vertices are streamed through a fenced ring buffer, persistently
+    // mapped when buffer storage is available
+    bool persistent = (glVersionMajor > 4 || (glVersionMajor == 4 && glVersionMinor >= 4)) ||
+                      IsGLExtensionSupported("GL_ARB_buffer_storage");
+    vertexStream.Init(GL_ARRAY_BUFFER, SpriteStreamSegmentSize, persistent);
+    instanceStream.Init(GL_ARRAY_BUFFER, InstanceStreamSegmentSize, persistent);
+    textureUploads.Init(TextureUploadSegmentSize, persistent);
+
+    // Per-draw uniform blocks are suballocated from a second ring (GL 3.1+)
+    useUniformBuffers = glVersionMajor > 3 || (glVersionMajor == 3 && glVersionMinor >= 1);
+    if (useUniformBuffers) {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformBufferAlignment = std::max(alignment, 16);
+        uniformStream.Init(GL_UNIFORM_BUFFER, UniformStreamSegmentSize, persistent);
+        shaderDefines += "#define USE_UBO\n";
+    }
+    // Permutations share the block copies of the generic model program;
+    // loose uniforms would have to be set on each of them
+    useModelPermutations = useUniformBuffers;
+
+    // Multi-draw indirect with baseInstance is core in GL 4.3; the per-draw
+    // matrices come from the MULTI_DRAW permutation
+    useMultiDrawIndirect = useModelPermutations && GLAD_GL_VERSION_4_3;
+
+    // Linked programs are cached on disk when the driver can hand them back
+    // (GL 4.1 / ARB_get_program_binary); the key covers the driver identity
+    GLint binaryFormats = 0;
+    if ((glVersionMajor > 4 || (glVersionMajor == 4 && glVersionMinor >= 1)) ||
+        IsGLExtensionSupported("GL_ARB_get_program_binary")) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    }
+    binaryCache.SetEnabled(binaryFormats > 0 && glProgramBinary != nullptr);
+    binaryCache.SetDriverIdentity(std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "|" +
+                                  reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "|" +
+                                  reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    InitParallelShaderCompile();
+
+    if (InitSpriteShaders()) {
+        shaderStats.Print("Sprite shaders");
+    }
+
+    // Scenes render into offscreen targets at the render size; EndFrame
+    // scales them to the output
+    viewport = {0, 0, GetRenderWidth(), GetRenderHeight()};
+    CreateRenderTargets();
+
+    // Environment bakes attach their target faces and levels per pass
+    glGenFramebuffers(1, &fbo_env);
+
+    // Fullscreen strip for the environment and post-processing passes
+    static const float quad[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+    glGenVertexArrays(1, &postVAO);
+    StateCache_GL::BindVertexArray(postVAO);
+    glGenBuffers(1, &postVertBuffer);
+    StateCache_GL::BindBuffer(GL_ARRAY_BUFFER, postVertBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    StateCache_GL::BindVertexArray(vao);
+
+    // A chain set before Init compiles now
+    QueuePostShaders();
+
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, 0);
+
+    enableModel = false;
+}
+
+void Renderer_GL::ConfigureForOpenGLVersion() {
+    std::cout << "\n=== OpenGL Configuration ===" << std::endl;
+    
+    // GL 4.3+: Advanced features
+    if (glVersionMajor > 4 || (glVersionMajor == 4 && glVersionMinor >= 3)) {
+        std::cout << "OpenGL 4.3+: Enabling Advanced Features" << std::endl;
+        // - Debug output callback
+        // - Compute shader support
+        // - Direct State Access (DSA)
+    }
+    // GL 4.0+: Tesselation and Direct State Access
+    else if (glVersionMajor > 4 || (glVersionMajor == 4 && glVersionMinor >= 0)) {
+        std::cout << "OpenGL 4.0+: Enabling Core Features" << std::endl;
+        // - Tesselation shaders
+        // - Indirect rendering
+        // - Transform feedback improvements
+    }
+    // GL 3.3+: Modern core profile
+    else if (glVersionMajor > 3 || (glVersionMajor == 3 && glVersionMinor >= 3)) {
+        std::cout << "OpenGL 3.3+: Standard Core Profile" << std::endl;
+        // - Instancing
+        // - Texture views
+        // - Immutable storage
+    }
+    // GL 3.0-3.2: Compatibility features
+    else if (glVersionMajor == 3 && glVersionMinor >= 0) {
+        std::cout << "OpenGL 3.0-3.2: Compatibility Mode" << std::endl;
+        // - Limited feature set
+        // - Fixed pipeline support may be needed
+    }
+    // GL 2.1 and below: Legacy rendering
+    else {
+        std::cout << "OpenGL 2.1 or lower: Legacy Mode" << std::endl;
+        // - Very limited feature set
+        // - May need alternative rendering paths
+    }
+    
+    // Query capabilities based on version
+    if (glVersionMajor >= 4) {
+        GLint maxSamples;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        std::cout << "Max MSAA Samples: " << maxSamples << std::endl;
+    }
+    
+    if (glVersionMajor >= 3) {
+        GLint maxArrayTextureLayers;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxArrayTextureLayers);
+        std::cout << "Max Array Texture Layers: " << maxArrayTextureLayers << std::endl;
+    }
+    
+    GLint maxTextureSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    std::cout << "Max Texture Size: " << maxTextureSize << std::endl;
+    
+    std::cout << "==========================\n" << std::endl;
+}
+
+void Renderer_GL::Close() {
+    DestroyRenderTargets();
+
+    if (fbo_env != 0) StateCache_GL::DeleteFramebuffers(1, &fbo_env);
+    if (fbo_shadow != 0) StateCache_GL::DeleteFramebuffers(1, &fbo_shadow);
+    if (fbo_shadow_texture != 0) StateCache_GL::DeleteTextures(1, &fbo_shadow_texture);
+    fbo_shadow = fbo_shadow_texture = 0;
+    if (!timerQueries.empty()) glDeleteQueries(static_cast<GLsizei>(timerQueries.size()), timerQueries.data());
+    timerQueries.clear();
+    freeTimerQueries.clear();
+    for (auto& slot : profileFrames) {
+        if (!slot.queries.empty()) glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+        slot.queries.clear();
+        slot.regions.clear();
+        slot.used = 0;
+        slot.pending = false;
+    }
+    profileStack.clear();
+
+    if (vao != 0) StateCache_GL::DeleteVertexArrays(1, &vao);
+    if (postVAO != 0) StateCache_GL::DeleteVertexArrays(1, &postVAO);
+    if (postVertBuffer != 0) StateCache_GL::DeleteBuffers(1, &postVertBuffer);
+    vertexStream.Destroy();
+    instanceStream.Destroy();
+    uniformStream.Destroy();
+    textureUploads.Destroy();
+    
+    DeleteModelVertexArrays(-1);
+    StateCache_GL::DeleteBuffers(2, &modelVertexBuffer[0]);
+    StateCache_GL::DeleteBuffers(2, &modelIndexBuffer[0]);
+
+    // Abandon programs still compiling
+    for (auto& job : shaderJobs) {
+        for (uint32_t shader : job.shaders) {
+            glDeleteShader(shader);
+        }
+        if (job.program != 0) {
+            glDeleteProgram(job.program);
+        }
+    }
+    shaderJobs.clear();
+
+    programCache.clear();
+    activeSpriteShader = nullptr;
+    spriteShader.reset();
+    spriteInstancedShader.reset();
+    modelShader.reset();
+    modelUnlitShader.reset();
+    modelPermutations.Clear();
+    shadowMapShader.reset();
+    panoramaToCubeMapShader.reset();
+    cubemapFilteringShader.reset();
+    postShaderSelect.clear();
+}
+
+std::string Renderer_GL::GetName() const {
+    return "OpenGL";
+}
+
+int Renderer_GL::InitModelShader() {
+    // Shadows stay off when the atlas cannot be created
+    if (enableShadow && !InitShadowFramebuffer()) {
+        enableShadow = false;
+    }
+    modelDefines = enableShadow ? "#define ENABLE_SHADOW\n" : "";
+    modelPermutations.Clear();
+    // Shadow vertex arrays use the locations of the program replaced here
+    DeleteModelVertexArrays(-1);
+
+    // The unlit stand-in is cheap enough to build right away; it draws
+    // models until the full program below is ready
+    modelUnlitShader = LoadShaderProgram("Model Shader (unlit)", "model.vert.glsl", "modelUnlit.frag.glsl", "",
+                                         modelDefines);
+    if (!modelUnlitShader) {
+        return -1;
+    }
+    RegisterModelInterface(*modelUnlitShader);
+    modelShader = modelUnlitShader;
+
+    // Everything else is submitted at once and swapped in by PollShaderJobs.
+    // Until then the shadow and IBL passes are skipped (their programs are
+    // null), as when the feature is off.
+    bool queued = QueueShaderProgram("Model Shader", "model.vert.glsl", "model.frag.glsl", "", modelDefines,
+        [this](const std::shared_ptr<ShaderProgram_GL>& shader) {
+            RegisterModelInterface(*shader);
+            modelShader = shader;
+        });
+    if (enableShadow) {
+        queued = QueueShaderProgram("Shadow Map Shader", "shadow.vert.glsl", "shadow.frag.glsl", "", "",
+            [this](const std::shared_ptr<ShaderProgram_GL>& shader) {
+                RegisterShadowInterface(*shader);
+                shadowMapShader = shader;
+            }) && queued;
+    }
+    queued = QueueShaderProgram("Panorama To Cubemap Shader", "ident.vert.glsl", "panoramaToCubeMap.frag.glsl",
+                                "", "",
+        [this](const std::shared_ptr<ShaderProgram_GL>& shader) {
+            shader->RegisterAttributes({"VertCoord"});
+            shader->RegisterUniforms({"currentFace"});
+            shader->RegisterTextures({"panorama"});
+            panoramaToCubeMapShader = shader;
+        }) && queued;
+    queued = QueueShaderProgram("Cubemap Filtering Shader", "ident.vert.glsl", "cubemapFiltering.frag.glsl",
+                                "", "",
+        [this](const std::shared_ptr<ShaderProgram_GL>& shader) {
+            shader->RegisterAttributes({"VertCoord"});
+            shader->RegisterUniforms({"sampleCount", "distribution", "width", "currentFace",
+                                      "roughness", "intensityScale", "isLUT"});
+            shader->RegisterTextures({"cubeMap"});
+            cubemapFilteringShader = shader;
+        }) && queued;
+    if (!queued) {
+        return -1;
+    }
+
+    if (shaderJobs.empty()) {
+        shaderStats.Print("Shaders");
+    }
+    return 0;
+}
+
+bool Renderer_GL::InitSpriteShaders() {
+    spriteShader = LoadShaderProgram("Sprite Shader", "sprite.vert.glsl", "sprite.frag.glsl", "");
+    if (!spriteShader) {
+        return false;
+    }
+    spriteShader->RegisterAttributes({"position", "uv", "palIndex"});
+    spriteShader->RegisterUniforms(SpriteUniformNames);
+    spriteShader->RegisterTextures(SpriteTextureNames);
+    AssignTextureUnits(*spriteShader);
+    activeSpriteShader = spriteShader.get();
+
+    // Optional: RenderQuadInstanced draws one quad at a time without it
+    spriteInstancedShader = LoadShaderProgram("Sprite Shader (instanced)", "sprite.vert.glsl",
+                                              "sprite.frag.glsl", "", "#define INSTANCED\n");
+    if (spriteInstancedShader) {
+        spriteInstancedShader->RegisterAttributes({"position", "uv", "i_modelview", "i_tint", "i_addAlpha",
+                                                   "i_multPalIndex"});
+        spriteInstancedShader->RegisterUniforms(SpriteUniformNames);
+        spriteInstancedShader->RegisterTextures(SpriteTextureNames);
+        AssignTextureUnits(*spriteInstancedShader);
+    }
+    return true;
+}
+
+void Renderer_GL::BeginFrame(bool clearColor) {
+    // Fence last frame's vertices and uniforms and start writing into the
+    // next segments
+    vertexStream.NextSegment();
+    instanceStream.NextSegment();
+    uniformStream.NextSegment();
+    textureUploads.NextFrame();
+    frameIndex++;
+
+    // Hand finished profiler frames over and start timing this one
+    BeginGPUProfileFrame();
+    BeginGPURegion("BeginFrame");
+
+    // Swap in any programs that finished compiling since the last frame
+    PollShaderJobs();
+
+    StateCache_GL::BindVertexArray(vao);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GL::Viewport(viewport.x, viewport.y, viewport.width, viewport.height);
+
+    // Clearing or invalidating straight after the bind spares tile-based
+    // GPUs from loading the previous frame
+    const RenderPassPolicy& policy = GetRenderPassPolicy(RenderPass::Scene);
+    LoadAttachments(clearColor ? AttachmentLoad::Clear : policy.colorLoad, policy.depthLoad);
+    EndGPURegion();
+}
+
+void Renderer_GL::EndFrame() {
+    BeginGPURegion("EndFrame");
+    if (fbo_pp.empty()) {
+        EndGPUProfileFrame();
+        return;
+    }
+
+    StateCache_GL::BindVertexArray(vao);
+
+    // Post-processing pass - simplified
+    StateCache_GL::Viewport(viewport.x, viewport.y, viewport.width, viewport.height);
+    StateCache_GL::Disable(GL_BLEND);
+
+    // End the scene pass: its depth and, once resolved, its samples are not
+    // read again unless the policy keeps them
+    const RenderPassPolicy& scenePass = GetRenderPassPolicy(RenderPass::Scene);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    InvalidateAttachments(false, scenePass.depthStore == AttachmentStore::DontCare);
+    ResolveSceneTarget();
+    if (fbo_f != 0 && scenePass.colorStore == AttachmentStore::DontCare) {
+        InvalidateAttachments(true, false);
+    }
+
+    // Present the frame to the default framebuffer, where ReadPixels reads
+    // it: through the post chain, or filtered when the render scale is not
+    // 1. Either covers the whole output, so nothing is loaded first.
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    InvalidateAttachments(true, true);
+    if (!RunPostPasses()) {
+        StateCache_GL::Disable(GL_SCISSOR_TEST);
+        StateCache_GL::BindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        StateCache_GL::BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        StateCache_GL::Check("EndFrame");
+        bool scaled = viewport.width != outputWidth || viewport.height != outputHeight;
+        glBlitFramebuffer(0, 0, viewport.width, viewport.height, 0, 0, outputWidth, outputHeight,
+                          GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+    }
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    EndGPUProfileFrame();
+}
+
+void Renderer_GL::Await() {
+    glFinish();
+}
+
+void Renderer_GL::Resize(int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0 || (width == outputWidth && height == outputHeight)) return;
+    outputWidth = width;
+    outputHeight = height;
+    UpdateRenderTargets();
+}
+
+void Renderer_GL::SetRenderScale(float scale) {
+    renderScale = std::min(std::max(scale, MinRenderScale), MaxRenderScale);
+    UpdateRenderTargets();
+}
+
+void Renderer_GL::SetMSAASamples(int32_t samples) {
+    samples = samples > 1 ? samples : 0;
+    if (samples == msaaLevel) return;
+    if (fbo == 0) {
+        msaaLevel = samples;
+        return;
+    }
+
+    DestroyRenderTargets();
+    msaaLevel = samples;
+    if (!CreateRenderTargets()) {
+        std::cerr << "Failed to recreate render targets with " << samples << " samples" << std::endl;
+    }
+}
+
+void Renderer_GL::ResolveSceneTarget() {
+    if (fbo_f == 0) return;
+
+    BeginGPURegion("ResolveMSAA");
+    bool scissor = StateCache_GL::IsEnabled(GL_SCISSOR_TEST);
+    StateCache_GL::Disable(GL_SCISSOR_TEST);
+    StateCache_GL::BindFramebuffer(GL_READ_FRAMEBUFFER, fbo_f);
+    StateCache_GL::BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    StateCache_GL::Check("ResolveSceneTarget");
+    glBlitFramebuffer(0, 0, viewport.width, viewport.height, 0, 0, viewport.width, viewport.height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo_f);
+    if (scissor) StateCache_GL::Enable(GL_SCISSOR_TEST);
+    EndGPURegion();
+}
+
+void Renderer_GL::LoadAttachments(AttachmentLoad color, AttachmentLoad depth) {
+    InvalidateAttachments(color == AttachmentLoad::DontCare, depth == AttachmentLoad::DontCare);
+    GLbitfield clearBits = (color == AttachmentLoad::Clear ? GL_COLOR_BUFFER_BIT : 0) |
+                           (depth == AttachmentLoad::Clear ? GL_DEPTH_BUFFER_BIT : 0);
+    if (clearBits != 0) {
+        glClear(clearBits);
+    }
+}
+
+void Renderer_GL::InvalidateAttachments(bool color, bool depth) {
+    if (!glInvalidateFramebuffer) return;     // GL 4.3; only a hint on desktop GPUs
+    // The default framebuffer names its buffers differently; absent
+    // attachments (stencil) are ignored
+    bool window = StateCache_GL::GetFramebuffer(GL_DRAW_FRAMEBUFFER) == 0;
+    GLenum attachments[3];
+    GLsizei count = 0;
+    if (color) {
+        attachments[count++] = window ? GL_COLOR : GL_COLOR_ATTACHMENT0;
+    }
+    if (depth) {
+        attachments[count++] = window ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+        attachments[count++] = window ? GL_STENCIL : GL_STENCIL_ATTACHMENT;
+    }
+    if (count > 0) {
+        glInvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, count, attachments);
+    }
+}
+
+void Renderer_GL::SetPostChain(const std::vector<PostEffect>& chain) {
+    postPasses = PlanPostPasses(chain);
+    postShaderSelect.clear();
+    if (fbo != 0) {
+        QueuePostShaders();
+    }
+}
+
+void Renderer_GL::ReloadPostShaders() {
+    if (fbo != 0) {
+        QueuePostShaders();
+    }
+}
+
+// Keeps the current programs, so a reload swaps each pass over once its
+// replacement links and a failed edit leaves the running one in place
+void Renderer_GL::QueuePostShaders() {
+    uint32_t generation = ++postGeneration;
+    postShaderSelect.resize(postPasses.size());
+    for (size_t i = 0; i < postPasses.size(); ++i) {
+        QueueShaderProgram("Post Shader (" + PostPassName(postPasses[i]) + ")", "ident.vert.glsl",
+                           "post.frag.glsl", "", PostPassDefines(postPasses[i]),
+            [this, i, generation](const std::shared_ptr<ShaderProgram_GL>& shader) {
+                if (generation != postGeneration) return;
+                shader->RegisterAttributes({"VertCoord"});
+                shader->RegisterUniforms({"TextureSize", "InputScale", "SceneSize"});
+                shader->RegisterTextures({"Texture"});
+                postShaderSelect[i] = shader;
+            });
+    }
+}
+
+bool Renderer_GL::RunPostPasses() {
+    if (postPasses.empty() || fbo_pp.size() < 2) return false;
+    for (const auto& shader : postShaderSelect) {
+        if (!shader) return false;
+    }
+
+    // Each target is sized exactly for the largest pass drawing into it
+    // (the render size when none does), so a shorter chain or a smaller
+    // render size frees memory, and chains alternating sizes on one target
+    // do not reallocate every frame
+    int32_t targetSize[2][2] = {{viewport.width, viewport.height}, {viewport.width, viewport.height}};
+    int32_t passWidth = viewport.width, passHeight = viewport.height;
+    for (size_t i = 0; i + 1 < postPasses.size(); ++i) {
+        passWidth *= postPasses[i].scale;
+        passHeight *= postPasses[i].scale;
+        int32_t* size = targetSize[i % 2];
+        size[0] = std::max(size[0], passWidth);
+        size[1] = std::max(size[1], passHeight);
+    }
+    for (int32_t target = 0; target < 2; ++target) {
+        if (!CreatePostTarget(target, targetSize[target][0], targetSize[target][1])) {
+            return false;
+        }
+    }
+
+    BeginGPURegion("PostProcess");
+    StateCache_GL::Disable(GL_SCISSOR_TEST);
+    StateCache_GL::Disable(GL_BLEND);
+    StateCache_GL::Disable(GL_DEPTH_TEST);
+    StateCache_GL::Disable(GL_CULL_FACE);
+
+    // Each pass reads the region of its source the previous pass drew; the
+    // last one draws straight to the output
+    uint32_t source = fbo_texture;
+    int32_t sourceWidth = viewport.width, sourceHeight = viewport.height;
+    int32_t textureWidth = viewport.width, textureHeight = viewport.height;
+    for (size_t i = 0; i < postPasses.size(); ++i) {
+        bool last = i + 1 == postPasses.size();
+        int32_t target = static_cast<int32_t>(i % 2);
+        int32_t width = last ? outputWidth : sourceWidth * postPasses[i].scale;
+        int32_t height = last ? outputHeight : sourceHeight * postPasses[i].scale;
+
+        const ShaderProgram_GL& shader = *postShaderSelect[i];
+        StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, last ? 0 : fbo_pp[target]);
+        if (!last) {
+            InvalidateAttachments(true, false);
+        }
+        StateCache_GL::Viewport(0, 0, width, height);
+        StateCache_GL::UseProgram(shader.GetProgram());
+        int32_t unit = shader.GetTextureUnit("Texture");
+        StateCache_GL::ActiveTexture(GL_TEXTURE0 + unit);
+        StateCache_GL::BindTexture(GL_TEXTURE_2D, source);
+        glUniform1i(shader.GetUniformLocation("Texture"), unit);
+        glUniform2f(shader.GetUniformLocation("TextureSize"), static_cast<float>(sourceWidth),
+                    static_cast<float>(sourceHeight));
+        glUniform2f(shader.GetUniformLocation("InputScale"), static_cast<float>(sourceWidth) / textureWidth,
+                    static_cast<float>(sourceHeight) / textureHeight);
+        glUniform2f(shader.GetUniformLocation("SceneSize"), static_cast<float>(viewport.width),
+                    static_cast<float>(viewport.height));
+        DrawFullscreenQuad(shader);
+
+        source = fbo_pp_texture[target];
+        sourceWidth = width;
+        sourceHeight = height;
+        textureWidth = postTargetSize[target][0];
+        textureHeight = postTargetSize[target][1];
+    }
+    EndGPURegion();
+    return true;
+}
+
+bool Renderer_GL::IsModelEnabled() const {
+    return enableModel;
+}
+
+bool Renderer_GL::IsShadowEnabled() const {
+    return enableShadow;
+}
+
+void Renderer_GL::BlendReset() {
+    StateCache_GL::BlendEquation(MapBlendEquation(BlendEquation::Add));
+    StateCache_GL::BlendFunc(MapBlendFunction(BlendFunc::SrcAlpha), MapBlendFunction(BlendFunc::OneMinusSrcAlpha));
+}
+
+// glState keeps the values the model pipeline asked for; the release
+// functions change GL state behind it, so the setters always go to the
+// state cache, which drops what is already set
+void Renderer_GL::SetBlending(BlendEquation eq, BlendFunc src, BlendFunc dst) {
+    glState.blendEquation = eq;
+    glState.blendSrc = src;
+    glState.blendDst = dst;
+    StateCache_GL::BlendEquation(MapBlendEquation(eq));
+    StateCache_GL::BlendFunc(MapBlendFunction(src), MapBlendFunction(dst));
+}
+
+void Renderer_GL::SetDepthTest(bool depthTest) {
+    glState.depthTest = depthTest;
+    if (depthTest) {
+        StateCache_GL::Enable(GL_DEPTH_TEST);
+        StateCache_GL::DepthFunc(GL_LESS);
+    } else {
+        StateCache_GL::Disable(GL_DEPTH_TEST);
+    }
+}
+
+void Renderer_GL::SetDepthMask(bool depthMask) {
+    glState.depthMask = depthMask;
+    StateCache_GL::DepthMask(depthMask);
+}
+
+void Renderer_GL::SetFrontFace(bool invertFrontFace) {
+    glState.invertFrontFace = invertFrontFace;
+    StateCache_GL::FrontFace(invertFrontFace ? GL_CW : GL_CCW);
+}
+
+void Renderer_GL::SetCullFace(bool doubleSided) {
+    glState.doubleSided = doubleSided;
+    if (!doubleSided) {
+        StateCache_GL::Enable(GL_CULL_FACE);
+        StateCache_GL::CullFace(GL_BACK);
+    } else {
+        StateCache_GL::Disable(GL_CULL_FACE);
+    }
+}
+
+void Renderer_GL::SetPipeline(BlendEquation eq, BlendFunc src, BlendFunc dst) {
+    // An instanced pipeline left unreleased must not leak its divisors
+    if (instancedPipeline) {
+        ReleaseSpriteInstanceAttributes();
+        instancedPipeline = false;
+    }
+    activeSpriteShader = spriteShader.get();
+    BindSpritePipeline(eq, src, dst);
+}
+
+void Renderer_GL::BindSpritePipeline(BlendEquation eq, BlendFunc src, BlendFunc dst) {
+    BeginPassRegion(ProfilePassSprites);
+    StateCache_GL::BindVertexArray(vao);
+    StateCache_GL::UseProgram(activeSpriteShader->GetProgram());
+
+    StateCache_GL::BlendEquation(MapBlendEquation(eq));
+    StateCache_GL::BlendFunc(MapBlendFunction(src), MapBlendFunction(dst));
+    StateCache_GL::Enable(GL_BLEND);
+
+    SetupSpriteVertexAttributes();
 }
 
 void Renderer_GL::SetPipelineBatch() {
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferBatch);
-    const int stride = 20;
+    SetupSpriteVertexAttributes();
+}
+
+void Renderer_GL::SetPipelineInstanced(BlendEquation eq, BlendFunc src, BlendFunc dst) {
+    // Without the INSTANCED program RenderQuadInstanced falls back to one
+    // draw per instance on the regular sprite program
+    instancedPipeline = spriteInstancedShader != nullptr;
+    activeSpriteShader = instancedPipeline ? spriteInstancedShader.get() : spriteShader.get();
+    BindSpritePipeline(eq, src, dst);
+}
 
-    int32_t loc = spriteShader->GetAttributeLocation("position");
+void Renderer_GL::SetupSpriteVertexAttributes() {
+    StateCache_GL::BindBuffer(GL_ARRAY_BUFFER, vertexStream.GetHandle());
+    const int stride = SpriteVertexStride;
+
+    int32_t loc = activeSpriteShader->GetAttributeLocation("position");
     glEnableVertexAttribArray(loc);
     glVertexAttribPointer(loc, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
 
-    loc = spriteShader->GetAttributeLocation("uv");
+    loc = activeSpriteShader->GetAttributeLocation("uv");
     glEnableVertexAttribArray(loc);
     glVertexAttribPointer(loc, 2, GL_FLOAT, GL_FALSE, stride, (void*)8);
 
-    loc = spriteShader->GetAttributeLocation("palIndex");
-    glEnableVertexAttribArray(loc);
-    glVertexAttribPointer(loc, 1, GL_FLOAT, GL_FALSE, stride, (void*)16);
+    // The INSTANCED program takes palIndex per instance instead
+    loc = activeSpriteShader->GetAttributeLocation("palIndex");
+    if (loc >= 0) {
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 1, GL_FLOAT, GL_FALSE, stride, (void*)16);
+    }
+}
+
+void Renderer_GL::SetupSpriteInstanceAttributes(size_t offset) {
+    StateCache_GL::BindBuffer(GL_ARRAY_BUFFER, instanceStream.GetHandle());
+    const int stride = sizeof(SpriteInstance);
+
+    for (const auto& attr : SpriteInstanceAttributes) {
+        int32_t loc = activeSpriteShader->GetAttributeLocation(attr.name);
+        for (int column = 0; column < attr.columns; ++column) {
+            glEnableVertexAttribArray(loc + column);
+            glVertexAttribPointer(loc + column, 4, GL_FLOAT, GL_FALSE, stride,
+                                  (void*)(offset + attr.offset + column * 4 * sizeof(float)));
+            glVertexAttribDivisor(loc + column, 1);
+        }
+    }
+}
+
+void Renderer_GL::ReleaseSpriteInstanceAttributes() {
+    // The VAO is shared with the regular sprite program, so divisors must not leak
+    for (const auto& attr : SpriteInstanceAttributes) {
+        int32_t loc = activeSpriteShader->GetAttributeLocation(attr.name);
+        for (int column = 0; column < attr.columns; ++column) {
+            glVertexAttribDivisor(loc + column, 0);
+            glDisableVertexAttribArray(loc + column);
+        }
+    }
 }
 
 void Renderer_GL::ReleasePipeline() {
-    int32_t loc = spriteShader->GetAttributeLocation("position");
+    int32_t loc = activeSpriteShader->GetAttributeLocation("position");
     glDisableVertexAttribArray(loc);
 
-    loc = spriteShader->GetAttributeLocation("uv");
+    loc = activeSpriteShader->GetAttributeLocation("uv");
     glDisableVertexAttribArray(loc);
 
-    loc = spriteShader->GetAttributeLocation("palIndex");
-    glDisableVertexAttribArray(loc);
+    loc = activeSpriteShader->GetAttributeLocation("palIndex");
+    if (loc >= 0) glDisableVertexAttribArray(loc);
+
+    if (instancedPipeline) {
+        ReleaseSpriteInstanceAttributes();
+        instancedPipeline = false;
+    }
+    // Setters between pipelines apply to the regular program
+    activeSpriteShader = spriteShader.get();
 
-    glDisable(GL_BLEND);
+    StateCache_GL::Disable(GL_BLEND);
+    EndPassRegion(ProfilePassSprites);
 }
 
 void Renderer_GL::prepareModelPipeline(uint32_t bufferIndex, const Environment* env) {
     if (!modelShader) return;
 
-    glUseProgram(modelShader->GetProgram());
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glViewport(0, 0, 1920, 1080);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_TEXTURE_CUBE_MAP);
-    glEnable(GL_BLEND);
+    BeginPassRegion(ProfilePassModels);
 
-    if (glState.depthTest) {
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LESS);
-    } else {
-        glDisable(GL_DEPTH_TEST);
-    }
+    StateCache_GL::UseProgram(modelShader->GetProgram());
+    boundModelProgram = modelShader->GetProgram();
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GL::Viewport(viewport.x, viewport.y, viewport.width, viewport.height);
+    LoadAttachments(AttachmentLoad::Load, GetRenderPassPolicy(RenderPass::Models).depthLoad);
+    StateCache_GL::Enable(GL_BLEND);
 
-    glDepthMask(glState.depthMask);
-    glFrontFace(glState.invertFrontFace ? GL_CW : GL_CCW);
+    // Reapply the last model state the sprite and shadow passes overrode
+    SetDepthTest(glState.depthTest);
+    SetDepthMask(glState.depthMask);
+    SetFrontFace(glState.invertFrontFace);
+    SetCullFace(glState.doubleSided);
+    SetBlending(glState.blendEquation, glState.blendSrc, glState.blendDst);
 
-    if (!glState.doubleSided) {
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+    // model.frag skips image-based lighting at zero intensity
+    static const UniformID lambertianID = InternUniform("lambertianEnvSampler");
+    static const UniformID GGXID = InternUniform("GGXEnvSampler");
+    static const UniformID GGXLUTID = InternUniform("GGXLUT");
+    static const UniformID intensityID = InternUniform("environmentIntensity");
+    static const UniformID mipCountID = InternUniform("mipCount");
+    if (env && env->IsReady()) {
+        SetModelTexture(lambertianID, env->lambertianTexture);
+        SetModelTexture(GGXID, env->GGXTexture);
+        SetModelTexture(GGXLUTID, env->GGXLUT);
+        SetModelUniformF(intensityID, &env->intensity, 1);
+        SetModelUniformI(mipCountID, env->GetMipCount());
+        SetModelUniformMatrix3("environmentRotation", std::vector<float>(env->rotation, env->rotation + 9));
     } else {
-        glDisable(GL_CULL_FACE);
+        const float intensity = 0.0f;
+        SetModelUniformF(intensityID, &intensity, 1);
     }
 
-    glBlendEquation(MapBlendEquation(glState.blendEquation));
-    glBlendFunc(MapBlendFunction(glState.blendSrc), MapBlendFunction(glState.blendDst));
+    // ENABLE_SHADOW programs read every light's shadows from the atlas
+    static const UniformID shadowAtlasID = InternUniform("shadowAtlas");
+    int32_t shadowUnit = fbo_shadow_texture != 0 ? modelShader->GetTextureUnit(shadowAtlasID) : -1;
+    if (shadowUnit >= 0) {
+        StateCache_GL::ActiveTexture(GL_TEXTURE0 + shadowUnit);
+        StateCache_GL::BindTexture(GL_TEXTURE_2D, fbo_shadow_texture);
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer[bufferIndex]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelIndexBuffer[bufferIndex]);
+    // Each mesh's vertex array binds the buffers (SetModelPipeline)
+    modelBufferIndex = bufferIndex;
 }
 
 void Renderer_GL::SetModelPipeline(BlendEquation eq, BlendFunc src, BlendFunc dst,
@@ -628,16 +2034,42 @@ void Renderer_GL::SetModelPipeline(BlendEquation eq, BlendFunc src, BlendFunc ds
     SetCullFace(doubleSided);
     SetBlending(eq, src, dst);
 
-    // Setup vertex attributes - simplified version
-    // A full implementation would set up all the vertex attribute pointers
+    // Vertex half of the permutation key
+    glState.useUV = useUV;
+    glState.useNormal = useNormal;
+    glState.useTangent = useTangent;
+    glState.useVertColor = useVertColor;
+    glState.useJoint0 = useJoint0;
+    glState.useJoint1 = useJoint1;
+    glState.useOutlineAttribute = useOutlineAttribute;
+
+    BindModelVertexArray(ModelVertexFeatures(glState), numVertices, vertAttrOffset, false);
+
+    // Generic attribute values are not vertex array state. Absent streams
+    // must read as neutral: the GL default (0,0,0,1) gives weights and the
+    // outline a w of 1, which the generic program takes as skinned and
+    // outlined vertices.
+    if (!useUV) glVertexAttrib2f(ModelLocationUV, 0.0f, 0.0f);
+    if (!useVertColor) glVertexAttrib4f(ModelLocationVertColor, 1.0f, 1.0f, 1.0f, 1.0f);
+    if (!useJoint0) {
+        glVertexAttrib4f(ModelLocationJoint0, 0.0f, 0.0f, 0.0f, 0.0f);
+        glVertexAttrib4f(ModelLocationWeight0, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+    if (!useJoint0 || !useJoint1) {
+        glVertexAttrib4f(ModelLocationJoint1, 0.0f, 0.0f, 0.0f, 0.0f);
+        glVertexAttrib4f(ModelLocationWeight1, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+    if (!useOutlineAttribute) glVertexAttrib4f(ModelLocationOutlineAttribute, 0.0f, 0.0f, 0.0f, 0.0f);
 }
 
 void Renderer_GL::ReleaseModelPipeline() {
     if (!modelShader) return;
 
-    glDepthMask(true);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+    StateCache_GL::DepthMask(true);
+    StateCache_GL::Disable(GL_DEPTH_TEST);
+    StateCache_GL::Disable(GL_CULL_FACE);
+    StateCache_GL::BindVertexArray(vao);
+    boundModelProgram = 0;
 
     glState.useUV = false;
     glState.useNormal = false;
@@ -646,22 +2078,32 @@ void Renderer_GL::ReleaseModelPipeline() {
     glState.useJoint0 = false;
     glState.useJoint1 = false;
     glState.useOutlineAttribute = false;
+
+    // The next model pass clears the depth again
+    if (GetRenderPassPolicy(RenderPass::Models).depthStore == AttachmentStore::DontCare) {
+        StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+        InvalidateAttachments(false, true);
+    }
+    EndPassRegion(ProfilePassModels);
 }
 
 void Renderer_GL::prepareShadowMapPipeline(uint32_t bufferIndex) {
-    if (!shadowMapShader) return;
-
-    glUseProgram(shadowMapShader->GetProgram());
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_shadow);
-    glViewport(0, 0, 1024, 1024);
-    glEnable(GL_TEXTURE_2D);
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    glDepthMask(true);
-
-    glBindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer[bufferIndex]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelIndexBuffer[bufferIndex]);
+    if (!IsShadowReady()) return;
+
+    BeginPassRegion(ProfilePassShadows);
+
+    StateCache_GL::UseProgram(shadowMapShader->GetProgram());
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo_shadow);
+    StateCache_GL::Viewport(0, 0, shadowAtlasSize, shadowAtlasSize);
+    StateCache_GL::Disable(GL_BLEND);
+    StateCache_GL::Enable(GL_DEPTH_TEST);
+    StateCache_GL::DepthFunc(GL_LESS);
+    StateCache_GL::DepthMask(true);
+    const RenderPassPolicy& policy = GetRenderPassPolicy(RenderPass::Shadows);
+    LoadAttachments(policy.colorLoad, policy.depthLoad);
+
+    // Each mesh's vertex array binds the buffers (setShadowMapPipeline)
+    modelBufferIndex = bufferIndex;
 }
 
 void Renderer_GL::setShadowMapPipeline(bool doubleSided, bool invertFrontFace, bool useUV, bool useNormal,
@@ -671,18 +2113,47 @@ void Renderer_GL::setShadowMapPipeline(bool doubleSided, bool invertFrontFace, b
 
     SetFrontFace(invertFrontFace);
     SetCullFace(doubleSided);
-    // Additional setup would go here
+
+    glState.useUV = useUV;
+    glState.useJoint0 = useJoint0;
+    glState.useJoint1 = useJoint1;
+
+    // Only positions are read; the other attributes are skipped over
+    uint32_t features = (useUV ? ModelFeatureUV : 0) | (useNormal ? ModelFeatureNormal : 0) |
+                        (useTangent ? ModelFeatureTangent : 0) | (useVertColor ? ModelFeatureVertColor : 0) |
+                        (useJoint0 ? ModelFeatureJoint0 : 0) | (useJoint1 ? ModelFeatureJoint1 : 0);
+    BindModelVertexArray(features, numVertices, vertAttrOffset, true);
+}
+
+void Renderer_GL::SetShadowAtlasView(int32_t x, int32_t y, int32_t size) {
+    if (!IsShadowReady()) return;
+
+    // The scissor limits the clear to the tile and keeps draws that miss
+    // the light's frustum out of the neighbouring ones
+    StateCache_GL::Viewport(x, y, size, size);
+    StateCache_GL::Enable(GL_SCISSOR_TEST);
+    StateCache_GL::Scissor(x, y, size, size);
+    StateCache_GL::DepthMask(true);
+    glClear(GL_DEPTH_BUFFER_BIT);
 }
 
 void Renderer_GL::ReleaseShadowPipeline() {
-    glDepthMask(true);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_BLEND);
+    if (GetRenderPassPolicy(RenderPass::Shadows).depthStore == AttachmentStore::DontCare) {
+        InvalidateAttachments(false, true);
+    }
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GL::Viewport(viewport.x, viewport.y, viewport.width, viewport.height);
+    StateCache_GL::Disable(GL_SCISSOR_TEST);
+    StateCache_GL::BindVertexArray(vao);
+    StateCache_GL::DepthMask(true);
+    StateCache_GL::Disable(GL_DEPTH_TEST);
+    StateCache_GL::Disable(GL_CULL_FACE);
+    StateCache_GL::Disable(GL_BLEND);
 
     glState.useUV = false;
     glState.useJoint0 = false;
     glState.useJoint1 = false;
+    EndPassRegion(ProfilePassShadows);
 }
 
 void Renderer_GL::SetMeshOulinePipeline(bool invertFrontFace, float meshOutline) {
@@ -696,18 +2167,23 @@ void Renderer_GL::SetMeshOulinePipeline(bool invertFrontFace, float meshOutline)
     }
 }
 
+// Takes a top-left origin rectangle in output pixels
 void Renderer_GL::Scissor(int32_t x, int32_t y, int32_t width, int32_t height) {
-    glEnable(GL_SCISSOR_TEST);
-    glScissor(x, 1080 - (y + height), width, height);
+    int32_t left = x * viewport.width / outputWidth;
+    int32_t right = (x + width) * viewport.width / outputWidth;
+    int32_t top = y * viewport.height / outputHeight;
+    int32_t bottom = (y + height) * viewport.height / outputHeight;
+    StateCache_GL::Enable(GL_SCISSOR_TEST);
+    StateCache_GL::Scissor(left, viewport.height - bottom, right - left, bottom - top);
 }
 
 void Renderer_GL::DisableScissor() {
-    glDisable(GL_SCISSOR_TEST);
+    StateCache_GL::Disable(GL_SCISSOR_TEST);
 }
 
 std::shared_ptr<ITexture> Renderer_GL::newTexture(int32_t width, int32_t height, int32_t depth, bool filter) {
     uint32_t handle;
-    glActiveTexture(GL_TEXTURE0);
+    StateCache_GL::ActiveTexture(GL_TEXTURE0);
     glGenTextures(1, &handle);
     return std::make_shared<Texture_GL>(width, height, depth, filter, handle);
 }
@@ -718,93 +2194,272 @@ std::shared_ptr<ITexture> Renderer_GL::newPaletteTexture() {
 
 std::shared_ptr<ITexture> Renderer_GL::newPaletteTextureArray(int32_t layers) {
     uint32_t handle;
-    glActiveTexture(GL_TEXTURE0);
+    StateCache_GL::ActiveTexture(GL_TEXTURE0);
     glGenTextures(1, &handle);
     
-    glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
-    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 256, 1, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    auto tex = std::make_shared<Texture_GL>(256, 1, layers, false, handle);
+    tex->Allocate(GL_TEXTURE_2D_ARRAY, GL_RGBA8, 1, layers);
     
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    return std::make_shared<Texture_GL>(256, 1, layers, false, handle);
+    return tex;
+}
+
+std::shared_ptr<ITexture> Renderer_GL::newModelTexture(int32_t width, int32_t height, int32_t depth, bool filter) {
+    return newTexture(width, height, depth, filter);
+}
+
+std::shared_ptr<ITexture> Renderer_GL::newDataTexture(int32_t width, int32_t height) {
+    uint32_t handle;
+    StateCache_GL::ActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &handle);
+    
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return std::make_shared<Texture_GL>(width, height, 128, false, handle);
+}
+
+std::shared_ptr<ITexture> Renderer_GL::newHDRTexture(int32_t width, int32_t height) {
+    uint32_t handle;
+    StateCache_GL::ActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &handle);
+    
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+
+    // Only read while baking the environment cubemaps
+    auto tex = std::make_shared<Texture_GL>(width, height, 96, false, handle);
+    tex->Allocate(GL_TEXTURE_2D, iblPrecision == IBLPrecision::Half ? GL_RGB16F : GL_RGB32F, 1);
+    return tex;
+}
+
+std::shared_ptr<ITexture> Renderer_GL::newCubeMapTexture(int32_t widthHeight, bool mipmap, int32_t lowestMipLevel) {
+    uint32_t handle;
+    StateCache_GL::ActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &handle);
+    
+    // Mip levels stop at lowestMipLevel when it is set and run down to 1x1
+    // otherwise; the levels are filled by rendering or glGenerateMipmap
+    int32_t levels = 1;
+    if (mipmap) {
+        levels = MipLevelCount(widthHeight, widthHeight);
+        if (lowestMipLevel > 0) {
+            levels = std::min(levels, lowestMipLevel + 1);
+        }
+    }
+
+    // Packed float keeps HDR range at a quarter of the size of RGBA32F
+    // (RGB32F is not color-renderable)
+    auto tex = std::make_shared<Texture_GL>(widthHeight, widthHeight, 24, false, handle);
+    tex->Allocate(GL_TEXTURE_CUBE_MAP, iblPrecision == IBLPrecision::Half ? GL_R11F_G11F_B10F : GL_RGBA32F, levels);
+
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    return tex;
+}
+
+std::shared_ptr<ITexture> Renderer_GL::newLUTTexture(int32_t widthHeight) {
+    uint32_t handle;
+    StateCache_GL::ActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &handle);
+
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, handle);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // model.frag reads the scale and bias from .rg only
+    auto tex = std::make_shared<Texture_GL>(widthHeight, widthHeight, 128, false, handle);
+    tex->Allocate(GL_TEXTURE_2D, iblPrecision == IBLPrecision::Half ? GL_RG16F : GL_RGBA32F, 1);
+    return tex;
+}
+
+// Every texture of this backend is a Texture_GL (see newTexture)
+void Renderer_GL::SetTextureData(const std::shared_ptr<ITexture>& tex, const std::vector<uint8_t>& data) {
+    if (!tex) return;
+    Texture_GL* texture = static_cast<Texture_GL*>(tex.get());
+
+    // Allocate level 0 now and let the texels follow through the ring
+    texture->SetData({});
+    if (!data.empty()) {
+        textureUploads.Upload(*texture, data, 0, 0, texture->GetWidth(), texture->GetHeight());
+    }
+}
+
+void Renderer_GL::SetTextureSubData(const std::shared_ptr<ITexture>& tex, const std::vector<uint8_t>& data,
+                                    int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (!tex) return;
+    textureUploads.Upload(*static_cast<Texture_GL*>(tex.get()), data, x, y, width, height);
 }
 
-std::shared_ptr<ITexture> Renderer_GL::newModelTexture(int32_t width, int32_t height, int32_t depth, bool filter) {
-    return newTexture(width, height, depth, filter);
+bool Renderer_GL::IsTextureReady(const std::shared_ptr<ITexture>& tex) const {
+    return tex && !textureUploads.IsPending(tex->GetHandle());
 }
 
-std::shared_ptr<ITexture> Renderer_GL::newDataTexture(int32_t width, int32_t height) {
-    uint32_t handle;
-    glActiveTexture(GL_TEXTURE0);
-    glGenTextures(1, &handle);
-    
-    glBindTexture(GL_TEXTURE_2D, handle);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+void Renderer_GL::SetTexturePixelData(const std::shared_ptr<ITexture>& tex, const std::vector<float>& data) {
+    if (!tex) return;
+    static_cast<Texture_GL*>(tex.get())->SetPixelData(data);
+}
 
-    return std::make_shared<Texture_GL>(width, height, 128, false, handle);
+// Faces are read and written with the storage's own transfer format, so a
+// level round-trips bit for bit
+bool Renderer_GL::ReadTextureLevel(const std::shared_ptr<ITexture>& tex, int32_t level, std::vector<uint8_t>& data) {
+    if (!tex) return false;
+    const Texture_GL* texture = static_cast<const Texture_GL*>(tex.get());
+    const TextureFormatInfo& info = LookupTextureFormat(texture->GetInternalFormat());
+    GLenum target = texture->GetTarget();
+    if (info.internalFormat != texture->GetInternalFormat() || target == GL_TEXTURE_2D_ARRAY ||
+        level < 0 || level >= texture->GetLevels()) {
+        return false;
+    }
+
+    const int32_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    const size_t faceSize = static_cast<size_t>(std::max(texture->GetWidth() >> level, 1)) *
+                            std::max(texture->GetHeight() >> level, 1) * info.bytesPerTexel;
+    data.resize(faceSize * faces);
+
+    StateCache_GL::BindTexture(target, texture->GetHandle());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (int32_t face = 0; face < faces; ++face) {
+        GLenum image = faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+        glGetTexImage(image, level, info.format, info.type, data.data() + faceSize * face);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    return true;
 }
 
-std::shared_ptr<ITexture> Renderer_GL::newHDRTexture(int32_t width, int32_t height) {
-    uint32_t handle;
-    glActiveTexture(GL_TEXTURE0);
-    glGenTextures(1, &handle);
-    
-    glBindTexture(GL_TEXTURE_2D, handle);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+bool Renderer_GL::WriteTextureLevel(const std::shared_ptr<ITexture>& tex, int32_t level, const std::vector<uint8_t>& data) {
+    if (!tex) return false;
+    const Texture_GL* texture = static_cast<const Texture_GL*>(tex.get());
+    const TextureFormatInfo& info = LookupTextureFormat(texture->GetInternalFormat());
+    GLenum target = texture->GetTarget();
+    if (info.internalFormat != texture->GetInternalFormat() || target == GL_TEXTURE_2D_ARRAY ||
+        level < 0 || level >= texture->GetLevels()) {
+        return false;
+    }
+
+    const int32_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    const int32_t width = std::max(texture->GetWidth() >> level, 1);
+    const int32_t height = std::max(texture->GetHeight() >> level, 1);
+    const size_t faceSize = static_cast<size_t>(width) * height * info.bytesPerTexel;
+    if (data.size() != faceSize * faces) return false;
+
+    StateCache_GL::BindTexture(target, texture->GetHandle());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int32_t face = 0; face < faces; ++face) {
+        GLenum image = faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+        glTexSubImage2D(image, level, 0, 0, width, height, info.format, info.type, data.data() + faceSize * face);
+    }
+    return true;
+}
 
-    return std::make_shared<Texture_GL>(width, height, 96, false, handle);
+size_t Renderer_GL::GetTextureMemory() const {
+    return Texture_GL::GetAllocatedBytes();
 }
 
-std::shared_ptr<ITexture> Renderer_GL::newCubeMapTexture(int32_t widthHeight, bool mipmap, int32_t lowestMipLevel) {
-    uint32_t handle;
-    glActiveTexture(GL_TEXTURE0);
-    glGenTextures(1, &handle);
-    
-    glBindTexture(GL_TEXTURE_CUBE_MAP, handle);
-    
-    for (int i = 0; i < 6; ++i) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB32F, widthHeight, widthHeight, 0, GL_RGB, GL_FLOAT, nullptr);
+// From the current target sizes; every attachment is created with the
+// formats counted here
+size_t Renderer_GL::GetRenderTargetMemory() const {
+    const size_t color = LookupTextureFormat(GL_RGBA8).bytesPerTexel;
+    const size_t depth = LookupTextureFormat(GL_DEPTH_COMPONENT24).bytesPerTexel;
+    const size_t pixels = static_cast<size_t>(viewport.width) * viewport.height;
+
+    size_t bytes = 0;
+    if (fbo_texture != 0) bytes += pixels * color;
+    if (rbo_depth != 0) bytes += pixels * depth;
+    if (rbo_f_color != 0) bytes += pixels * color * msaaLevel;
+    if (rbo_f_depth != 0) bytes += pixels * depth * msaaLevel;
+    for (size_t i = 0; i < fbo_pp_texture.size(); ++i) {
+        if (fbo_pp_texture[i] != 0) {
+            bytes += static_cast<size_t>(postTargetSize[i][0]) * postTargetSize[i][1] * color;
+        }
+    }
+    if (fbo_shadow_texture != 0) {
+        bytes += static_cast<size_t>(shadowAtlasSize) * shadowAtlasSize * depth;
     }
+    return bytes;
+}
 
-    if (mipmap) {
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-    } else {
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+void Renderer_GL::CopyTextureRegion(const std::shared_ptr<ITexture>& src, int32_t srcX, int32_t srcY,
+                                    const std::shared_ptr<ITexture>& dst, int32_t dstX, int32_t dstY,
+                                    int32_t width, int32_t height) {
+    if (!src || !dst || width <= 0 || height <= 0) return;
+
+    if (GLAD_GL_VERSION_4_3) {
+        glCopyImageSubData(src->GetHandle(), GL_TEXTURE_2D, 0, srcX, srcY, 0,
+                           dst->GetHandle(), GL_TEXTURE_2D, 0, dstX, dstY, 0, width, height, 1);
+        return;
     }
 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Framebuffer blit: works for any color-renderable format
+    uint32_t previousRead = StateCache_GL::GetFramebuffer(GL_READ_FRAMEBUFFER);
+    uint32_t previousDraw = StateCache_GL::GetFramebuffer(GL_DRAW_FRAMEBUFFER);
+    bool scissor = StateCache_GL::IsEnabled(GL_SCISSOR_TEST);
+    StateCache_GL::Disable(GL_SCISSOR_TEST);
+
+    GLuint fbos[2] = {0, 0};
+    glGenFramebuffers(2, fbos);
+    StateCache_GL::BindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src->GetHandle(), 0);
+    StateCache_GL::BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst->GetHandle(), 0);
+    glBlitFramebuffer(srcX, srcY, srcX + width, srcY + height, dstX, dstY, dstX + width, dstY + height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    StateCache_GL::BindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+    StateCache_GL::BindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+    StateCache_GL::DeleteFramebuffers(2, fbos);
+    if (scissor) StateCache_GL::Enable(GL_SCISSOR_TEST);
+}
 
-    return std::make_shared<Texture_GL>(widthHeight, widthHeight, 24, false, handle);
+// Uploads a 1-4 component float uniform from raw memory
+static void UploadUniformF(int32_t loc, const float* values, int count) {
+    switch (count) {
+    case 1:
+        glUniform1fv(loc, 1, values);
+        break;
+    case 2:
+        glUniform2fv(loc, 1, values);
+        break;
+    case 3:
+        glUniform3fv(loc, 1, values);
+        break;
+    case 4:
+        glUniform4fv(loc, 1, values);
+        break;
+    }
 }
 
 void Renderer_GL::SetTexture(const std::string& name, const std::shared_ptr<ITexture>& tex) {
-    if (!tex || !tex->IsValid() || !spriteShader) {
+    if (!tex || !tex->IsValid() || !activeSpriteShader) {
         std::cerr << "Renderer_GL.SetTexture " << name << " is empty or invalid" << std::endl;
         return;
     }
 
-    int32_t loc = spriteShader->GetUniformLocation(name);
-    int32_t unit = spriteShader->GetTextureUnit(name);
+    int32_t loc = activeSpriteShader->GetUniformLocation(name);
+    int32_t unit = activeSpriteShader->GetTextureUnit(name);
 
-    glActiveTexture(GL_TEXTURE0 + unit);
+    StateCache_GL::ActiveTexture(GL_TEXTURE0 + unit);
     
     // Check if it's a palette texture array
     if (name == "pal" || (tex->GetDepth() > 1 && tex->GetHeight() == 1)) {
-        glBindTexture(GL_TEXTURE_2D_ARRAY, tex->GetHandle());
+        StateCache_GL::BindTexture(GL_TEXTURE_2D_ARRAY, tex->GetHandle());
     } else {
-        glBindTexture(GL_TEXTURE_2D, tex->GetHandle());
+        StateCache_GL::BindTexture(GL_TEXTURE_2D, tex->GetHandle());
     }
     
     glUniform1i(loc, unit);
@@ -813,12 +2468,12 @@ void Renderer_GL::SetTexture(const std::string& name, const std::shared_ptr<ITex
 void Renderer_GL::SetModelTexture(const std::string& name, const std::shared_ptr<ITexture>& tex) {
     if (!modelShader || !tex) return;
 
-    int32_t loc = modelShader->GetUniformLocation(name);
+    // Sampler units were assigned by RegisterModelInterface
     int32_t unit = modelShader->GetTextureUnit(name);
+    if (unit < 0) return;
 
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, tex->GetHandle());
-    glUniform1i(loc, unit);
+    StateCache_GL::ActiveTexture(GL_TEXTURE0 + unit);
+    StateCache_GL::BindTexture(static_cast<const Texture_GL*>(tex.get())->GetTarget(), tex->GetHandle());
 }
 
 void Renderer_GL::SetShadowMapTexture(const std::string& name, const std::shared_ptr<ITexture>& tex) {
@@ -827,20 +2482,48 @@ void Renderer_GL::SetShadowMapTexture(const std::string& name, const std::shared
     int32_t loc = shadowMapShader->GetUniformLocation(name);
     int32_t unit = shadowMapShader->GetTextureUnit(name);
 
-    glActiveTexture(GL_TEXTURE0 + unit);
-    glBindTexture(GL_TEXTURE_2D, tex->GetHandle());
+    StateCache_GL::ActiveTexture(GL_TEXTURE0 + unit);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, tex->GetHandle());
     glUniform1i(loc, unit);
 }
 
+void Renderer_GL::SetTexture(UniformID id, const std::shared_ptr<ITexture>& tex) {
+    static const UniformID palID = InternUniform("pal");
+    if (!activeSpriteShader || !tex) return;
+
+    int32_t unit = activeSpriteShader->GetTextureUnit(id);
+    if (unit < 0) return;
+
+    StateCache_GL::ActiveTexture(GL_TEXTURE0 + unit);
+    if (id == palID || (tex->GetDepth() > 1 && tex->GetHeight() == 1)) {
+        StateCache_GL::BindTexture(GL_TEXTURE_2D_ARRAY, tex->GetHandle());
+    } else {
+        StateCache_GL::BindTexture(GL_TEXTURE_2D, tex->GetHandle());
+    }
+    glUniform1i(activeSpriteShader->GetUniformLocation(id), unit);
+}
+
+void Renderer_GL::SetModelTexture(UniformID id, const std::shared_ptr<ITexture>& tex) {
+    if (!modelShader || !tex) return;
+
+    int32_t unit = modelShader->GetTextureUnit(id);
+    if (unit < 0) return;
+
+    StateCache_GL::ActiveTexture(GL_TEXTURE0 + unit);
+    StateCache_GL::BindTexture(static_cast<const Texture_GL*>(tex.get())->GetTarget(), tex->GetHandle());
+}
+
 void Renderer_GL::SetUniformI(const std::string& name, int val) {
-    if (!spriteShader) return;
-    int32_t loc = spriteShader->GetUniformLocation(name);
+    if (!activeSpriteShader) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(activeSpriteShader, name, &val, sizeof(int), 1)) return;
     glUniform1i(loc, val);
 }
 
 void Renderer_GL::SetUniformF(const std::string& name, const std::vector<float>& values) {
-    if (!spriteShader) return;
-    int32_t loc = spriteShader->GetUniformLocation(name);
+    if (!activeSpriteShader) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(activeSpriteShader, name, values.data(), static_cast<int>(values.size() * sizeof(float)), 1)) return;
     
     switch (values.size()) {
     case 1:
@@ -859,8 +2542,14 @@ void Renderer_GL::SetUniformF(const std::string& name, const std::vector<float>&
 }
 
 void Renderer_GL::SetUniformFv(const std::string& name, const std::vector<float>& values) {
-    if (!spriteShader) return;
-    int32_t loc = spriteShader->GetUniformLocation(name);
+    if (!activeSpriteShader) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(name);
+    if (loc < 0) {
+        // Up to 4 floats form one vector, longer inputs are vec4 arrays
+        int elementSize = static_cast<int>(std::min<size_t>(values.size(), 4) * sizeof(float));
+        int count = values.size() > 4 ? static_cast<int>(values.size() / 4) : 1;
+        if (StoreBlockUniform(activeSpriteShader, name, values.data(), elementSize, count)) return;
+    }
     
     switch (values.size()) {
     case 2:
@@ -876,20 +2565,56 @@ void Renderer_GL::SetUniformFv(const std::string& name, const std::vector<float>
 }
 
 void Renderer_GL::SetUniformMatrix(const std::string& name, const std::vector<float>& value) {
-    if (!spriteShader || value.size() != 16) return;
-    int32_t loc = spriteShader->GetUniformLocation(name);
+    if (!activeSpriteShader || value.size() != 16) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(activeSpriteShader, name, value.data(), 4 * sizeof(float), 4)) return;
     glUniformMatrix4fv(loc, 1, GL_FALSE, value.data());
 }
 
+void Renderer_GL::SetUniformI(UniformID id, int val) {
+    if (!activeSpriteShader) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        glUniform1i(loc, val);
+    } else {
+        activeSpriteShader->WriteBlockUniform(id, &val, sizeof(int), 1);
+    }
+}
+
+void Renderer_GL::SetUniformF(UniformID id, const float* values, int count) {
+    if (!activeSpriteShader) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        UploadUniformF(loc, values, count);
+    } else {
+        activeSpriteShader->WriteBlockUniform(id, values, count * sizeof(float), 1);
+    }
+}
+
+void Renderer_GL::SetUniformMatrix(UniformID id, const float* value) {
+    if (!activeSpriteShader) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        glUniformMatrix4fv(loc, 1, GL_FALSE, value);
+    } else {
+        activeSpriteShader->WriteBlockUniform(id, value, 4 * sizeof(float), 4);
+    }
+}
+
 void Renderer_GL::SetModelUniformI(const std::string& name, int val) {
     if (!modelShader) return;
+    if (uint32_t feature = ModelMaterialFeature(InternUniform(name))) {
+        modelMaterialFeatures = val ? (modelMaterialFeatures | feature) : (modelMaterialFeatures & ~feature);
+    }
     int32_t loc = modelShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(modelShader.get(), name, &val, sizeof(int), 1)) return;
     glUniform1i(loc, val);
 }
 
 void Renderer_GL::SetModelUniformF(const std::string& name, const std::vector<float>& values) {
     if (!modelShader) return;
     int32_t loc = modelShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(modelShader.get(), name, values.data(), static_cast<int>(values.size() * sizeof(float)), 1)) return;
     
     switch (values.size()) {
     case 1:
@@ -910,6 +2635,12 @@ void Renderer_GL::SetModelUniformF(const std::string& name, const std::vector<fl
 void Renderer_GL::SetModelUniformFv(const std::string& name, const std::vector<float>& values) {
     if (!modelShader) return;
     int32_t loc = modelShader->GetUniformLocation(name);
+    if (loc < 0) {
+        // Up to 4 floats form one vector, longer inputs are vec4 arrays
+        int elementSize = static_cast<int>(std::min<size_t>(values.size(), 4) * sizeof(float));
+        int count = values.size() > 4 ? static_cast<int>(values.size() / 4) : 1;
+        if (StoreBlockUniform(modelShader.get(), name, values.data(), elementSize, count)) return;
+    }
     
     switch (values.size()) {
     case 2:
@@ -918,11 +2649,11 @@ void Renderer_GL::SetModelUniformFv(const std::string& name, const std::vector<f
     case 3:
         glUniform3fv(loc, 1, values.data());
         break;
-    case 4:
-        glUniform4fv(loc, 1, values.data());
-        break;
-    case 8:
-        glUniform4fv(loc, 2, values.data());
+    default:
+        // vec4 arrays: morphTargetWeight, shadowAtlasRects, shadowCascades
+        if (values.size() % 4 == 0) {
+            glUniform4fv(loc, static_cast<GLsizei>(values.size() / 4), values.data());
+        }
         break;
     }
 }
@@ -930,15 +2661,50 @@ void Renderer_GL::SetModelUniformFv(const std::string& name, const std::vector<f
 void Renderer_GL::SetModelUniformMatrix(const std::string& name, const std::vector<float>& value) {
     if (!modelShader || value.size() != 16) return;
     int32_t loc = modelShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(modelShader.get(), name, value.data(), 4 * sizeof(float), 4)) return;
     glUniformMatrix4fv(loc, 1, GL_FALSE, value.data());
 }
 
 void Renderer_GL::SetModelUniformMatrix3(const std::string& name, const std::vector<float>& value) {
     if (!modelShader || value.size() != 9) return;
     int32_t loc = modelShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(modelShader.get(), name, value.data(), 3 * sizeof(float), 3)) return;
     glUniformMatrix3fv(loc, 1, GL_FALSE, value.data());
 }
 
+void Renderer_GL::SetModelUniformI(UniformID id, int val) {
+    if (!modelShader) return;
+    if (uint32_t feature = ModelMaterialFeature(id)) {
+        modelMaterialFeatures = val ? (modelMaterialFeatures | feature) : (modelMaterialFeatures & ~feature);
+    }
+    int32_t loc = modelShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        glUniform1i(loc, val);
+    } else {
+        modelShader->WriteBlockUniform(id, &val, sizeof(int), 1);
+    }
+}
+
+void Renderer_GL::SetModelUniformF(UniformID id, const float* values, int count) {
+    if (!modelShader) return;
+    int32_t loc = modelShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        UploadUniformF(loc, values, count);
+    } else {
+        modelShader->WriteBlockUniform(id, values, count * sizeof(float), 1);
+    }
+}
+
+void Renderer_GL::SetModelUniformMatrix(UniformID id, const float* value) {
+    if (!modelShader) return;
+    int32_t loc = modelShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        glUniformMatrix4fv(loc, 1, GL_FALSE, value);
+    } else {
+        modelShader->WriteBlockUniform(id, value, 4 * sizeof(float), 4);
+    }
+}
+
 void Renderer_GL::SetShadowMapUniformI(const std::string& name, int val) {
     if (!shadowMapShader) return;
     int32_t loc = shadowMapShader->GetUniformLocation(name);
@@ -997,60 +2763,334 @@ void Renderer_GL::SetShadowMapUniformMatrix3(const std::string& name, const std:
     glUniformMatrix3fv(loc, 1, GL_FALSE, value.data());
 }
 
-void Renderer_GL::SetShadowFrameTexture(uint32_t i) {
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, fbo_shadow_cube_texture, 0);
+void Renderer_GL::SetShadowAtlasSize(int32_t size) {
+    shadowAtlasSize = std::max(0, size);
+    enableShadow = shadowAtlasSize > 0;
 }
 
-void Renderer_GL::SetShadowFrameCubeTexture(uint32_t i) {
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, fbo_shadow_cube_texture, 0);
-}
+int32_t Renderer_GL::SetVertexData(const std::vector<float>& values) {
+    if (values.empty()) return vertexFirst;
+
+    // Offsets are stride-aligned so they map directly onto a first vertex
+    uint32_t generation = vertexStream.GetGeneration();
+    size_t offset = vertexStream.Append(values.data(), values.size() * sizeof(float), SpriteVertexStride);
+    if (vertexStream.GetGeneration() != generation && activeSpriteShader) {
+        // The ring was reallocated to fit this upload
+        SetupSpriteVertexAttributes();
+    }
 
-void Renderer_GL::SetVertexData(const std::vector<float>& values) {
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, values.size() * sizeof(float), values.data(), GL_STATIC_DRAW);
+    vertexFirst = static_cast<int32_t>(offset / SpriteVertexStride);
+    return vertexFirst;
 }
 
-void Renderer_GL::SetVertexDataArray(const std::vector<float>& values) {
-    if (values.empty()) return;
-    
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferBatch);
-    glBufferData(GL_ARRAY_BUFFER, values.size() * sizeof(float), values.data(), GL_STATIC_DRAW);
+int32_t Renderer_GL::SetVertexDataArray(const std::vector<float>& values) {
+    return SetVertexData(values);
 }
 
 void Renderer_GL::SetModelVertexData(uint32_t bufferIndex, const std::vector<uint8_t>& values) {
-    glBindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer[bufferIndex]);
+    // New contents come with new meshes
+    DeleteModelVertexArrays(bufferIndex);
+
+    StateCache_GL::BindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer[bufferIndex]);
     glBufferData(GL_ARRAY_BUFFER, values.size(), values.data(), GL_STATIC_DRAW);
 }
 
 void Renderer_GL::SetModelIndexData(uint32_t bufferIndex, const std::vector<uint32_t>& values) {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelIndexBuffer[bufferIndex]);
+    StateCache_GL::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelIndexBuffer[bufferIndex]);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, values.size() * sizeof(uint32_t), values.data(), GL_STATIC_DRAW);
 }
 
+void Renderer_GL::FlushUniformBlocks(ShaderProgram_GL* shader) {
+    if (shader && shader->blockOwner) {
+        shader = shader->blockOwner.get();
+    }
+    if (!useUniformBuffers || !shader || !shader->HasUniformBlocks()) {
+        return;
+    }
+
+    // A block is re-uploaded when it changed, on the first draw of each frame
+    // (its previous range lives in a segment that will be recycled) and after
+    // the ring was reallocated. Environment data set once per frame is thus
+    // uploaded exactly once per frame.
+    uint32_t generation = uniformStream.GetGeneration();
+    for (auto& block : shader->blocks) {
+        if (block.dirty || block.uploadFrame != frameIndex || block.uploadGeneration != generation) {
+            block.uploadOffset = uniformStream.Append(block.data.data(), block.data.size(), uniformBufferAlignment);
+            block.uploadFrame = frameIndex;
+            block.uploadGeneration = uniformStream.GetGeneration();
+            block.dirty = false;
+        }
+    }
+    if (uniformStream.GetGeneration() != generation) {
+        // The ring grew mid-flush, leaving earlier blocks in the old buffer
+        FlushUniformBlocks(shader);
+        return;
+    }
+
+    for (auto& block : shader->blocks) {
+        auto& bound = boundBlocks[block.binding];
+        if (bound.generation != block.uploadGeneration || bound.offset != block.uploadOffset) {
+            StateCache_GL::BindBufferRange(GL_UNIFORM_BUFFER, block.binding, uniformStream.GetHandle(),
+                              block.uploadOffset, block.data.size());
+            bound.generation = block.uploadGeneration;
+            bound.offset = block.uploadOffset;
+        }
+    }
+}
+
+bool Renderer_GL::StoreBlockUniform(ShaderProgram_GL* shader, const std::string& name, const void* data,
+                                    int elementSize, int count) {
+    if (!shader->HasUniformBlocks()) {
+        return false;
+    }
+    return shader->WriteBlockUniform(InternUniform(name), data, elementSize, count);
+}
+
 void Renderer_GL::RenderQuad() {
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    FlushUniformBlocks(activeSpriteShader);
+    StateCache_GL::Check("RenderQuad");
+    glDrawArrays(GL_TRIANGLE_STRIP, vertexFirst, 4);
 }
 
 void Renderer_GL::RenderQuadBatch(int32_t vertexCount) {
-    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+    FlushUniformBlocks(activeSpriteShader);
+    StateCache_GL::Check("RenderQuadBatch");
+    glDrawArrays(GL_TRIANGLES, vertexFirst, vertexCount);
+}
+
+void Renderer_GL::RenderQuadInstanced(const SpriteInstance* instances, int32_t count) {
+    if (!instances || count <= 0 || !activeSpriteShader) return;
+
+    if (!instancedPipeline) {
+        // One draw per instance; palIndex becomes a constant attribute value
+        static const UniformID modelviewID = InternUniform("modelview");
+        static const UniformID tintID = InternUniform("tint");
+        static const UniformID addID = InternUniform("add");
+        static const UniformID multID = InternUniform("mult");
+        static const UniformID alphaID = InternUniform("alpha");
+
+        int32_t palIndexLoc = activeSpriteShader->GetAttributeLocation("palIndex");
+        if (palIndexLoc >= 0) glDisableVertexAttribArray(palIndexLoc);
+        for (int32_t i = 0; i < count; ++i) {
+            const SpriteInstance& inst = instances[i];
+            SetUniformMatrix(modelviewID, inst.modelview);
+            SetUniformF(tintID, inst.tint, 4);
+            SetUniformF(addID, inst.add, 3);
+            SetUniformF(multID, inst.mult, 3);
+            SetUniformF(alphaID, &inst.alpha, 1);
+            if (palIndexLoc >= 0) glVertexAttrib1f(palIndexLoc, inst.palIndex);
+            RenderQuad();
+        }
+        if (palIndexLoc >= 0) glEnableVertexAttribArray(palIndexLoc);
+        return;
+    }
+
+    // Instance records are re-pointed per call since their offset in the
+    // ring changes; the base quad stays at vertexFirst
+    size_t offset = instanceStream.Append(instances, count * sizeof(SpriteInstance), 4 * sizeof(float));
+    SetupSpriteInstanceAttributes(offset);
+    FlushUniformBlocks(activeSpriteShader);
+    StateCache_GL::Check("RenderQuadInstanced");
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, vertexFirst, 4, count);
 }
 
 void Renderer_GL::RenderElements(PrimitiveMode mode, int count, int offset) {
+    if (!modelShader) return;
+
+    FlushUniformBlocks(modelShader.get());
+    BindModelProgram();
+    StateCache_GL::Check("RenderElements");
     glDrawElementsBaseVertex(MapPrimitiveMode(mode), count, GL_UNSIGNED_INT, 
                              reinterpret_cast<const void*>(static_cast<uintptr_t>(offset)), 0);
 }
 
+void Renderer_GL::RenderElementsMultiDraw(PrimitiveMode mode, const ModelDraw* draws, int32_t count) {
+    if (!modelShader || !draws || count <= 0) return;
+
+    ShaderProgram_GL* program = nullptr;
+    if (useMultiDrawIndirect && modelShader != modelUnlitShader) {
+        program = FindModelPermutation(ModelVertexFeatures(glState) | modelMaterialFeatures | ModelFeatureMultiDraw);
+    }
+    if (!program) {
+        // One draw per primitive with its matrices as uniforms
+        static const UniformID modelID = InternUniform("model");
+        static const UniformID normalMatrixID = InternUniform("normalMatrix");
+        for (int32_t i = 0; i < count; ++i) {
+            mat4x4 model, inverse, normalMatrix;
+            memcpy(model, draws[i].model, sizeof(model));
+            mat4x4_invert(inverse, model);
+            mat4x4_transpose(normalMatrix, inverse);
+            SetModelUniformMatrix(modelID, draws[i].model);
+            SetModelUniformMatrix(normalMatrixID, &normalMatrix[0][0]);
+            RenderElements(mode, draws[i].count, draws[i].offset);
+        }
+        return;
+    }
+
+    // Records first: the commands are smaller, so their append cannot grow
+    // (reallocate) the stream under the records. Each command's
+    // baseInstance selects its record.
+    size_t recordOffset = instanceStream.Append(draws, count * sizeof(ModelDraw), 4 * sizeof(float));
+    indirectCommands.resize(count);
+    for (int32_t i = 0; i < count; ++i) {
+        indirectCommands[i] = {static_cast<uint32_t>(draws[i].count), 1,
+                               static_cast<uint32_t>(draws[i].offset) / 4, 0, static_cast<uint32_t>(i)};
+    }
+    size_t commandOffset = instanceStream.Append(indirectCommands.data(),
+                                                 count * sizeof(DrawElementsIndirectCommand), sizeof(uint32_t));
+
+    FlushUniformBlocks(modelShader.get());
+    UseModelProgram(program);
+    SetupModelDrawAttributes(recordOffset);
+    StateCache_GL::BindBuffer(GL_DRAW_INDIRECT_BUFFER, instanceStream.GetHandle());
+    StateCache_GL::Check("RenderElementsMultiDraw");
+    glMultiDrawElementsIndirect(MapPrimitiveMode(mode), GL_UNSIGNED_INT,
+                                reinterpret_cast<const void*>(commandOffset), count, 0);
+    ReleaseModelDrawAttributes();
+}
+
+// drawModel of the MULTI_DRAW permutation, one record per instance. The
+// mesh vertex arrays are shared with RenderElements, so the attributes are
+// released again after the draw.
+void Renderer_GL::SetupModelDrawAttributes(size_t offset) {
+    StateCache_GL::BindBuffer(GL_ARRAY_BUFFER, instanceStream.GetHandle());
+    for (uint32_t column = 0; column < 4; ++column) {
+        uint32_t loc = ModelLocationDrawModel + column;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, sizeof(ModelDraw),
+                              reinterpret_cast<const void*>(offset + column * 4 * sizeof(float)));
+        glVertexAttribDivisor(loc, 1);
+    }
+}
+
+void Renderer_GL::ReleaseModelDrawAttributes() {
+    for (uint32_t column = 0; column < 4; ++column) {
+        glVertexAttribDivisor(ModelLocationDrawModel + column, 0);
+        glDisableVertexAttribArray(ModelLocationDrawModel + column);
+    }
+}
+
+// Draws with the permutation for the current GLState and material switches;
+// the generic program covers it until it is ready
+void Renderer_GL::BindModelProgram() {
+    ShaderProgram_GL* program = nullptr;
+    if (useModelPermutations && modelShader != modelUnlitShader) {
+        program = FindModelPermutation(ModelVertexFeatures(glState) | modelMaterialFeatures);
+    }
+    UseModelProgram(program ? program : modelShader.get());
+}
+
+// The permutation for key once it has compiled, queueing it on first use
+ShaderProgram_GL* Renderer_GL::FindModelPermutation(uint32_t key) {
+    auto& entry = modelPermutations[key];
+    if (entry.state == ShaderPermutationTable<ShaderProgram_GL>::State::Missing) {
+        QueueModelPermutation(key);
+    }
+    return entry.state == ShaderPermutationTable<ShaderProgram_GL>::State::Ready ? entry.program.get() : nullptr;
+}
+
+void Renderer_GL::UseModelProgram(ShaderProgram_GL* program) {
+    if (program->GetProgram() != boundModelProgram) {
+        StateCache_GL::UseProgram(program->GetProgram());
+        boundModelProgram = program->GetProgram();
+    }
+}
+
+void Renderer_GL::QueueModelPermutation(uint32_t key) {
+    modelPermutations[key].state = ShaderPermutationTable<ShaderProgram_GL>::State::Pending;
+
+    char id[48];
+    snprintf(id, sizeof(id), "Model Shader (permutation %03x)", key);
+    std::shared_ptr<ShaderProgram_GL> base = modelShader;
+    QueueShaderProgram(id, "model.vert.glsl", "model.frag.glsl", "", modelDefines + ModelPermutationDefines(key),
+        [this, key, base](const std::shared_ptr<ShaderProgram_GL>& shader) {
+            shader->ShareUniformBlocks(base);
+            RegisterModelInterface(*shader);
+            modelPermutations[key].program = shader;
+            modelPermutations[key].state = ShaderPermutationTable<ShaderProgram_GL>::State::Ready;
+        });
+}
+
+// Binds the vertex array of one mesh, creating it on first use. Model
+// programs share the fixed ModelVertexLocation locations; shadow arrays use
+// the shadow program's own.
+void Renderer_GL::BindModelVertexArray(uint32_t features, uint32_t numVertices, uint32_t vertAttrOffset, bool shadow) {
+    ModelVertexArrayKey key = {modelBufferIndex, features, numVertices, vertAttrOffset, shadow};
+    auto it = modelVertexArrays.find(key);
+    if (it != modelVertexArrays.end()) {
+        StateCache_GL::BindVertexArray(it->second);
+        return;
+    }
+
+    uint32_t array = 0;
+    glGenVertexArrays(1, &array);
+    StateCache_GL::BindVertexArray(array);
+    StateCache_GL::BindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer[modelBufferIndex]);
+    StateCache_GL::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelIndexBuffer[modelBufferIndex]);
+
+    size_t offset = vertAttrOffset;
+    for (int i = 0; i < ModelVertexAttributeCount; ++i) {
+        const ModelVertexAttribute& attr = ModelVertexAttributes[i];
+        if (!ModelVertexAttributePresent(attr, features)) continue;
+
+        int32_t loc = shadow ? shadowMapShader->GetAttributeLocation(attr.name) : i;
+        if (loc >= 0) {
+            // Integer data is converted, as the shaders declare float inputs
+            glEnableVertexAttribArray(loc);
+            glVertexAttribPointer(loc, attr.components, attr.integer ? GL_INT : GL_FLOAT, GL_FALSE, 0,
+                                  reinterpret_cast<const void*>(offset));
+        }
+        offset += size_t(attr.components) * 4 * numVertices;
+    }
+
+    modelVertexArrays[key] = array;
+}
+
+// bufferIndex < 0 deletes the arrays of both buffers
+void Renderer_GL::DeleteModelVertexArrays(int32_t bufferIndex) {
+    for (auto it = modelVertexArrays.begin(); it != modelVertexArrays.end();) {
+        if (bufferIndex < 0 || it->first.bufferIndex == static_cast<uint32_t>(bufferIndex)) {
+            StateCache_GL::DeleteVertexArrays(1, &it->second);
+            it = modelVertexArrays.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 void Renderer_GL::RenderShadowMapElements(PrimitiveMode mode, int count, int offset) {
-    RenderElements(mode, count, offset);
+    // The shadow program has no uniform blocks, so skip the model flush
+    StateCache_GL::Check("RenderShadowMapElements");
+    glDrawElementsBaseVertex(MapPrimitiveMode(mode), count, GL_UNSIGNED_INT,
+                             reinterpret_cast<const void*>(static_cast<uintptr_t>(offset)), 0);
+}
+
+void Renderer_GL::DrawFullscreenQuad(const ShaderProgram_GL& shader) {
+    int32_t loc = shader.GetAttributeLocation("VertCoord");
+    if (loc < 0) return;
+
+    StateCache_GL::BindVertexArray(postVAO);
+    StateCache_GL::BindBuffer(GL_ARRAY_BUFFER, postVertBuffer);
+    glEnableVertexAttribArray(loc);
+    glVertexAttribPointer(loc, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    StateCache_GL::Check("DrawFullscreenQuad");
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    StateCache_GL::BindVertexArray(vao);
 }
 
 void Renderer_GL::RenderCubeMap(const std::shared_ptr<ITexture>& envTex, const std::shared_ptr<ITexture>& cubeTex) {
     if (!envTex || !cubeTex || !panoramaToCubeMapShader) return;
 
     int32_t textureSize = cubeTex->GetWidth();
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_env);
-    glViewport(0, 0, textureSize, textureSize);
-    glUseProgram(panoramaToCubeMapShader->GetProgram());
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo_env);
+    StateCache_GL::Viewport(0, 0, textureSize, textureSize);
+    StateCache_GL::Disable(GL_BLEND);
+    StateCache_GL::UseProgram(panoramaToCubeMapShader->GetProgram());
+
+    int32_t unit = panoramaToCubeMapShader->GetTextureUnit("panorama");
+    StateCache_GL::ActiveTexture(GL_TEXTURE0 + unit);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, envTex->GetHandle());
+    glUniform1i(panoramaToCubeMapShader->GetUniformLocation("panorama"), unit);
 
     for (int i = 0; i < 6; ++i) {
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubeTex->GetHandle(), 0);
@@ -1059,25 +3099,47 @@ void Renderer_GL::RenderCubeMap(const std::shared_ptr<ITexture>& envTex, const s
         int32_t loc = panoramaToCubeMapShader->GetUniformLocation("currentFace");
         glUniform1i(loc, i);
 
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        DrawFullscreenQuad(*panoramaToCubeMapShader);
     }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTex->GetHandle());
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GL::BindTexture(GL_TEXTURE_CUBE_MAP, cubeTex->GetHandle());
     glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 }
 
 void Renderer_GL::RenderFilteredCubeMap(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
                                        const std::shared_ptr<ITexture>& filteredTex,
                                        int32_t mipmapLevel, int32_t sampleCount, float roughness) {
+    if (!filteredTex) return;
+
+    int32_t currentTextureSize = std::max(filteredTex->GetWidth() >> mipmapLevel, 1);
+    for (int32_t face = 0; face < 6; ++face) {
+        RenderFilteredCubeMapRows(distribution, cubeTex, filteredTex, mipmapLevel, face,
+                                  0, currentTextureSize, sampleCount, roughness);
+    }
+}
+
+void Renderer_GL::RenderFilteredCubeMapRows(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                                           const std::shared_ptr<ITexture>& filteredTex, int32_t mipmapLevel,
+                                           int32_t face, int32_t firstRow, int32_t rowCount,
+                                           int32_t sampleCount, float roughness) {
     if (!cubeTex || !filteredTex || !cubemapFilteringShader) return;
 
     int32_t textureSize = filteredTex->GetWidth();
-    int32_t currentTextureSize = textureSize >> mipmapLevel;
+    int32_t currentTextureSize = std::max(textureSize >> mipmapLevel, 1);
+
+    // Runs mid-frame when a bake is spread over frames (Environment::Update)
+    int32_t frameViewport[4];
+    StateCache_GL::GetViewport(frameViewport);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo_env);
+    StateCache_GL::Viewport(0, 0, currentTextureSize, currentTextureSize);
+    StateCache_GL::Disable(GL_BLEND);
+    StateCache_GL::UseProgram(cubemapFilteringShader->GetProgram());
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_env);
-    glViewport(0, 0, currentTextureSize, currentTextureSize);
-    glUseProgram(cubemapFilteringShader->GetProgram());
+    int32_t unit = cubemapFilteringShader->GetTextureUnit("cubeMap");
+    StateCache_GL::ActiveTexture(GL_TEXTURE0 + unit);
+    StateCache_GL::BindTexture(GL_TEXTURE_CUBE_MAP, cubeTex->GetHandle());
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("cubeMap"), unit);
 
     int32_t loc = cubemapFilteringShader->GetUniformLocation("sampleCount");
     glUniform1i(loc, sampleCount);
@@ -1085,65 +3147,268 @@ void Renderer_GL::RenderFilteredCubeMap(int32_t distribution, const std::shared_
     loc = cubemapFilteringShader->GetUniformLocation("distribution");
     glUniform1i(loc, distribution);
 
+    // Texel solid angle of the source, which picks the sampled mip level
     loc = cubemapFilteringShader->GetUniformLocation("width");
-    glUniform1i(loc, textureSize);
+    glUniform1i(loc, cubeTex->GetWidth());
 
     loc = cubemapFilteringShader->GetUniformLocation("roughness");
     glUniform1f(loc, roughness);
 
-    for (int i = 0; i < 6; ++i) {
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 
-                              filteredTex->GetHandle(), mipmapLevel);
-        glClear(GL_COLOR_BUFFER_BIT);
+    loc = cubemapFilteringShader->GetUniformLocation("intensityScale");
+    glUniform1f(loc, 1.0f);
+
+    loc = cubemapFilteringShader->GetUniformLocation("isLUT");
+    glUniform1i(loc, 0);
+
+    loc = cubemapFilteringShader->GetUniformLocation("currentFace");
+    glUniform1i(loc, face);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+                          filteredTex->GetHandle(), mipmapLevel);
+    DrawEnvironmentRows(*cubemapFilteringShader, currentTextureSize, firstRow, rowCount);
+
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GL::Viewport(frameViewport[0], frameViewport[1], frameViewport[2], frameViewport[3]);
+}
+
+void Renderer_GL::RenderLUT(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                           const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount) {
+    if (!lutTex) return;
+    RenderLUTRows(distribution, cubeTex, lutTex, sampleCount, 0, lutTex->GetHeight());
+}
+
+void Renderer_GL::RenderLUTRows(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                               const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount,
+                               int32_t firstRow, int32_t rowCount) {
+    if (!cubeTex || !lutTex || !cubemapFilteringShader) return;
+
+    int32_t textureSize = lutTex->GetWidth();
+    int32_t frameViewport[4];
+    StateCache_GL::GetViewport(frameViewport);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo_env);
+    StateCache_GL::Viewport(0, 0, textureSize, textureSize);
+    StateCache_GL::Disable(GL_BLEND);
+    StateCache_GL::UseProgram(cubemapFilteringShader->GetProgram());
+
+    int32_t loc = cubemapFilteringShader->GetUniformLocation("sampleCount");
+    glUniform1i(loc, sampleCount);
+
+    loc = cubemapFilteringShader->GetUniformLocation("distribution");
+    glUniform1i(loc, distribution);
+
+    loc = cubemapFilteringShader->GetUniformLocation("width");
+    glUniform1i(loc, textureSize);
+
+    loc = cubemapFilteringShader->GetUniformLocation("roughness");
+    glUniform1f(loc, 0);
+
+    loc = cubemapFilteringShader->GetUniformLocation("currentFace");
+    glUniform1i(loc, 0);
+
+    loc = cubemapFilteringShader->GetUniformLocation("isLUT");
+    glUniform1i(loc, 1);
+
+    // No-op for a texture from newLUTTexture
+    static_cast<Texture_GL*>(lutTex.get())->Allocate(GL_TEXTURE_2D,
+        iblPrecision == IBLPrecision::Half ? GL_RG16F : GL_RGBA32F, 1);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lutTex->GetHandle(), 0);
+    DrawEnvironmentRows(*cubemapFilteringShader, textureSize, firstRow, rowCount);
+
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GL::Viewport(frameViewport[0], frameViewport[1], frameViewport[2], frameViewport[3]);
+}
+
+// Fills rows [firstRow, firstRow + rowCount) of the square fbo_env
+// attachment, scissoring off the rest
+void Renderer_GL::DrawEnvironmentRows(const ShaderProgram_GL& shader, int32_t size, int32_t firstRow, int32_t rowCount) {
+    firstRow = std::max(firstRow, 0);
+    rowCount = std::min(rowCount, size - firstRow);
+    if (rowCount <= 0) return;
+
+    bool partial = firstRow > 0 || rowCount < size;
+    if (partial) {
+        StateCache_GL::Enable(GL_SCISSOR_TEST);
+        StateCache_GL::Scissor(0, firstRow, size, rowCount);
+    }
+    glClear(GL_COLOR_BUFFER_BIT);
+    DrawFullscreenQuad(shader);
+    if (partial) {
+        StateCache_GL::Disable(GL_SCISSOR_TEST);
+    }
+}
+
+// ==========================================
+// State Cache
+// ==========================================
+
+void Renderer_GL::InvalidateState() {
+    StateCache_GL::Invalidate();
+}
+
+void Renderer_GL::SetStateValidation(bool enabled) {
+    StateCache_GL::SetValidation(enabled);
+}
+
+StateCacheStats Renderer_GL::GetStateCacheStats() const {
+    return StateCache_GL::GetStats();
+}
+
+void Renderer_GL::ResetStateCacheStats() {
+    StateCache_GL::ResetStats();
+}
+
+// ==========================================
+// GPU Timer Queries
+// ==========================================
+
+uint32_t Renderer_GL::BeginGPUTimer() {
+    if (!GLAD_GL_VERSION_3_3) return 0;
+
+    if (freeTimerQueries.empty()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        timerQueries.push_back(query);
+        freeTimerQueries.push_back(query);
+    }
+    GLuint query = freeTimerQueries.back();
+    freeTimerQueries.pop_back();
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    return query;
+}
+
+void Renderer_GL::EndGPUTimer() {
+    if (!GLAD_GL_VERSION_3_3) return;
+    glEndQuery(GL_TIME_ELAPSED);
+}
 
-        loc = cubemapFilteringShader->GetUniformLocation("currentFace");
-        glUniform1i(loc, i);
+bool Renderer_GL::ReadGPUTimer(uint32_t query, uint64_t& nanoseconds) {
+    if (query == 0) return false;
 
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    }
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+    nanoseconds = elapsed;
+    freeTimerQueries.push_back(query);
+    return true;
 }
 
-void Renderer_GL::RenderLUT(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
-                           const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount) {
-    if (!cubeTex || !lutTex || !cubemapFilteringShader) return;
+// ==========================================
+// GPU Profiling
+// ==========================================
 
-    int32_t textureSize = lutTex->GetWidth();
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_env);
-    glViewport(0, 0, textureSize, textureSize);
-    glUseProgram(cubemapFilteringShader->GetProgram());
+static const char* const ProfilePassNames[] = {"Shadows", "Models", "Sprites"};
+const uint32_t Renderer_GL::NoProfileRegion;
 
-    int32_t loc = cubemapFilteringShader->GetUniformLocation("sampleCount");
-    glUniform1i(loc, sampleCount);
+void Renderer_GL::BeginGPUProfileFrame() {
+    // Regions left open by a frame without EndFrame are never closed
+    profileStack.clear();
+    for (bool& open : profilePassOpen) {
+        open = false;
+    }
 
-    loc = cubemapFilteringShader->GetUniformLocation("distribution");
-    glUniform1i(loc, distribution);
+    // Timestamps complete in submission order, so a frame is done once its
+    // last query is. Slots are visited oldest first, starting with the one
+    // this frame is about to reuse.
+    for (int i = 0; i < ProfileFrameCount; ++i) {
+        ProfileFrame& slot = profileFrames[(frameIndex + i) % ProfileFrameCount];
+        if (!slot.pending) continue;
+        if (slot.used > 0) {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(slot.queries[slot.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) break;
+
+            std::vector<GLuint64> stamps(slot.used);
+            for (uint32_t q = 0; q < slot.used; ++q) {
+                glGetQueryObjectui64v(slot.queries[q], GL_QUERY_RESULT, &stamps[q]);
+            }
+            std::vector<GPUProfileSpan> spans;
+            spans.reserve(slot.regions.size());
+            for (const ProfileRegion& region : slot.regions) {
+                if (region.end == NoProfileRegion) continue;
+                spans.push_back(GPUProfileSpan{region.name, region.depth, stamps[region.begin], stamps[region.end]});
+            }
+            gpuProfiler.AddFrame(slot.frame, spans);
+        }
+        slot.pending = false;
+    }
 
-    loc = cubemapFilteringShader->GetUniformLocation("width");
-    glUniform1i(loc, textureSize);
+    // glQueryCounter is GL 3.3
+    if (!gpuProfiling || !GLAD_GL_VERSION_3_3) return;
 
-    loc = cubemapFilteringShader->GetUniformLocation("roughness");
-    glUniform1f(loc, 0);
+    ProfileFrame& slot = profileFrames[frameIndex % ProfileFrameCount];
+    if (slot.pending) {
+        // Still running ProfileFrameCount frames later; its queries are reissued
+        gpuProfiler.DropFrame();
+    }
+    slot.regions.clear();
+    slot.used = 0;
+    slot.frame = frameIndex;
+    slot.pending = true;
+    BeginGPURegion("Frame");
+}
 
-    loc = cubemapFilteringShader->GetUniformLocation("currentFace");
-    glUniform1i(loc, 0);
+void Renderer_GL::EndGPUProfileFrame() {
+    while (!profileStack.empty()) {
+        EndGPURegion();
+    }
+    for (bool& open : profilePassOpen) {
+        open = false;
+    }
+}
 
-    loc = cubemapFilteringShader->GetUniformLocation("isLUT");
-    glUniform1i(loc, 1);
+uint32_t Renderer_GL::IssueTimestamp(ProfileFrame& slot) {
+    if (slot.used == slot.queries.size()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        slot.queries.push_back(query);
+    }
+    glQueryCounter(slot.queries[slot.used], GL_TIMESTAMP);
+    return slot.used++;
+}
 
-    glBindTexture(GL_TEXTURE_2D, lutTex->GetHandle());
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, lutTex->GetWidth(), lutTex->GetHeight(), 0, GL_RGBA, GL_FLOAT, nullptr);
+void Renderer_GL::BeginGPURegion(const char* name) {
+    // Untimed regions still take a stack entry so EndGPURegion stays paired
+    ProfileFrame& slot = profileFrames[frameIndex % ProfileFrameCount];
+    if (!gpuProfiling || !slot.pending || slot.frame != frameIndex) {
+        profileStack.push_back(NoProfileRegion);
+        return;
+    }
+    int32_t depth = static_cast<int32_t>(profileStack.size());
+    slot.regions.push_back(ProfileRegion{name, depth, IssueTimestamp(slot), NoProfileRegion});
+    profileStack.push_back(static_cast<uint32_t>(slot.regions.size() - 1));
+}
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lutTex->GetHandle(), 0);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+void Renderer_GL::EndGPURegion() {
+    if (profileStack.empty()) return;
 
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    uint32_t index = profileStack.back();
+    profileStack.pop_back();
+    if (index == NoProfileRegion) return;
+
+    ProfileFrame& slot = profileFrames[frameIndex % ProfileFrameCount];
+    slot.regions[index].end = IssueTimestamp(slot);
+}
+
+void Renderer_GL::BeginPassRegion(ProfilePass pass) {
+    // The sprite batcher sets the pipeline again for every blend change
+    // before a single release, so a pass is one region until released
+    if (profilePassOpen[pass]) return;
+    BeginGPURegion(ProfilePassNames[pass]);
+    profilePassOpen[pass] = true;
+}
+
+void Renderer_GL::EndPassRegion(ProfilePass pass) {
+    if (!profilePassOpen[pass]) return;
+    EndGPURegion();
+    profilePassOpen[pass] = false;
 }
 
 void Renderer_GL::ReadPixels(std::vector<uint8_t>& data, int width, int height) {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    StateCache_GL::BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
     if (data.size() < static_cast<size_t>(width * height * 4)) {
         data.resize(width * height * 4);
     }
@@ -1175,22 +3440,129 @@ void Renderer_GL::SetVSync() {
 
 std::shared_ptr<ShaderProgram_GL> Renderer_GL::newShaderProgram(const std::string& vert, const std::string& frag,
                                                                const std::string& geo, const std::string& id,
-                                                               bool crashWhenFail) {
-    auto shader = std::make_shared<ShaderProgram_GL>();
+                                                               bool crashWhenFail, const std::string& defines) {
+    shaderStats.programs++;
+
+    std::vector<std::string> sources = PrepareShaderSources(vert, frag, geo, defines);
+    uint64_t key = binaryCache.MakeKey(sources);
+    auto shader = FindCachedProgram(key);
+    if (shader) {
+        return shader;
+    }
+
+    std::vector<uint32_t> shaders;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        uint32_t compiled = compileShader(ShaderStages[i], sources[i]);
+        if (compiled == 0) {
+            for (uint32_t other : shaders) {
+                glDeleteShader(other);
+            }
+            if (crashWhenFail) {
+                std::cerr << "Failed to compile shader program: " << id << std::endl;
+            }
+            return nullptr;
+        }
+        shaders.push_back(compiled);
+    }
+
+    uint32_t program = linkProgram(shaders);
+    if (program == 0) {
+        if (crashWhenFail) {
+            std::cerr << "Failed to link shader program: " << id << std::endl;
+        }
+        return nullptr;
+    }
+    shaderStats.compiled++;
+    StoreProgramBinary(key, program);
+
+    shader = std::make_shared<ShaderProgram_GL>();
+    shader->program = program;
+    programCache[key] = shader;
+    return shader;
+}
+
+std::shared_ptr<ShaderProgram_GL> Renderer_GL::LoadShaderProgram(const std::string& id, const std::string& vertFile,
+                                                                const std::string& fragFile, const std::string& geoFile,
+                                                                const std::string& defines) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::string vert = LoadShaderSource(shaderDirectory, vertFile);
+    std::string frag = LoadShaderSource(shaderDirectory, fragFile);
+    std::string geo = geoFile.empty() ? "" : LoadShaderSource(shaderDirectory, geoFile);
+    std::shared_ptr<ShaderProgram_GL> shader;
+    if (!vert.empty() && !frag.empty() && (geoFile.empty() || !geo.empty())) {
+        shader = newShaderProgram(vert, frag, geo, id, true, defines);
+    }
+
+    shaderStats.milliseconds += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return shader;
+}
+
+std::string Renderer_GL::PrepareShaderSource(const std::string& src, const std::string& defines) const {
+    // The shared sources carry no #version; GL targets the 3.3 core dialect
+    std::string versioned = src.compare(0, 8, "#version") == 0 ? src : "#version 330 core\n" + src;
+    return InsertAfterVersion(versioned, shaderDefines + defines);
+}
+
+std::vector<std::string> Renderer_GL::PrepareShaderSources(const std::string& vert, const std::string& frag,
+                                                           const std::string& geo, const std::string& defines) const {
+    std::vector<std::string> sources;
+    sources.push_back(PrepareShaderSource(vert, defines));
+    sources.push_back(PrepareShaderSource(frag, defines));
+    if (!geo.empty()) {
+        sources.push_back(PrepareShaderSource(geo, defines));
+    }
+    return sources;
+}
 
-    // This is a simplified version. A full implementation would compile and link shaders
-    // including error checking and logging.
+std::shared_ptr<ShaderProgram_GL> Renderer_GL::FindCachedProgram(uint64_t key) {
+    // Identical variants share one program
+    auto cached = programCache.find(key);
+    if (cached != programCache.end()) {
+        shaderStats.memoryHits++;
+        return cached->second;
+    }
 
+    uint32_t program = LoadProgramBinary(key);
+    if (program == 0) {
+        return nullptr;
+    }
+    auto shader = std::make_shared<ShaderProgram_GL>();
+    shader->program = program;
+    programCache[key] = shader;
     return shader;
 }
 
 uint32_t Renderer_GL::compileShader(uint32_t shaderType, const std::string& src) {
+    uint32_t shader = beginCompileShader(shaderType, src);
+    if (!finishCompileShader(shader)) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+uint32_t Renderer_GL::linkProgram(const std::vector<uint32_t>& shaders) {
+    uint32_t program = beginLinkProgram(shaders);
+    if (!finishLinkProgram(program)) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+uint32_t Renderer_GL::beginCompileShader(uint32_t shaderType, const std::string& src) {
     uint32_t shader = glCreateShader(shaderType);
-    std::string versioned = "#version 330 core\n" + src;
-    const char* srcPtr = versioned.c_str();
+    const char* srcPtr = src.c_str();
     glShaderSource(shader, 1, &srcPtr, nullptr);
     glCompileShader(shader);
+    return shader;
+}
 
+// Blocks until the driver is done with the shader unless
+// GL_COMPLETION_STATUS_KHR already reported it complete
+bool Renderer_GL::finishCompileShader(uint32_t shader) {
     int32_t ok;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
     if (ok == 0) {
@@ -1201,26 +3573,39 @@ uint32_t Renderer_GL::compileShader(uint32_t shaderType, const std::string& src)
             glGetShaderInfoLog(shader, size, &len, errorLog.data());
             std::cerr << "Shader compilation error: " << errorLog.data() << std::endl;
         }
-        glDeleteShader(shader);
-        return 0;
+        return false;
     }
-
-    return shader;
+    return true;
 }
 
-uint32_t Renderer_GL::linkProgram(const std::vector<uint32_t>& shaders) {
+uint32_t Renderer_GL::beginLinkProgram(const std::vector<uint32_t>& shaders) {
     uint32_t program = glCreateProgram();
 
     for (uint32_t shader : shaders) {
         glAttachShader(program, shader);
     }
 
+    // Model programs share vertex arrays through fixed input locations. The
+    // names are simply unused by other programs, and explicit layout
+    // qualifiers take precedence.
+    for (int i = 0; i < ModelVertexAttributeCount; ++i) {
+        glBindAttribLocation(program, i, ModelVertexAttributes[i].name);
+    }
+    glBindAttribLocation(program, ModelLocationDrawModel, "drawModel");
+
+    if (binaryCache.IsEnabled()) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(program);
 
+    // Flagged only; the driver keeps them while attached
     for (uint32_t shader : shaders) {
         glDeleteShader(shader);
     }
+    return program;
+}
 
+bool Renderer_GL::finishLinkProgram(uint32_t program) {
     int32_t ok;
     glGetProgramiv(program, GL_LINK_STATUS, &ok);
     if (ok == 0) {
@@ -1231,13 +3616,211 @@ uint32_t Renderer_GL::linkProgram(const std::vector<uint32_t>& shaders) {
             glGetProgramInfoLog(program, size, &len, errorLog.data());
             std::cerr << "Program linking error: " << errorLog.data() << std::endl;
         }
+        return false;
+    }
+    return true;
+}
+
+// ===== Asynchronous Shader Compilation =====
+
+void Renderer_GL::InitParallelShaderCompile() {
+    // The ARB extension shares the enums; only the entry point name differs
+    const char* maxThreadsName = nullptr;
+    if (IsGLExtensionSupported("GL_KHR_parallel_shader_compile")) {
+        maxThreadsName = "glMaxShaderCompilerThreadsKHR";
+    } else if (IsGLExtensionSupported("GL_ARB_parallel_shader_compile")) {
+        maxThreadsName = "glMaxShaderCompilerThreadsARB";
+    }
+    parallelShaderCompile = maxThreadsName != nullptr;
+    if (!parallelShaderCompile || !procLoader) {
+        return;
+    }
+
+    // 0xFFFFFFFF lets the driver pick the thread count
+    typedef void (GLAD_API_PTR *MaxShaderCompilerThreadsProc)(GLuint count);
+    auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(procLoader(maxThreadsName));
+    if (maxThreads) {
+        maxThreads(0xFFFFFFFFu);
+    }
+}
+
+bool Renderer_GL::QueueShaderProgram(const std::string& id, const std::string& vertFile,
+                                     const std::string& fragFile, const std::string& geoFile,
+                                     const std::string& defines,
+                                     std::function<void(const std::shared_ptr<ShaderProgram_GL>&)> onReady) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::string vert = LoadShaderSource(shaderDirectory, vertFile);
+    std::string frag = LoadShaderSource(shaderDirectory, fragFile);
+    std::string geo = geoFile.empty() ? "" : LoadShaderSource(shaderDirectory, geoFile);
+    if (vert.empty() || frag.empty() || (!geoFile.empty() && geo.empty())) {
+        return false;
+    }
+    shaderStats.programs++;
+
+    std::vector<std::string> sources = PrepareShaderSources(vert, frag, geo, defines);
+    uint64_t key = binaryCache.MakeKey(sources);
+    auto shader = FindCachedProgram(key);
+    if (shader) {
+        onReady(shader);
+    } else {
+        ShaderJob job;
+        job.id = id;
+        job.key = key;
+        job.program = 0;
+        job.onReady = std::move(onReady);
+        for (size_t i = 0; i < sources.size(); ++i) {
+            job.shaders.push_back(beginCompileShader(ShaderStages[i], sources[i]));
+        }
+        shaderJobs.push_back(std::move(job));
+    }
+
+    shaderStats.milliseconds += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+// Returns true once the job is finished, successfully or not. Without wait
+// it never blocks when completion can be polled.
+bool Renderer_GL::AdvanceShaderJob(ShaderJob& job, bool wait) {
+    bool poll = !wait && parallelShaderCompile;
+
+    if (job.program == 0) {
+        if (poll) {
+            for (uint32_t shader : job.shaders) {
+                int32_t done = GL_FALSE;
+                glGetShaderiv(shader, GL_COMPLETION_STATUS_KHR, &done);
+                if (done == GL_FALSE) {
+                    return false;
+                }
+            }
+        }
+
+        bool compiled = true;
+        for (uint32_t shader : job.shaders) {
+            compiled = finishCompileShader(shader) && compiled;
+        }
+        if (!compiled) {
+            for (uint32_t shader : job.shaders) {
+                glDeleteShader(shader);
+            }
+            job.shaders.clear();
+            std::cerr << "Failed to compile shader program: " << job.id << std::endl;
+            return true;
+        }
+
+        job.program = beginLinkProgram(job.shaders);
+        job.shaders.clear();
+        if (!wait) {
+            return false;
+        }
+    }
+
+    if (poll) {
+        int32_t done = GL_FALSE;
+        glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &done);
+        if (done == GL_FALSE) {
+            return false;
+        }
+    }
+
+    uint32_t program = job.program;
+    job.program = 0;
+    if (!finishLinkProgram(program)) {
+        glDeleteProgram(program);
+        std::cerr << "Failed to link shader program: " << job.id << std::endl;
+        return true;
+    }
+    shaderStats.compiled++;
+    StoreProgramBinary(job.key, program);
+
+    auto shader = std::make_shared<ShaderProgram_GL>();
+    shader->program = program;
+    programCache[job.key] = shader;
+    job.onReady(shader);
+    return true;
+}
+
+void Renderer_GL::PollShaderJobs() {
+    if (shaderJobs.empty()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // onReady callbacks only swap programs, so the vector is stable here
+    for (auto it = shaderJobs.begin(); it != shaderJobs.end();) {
+        it = AdvanceShaderJob(*it, false) ? shaderJobs.erase(it) : it + 1;
+        if (!parallelShaderCompile) {
+            break;
+        }
+    }
+
+    shaderStats.milliseconds += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    if (shaderJobs.empty()) {
+        shaderStats.Print("Shaders");
+    }
+}
+
+void Renderer_GL::FinishShaderJobs() {
+    if (shaderJobs.empty()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto& job : shaderJobs) {
+        AdvanceShaderJob(job, true);
+    }
+    shaderJobs.clear();
+
+    shaderStats.milliseconds += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    shaderStats.Print("Shaders");
+}
+
+uint32_t Renderer_GL::LoadProgramBinary(uint64_t key) {
+    uint32_t format;
+    std::vector<uint8_t> binary;
+    if (!binaryCache.Load(key, format, binary)) {
+        return 0;
+    }
+
+    uint32_t program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    int32_t ok = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (ok == 0) {
+        // Drivers may refuse binaries from an older build; recompile and
+        // replace the entry. Drops GL_INVALID_ENUM for a retired format.
+        glGetError();
         glDeleteProgram(program);
+        binaryCache.Evict(key);
+        shaderStats.binaryRejects++;
         return 0;
     }
 
+    shaderStats.binaryHits++;
     return program;
 }
 
+void Renderer_GL::StoreProgramBinary(uint64_t key, uint32_t program) {
+    if (!binaryCache.IsEnabled()) {
+        return;
+    }
+
+    int32_t length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<uint8_t> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+    binaryCache.Store(key, format, binary);
+}
+
 uint32_t Renderer_GL::MapBlendEquation(BlendEquation eq) const {
     static const std::map<BlendEquation, uint32_t> BlendEquationLUT = {
         {BlendEquation::Add, GL_FUNC_ADD},
@@ -1280,7 +3863,7 @@ bool Renderer_GL::InitFramebuffer(uint32_t& fbo, uint32_t& texture, uint32_t& rb
                                   int32_t width, int32_t height, bool useMultisample) {
     // Generate texture
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, texture);
     
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -1288,8 +3871,7 @@ bool Renderer_GL::InitFramebuffer(uint32_t& fbo, uint32_t& texture, uint32_t& rb
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     
     // Allocate texture storage
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, 
-                GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    AllocateTextureStorage(GL_TEXTURE_2D, GL_RGBA8, 1, width, height);
     
     // Generate depth renderbuffer
     glGenRenderbuffers(1, &rbo);
@@ -1304,7 +3886,7 @@ bool Renderer_GL::InitFramebuffer(uint32_t& fbo, uint32_t& texture, uint32_t& rb
     
     // Generate and configure framebuffer
     glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                           GL_TEXTURE_2D, texture, 0);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
@@ -1314,114 +3896,212 @@ bool Renderer_GL::InitFramebuffer(uint32_t& fbo, uint32_t& texture, uint32_t& rb
     GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
     if (status != GL_FRAMEBUFFER_COMPLETE) {
         std::cerr << "Framebuffer incomplete: " << std::hex << status << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, 0);
+        StateCache_GL::BindTexture(GL_TEXTURE_2D, 0);
         glBindRenderbuffer(GL_RENDERBUFFER, 0);
         return false;
     }
     
     // Unbind
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, 0);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
     
     return true;
 }
 
+bool Renderer_GL::InitMultisampleFramebuffer(uint32_t& fbo, uint32_t& color, uint32_t& depth,
+                                             int32_t width, int32_t height, int32_t samples) {
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Multisample framebuffer incomplete: " << std::hex << status << std::dec << std::endl;
+        StateCache_GL::DeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+        fbo = color = depth = 0;
+        return false;
+    }
+    return true;
+}
+
 bool Renderer_GL::InitShadowFramebuffer() {
     if (!enableShadow) return true;
-    
-    // Generate shadow framebuffer
-    glGenFramebuffers(1, &fbo_shadow);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_shadow);
-    
-    // Generate cube map texture for point light shadows
-    glGenTextures(1, &fbo_shadow_cube_texture);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, fbo_shadow_cube_texture);
-    
-    // Allocate storage for all 6 faces
-    const int32_t shadowMapSize = 1024; // Default shadow map resolution
-    for (int i = 0; i < 6; i++) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT24,
-                    shadowMapSize, shadowMapSize, 0,
-                    GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (shadowAtlasSize > maxTextureSize) {
+        std::cerr << "Shadow atlas of " << shadowAtlasSize << " texels exceeds the maximum texture size, using "
+                  << maxTextureSize << std::endl;
+        shadowAtlasSize = maxTextureSize;
     }
-    
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    
-    // Attach first face as depth attachment
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                          GL_TEXTURE_CUBE_MAP_POSITIVE_X, fbo_shadow_cube_texture, 0);
-    
-    // Check framebuffer completeness
+
+    if (fbo_shadow == 0) {
+        glGenFramebuffers(1, &fbo_shadow);
+    }
+    if (fbo_shadow_texture != 0) {
+        StateCache_GL::DeleteTextures(1, &fbo_shadow_texture);
+    }
+
+    // One depth texture for every light (ShadowAtlas.h); point and spot
+    // lights store linear distance, so 24 bits
+    glGenTextures(1, &fbo_shadow_texture);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, fbo_shadow_texture);
+    AllocateTextureStorage(GL_TEXTURE_2D, GL_DEPTH_COMPONENT24, 1, shadowAtlasSize, shadowAtlasSize);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Depth only
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo_shadow);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, fbo_shadow_texture, 0);
+    GLenum none = GL_NONE;
+    glDrawBuffers(1, &none);
+    glReadBuffer(GL_NONE);
+
     GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, 0);
     if (status != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Shadow framebuffer incomplete: " << std::hex << status << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        std::cerr << "Shadow framebuffer incomplete: " << std::hex << status << std::dec << std::endl;
+        StateCache_GL::DeleteFramebuffers(1, &fbo_shadow);
+        StateCache_GL::DeleteTextures(1, &fbo_shadow_texture);
+        fbo_shadow = fbo_shadow_texture = 0;
         return false;
     }
-    
-    // Unbind
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-    
+
+    // Tiles start out cleared
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo_shadow);
+    StateCache_GL::Disable(GL_SCISSOR_TEST);
+    StateCache_GL::DepthMask(true);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, 0);
     return true;
 }
 
-bool Renderer_GL::InitPostProcessingFramebuffers() {
-    // Create 2 post-processing framebuffers for ping-pong rendering
-    fbo_pp.resize(2);
-    fbo_pp_texture.resize(2);
-    
-    for (int i = 0; i < 2; i++) {
-        // Generate texture
-        glGenTextures(1, &fbo_pp_texture[i]);
-        glBindTexture(GL_TEXTURE_2D, fbo_pp_texture[i]);
-        
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        
-        // Use RGBA32F for HDR post-processing
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, viewport.width, viewport.height,
-                    0, GL_RGBA, GL_FLOAT, nullptr);
-        
-        // Generate framebuffer
-        glGenFramebuffers(1, &fbo_pp[i]);
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo_pp[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                              GL_TEXTURE_2D, fbo_pp_texture[i], 0);
-        
-        // Check framebuffer completeness
-        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-        if (status != GL_FRAMEBUFFER_COMPLETE) {
-            std::cerr << "Post-processing framebuffer " << i << " incomplete: "
-                     << std::hex << status << std::endl;
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            glBindTexture(GL_TEXTURE_2D, 0);
+bool Renderer_GL::CreateRenderTargets() {
+    if (!InitFramebuffer(fbo, fbo_texture, rbo_depth, viewport.width, viewport.height, false)) {
+        return false;
+    }
+
+    // Scenes draw into the multisampled target; ResolveSceneTarget blits it
+    // into fbo_texture
+    if (msaaLevel > 1) {
+        GLint maxSamples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        msaaLevel = std::min(msaaLevel, static_cast<int>(maxSamples));
+        if (msaaLevel < 2 || !InitMultisampleFramebuffer(fbo_f, rbo_f_color, rbo_f_depth, viewport.width,
+                                                         viewport.height, msaaLevel)) {
+            std::cerr << "MSAA unavailable, rendering without it" << std::endl;
+            msaaLevel = 0;
+        }
+    }
+
+    // Post-processing FBOs; RunPostPasses sizes them for the chain
+    fbo_pp.assign(2, 0);
+    fbo_pp_texture.assign(2, 0);
+    for (int32_t i = 0; i < 2; ++i) {
+        if (!CreatePostTarget(i, viewport.width, viewport.height)) {
             return false;
         }
     }
-    
-    // Unbind
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
     return true;
 }
 
+bool Renderer_GL::CreatePostTarget(int32_t index, int32_t width, int32_t height) {
+    if (fbo_pp[index] != 0 && postTargetSize[index][0] == width && postTargetSize[index][1] == height) {
+        return true;
+    }
+
+    // Storage is immutable, so a resized target is a new texture
+    if (fbo_pp_texture[index] != 0) StateCache_GL::DeleteTextures(1, &fbo_pp_texture[index]);
+    glGenTextures(1, &fbo_pp_texture[index]);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, fbo_pp_texture[index]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    AllocateTextureStorage(GL_TEXTURE_2D, GL_RGBA8, 1, width, height);
+    postTargetSize[index][0] = width;
+    postTargetSize[index][1] = height;
+
+    if (fbo_pp[index] == 0) glGenFramebuffers(1, &fbo_pp[index]);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, fbo_pp[index]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbo_pp_texture[index], 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    StateCache_GL::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache_GL::BindTexture(GL_TEXTURE_2D, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Post-processing framebuffer " << index << " incomplete: " << std::hex << status
+                  << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Renderer_GL::DestroyRenderTargets() {
+    if (fbo != 0) StateCache_GL::DeleteFramebuffers(1, &fbo);
+    if (fbo_texture != 0) StateCache_GL::DeleteTextures(1, &fbo_texture);
+    if (rbo_depth != 0) glDeleteRenderbuffers(1, &rbo_depth);
+    fbo = fbo_texture = rbo_depth = 0;
+
+    if (fbo_f != 0) StateCache_GL::DeleteFramebuffers(1, &fbo_f);
+    if (rbo_f_color != 0) glDeleteRenderbuffers(1, &rbo_f_color);
+    if (rbo_f_depth != 0) glDeleteRenderbuffers(1, &rbo_f_depth);
+    fbo_f = rbo_f_color = rbo_f_depth = 0;
+
+    for (auto tex : fbo_pp_texture) {
+        if (tex != 0) StateCache_GL::DeleteTextures(1, &tex);
+    }
+    for (auto buf : fbo_pp) {
+        if (buf != 0) StateCache_GL::DeleteFramebuffers(1, &buf);
+    }
+    fbo_pp_texture.clear();
+    fbo_pp.clear();
+    for (auto& size : postTargetSize) {
+        size[0] = size[1] = 0;
+    }
+}
+
+// Recreates the targets when the output size or render scale changes
+// their size. Before Init only the size is recorded.
+void Renderer_GL::UpdateRenderTargets() {
+    int32_t width = GetRenderWidth();
+    int32_t height = GetRenderHeight();
+    if (fbo == 0) {
+        viewport = {0, 0, width, height};
+        return;
+    }
+    if (width == viewport.width && height == viewport.height) return;
+
+    DestroyRenderTargets();
+    viewport = {0, 0, width, height};
+    if (!CreateRenderTargets()) {
+        std::cerr << "Failed to resize render targets to " << width << "x" << height << std::endl;
+    }
+}
+
 void Renderer_GL::CacheRenderState() {
     // Cache current OpenGL state to restore later
     // This is useful when temporarily changing state for specific operations
     
     // Save blend state
-    GLboolean blendEnabled = glIsEnabled(GL_BLEND);
+    bool blendEnabled = StateCache_GL::IsEnabled(GL_BLEND);
     if (blendEnabled) {
         glState.blendEquation = BlendEquation::Add; // Default, would need to query actual value
         glState.blendSrc = BlendFunc::One;
@@ -1429,13 +4109,13 @@ void Renderer_GL::CacheRenderState() {
     }
     
     // Save depth state
-    glState.depthTest = glIsEnabled(GL_DEPTH_TEST) == GL_TRUE;
+    glState.depthTest = StateCache_GL::IsEnabled(GL_DEPTH_TEST);
     GLboolean depthWriteMask;
     glGetBooleanv(GL_DEPTH_WRITEMASK, &depthWriteMask);
     glState.depthMask = (depthWriteMask == GL_TRUE);
     
     // Save face culling state
-    glState.doubleSided = (glIsEnabled(GL_CULL_FACE) == GL_FALSE);
+    glState.doubleSided = !StateCache_GL::IsEnabled(GL_CULL_FACE);
     
     // Save front face orientation
     GLint frontFaceMode;
@@ -1464,29 +4144,29 @@ void Renderer_GL::ResetRenderState() {
     // Reset to default OpenGL state
     
     // Reset blend state
-    glDisable(GL_BLEND);
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_ONE, GL_ZERO);
+    StateCache_GL::Disable(GL_BLEND);
+    StateCache_GL::BlendEquation(GL_FUNC_ADD);
+    StateCache_GL::BlendFunc(GL_ONE, GL_ZERO);
     glState.blendEquation = BlendEquation::Add;
     glState.blendSrc = BlendFunc::One;
     glState.blendDst = BlendFunc::Zero;
     
     // Reset depth state
-    glDisable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
+    StateCache_GL::Disable(GL_DEPTH_TEST);
+    StateCache_GL::DepthMask(GL_TRUE);
     glState.depthTest = false;
     glState.depthMask = true;
     
     // Reset face culling
-    glDisable(GL_CULL_FACE);
+    StateCache_GL::Disable(GL_CULL_FACE);
     glState.doubleSided = true;
     
     // Reset front face
-    glFrontFace(GL_CCW);
+    StateCache_GL::FrontFace(GL_CCW);
     glState.invertFrontFace = false;
     
     // Reset scissor test
-    glDisable(GL_SCISSOR_TEST);
+    StateCache_GL::Disable(GL_SCISSOR_TEST);
     
     // Reset vertex attribute state flags
     glState.useUV = false;
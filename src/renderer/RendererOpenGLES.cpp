@@ -1,19 +1,41 @@
 #include "RendererOpenGLES.h"
+#include "Environment.h"
+#include <cstdlib>
 #include <cstring>
+#include <cstddef>
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
 
-// STB Image Write for PNG saving
-#define STB_IMAGE_WRITE_IMPLEMENTATION
+// STB Image Write for PNG saving (ImageWrite.cpp)
 #include "stb_image_write.h"
 
+// KHR_parallel_shader_compile (not in the bundled glad headers)
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// EXT_disjoint_timer_query (not in the bundled glad headers)
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_TIMESTAMP_EXT
+#define GL_TIMESTAMP_EXT 0x8E28
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
 // ------------------------------------------------------------------
 // ShaderProgram_GLES Implementation
 // ------------------------------------------------------------------
 
-ShaderProgram_GLES::ShaderProgram_GLES() : program(0) {
+ShaderProgram_GLES::ShaderProgram_GLES() : program(0), blocksReflected(false) {
 }
 
 ShaderProgram_GLES::~ShaderProgram_GLES() {
@@ -37,18 +59,29 @@ void ShaderProgram_GLES::RegisterUniforms(const std::vector<std::string>& names)
         GLint loc = glGetUniformLocation(program, name.c_str());
         if (loc >= 0) {
             uniforms[name] = loc;
+            StoreByID(uniformsByID, InternUniform(name), loc);
+        } else {
+            RegisterBlockMember(name);
         }
     }
+#ifdef DEBUG
+    CheckBlockArrays(names);
+#endif
 }
 
+// Units follow the list order, active or not, so programs registering the
+// same list (model permutations) agree on them
 void ShaderProgram_GLES::RegisterTextures(const std::vector<std::string>& names) {
     int unit = 0;
     for (const auto& name : names) {
         GLint loc = glGetUniformLocation(program, name.c_str());
         if (loc >= 0) {
             uniforms[name] = loc;
-            textures[name] = unit++;
+            textures[name] = unit;
+            StoreByID(uniformsByID, InternUniform(name), loc);
+            StoreByID(texturesByID, InternUniform(name), unit);
         }
+        unit++;
     }
 }
 
@@ -96,26 +129,257 @@ uint8_t* ShaderProgram_GLES::glStr(const std::string& s) {
     return const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(s.c_str()));
 }
 
+void ShaderProgram_GLES::StoreByID(std::vector<int32_t>& table, UniformID id, int32_t value) {
+    if (id >= static_cast<int32_t>(table.size())) {
+        table.resize(id + 1, -1);
+    }
+    table[id] = value;
+}
+
+void ShaderProgram_GLES::ReflectUniformBlocks() {
+    blocksReflected = true;
+
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        GLint nameLength = 0;
+        glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &nameLength);
+        std::vector<char> name(std::max(nameLength, 1));
+        glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(name.size()), nullptr, name.data());
+
+        int32_t binding = GetUniformBlockBinding(name.data());
+        if (binding < 0) {
+            std::cerr << "Unknown uniform block " << name.data() << std::endl;
+            continue;
+        }
+
+        GLint size = 0;
+        glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        glUniformBlockBinding(program, i, binding);
+
+        UniformBlock block;
+        block.index = i;
+        block.binding = binding;
+        block.data.assign(size, 0);
+        block.dirty = true;
+        block.uploadFrame = ~0ull;
+        block.uploadGeneration = 0;
+        block.uploadOffset = 0;
+        blocks.push_back(block);
+    }
+}
+
+void ShaderProgram_GLES::RegisterBlockMember(const std::string& name) {
+    if (blockOwner) {
+        return;
+    }
+    if (!blocksReflected) {
+        ReflectUniformBlocks();
+    }
+    if (blocks.empty()) {
+        return;
+    }
+
+    const char* namePtr = name.c_str();
+    GLuint index = GL_INVALID_INDEX;
+    glGetUniformIndices(program, 1, &namePtr, &index);
+    if (index == GL_INVALID_INDEX) {
+        return;
+    }
+
+    GLint blockIndex = -1, offset = 0, arrayStride = 0, matrixStride = 0;
+    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &arrayStride);
+    glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &matrixStride);
+    // "name[i]" resolves to the whole array, whose offset is element 0's
+    if (!name.empty() && name.back() == ']' && arrayStride > 0) {
+        size_t open = name.rfind('[');
+        offset += arrayStride * std::atoi(name.c_str() + open + 1);
+    }
+
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        if (static_cast<GLint>(blocks[b].index) != blockIndex) {
+            continue;
+        }
+        UniformID id = InternUniform(name);
+        if (id >= static_cast<int32_t>(blockMembersByID.size())) {
+            blockMembersByID.resize(id + 1, BlockMember{-1, 0, 0, 0});
+        }
+        blockMembersByID[id] = BlockMember{static_cast<int32_t>(b), offset, arrayStride, matrixStride};
+        return;
+    }
+}
+
+bool ShaderProgram_GLES::WriteBlockUniform(UniformID id, const void* data, int elementSize, int count) {
+    if (blockOwner) {
+        return blockOwner->WriteBlockUniform(id, data, elementSize, count);
+    }
+    if (id < 0 || id >= static_cast<int32_t>(blockMembersByID.size()) || count <= 0) {
+        return false;
+    }
+    const BlockMember& member = blockMembersByID[id];
+    if (member.block < 0) {
+        return false;
+    }
+
+    // Matrix columns and array elements are padded out to their std140 stride
+    UniformBlock& block = blocks[member.block];
+    int stride = member.matrixStride > 0 ? member.matrixStride :
+                 (member.arrayStride > 0 ? member.arrayStride : elementSize);
+    size_t end = static_cast<size_t>(member.offset + stride * (count - 1) + elementSize);
+    if (end > block.data.size()) {
+        return false;
+    }
+
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    for (int i = 0; i < count; ++i) {
+        memcpy(&block.data[member.offset + i * stride], src + i * elementSize, elementSize);
+    }
+    block.dirty = true;
+    return true;
+}
+
+#ifdef DEBUG
+// Writes element 0 and element i of every "name[i]" block member and reads
+// both back, so array elements that alias in the block copy are reported
+void ShaderProgram_GLES::CheckBlockArrays(const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+        size_t open = name.rfind('[');
+        if (name.empty() || name.back() != ']' || open == std::string::npos ||
+            std::atoi(name.c_str() + open + 1) == 0) {
+            continue;
+        }
+        UniformID first = InternUniform(name.substr(0, open) + "[0]");
+        UniformID element = InternUniform(name);
+        if (first >= static_cast<int32_t>(blockMembersByID.size()) ||
+            element >= static_cast<int32_t>(blockMembersByID.size()) ||
+            blockMembersByID[first].block < 0 || blockMembersByID[element].block < 0) {
+            continue;
+        }
+
+        const BlockMember& a = blockMembersByID[first];
+        const BlockMember& b = blockMembersByID[element];
+        float saved[2], read[2];
+        memcpy(&saved[0], &blocks[a.block].data[a.offset], sizeof(float));
+        memcpy(&saved[1], &blocks[b.block].data[b.offset], sizeof(float));
+        float values[2] = {1.0f, 2.0f};
+        WriteBlockUniform(first, &values[0], sizeof(float), 1);
+        WriteBlockUniform(element, &values[1], sizeof(float), 1);
+        memcpy(&read[0], &blocks[a.block].data[a.offset], sizeof(float));
+        memcpy(&read[1], &blocks[b.block].data[b.offset], sizeof(float));
+        if (read[0] != values[0] || read[1] != values[1]) {
+            std::cerr << "Uniform block member " << name << " aliases element 0" << std::endl;
+        }
+        WriteBlockUniform(first, &saved[0], sizeof(float), 1);
+        WriteBlockUniform(element, &saved[1], sizeof(float), 1);
+    }
+}
+#endif
+
+void ShaderProgram_GLES::ShareUniformBlocks(const std::shared_ptr<ShaderProgram_GLES>& base) {
+    // Reflection binds this program's blocks to the shared points; the
+    // copies it allocates are dropped in favour of the base program's
+    ReflectUniformBlocks();
+    blocks.clear();
+    blockMembersByID.clear();
+    blockOwner = base;
+}
+
+// ------------------------------------------------------------------
+// Texture Storage
+// ------------------------------------------------------------------
+
+// Bytes per texel of the sized formats this backend allocates
+static int32_t TextureFormatBytes(GLenum internalFormat) {
+    switch (internalFormat) {
+        case GL_R8:                 return 1;
+        case GL_RGB8:               return 3;
+        case GL_RGBA8:              return 4;
+        case GL_R11F_G11F_B10F:     return 4;
+        case GL_RG16F:              return 4;
+        case GL_RGB16F:             return 6;
+        case GL_RGBA16F:            return 8;
+        case GL_RGB32F:             return 12;
+        case GL_RGBA32F:            return 16;
+        case GL_DEPTH_COMPONENT16:  return 2;
+        case GL_DEPTH_COMPONENT24:  return 4;
+        default:                    return 4;
+    }
+}
+
+// Levels of a full mip chain down to 1x1
+static int32_t MipLevelCount(int32_t width, int32_t height) {
+    int32_t levels = 1;
+    while ((std::max(width, height) >> levels) > 0) {
+        levels++;
+    }
+    return levels;
+}
+
+// Float components kept per texel by ReadTextureLevel / WriteTextureLevel:
+// the renderable float formats, 0 for the rest
+static int32_t TransferComponents(GLenum internalFormat) {
+    switch (internalFormat) {
+        case GL_RG16F:              return 2;
+        case GL_RGBA16F:            return 4;
+        case GL_RGBA32F:            return 4;
+        default:                    return 0;
+    }
+}
+
+// Allocates immutable storage for every level of the texture bound to
+// target (core in ES 3.0) and returns its size in bytes
+static size_t AllocateTextureStorage(GLenum target, GLenum internalFormat, int32_t levels,
+                                     int32_t width, int32_t height, int32_t layers = 1) {
+    if (target == GL_TEXTURE_2D_ARRAY) {
+        glTexStorage3D(target, levels, internalFormat, width, height, layers);
+    } else {
+        glTexStorage2D(target, levels, internalFormat, width, height);
+    }
+
+    size_t size = 0;
+    for (int32_t level = 0; level < levels; ++level) {
+        size += static_cast<size_t>(std::max(width >> level, 1)) * std::max(height >> level, 1);
+    }
+    const int32_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    return size * TextureFormatBytes(internalFormat) * faces * layers;
+}
+
 // ------------------------------------------------------------------
 // Texture_GLES Implementation
 // ------------------------------------------------------------------
 
+size_t Texture_GLES::allocatedBytes = 0;
+
 Texture_GLES::Texture_GLES(int32_t width, int32_t height, int32_t depth, bool filter, uint32_t handle)
     : ITexture(width, height, depth, filter, handle), width(width), height(height), depth(depth), filter(filter), handle(handle), 
-      textureTarget(depth > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D) {
+      textureTarget(GL_TEXTURE_2D), internalFormat(0), levels(0), memorySize(0) {
 }
 
 Texture_GLES::~Texture_GLES() {
     if (handle != 0) {
-        glDeleteTextures(1, &handle);
+        StateCache_GLES::DeleteTextures(1, &handle);
         handle = 0;
     }
+    allocatedBytes -= memorySize;
+}
+
+void Texture_GLES::Allocate(GLenum target, uint32_t internalFormat, int32_t levels, int32_t layers) {
+    if (handle == 0 || this->levels != 0) return;
+    
+    StateCache_GLES::BindTexture(target, handle);
+    memorySize = AllocateTextureStorage(target, internalFormat, levels, width, height, layers);
+    allocatedBytes += memorySize;
+    this->levels = levels;
+    textureTarget = target;
+    this->internalFormat = internalFormat;
 }
 
 void Texture_GLES::SetPaletteLayer(const std::vector<uint8_t>& data, int32_t layer) {
     if (handle == 0 || data.empty()) return;
     
-    glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D_ARRAY, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     
     // Upload to specific Z-slice (layer)
@@ -123,7 +387,7 @@ void Texture_GLES::SetPaletteLayer(const std::vector<uint8_t>& data, int32_t lay
     glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, 256, 1, 1, 
                    GL_RGBA, GL_UNSIGNED_BYTE, data.data());
     
-    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D_ARRAY, 0);
 }
 
 void Texture_GLES::SetData(const std::vector<uint8_t>& data) {
@@ -132,19 +396,13 @@ void Texture_GLES::SetData(const std::vector<uint8_t>& data) {
     GLint interp = filter ? GL_LINEAR : GL_NEAREST;
     uint32_t format = MapInternalFormat(std::max(depth, (int32_t)8));
     
-    glBindTexture(GL_TEXTURE_2D, handle);
-    // Ensure any pending GL commands which upload texture data finish before
-    // reading with GetTexImage. This avoids reading an incomplete texture on
-    // some drivers where uploads are deferred.
-    glFinish();
+    Allocate(GL_TEXTURE_2D, MapSizedFormat(std::max(depth, (int32_t)8)), 1);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     
     if (!data.empty()) {
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, 
-                    format, GL_UNSIGNED_BYTE, data.data());
-    } else {
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, 
-                    format, GL_UNSIGNED_BYTE, nullptr);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                       format, GL_UNSIGNED_BYTE, data.data());
     }
     
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, interp);
@@ -152,7 +410,7 @@ void Texture_GLES::SetData(const std::vector<uint8_t>& data) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture_GLES::SetSubData(const std::vector<uint8_t>& data, int32_t x, int32_t y, 
@@ -161,7 +419,7 @@ void Texture_GLES::SetSubData(const std::vector<uint8_t>& data, int32_t x, int32
     
     uint32_t format = MapInternalFormat(std::max(this->depth, (int32_t)8));
     
-    glBindTexture(GL_TEXTURE_2D, handle);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     
     if (!data.empty()) {
@@ -169,7 +427,20 @@ void Texture_GLES::SetSubData(const std::vector<uint8_t>& data, int32_t x, int32
                        format, GL_UNSIGNED_BYTE, data.data());
     }
     
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture_GLES::SetSubData(size_t offset, int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (handle == 0) return;
+    
+    uint32_t format = MapInternalFormat(std::max(this->depth, (int32_t)8));
+    
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, handle);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height,
+                   format, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+    
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture_GLES::SetDataG(const std::vector<uint8_t>& data, 
@@ -181,10 +452,13 @@ void Texture_GLES::SetDataG(const std::vector<uint8_t>& data,
     
     uint32_t format = MapInternalFormat(std::max(depth, (int32_t)8));
     
-    glBindTexture(GL_TEXTURE_2D, handle);
+    Allocate(GL_TEXTURE_2D, MapSizedFormat(std::max(depth, (int32_t)8)), MipLevelCount(width, height));
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, 
-                format, GL_UNSIGNED_BYTE, data.empty() ? nullptr : data.data());
+    if (!data.empty()) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                       format, GL_UNSIGNED_BYTE, data.data());
+    }
     glGenerateMipmap(GL_TEXTURE_2D);
     
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, MapTextureSamplingParam(mag));
@@ -192,18 +466,23 @@ void Texture_GLES::SetDataG(const std::vector<uint8_t>& data,
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, MapTextureSamplingParam(ws));
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, MapTextureSamplingParam(wt));
     
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture_GLES::SetPixelData(const std::vector<float>& data) {
     if (handle == 0) return;
     
-    glBindTexture(GL_TEXTURE_2D, handle);
+    // RGB for HDR panoramas (depth 96), RGBA for data textures
+    GLenum format = depth == 96 ? GL_RGB : GL_RGBA;
+    Allocate(GL_TEXTURE_2D, depth == 96 ? GL_RGB32F : GL_RGBA32F, 1);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, handle);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, 
-                GL_RGBA, GL_FLOAT, data.empty() ? nullptr : data.data());
+    if (!data.empty()) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                       format, GL_FLOAT, data.data());
+    }
     
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture_GLES::CopyData(const Texture_GLES* src) {
@@ -217,20 +496,20 @@ void Texture_GLES::CopyData(const Texture_GLES* src) {
     
     // 1. SAVE THE CURRENT FRAMEBUFFER BINDING
     // If we don't do this, we break the rendering loop by unbinding the main FBO.
-    GLint prevFBO = 0;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFBO);
+    uint32_t prevReadFBO = StateCache_GLES::GetFramebuffer(GL_READ_FRAMEBUFFER);
+    uint32_t prevDrawFBO = StateCache_GLES::GetFramebuffer(GL_DRAW_FRAMEBUFFER);
     
     // Create source FBO
     GLuint srcFBO = 0;
     glGenFramebuffers(1, &srcFBO);
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, srcFBO);
+    StateCache_GLES::BindFramebuffer(GL_READ_FRAMEBUFFER, srcFBO);
     glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                           GL_TEXTURE_2D, src->handle, 0);
     
     // Create destination FBO
     GLuint dstFBO = 0;
     glGenFramebuffers(1, &dstFBO);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dstFBO);
+    StateCache_GLES::BindFramebuffer(GL_DRAW_FRAMEBUFFER, dstFBO);
     glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                           GL_TEXTURE_2D, handle, 0);
     
@@ -243,11 +522,12 @@ void Texture_GLES::CopyData(const Texture_GLES* src) {
     }
     
     // Cleanup Temp FBOs
-    glDeleteFramebuffers(1, &srcFBO);
-    glDeleteFramebuffers(1, &dstFBO);
+    StateCache_GLES::DeleteFramebuffers(1, &srcFBO);
+    StateCache_GLES::DeleteFramebuffers(1, &dstFBO);
     
-    // 2. RESTORE THE PREVIOUS FRAMEBUFFER
-    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(prevFBO));
+    // 2. RESTORE THE PREVIOUS FRAMEBUFFERS
+    StateCache_GLES::BindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFBO);
+    StateCache_GLES::BindFramebuffer(GL_DRAW_FRAMEBUFFER, prevDrawFBO);
 }
 
 bool Texture_GLES::IsValid() const {
@@ -266,21 +546,22 @@ int Texture_GLES::SavePNG(const std::string& filename, const std::vector<uint32_
     // --- 1. Read Texture Data from GPU (GLES Workaround) ---
     
     // Save the current framebuffer so we don't break the render loop
-    GLint prevFBO = 0;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFBO);
+    uint32_t prevReadFBO = StateCache_GLES::GetFramebuffer(GL_READ_FRAMEBUFFER);
+    uint32_t prevDrawFBO = StateCache_GLES::GetFramebuffer(GL_DRAW_FRAMEBUFFER);
     
     // Create a temporary FBO to read the texture
     GLuint fbo = 0;
     glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, handle, 0);
     
     // Check FBO status
     GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
     if (status != GL_FRAMEBUFFER_COMPLETE) {
         std::cerr << "SavePNG: FBO incomplete: " << std::hex << status << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(prevFBO));
-        glDeleteFramebuffers(1, &fbo);
+        StateCache_GLES::BindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFBO);
+        StateCache_GLES::BindFramebuffer(GL_DRAW_FRAMEBUFFER, prevDrawFBO);
+        StateCache_GLES::DeleteFramebuffers(1, &fbo);
         return -1;
     }
     
@@ -291,8 +572,9 @@ int Texture_GLES::SavePNG(const std::string& filename, const std::vector<uint32_
     glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rawData.data());
     
     // Restore state and cleanup
-    glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(prevFBO));
-    glDeleteFramebuffers(1, &fbo);
+    StateCache_GLES::BindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFBO);
+    StateCache_GLES::BindFramebuffer(GL_DRAW_FRAMEBUFFER, prevDrawFBO);
+    StateCache_GLES::DeleteFramebuffers(1, &fbo);
     
     // --- 2. Process Data ---
     
@@ -374,10 +656,10 @@ void Texture_GLES::SetFilterMode(bool linearFilter) {
     filter = linearFilter;
     GLint filterMode = linearFilter ? GL_LINEAR : GL_NEAREST;
     
-    glBindTexture(textureTarget, handle);
+    StateCache_GLES::BindTexture(textureTarget, handle);
     glTexParameteri(textureTarget, GL_TEXTURE_MAG_FILTER, filterMode);
     glTexParameteri(textureTarget, GL_TEXTURE_MIN_FILTER, filterMode);
-    glBindTexture(textureTarget, 0);
+    StateCache_GLES::BindTexture(textureTarget, 0);
 }
 
 void Texture_GLES::SetTextureParameters() {
@@ -385,12 +667,12 @@ void Texture_GLES::SetTextureParameters() {
     
     GLint filterMode = filter ? GL_LINEAR : GL_NEAREST;
     
-    glBindTexture(textureTarget, handle);
+    StateCache_GLES::BindTexture(textureTarget, handle);
     glTexParameteri(textureTarget, GL_TEXTURE_MAG_FILTER, filterMode);
     glTexParameteri(textureTarget, GL_TEXTURE_MIN_FILTER, filterMode);
     glTexParameteri(textureTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(textureTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glBindTexture(textureTarget, 0);
+    StateCache_GLES::BindTexture(textureTarget, 0);
 }
 
 uint32_t Texture_GLES::MapInternalFormat(int32_t depth) const {
@@ -404,6 +686,17 @@ uint32_t Texture_GLES::MapInternalFormat(int32_t depth) const {
     }
 }
 
+uint32_t Texture_GLES::MapSizedFormat(int32_t depth) const {
+    switch (depth) {
+        case 8:   return GL_R8;
+        case 24:  return GL_RGB8;
+        case 32:  return GL_RGBA8;
+        case 96:  return GL_RGB32F;
+        case 128: return GL_RGBA32F;
+        default:  return GL_RGBA8;
+    }
+}
+
 int32_t Texture_GLES::MapTextureSamplingParam(TextureSamplingParam param) const {
     static const std::map<TextureSamplingParam, int32_t> SamplingParamLUT = {
         {TextureSamplingParam::FilterNearest, GL_NEAREST},
@@ -422,334 +715,1528 @@ int32_t Texture_GLES::MapTextureSamplingParam(TextureSamplingParam param) const
 }
 
 // ------------------------------------------------------------------
-// Renderer_GLES Implementation
+// StreamBuffer_GLES Implementation
 // ------------------------------------------------------------------
 
-Renderer_GLES::Renderer_GLES() 
-    : IRenderer(), msaaLevel(0) {
-    
-    modelVertexBuffer[0] = modelVertexBuffer[1] = 0;
-    modelIndexBuffer[0] = modelIndexBuffer[1] = 0;
-    viewport = {0, 0, 0, 0};
-    
-    // Initialize capabilities struct
-    capabilities.hasInstancedArrays = false;
-    capabilities.hasTextureArrays = true;  // ES 3.0+
-    capabilities.hasSamplerObjects = true;  // ES 3.0+
-    capabilities.hasComputeShaders = true;  // ES 3.1+
-    capabilities.hasIndirectDispatch = true;  // ES 3.1+
-    capabilities.hasShaderImageLoadStore = true;  // ES 3.1+
+StreamBuffer_GLES::StreamBuffer_GLES()
+    : handle(0), target(GL_ARRAY_BUFFER), segmentSize(0), cursor(0), segment(0), generation(0) {
 }
 
-Renderer_GLES::~Renderer_GLES() {
-    Close();
+StreamBuffer_GLES::~StreamBuffer_GLES() {
+    Destroy();
 }
 
-std::string Renderer_GLES::GetName() const {
-    return "OpenGL ES";
-}
+bool StreamBuffer_GLES::Init(GLenum target, size_t segmentSize) {
+    this->target = target;
+    this->segmentSize = segmentSize;
+    segment = 0;
+    cursor = 0;
+    generation++;
 
-void Renderer_GLES::Init() {
-    // Query and store OpenGL ES version
-    glGetIntegerv(GL_MAJOR_VERSION, &glVersionMajor);
-    glGetIntegerv(GL_MINOR_VERSION, &glVersionMinor);
-    
-    // Print GL info
-    PrintGLESInfo();
-    std::cout << "Detected OpenGL ES: " << glVersionMajor << "." << glVersionMinor << std::endl;
-    
-    // Detect capabilities
-    DetectCapabilities();
-    
-    // Configure based on OpenGL ES version
-    ConfigureForOpenGLESVersion();
-    
-    // Generate VAO (required in ES 3.0+)
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    
-    // Generate buffers
-    glGenBuffers(1, &postVertBuffer);
-    glGenBuffers(1, &vertexBuffer);
-    glGenBuffers(1, &vertexBufferBatch);
-    glGenBuffers(2, &modelVertexBuffer[0]);
-    glGenBuffers(2, &modelIndexBuffer[0]);
-    
-    // TODO: Initialize shaders when shader sources are available
-    // TODO: Initialize framebuffers
-    // TODO: Set up post-processing
-    
-    glActiveTexture(GL_TEXTURE0);
+    glGenBuffers(1, &handle);
+    StateCache_GLES::BindBuffer(target, handle);
+    glBufferData(target, static_cast<GLsizeiptr>(segmentSize * SegmentCount), nullptr, GL_STREAM_DRAW);
+    return true;
 }
 
-void Renderer_GLES::ConfigureForOpenGLESVersion() {
-    std::cout << "\n=== OpenGL ES Configuration ===" << std::endl;
-    
-    // ES 3.2+: Advanced compute and synchronization
-    if (glVersionMajor > 3 || (glVersionMajor == 3 && glVersionMinor >= 2)) {
-        std::cout << "OpenGL ES 3.2+: Enabling Advanced Features" << std::endl;
-        // - Geometry shaders
-        // - Tesselation support
-        // - Advanced memory barriers
-    }
-    // ES 3.1: Compute shaders
-    else if (glVersionMajor == 3 && glVersionMinor >= 1) {
-        std::cout << "OpenGL ES 3.1: Enabling Compute Shaders" << std::endl;
-        // - Compute shader support
-        // - Shader storage buffers
-        // - Atomic operations
-    }
-    // ES 3.0: Core modern ES
-    else if (glVersionMajor == 3 && glVersionMinor == 0) {
-        std::cout << "OpenGL ES 3.0: Standard Features" << std::endl;
-        // - Instancing
-        // - Transform feedback
-        // - Occlusion queries
-    }
-    // ES 2.0: Legacy mobile ES
-    else if (glVersionMajor == 2) {
-        std::cout << "OpenGL ES 2.0: Limited Feature Set" << std::endl;
-        // - Basic shader support
-        // - Limited texture formats
-        // - No VAO support
-    }
-    else {
-        std::cout << "OpenGL ES 1.x: Minimal Feature Set" << std::endl;
-    }
-    
-    // Query mobile-specific capabilities
-    GLint maxTextures;
-    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxTextures);
-    std::cout << "Max Texture Units: " << maxTextures << std::endl;
-    
-    GLint maxVertexAttribs;
-    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxVertexAttribs);
-    std::cout << "Max Vertex Attributes: " << maxVertexAttribs << std::endl;
-    
-    if (glVersionMajor >= 3) {
-        GLint maxDrawBuffers;
-        glGetIntegerv(GL_MAX_DRAW_BUFFERS, &maxDrawBuffers);
-        std::cout << "Max Draw Buffers: " << maxDrawBuffers << std::endl;
+void StreamBuffer_GLES::Destroy() {
+    if (handle != 0) {
+        StateCache_GLES::DeleteBuffers(1, &handle);
+        handle = 0;
     }
-    
-    std::cout << "==========================\n" << std::endl;
 }
 
-void Renderer_GLES::Close() {
-    // Delete VAO
-    if (vao != 0) {
-        glDeleteVertexArrays(1, &vao);
-        vao = 0;
-    }
-    
-    // Delete buffers
-    if (postVertBuffer != 0) glDeleteBuffers(1, &postVertBuffer);
-    if (vertexBuffer != 0) glDeleteBuffers(1, &vertexBuffer);
-    if (vertexBufferBatch != 0) glDeleteBuffers(1, &vertexBufferBatch);
-    if (modelVertexBuffer[0] != 0) glDeleteBuffers(2, &modelVertexBuffer[0]);
-    if (modelIndexBuffer[0] != 0) glDeleteBuffers(2, &modelIndexBuffer[0]);
-    
-    // Delete framebuffers
-    if (fbo != 0) glDeleteFramebuffers(1, &fbo);
-    if (fbo_f != 0) glDeleteFramebuffers(1, &fbo_f);
-    if (fbo_shadow != 0) glDeleteFramebuffers(1, &fbo_shadow);
-    if (fbo_env != 0) glDeleteFramebuffers(1, &fbo_env);
-    
-    // Delete textures
-    if (fbo_texture != 0) glDeleteTextures(1, &fbo_texture);
-    if (rbo_depth != 0) glDeleteRenderbuffers(1, &rbo_depth);
-    if (fbo_shadow_cube_texture != 0) glDeleteTextures(1, &fbo_shadow_cube_texture);
-    
-    // Delete post-processing FBOs
-    if (!fbo_pp.empty()) {
-        glDeleteFramebuffers(fbo_pp.size(), fbo_pp.data());
-        fbo_pp.clear();
+size_t StreamBuffer_GLES::Append(const void* data, size_t size, size_t alignment) {
+    if (size > segmentSize) {
+        Grow(size + alignment);
     }
-    if (!fbo_pp_texture.empty()) {
-        glDeleteTextures(fbo_pp_texture.size(), fbo_pp_texture.data());
-        fbo_pp_texture.clear();
+
+    size_t segmentEnd = (segment + 1) * segmentSize;
+    size_t offset = (cursor + alignment - 1) / alignment * alignment;
+    if (offset + size > segmentEnd) {
+        // Current segment is full; move on to the next one mid-frame
+        NextSegment();
+        offset = (cursor + alignment - 1) / alignment * alignment;
     }
-}
 
-int Renderer_GLES::InitModelShader() {
-    // TODO: Implement when shader sources are available
-    return 0;
+    // One driver copy per append instead of a map/unmap round trip; the
+    // store was orphaned when the ring last wrapped, so nothing the GPU
+    // still reads is written
+    StateCache_GLES::BindBuffer(target, handle);
+    glBufferSubData(target, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+
+    cursor = offset + size;
+    return offset;
 }
 
-void Renderer_GLES::BeginFrame(bool clearColor) {
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glViewport(viewport.x, viewport.y, viewport.width, viewport.height);
-    
-    GLbitfield clearBits = GL_DEPTH_BUFFER_BIT;
-    if (clearColor) {
-        clearBits |= GL_COLOR_BUFFER_BIT;
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+void StreamBuffer_GLES::NextSegment() {
+    if (handle == 0) {
+        return;
     }
-    glClear(clearBits);
-}
 
-void Renderer_GLES::EndFrame() {
-    // TODO: Implement post-processing pipeline when shaders are available
-    glFinish();
+    // Orphaning the store on wrap leaves the old one to pending draws
+    segment = (segment + 1) % SegmentCount;
+    cursor = segment * segmentSize;
+    if (segment == 0) {
+        StateCache_GLES::BindBuffer(target, handle);
+        glBufferData(target, static_cast<GLsizeiptr>(segmentSize * SegmentCount), nullptr, GL_STREAM_DRAW);
+    }
 }
 
-void Renderer_GLES::Await() {
-    glFinish();
+void StreamBuffer_GLES::Grow(size_t minSegmentSize) {
+    size_t newSize = segmentSize;
+    while (newSize < minSegmentSize) {
+        newSize *= 2;
+    }
+
+    // Draws still in flight keep the deleted buffer's storage alive
+    Destroy();
+    Init(target, newSize);
 }
 
-bool Renderer_GLES::IsModelEnabled() const {
-    return enableModel;
+// ------------------------------------------------------------------
+// TextureUploadQueue_GLES Implementation
+// ------------------------------------------------------------------
+
+TextureUploadQueue_GLES::TextureUploadQueue_GLES() : recording(1), recorded(false) {
 }
 
-bool Renderer_GLES::IsShadowEnabled() const {
-    return enableShadow;
+TextureUploadQueue_GLES::~TextureUploadQueue_GLES() {
+    Destroy();
 }
 
-void Renderer_GLES::BlendReset() {
-    glDisable(GL_BLEND);
-    glState.blendEquation = BlendEquation::Add;
-    glState.blendSrc = BlendFunc::One;
-    glState.blendDst = BlendFunc::Zero;
+bool TextureUploadQueue_GLES::Init(size_t segmentSize) {
+    bool ok = ring.Init(GL_PIXEL_UNPACK_BUFFER, segmentSize);
+    // Any other texture upload must keep reading from client memory
+    StateCache_GLES::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return ok;
 }
 
-void Renderer_GLES::SetBlending(BlendEquation eq, BlendFunc src, BlendFunc dst) {
-    if (glState.blendEquation != eq || glState.blendSrc != src || glState.blendDst != dst) {
-        glState.blendEquation = eq;
-        glState.blendSrc = src;
-        glState.blendDst = dst;
-        
-        glEnable(GL_BLEND);
-        glBlendEquation(MapBlendEquation(eq));
-        glBlendFunc(MapBlendFunction(src), MapBlendFunction(dst));
+void TextureUploadQueue_GLES::Destroy() {
+    for (Batch& batch : inFlight) {
+        glDeleteSync(batch.fence);
     }
+    inFlight.clear();
+    pending.clear();
+    recorded = false;
+    ring.Destroy();
 }
 
-void Renderer_GLES::SetDepthTest(bool depthTest) {
-    if (glState.depthTest != depthTest) {
-        glState.depthTest = depthTest;
-        if (depthTest) {
-            glEnable(GL_DEPTH_TEST);
-        } else {
-            glDisable(GL_DEPTH_TEST);
-        }
+void TextureUploadQueue_GLES::Upload(Texture_GLES& texture, const std::vector<uint8_t>& data,
+                                     int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0) return;
+
+    const size_t size = static_cast<size_t>(width) * height * texture.GetBytesPerPixel();
+    if (data.size() < size) {
+        std::cerr << "TextureUploadQueue: " << data.size() << " bytes given for a "
+                  << width << "x" << height << " upload of " << size << std::endl;
+        return;
     }
-}
 
-void Renderer_GLES::SetDepthMask(bool depthMask) {
-    if (glState.depthMask != depthMask) {
-        glState.depthMask = depthMask;
-        glDepthMask(depthMask ? GL_TRUE : GL_FALSE);
+    // Before Init (or after Close) there is no ring to stage into
+    if (ring.GetHandle() == 0) {
+        texture.SetSubData(data, x, y, width, height);
+        return;
     }
+
+    // The copy into the ring returns at once; the driver pulls the texels
+    // from the buffer when it executes the glTexSubImage2D
+    size_t offset = ring.Append(data.data(), size, 4);
+    StateCache_GLES::BindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.GetHandle());
+    texture.SetSubData(offset, x, y, width, height);
+    StateCache_GLES::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    pending[texture.GetHandle()] = recording;
+    recorded = true;
 }
 
-void Renderer_GLES::SetFrontFace(bool invertFrontFace) {
-    if (glState.invertFrontFace != invertFrontFace) {
-        glState.invertFrontFace = invertFrontFace;
-        glFrontFace(invertFrontFace ? GL_CW : GL_CCW);
+void TextureUploadQueue_GLES::NextFrame() {
+    if (recorded) {
+        inFlight.push_back(Batch{recording, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+        recording++;
+        recorded = false;
+        ring.NextSegment();
+        StateCache_GLES::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
     }
-}
 
-void Renderer_GLES::SetCullFace(bool doubleSided) {
-    if (glState.doubleSided != doubleSided) {
-        glState.doubleSided = doubleSided;
-        if (doubleSided) {
-            glDisable(GL_CULL_FACE);
+    // Batches complete in order, so stop at the first unsignaled fence
+    uint64_t retired = 0;
+    while (!inFlight.empty()) {
+        GLenum result = glClientWaitSync(inFlight.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break;
+
+        retired = inFlight.front().serial;
+        glDeleteSync(inFlight.front().fence);
+        inFlight.erase(inFlight.begin());
+    }
+    if (retired == 0) return;
+
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (it->second <= retired) {
+            it = pending.erase(it);
         } else {
-            glEnable(GL_CULL_FACE);
+            ++it;
         }
     }
 }
 
-void Renderer_GLES::SetPipeline(BlendEquation eq, BlendFunc src, BlendFunc dst) {
-    if (!spriteShader) return;
-    
-    glUseProgram(spriteShader->GetProgram());
-    SetBlending(eq, src, dst);
-    SetDepthTest(false);
-    SetCullFace(true);
-    
-    // Bind vertex buffer and set up attributes
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+// ------------------------------------------------------------------
+// StateCache_GLES Implementation
+// ------------------------------------------------------------------
+
+StateCache_GLES::State StateCache_GLES::state;
+uint32_t StateCache_GLES::usedUnits = 0;
+bool StateCache_GLES::validation = false;
+StateCacheStats StateCache_GLES::stats = {};
+const uint32_t StateCache_GLES::Unknown;
+
+void StateCache_GLES::Invalidate() {
+    state.program = Unknown;
+    state.vertexArray = Unknown;
+    std::fill(std::begin(state.buffers), std::end(state.buffers), Unknown);
+    state.activeUnit = Unknown;
+    for (auto& unit : state.textures) {
+        std::fill(std::begin(unit), std::end(unit), Unknown);
+    }
+    state.readFramebuffer = Unknown;
+    state.drawFramebuffer = Unknown;
+    state.viewportKnown = false;
+    state.scissorKnown = false;
+    std::fill(std::begin(state.capabilities), std::end(state.capabilities), Unknown);
+    state.blendEquation = Unknown;
+    state.blendSrc = Unknown;
+    state.blendDst = Unknown;
+    state.depthFunc = Unknown;
+    state.depthMask = Unknown;
+    state.cullFace = Unknown;
+    state.frontFace = Unknown;
+    usedUnits = 0;
+}
+
+void StateCache_GLES::ResetStats() {
+    stats = StateCacheStats();
+}
+
+int StateCache_GLES::BufferIndex(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER: return BufferArray;
+        case GL_ELEMENT_ARRAY_BUFFER: return BufferElementArray;
+        case GL_PIXEL_PACK_BUFFER: return BufferPixelPack;
+        case GL_PIXEL_UNPACK_BUFFER: return BufferPixelUnpack;
+        case GL_UNIFORM_BUFFER: return BufferUniform;
+        case GL_DRAW_INDIRECT_BUFFER: return BufferDrawIndirect;
+        default: return -1;
+    }
+}
+
+int StateCache_GLES::TextureIndex(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D: return Texture2D;
+        case GL_TEXTURE_2D_ARRAY: return Texture2DArray;
+        case GL_TEXTURE_CUBE_MAP: return TextureCubeMap;
+        default: return -1;
+    }
+}
+
+int StateCache_GLES::CapabilityIndex(GLenum capability) {
+    switch (capability) {
+        case GL_BLEND: return CapabilityBlend;
+        case GL_DEPTH_TEST: return CapabilityDepthTest;
+        case GL_CULL_FACE: return CapabilityCullFace;
+        case GL_SCISSOR_TEST: return CapabilityScissorTest;
+        default: return -1;
+    }
+}
+
+bool StateCache_GLES::Redundant(StateCall kind, bool matches) {
+    stats.calls[static_cast<int>(kind)]++;
+    if (matches) stats.redundant[static_cast<int>(kind)]++;
+    return matches;
+}
+
+void StateCache_GLES::UseProgram(uint32_t program) {
+    if (Redundant(StateCall::Program, state.program == program)) return;
+    state.program = program;
+    glUseProgram(program);
+}
+
+void StateCache_GLES::BindVertexArray(uint32_t array) {
+    if (Redundant(StateCall::VertexArray, state.vertexArray == array)) return;
+    state.vertexArray = array;
+    state.buffers[BufferElementArray] = Unknown;
+    glBindVertexArray(array);
+}
+
+void StateCache_GLES::BindBuffer(GLenum target, uint32_t buffer) {
+    int index = BufferIndex(target);
+    if (Redundant(StateCall::Buffer, index >= 0 && state.buffers[index] == buffer)) return;
+    if (index >= 0) state.buffers[index] = buffer;
+    glBindBuffer(target, buffer);
+}
+
+void StateCache_GLES::BindBufferRange(GLenum target, uint32_t index, uint32_t buffer, GLintptr offset, GLsizeiptr size) {
+    // Indexed ranges are tracked by the callers (boundBlocks)
+    Redundant(StateCall::Buffer, false);
+    int generic = BufferIndex(target);
+    if (generic >= 0) state.buffers[generic] = buffer;
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void StateCache_GLES::ActiveTexture(GLenum unit) {
+    uint32_t index = unit - GL_TEXTURE0;
+    if (Redundant(StateCall::Texture, state.activeUnit == index)) return;
+    state.activeUnit = index;
+    glActiveTexture(unit);
+}
+
+void StateCache_GLES::BindTexture(GLenum target, uint32_t texture) {
+    int index = TextureIndex(target);
+    bool cached = index >= 0 && state.activeUnit < static_cast<uint32_t>(MaxTextureUnits);
+    if (Redundant(StateCall::Texture, cached && state.textures[state.activeUnit][index] == texture)) return;
+    if (cached) {
+        state.textures[state.activeUnit][index] = texture;
+        usedUnits = std::max(usedUnits, state.activeUnit + 1);
+    }
+    glBindTexture(target, texture);
+}
+
+void StateCache_GLES::BindFramebuffer(GLenum target, uint32_t framebuffer) {
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    if (Redundant(StateCall::Framebuffer, (!read || state.readFramebuffer == framebuffer) &&
+                                          (!draw || state.drawFramebuffer == framebuffer))) {
+        return;
+    }
+    if (read) state.readFramebuffer = framebuffer;
+    if (draw) state.drawFramebuffer = framebuffer;
+    glBindFramebuffer(target, framebuffer);
+}
+
+uint32_t StateCache_GLES::GetProgram() {
+    if (state.program == Unknown) {
+        GLint program = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        state.program = static_cast<uint32_t>(program);
+    }
+    return state.program;
+}
+
+uint32_t StateCache_GLES::GetFramebuffer(GLenum target) {
+    uint32_t& cached = target == GL_READ_FRAMEBUFFER ? state.readFramebuffer : state.drawFramebuffer;
+    if (cached == Unknown) {
+        GLint framebuffer = 0;
+        glGetIntegerv(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING,
+                      &framebuffer);
+        cached = static_cast<uint32_t>(framebuffer);
+    }
+    return cached;
+}
+
+void StateCache_GLES::GetViewport(int32_t viewport[4]) {
+    if (!state.viewportKnown) {
+        glGetIntegerv(GL_VIEWPORT, state.viewport);
+        state.viewportKnown = true;
+    }
+    std::copy(state.viewport, state.viewport + 4, viewport);
+}
+
+bool StateCache_GLES::IsEnabled(GLenum capability) {
+    int index = CapabilityIndex(capability);
+    if (index < 0) return glIsEnabled(capability) == GL_TRUE;
+    if (state.capabilities[index] == Unknown) {
+        state.capabilities[index] = glIsEnabled(capability) == GL_TRUE ? 1 : 0;
+    }
+    return state.capabilities[index] == 1;
+}
+
+void StateCache_GLES::Viewport(int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (Redundant(StateCall::Viewport, state.viewportKnown && state.viewport[0] == x && state.viewport[1] == y &&
+                                       state.viewport[2] == width && state.viewport[3] == height)) {
+        return;
+    }
+    state.viewport[0] = x;
+    state.viewport[1] = y;
+    state.viewport[2] = width;
+    state.viewport[3] = height;
+    state.viewportKnown = true;
+    glViewport(x, y, width, height);
+}
+
+void StateCache_GLES::Scissor(int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (Redundant(StateCall::Scissor, state.scissorKnown && state.scissor[0] == x && state.scissor[1] == y &&
+                                      state.scissor[2] == width && state.scissor[3] == height)) {
+        return;
+    }
+    state.scissor[0] = x;
+    state.scissor[1] = y;
+    state.scissor[2] = width;
+    state.scissor[3] = height;
+    state.scissorKnown = true;
+    glScissor(x, y, width, height);
+}
+
+void StateCache_GLES::SetCapability(GLenum capability, bool enabled) {
+    int index = CapabilityIndex(capability);
+    uint32_t value = enabled ? 1 : 0;
+    if (Redundant(StateCall::Capability, index >= 0 && state.capabilities[index] == value)) return;
+    if (index >= 0) state.capabilities[index] = value;
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+void StateCache_GLES::Enable(GLenum capability) {
+    SetCapability(capability, true);
+}
+
+void StateCache_GLES::Disable(GLenum capability) {
+    SetCapability(capability, false);
+}
+
+void StateCache_GLES::BlendEquation(GLenum mode) {
+    if (Redundant(StateCall::Blend, state.blendEquation == mode)) return;
+    state.blendEquation = mode;
+    glBlendEquation(mode);
+}
+
+void StateCache_GLES::BlendFunc(GLenum src, GLenum dst) {
+    if (Redundant(StateCall::Blend, state.blendSrc == src && state.blendDst == dst)) return;
+    state.blendSrc = src;
+    state.blendDst = dst;
+    glBlendFunc(src, dst);
+}
+
+void StateCache_GLES::DepthFunc(GLenum func) {
+    if (Redundant(StateCall::Depth, state.depthFunc == func)) return;
+    state.depthFunc = func;
+    glDepthFunc(func);
+}
+
+void StateCache_GLES::DepthMask(GLboolean mask) {
+    uint32_t value = mask ? 1 : 0;
+    if (Redundant(StateCall::Depth, state.depthMask == value)) return;
+    state.depthMask = value;
+    glDepthMask(mask);
+}
+
+void StateCache_GLES::CullFace(GLenum mode) {
+    if (Redundant(StateCall::Face, state.cullFace == mode)) return;
+    state.cullFace = mode;
+    glCullFace(mode);
+}
+
+void StateCache_GLES::FrontFace(GLenum mode) {
+    if (Redundant(StateCall::Face, state.frontFace == mode)) return;
+    state.frontFace = mode;
+    glFrontFace(mode);
+}
+
+void StateCache_GLES::DeleteBuffers(GLsizei count, const uint32_t* buffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        for (uint32_t& bound : state.buffers) {
+            if (bound == buffers[i]) bound = 0;
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void StateCache_GLES::DeleteTextures(GLsizei count, const uint32_t* textures) {
+    for (GLsizei i = 0; i < count; ++i) {
+        for (uint32_t unit = 0; unit < usedUnits; ++unit) {
+            for (uint32_t& bound : state.textures[unit]) {
+                if (bound == textures[i]) bound = 0;
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+void StateCache_GLES::DeleteFramebuffers(GLsizei count, const uint32_t* framebuffers) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (state.readFramebuffer == framebuffers[i]) state.readFramebuffer = 0;
+        if (state.drawFramebuffer == framebuffers[i]) state.drawFramebuffer = 0;
+    }
+    glDeleteFramebuffers(count, framebuffers);
+}
+
+void StateCache_GLES::DeleteVertexArrays(GLsizei count, const uint32_t* arrays) {
+    for (GLsizei i = 0; i < count; ++i) {
+        if (state.vertexArray == arrays[i]) {
+            state.vertexArray = 0;
+            state.buffers[BufferElementArray] = Unknown;
+        }
+    }
+    glDeleteVertexArrays(count, arrays);
+}
+
+// Prints a cached value that disagrees with GL; unknown values are skipped
+static bool CompareState(const char* where, const char* what, uint32_t cached, GLint actual) {
+    if (cached == 0xFFFFFFFFu || cached == static_cast<uint32_t>(actual)) return true;
+    std::cerr << "State cache mismatch at " << where << ": " << what << " is " << actual
+              << ", cached " << cached << std::endl;
+    return false;
+}
+
+bool StateCache_GLES::Validate(const char* where) {
+    struct Query {
+        const char* name;
+        GLenum pname;
+        uint32_t cached;
+    };
+    const Query queries[] = {
+        {"program", GL_CURRENT_PROGRAM, state.program},
+        {"vertex array", GL_VERTEX_ARRAY_BINDING, state.vertexArray},
+        {"array buffer", GL_ARRAY_BUFFER_BINDING, state.buffers[BufferArray]},
+        {"element array buffer", GL_ELEMENT_ARRAY_BUFFER_BINDING, state.buffers[BufferElementArray]},
+        {"pixel pack buffer", GL_PIXEL_PACK_BUFFER_BINDING, state.buffers[BufferPixelPack]},
+        {"pixel unpack buffer", GL_PIXEL_UNPACK_BUFFER_BINDING, state.buffers[BufferPixelUnpack]},
+        {"uniform buffer", GL_UNIFORM_BUFFER_BINDING, state.buffers[BufferUniform]},
+        {"draw indirect buffer", GL_DRAW_INDIRECT_BUFFER_BINDING, state.buffers[BufferDrawIndirect]},
+        {"read framebuffer", GL_READ_FRAMEBUFFER_BINDING, state.readFramebuffer},
+        {"draw framebuffer", GL_DRAW_FRAMEBUFFER_BINDING, state.drawFramebuffer},
+        {"blend equation", GL_BLEND_EQUATION_RGB, state.blendEquation},
+        {"blend source", GL_BLEND_SRC_RGB, state.blendSrc},
+        {"blend destination", GL_BLEND_DST_RGB, state.blendDst},
+        {"depth func", GL_DEPTH_FUNC, state.depthFunc},
+        {"depth mask", GL_DEPTH_WRITEMASK, state.depthMask},
+        {"cull face", GL_CULL_FACE_MODE, state.cullFace},
+        {"front face", GL_FRONT_FACE, state.frontFace},
+    };
+
+    int mismatches = 0;
+    for (const Query& query : queries) {
+        // Also skips targets the context may not have (draw indirect)
+        if (query.cached == Unknown) continue;
+        GLint actual = 0;
+        glGetIntegerv(query.pname, &actual);
+        mismatches += !CompareState(where, query.name, query.cached, actual);
+    }
+
+    static const struct {
+        const char* name;
+        GLenum capability;
+    } capabilities[CapabilityCount] = {
+        {"blend", GL_BLEND}, {"depth test", GL_DEPTH_TEST}, {"cull face", GL_CULL_FACE},
+        {"scissor test", GL_SCISSOR_TEST},
+    };
+    for (int i = 0; i < CapabilityCount; ++i) {
+        mismatches += !CompareState(where, capabilities[i].name, state.capabilities[i],
+                              glIsEnabled(capabilities[i].capability) == GL_TRUE ? 1 : 0);
+    }
+
+    GLint rect[4];
+    const char* rectNames[4] = {"x", "y", "width", "height"};
+    glGetIntegerv(GL_VIEWPORT, rect);
+    for (int i = 0; i < 4 && state.viewportKnown; ++i) {
+        mismatches += !CompareState(where, (std::string("viewport ") + rectNames[i]).c_str(), state.viewport[i], rect[i]);
+    }
+    glGetIntegerv(GL_SCISSOR_BOX, rect);
+    for (int i = 0; i < 4 && state.scissorKnown; ++i) {
+        mismatches += !CompareState(where, (std::string("scissor ") + rectNames[i]).c_str(), state.scissor[i], rect[i]);
+    }
+
+    // Texture bindings are per unit, so each used unit is made active in turn
+    GLint activeTexture = GL_TEXTURE0;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+    mismatches += !CompareState(where, "active texture", state.activeUnit, activeTexture - GL_TEXTURE0);
+    static const GLenum textureBindings[TextureTargetCount] = {
+        GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP
+    };
+    static const char* textureNames[TextureTargetCount] = {"2D", "2D array", "cube map"};
+    for (uint32_t unit = 0; unit < usedUnits; ++unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        for (int target = 0; target < TextureTargetCount; ++target) {
+            GLint actual = 0;
+            glGetIntegerv(textureBindings[target], &actual);
+            std::string name = "unit " + std::to_string(unit) + " " + textureNames[target] + " texture";
+            mismatches += !CompareState(where, name.c_str(), state.textures[unit][target], actual);
+        }
+    }
+    glActiveTexture(activeTexture);
+
+    stats.mismatches += mismatches;
+    return mismatches == 0;
+}
+
+// Uniforms and textures the loader registers on each built-in program
+static const std::vector<std::string> SpriteUniformNames = {
+    "modelview", "projection", "x1x2x4x3", "alpha", "tint", "mask", "neg", "gray", "add", "mult",
+    "isFlat", "isRgba", "isTrapez", "hue", "uvRect", "useUV"
+};
+static const std::vector<std::string> SpriteTextureNames = {"pal", "tex"};
+
+static std::vector<std::string> ModelUniformNames() {
+    std::vector<std::string> names = {
+        "model", "view", "projection", "normalMatrix", "unlit", "baseColorFactor", "add", "mult",
+        "useTexture", "useNormalMap", "useMetallicRoughnessMap", "useEmissionMap", "neg", "gray", "hue",
+        "enableAlpha", "alphaThreshold", "numJoints", "morphTargetWeight", "morphTargetOffset",
+        "morphTargetTextureDimension", "numTargets", "numVertices", "metallicRoughness",
+        "ambientOcclusionStrength", "emission", "environmentIntensity", "mipCount", "meshOutline",
+        "cameraPosition", "environmentRotation", "texTransform", "normalMapTransform",
+        "metallicRoughnessMapTransform", "ambientOcclusionMapTransform", "emissionMapTransform",
+        "shadowAtlasRects", "shadowCascades"
+    };
+    static const char* lightFields[] = {
+        "direction", "range", "color", "intensity", "position", "innerConeCos", "outerConeCos",
+        "type", "shadowBias", "shadowMapFar"
+    };
+    for (int i = 0; i < 4; ++i) {
+        std::string light = "lights[" + std::to_string(i) + "].";
+        for (const char* field : lightFields) {
+            names.push_back(light + field);
+        }
+        names.push_back("lightMatrices[" + std::to_string(i) + "]");
+    }
+    return names;
+}
+
+// Points every sampler of the program at its unit once, so binding a
+// texture never has to touch the program (it may not be current)
+static void AssignTextureUnits(ShaderProgram_GLES& shader) {
+    uint32_t current = StateCache_GLES::GetProgram();
+    StateCache_GLES::UseProgram(shader.GetProgram());
+    for (const auto& texture : shader.GetAllTextures()) {
+        GLint loc = shader.GetUniformLocation(texture.first);
+        if (loc >= 0) glUniform1i(loc, texture.second);
+    }
+    StateCache_GLES::UseProgram(current);
+}
+
+// Shared by the model program, its permutations and its unlit stand-in
+static void RegisterModelInterface(ShaderProgram_GLES& shader) {
+    shader.RegisterAttributes({"vertexId", "position", "uv", "normalIn", "tangentIn", "vertColor",
+                               "joints_0", "joints_1", "weights_0", "weights_1", "outlineAttributeIn"});
+    shader.RegisterUniforms(ModelUniformNames());
+    shader.RegisterTextures({"tex", "morphTargetValues", "jointMatrices", "normalMap", "metallicRoughnessMap",
+                             "ambientOcclusionMap", "emissionMap", "lambertianEnvSampler", "GGXEnvSampler",
+                             "GGXLUT", "shadowAtlas"});
+
+    AssignTextureUnits(shader);
+}
+
+// One light view per draw into its atlas tile (SetShadowAtlasView)
+static void RegisterShadowInterface(ShaderProgram_GLES& shader) {
+    shader.RegisterAttributes({"position"});
+    shader.RegisterUniforms({"model", "lightVP", "lightType", "lightPosition", "farPlane"});
+}
+
+// ES 3.1 has no geometry stage
+static const uint32_t ShaderStages[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+
+// Instanced attributes of the INSTANCED sprite program, laid out as SpriteInstance
+static const struct {
+    const char* name;
+    size_t offset;
+    int columns;    // vec4 columns; a mat4 spans four consecutive locations
+} SpriteInstanceAttributes[] = {
+    {"i_modelview", offsetof(SpriteInstance, modelview), 4},
+    {"i_tint", offsetof(SpriteInstance, tint), 1},
+    {"i_addAlpha", offsetof(SpriteInstance, add), 1},
+    {"i_multPalIndex", offsetof(SpriteInstance, mult), 1},
+};
+
+// ------------------------------------------------------------------
+// Renderer_GLES Implementation
+// ------------------------------------------------------------------
+
+Renderer_GLES::Renderer_GLES() 
+    : IRenderer(), postVAO(0), vertexFirst(0), instancedPipeline(false), activeSpriteShader(nullptr), useUniformBuffers(false), uniformBufferAlignment(256),
+      frameIndex(0), shaderDirectory("shaders/"), parallelShaderCompile(false), modelMaterialFeatures(0),
+      boundModelProgram(0), useModelPermutations(false), useDrawIndirect(false), modelBufferIndex(0), msaaLevel(0) {
+    for (auto& bound : boundBlocks) {
+        bound.generation = 0;
+        bound.offset = 0;
+    }
+    for (auto& slot : profileFrames) {
+        slot.used = 0;
+        slot.frame = 0;
+        slot.pending = false;
+    }
+    for (bool& open : profilePassOpen) {
+        open = false;
+    }
+    
+    modelVertexBuffer[0] = modelVertexBuffer[1] = 0;
+    modelIndexBuffer[0] = modelIndexBuffer[1] = 0;
+    fbo = fbo_texture = rbo_depth = 0;
+    fbo_f = fbo_shadow = fbo_shadow_texture = fbo_env = 0;
+    shadowAtlasSize = 0;
+    enableShadow = false;
+    rbo_f_color = rbo_f_depth = 0;
+    for (auto& size : postTargetSize) {
+        size[0] = size[1] = 0;
+    }
+    postGeneration = 0;
+    queryCounterEXT = nullptr;
+    getQueryObjectui64vEXT = nullptr;
+    renderbufferStorageMultisampleEXT = nullptr;
+    framebufferTexture2DMultisampleEXT = nullptr;
+    viewport = {0, 0, 0, 0};
+
+    glState.depthTest = false;
+    glState.depthMask = false;
+    glState.invertFrontFace = false;
+    glState.doubleSided = false;
+    glState.blendEquation = BlendEquation::Add;
+    glState.blendSrc = BlendFunc::SrcAlpha;
+    glState.blendDst = BlendFunc::OneMinusSrcAlpha;
+    glState.useUV = false;
+    glState.useNormal = false;
+    glState.useTangent = false;
+    glState.useVertColor = false;
+    glState.useJoint0 = false;
+    glState.useJoint1 = false;
+    glState.useOutlineAttribute = false;
+    
+    // Initialize capabilities struct
+    capabilities.hasInstancedArrays = false;
+    capabilities.hasTextureArrays = true;  // ES 3.0+
+    capabilities.hasSamplerObjects = true;  // ES 3.0+
+    capabilities.hasComputeShaders = true;  // ES 3.1+
+    capabilities.hasIndirectDispatch = true;  // ES 3.1+
+    capabilities.hasShaderImageLoadStore = true;  // ES 3.1+
+}
+
+Renderer_GLES::~Renderer_GLES() {
+    Close();
+}
+
+std::string Renderer_GLES::GetName() const {
+    return "OpenGL ES";
+}
+
+void Renderer_GLES::Init() {
+    // Nothing is known about the state the context was handed over in
+    StateCache_GLES::Invalidate();
+
+    // Query and store OpenGL ES version
+    glGetIntegerv(GL_MAJOR_VERSION, &glVersionMajor);
+    glGetIntegerv(GL_MINOR_VERSION, &glVersionMinor);
     
-    GLint stride = 5 * sizeof(float);  // position(2) + uv(2) + palIndex(1)
+    // Print GL info
+    PrintGLESInfo();
+    std::cout << "Detected OpenGL ES: " << glVersionMajor << "." << glVersionMinor << std::endl;
     
-    GLint posLoc = spriteShader->GetAttributeLocation("position");
-    if (posLoc >= 0) {
-        glEnableVertexAttribArray(posLoc);
-        glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    // Detect capabilities
+    DetectCapabilities();
+    InitTimerQueries();
+    InitMultisampledRenderToTexture();
+    
+    // Configure based on OpenGL ES version
+    ConfigureForOpenGLESVersion();
+    
+    // Generate VAO (required in ES 3.0+)
+    glGenVertexArrays(1, &vao);
+    StateCache_GLES::BindVertexArray(vao);
+    
+    // Generate buffers
+    glGenBuffers(2, &modelVertexBuffer[0]);
+    glGenBuffers(2, &modelIndexBuffer[0]);
+
+    // Sprite vertices are streamed through a fenced ring buffer
+    vertexStream.Init(GL_ARRAY_BUFFER, SpriteStreamSegmentSize);
+    instanceStream.Init(GL_ARRAY_BUFFER, InstanceStreamSegmentSize);
+    textureUploads.Init(TextureUploadSegmentSize);
+
+    // Per-draw uniform blocks are suballocated from a second ring (ES 3.0+)
+    useUniformBuffers = glVersionMajor >= 3;
+    if (useUniformBuffers) {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformBufferAlignment = std::max(alignment, 16);
+        uniformStream.Init(GL_UNIFORM_BUFFER, UniformStreamSegmentSize);
+        shaderDefines += "#define USE_UBO\n";
+    }
+    // Permutations share the block copies of the generic model program;
+    // loose uniforms would have to be set on each of them
+    useModelPermutations = useUniformBuffers;
+
+    // Indirect draws are core in ES 3.1; the per-draw matrices come from the
+    // MULTI_DRAW permutation
+    useDrawIndirect = useModelPermutations && GLAD_GL_ES_VERSION_3_1;
+
+    // Linked programs are cached on disk when the driver exposes at least
+    // one binary format (ES 3.0 core); the key covers the driver identity
+    GLint binaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    binaryCache.SetEnabled(binaryFormats > 0);
+    binaryCache.SetDriverIdentity(std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "|" +
+                                  reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "|" +
+                                  reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    InitParallelShaderCompile();
+
+    if (InitSpriteShaders()) {
+        shaderStats.Print("Sprite shaders");
+    }
+    
+    // Scenes render into an offscreen target at the render size; EndFrame
+    // scales it to the output
+    viewport = {0, 0, GetRenderWidth(), GetRenderHeight()};
+    CreateRenderTargets();
+
+    // Environment bakes attach their target faces and levels per pass
+    glGenFramebuffers(1, &fbo_env);
+
+    // Fullscreen strip for the environment and post-processing passes
+    static const float quad[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+    glGenVertexArrays(1, &postVAO);
+    StateCache_GLES::BindVertexArray(postVAO);
+    glGenBuffers(1, &postVertBuffer);
+    StateCache_GLES::BindBuffer(GL_ARRAY_BUFFER, postVertBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    StateCache_GLES::BindVertexArray(vao);
+
+    // A chain set before Init compiles now
+    QueuePostShaders();
+
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0);
+}
+
+void Renderer_GLES::ConfigureForOpenGLESVersion() {
+    std::cout << "\n=== OpenGL ES Configuration ===" << std::endl;
+    
+    // ES 3.2+: Advanced compute and synchronization
+    if (glVersionMajor > 3 || (glVersionMajor == 3 && glVersionMinor >= 2)) {
+        std::cout << "OpenGL ES 3.2+: Enabling Advanced Features" << std::endl;
+        // - Geometry shaders
+        // - Tesselation support
+        // - Advanced memory barriers
+    }
+    // ES 3.1: Compute shaders
+    else if (glVersionMajor == 3 && glVersionMinor >= 1) {
+        std::cout << "OpenGL ES 3.1: Enabling Compute Shaders" << std::endl;
+        // - Compute shader support
+        // - Shader storage buffers
+        // - Atomic operations
+    }
+    // ES 3.0: Core modern ES
+    else if (glVersionMajor == 3 && glVersionMinor == 0) {
+        std::cout << "OpenGL ES 3.0: Standard Features" << std::endl;
+        // - Instancing
+        // - Transform feedback
+        // - Occlusion queries
+    }
+    // ES 2.0: Legacy mobile ES
+    else if (glVersionMajor == 2) {
+        std::cout << "OpenGL ES 2.0: Limited Feature Set" << std::endl;
+        // - Basic shader support
+        // - Limited texture formats
+        // - No VAO support
+    }
+    else {
+        std::cout << "OpenGL ES 1.x: Minimal Feature Set" << std::endl;
+    }
+    
+    // Query mobile-specific capabilities
+    GLint maxTextures;
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxTextures);
+    std::cout << "Max Texture Units: " << maxTextures << std::endl;
+    
+    GLint maxVertexAttribs;
+    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxVertexAttribs);
+    std::cout << "Max Vertex Attributes: " << maxVertexAttribs << std::endl;
+    
+    if (glVersionMajor >= 3) {
+        GLint maxDrawBuffers;
+        glGetIntegerv(GL_MAX_DRAW_BUFFERS, &maxDrawBuffers);
+        std::cout << "Max Draw Buffers: " << maxDrawBuffers << std::endl;
+    }
+    
+    std::cout << "==========================\n" << std::endl;
+}
+
+void Renderer_GLES::Close() {
+    // Delete VAO
+    if (vao != 0) {
+        StateCache_GLES::DeleteVertexArrays(1, &vao);
+        vao = 0;
+    }
+    
+    if (postVAO != 0) {
+        StateCache_GLES::DeleteVertexArrays(1, &postVAO);
+        postVAO = 0;
+    }
+    
+    // Delete buffers
+    if (postVertBuffer != 0) StateCache_GLES::DeleteBuffers(1, &postVertBuffer);
+    vertexStream.Destroy();
+    instanceStream.Destroy();
+    uniformStream.Destroy();
+    textureUploads.Destroy();
+    DeleteModelVertexArrays(-1);
+    if (modelVertexBuffer[0] != 0) StateCache_GLES::DeleteBuffers(2, &modelVertexBuffer[0]);
+    if (modelIndexBuffer[0] != 0) StateCache_GLES::DeleteBuffers(2, &modelIndexBuffer[0]);
+
+    // Release shader programs, abandoning those still compiling
+    for (auto& job : shaderJobs) {
+        for (uint32_t shader : job.shaders) {
+            glDeleteShader(shader);
+        }
+        if (job.program != 0) {
+            glDeleteProgram(job.program);
+        }
+    }
+    shaderJobs.clear();
+    programCache.clear();
+    activeSpriteShader = nullptr;
+    spriteShader.reset();
+    spriteInstancedShader.reset();
+    modelShader.reset();
+    modelUnlitShader.reset();
+    modelPermutations.Clear();
+    panoramaToCubeMapShader.reset();
+    shadowMapShader.reset();
+    cubemapFilteringShader.reset();
+    postShaderSelect.clear();
+    
+    // Delete framebuffers
+    if (fbo_shadow != 0) StateCache_GLES::DeleteFramebuffers(1, &fbo_shadow);
+    if (fbo_env != 0) StateCache_GLES::DeleteFramebuffers(1, &fbo_env);
+
+    // Delete timer and profiler queries
+    if (!timerQueries.empty()) glDeleteQueries(static_cast<GLsizei>(timerQueries.size()), timerQueries.data());
+    timerQueries.clear();
+    freeTimerQueries.clear();
+    for (auto& slot : profileFrames) {
+        if (!slot.queries.empty()) glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+        slot.queries.clear();
+        slot.regions.clear();
+        slot.used = 0;
+        slot.pending = false;
+    }
+    profileStack.clear();
+    
+    // Delete textures and the main and post-processing targets
+    DestroyRenderTargets();
+    if (fbo_shadow_texture != 0) StateCache_GLES::DeleteTextures(1, &fbo_shadow_texture);
+    fbo_shadow = fbo_shadow_texture = 0;
+}
+
+int Renderer_GLES::InitModelShader() {
+    // Shadows stay off when the atlas cannot be created
+    if (enableShadow && !InitShadowFramebuffer()) {
+        enableShadow = false;
+    }
+    modelDefines = enableShadow ? "#define ENABLE_SHADOW\n" : "";
+    modelPermutations.Clear();
+    // Shadow vertex arrays use the locations of the program replaced here
+    DeleteModelVertexArrays(-1);
+
+    // The unlit stand-in is cheap enough to build right away; it draws
+    // models until the full program below is ready
+    modelUnlitShader = LoadShaderProgram("Model Shader (unlit)", "model.vert.glsl", "modelUnlit.frag.glsl", "",
+                                         modelDefines);
+    if (!modelUnlitShader) {
+        return -1;
+    }
+    RegisterModelInterface(*modelUnlitShader);
+    modelShader = modelUnlitShader;
+
+    // Everything else is submitted at once and swapped in by PollShaderJobs.
+    // Until then the shadow and IBL passes are skipped (their programs are
+    // null), as when the feature is off.
+    bool queued = QueueShaderProgram("Model Shader", "model.vert.glsl", "model.frag.glsl", modelDefines,
+        [this](const std::shared_ptr<ShaderProgram_GLES>& shader) {
+            RegisterModelInterface(*shader);
+            modelShader = shader;
+        });
+    if (enableShadow) {
+        queued = QueueShaderProgram("Shadow Map Shader", "shadow.vert.glsl", "shadow.frag.glsl", "",
+            [this](const std::shared_ptr<ShaderProgram_GLES>& shader) {
+                RegisterShadowInterface(*shader);
+                shadowMapShader = shader;
+            }) && queued;
+    }
+    queued = QueueShaderProgram("Panorama To Cubemap Shader", "ident.vert.glsl", "panoramaToCubeMap.frag.glsl", "",
+        [this](const std::shared_ptr<ShaderProgram_GLES>& shader) {
+            shader->RegisterAttributes({"VertCoord"});
+            shader->RegisterUniforms({"currentFace"});
+            shader->RegisterTextures({"panorama"});
+            panoramaToCubeMapShader = shader;
+        }) && queued;
+    queued = QueueShaderProgram("Cubemap Filtering Shader", "ident.vert.glsl", "cubemapFiltering.frag.glsl", "",
+        [this](const std::shared_ptr<ShaderProgram_GLES>& shader) {
+            shader->RegisterAttributes({"VertCoord"});
+            shader->RegisterUniforms({"sampleCount", "distribution", "width", "currentFace",
+                                      "roughness", "intensityScale", "isLUT"});
+            shader->RegisterTextures({"cubeMap"});
+            cubemapFilteringShader = shader;
+        }) && queued;
+    if (!queued) {
+        return -1;
+    }
+
+    if (shaderJobs.empty()) {
+        shaderStats.Print("Shaders");
+    }
+    return 0;
+}
+
+bool Renderer_GLES::InitSpriteShaders() {
+    spriteShader = LoadShaderProgram("Sprite Shader", "sprite.vert.glsl", "sprite.frag.glsl", "");
+    if (!spriteShader) {
+        return false;
+    }
+    spriteShader->RegisterAttributes({"position", "uv", "palIndex"});
+    spriteShader->RegisterUniforms(SpriteUniformNames);
+    spriteShader->RegisterTextures(SpriteTextureNames);
+    AssignTextureUnits(*spriteShader);
+    activeSpriteShader = spriteShader.get();
+
+    // Optional: RenderQuadInstanced draws one quad at a time without it
+    spriteInstancedShader = LoadShaderProgram("Sprite Shader (instanced)", "sprite.vert.glsl",
+                                              "sprite.frag.glsl", "", "#define INSTANCED\n");
+    if (spriteInstancedShader) {
+        spriteInstancedShader->RegisterAttributes({"position", "uv", "i_modelview", "i_tint", "i_addAlpha",
+                                                   "i_multPalIndex"});
+        spriteInstancedShader->RegisterUniforms(SpriteUniformNames);
+        spriteInstancedShader->RegisterTextures(SpriteTextureNames);
+        AssignTextureUnits(*spriteInstancedShader);
+    }
+    return true;
+}
+
+void Renderer_GLES::BeginFrame(bool clearColor) {
+    // Fence last frame's vertices and uniforms and start writing into the
+    // next segments
+    vertexStream.NextSegment();
+    instanceStream.NextSegment();
+    uniformStream.NextSegment();
+    textureUploads.NextFrame();
+    frameIndex++;
+
+    // Hand finished profiler frames over and start timing this one
+    BeginGPUProfileFrame();
+    BeginGPURegion("BeginFrame");
+
+    // Swap in any programs that finished compiling since the last frame
+    PollShaderJobs();
+
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GLES::Viewport(viewport.x, viewport.y, viewport.width, viewport.height);
+
+    // Clearing or invalidating straight after the bind spares tile-based
+    // GPUs from loading the previous frame
+    const RenderPassPolicy& policy = GetRenderPassPolicy(RenderPass::Scene);
+    AttachmentLoad colorLoad = clearColor ? AttachmentLoad::Clear : policy.colorLoad;
+    if (colorLoad == AttachmentLoad::Clear) {
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     }
-    
-    GLint uvLoc = spriteShader->GetAttributeLocation("uv");
-    if (uvLoc >= 0) {
-        glEnableVertexAttribArray(uvLoc);
-        glVertexAttribPointer(uvLoc, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(float)));
+    LoadAttachments(colorLoad, policy.depthLoad);
+    EndGPURegion();
+}
+
+void Renderer_GLES::EndFrame() {
+    BeginGPURegion("EndFrame");
+
+    // End the scene pass: its depth and, once resolved, its samples are not
+    // read again unless the policy keeps them
+    const RenderPassPolicy& scenePass = GetRenderPassPolicy(RenderPass::Scene);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    InvalidateAttachments(false, scenePass.depthStore == AttachmentStore::DontCare);
+    ResolveSceneTarget();
+    if (fbo_f != 0 && scenePass.colorStore == AttachmentStore::DontCare) {
+        InvalidateAttachments(true, false);
     }
-    
-    GLint palIndexLoc = spriteShader->GetAttributeLocation("palIndex");
-    if (palIndexLoc >= 0) {
-        glEnableVertexAttribArray(palIndexLoc);
-        glVertexAttribPointer(palIndexLoc, 1, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
+
+    // Present the frame to the default framebuffer, where ReadPixels reads
+    // it: through the post chain, or filtered when the render scale is not
+    // 1. Either covers the whole output, so nothing is loaded first.
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    InvalidateAttachments(true, true);
+    if (!RunPostPasses()) {
+        StateCache_GLES::Disable(GL_SCISSOR_TEST);
+        StateCache_GLES::BindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        StateCache_GLES::BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        StateCache_GLES::Check("EndFrame");
+        bool scaled = viewport.width != outputWidth || viewport.height != outputHeight;
+        glBlitFramebuffer(0, 0, viewport.width, viewport.height, 0, 0, outputWidth, outputHeight,
+                          GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
     }
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    EndGPUProfileFrame();
 }
 
-void Renderer_GLES::SetPipelineBatch() {
+void Renderer_GLES::Await() {
+    glFinish();
+}
+
+void Renderer_GLES::Resize(int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0 || (width == outputWidth && height == outputHeight)) return;
+    outputWidth = width;
+    outputHeight = height;
+    UpdateRenderTargets();
+}
+
+void Renderer_GLES::SetRenderScale(float scale) {
+    renderScale = std::min(std::max(scale, MinRenderScale), MaxRenderScale);
+    UpdateRenderTargets();
+}
+
+void Renderer_GLES::SetMSAASamples(int32_t samples) {
+    samples = samples > 1 ? samples : 0;
+    if (samples == msaaLevel) return;
+    if (fbo == 0) {
+        msaaLevel = samples;
+        return;
+    }
+
+    DestroyRenderTargets();
+    msaaLevel = samples;
+    if (!CreateRenderTargets()) {
+        std::cerr << "Failed to recreate render targets with " << samples << " samples" << std::endl;
+    }
+}
+
+// Only needed without EXT_multisampled_render_to_texture
+void Renderer_GLES::ResolveSceneTarget() {
+    if (fbo_f == 0) return;
+
+    BeginGPURegion("ResolveMSAA");
+    bool scissor = StateCache_GLES::IsEnabled(GL_SCISSOR_TEST);
+    StateCache_GLES::Disable(GL_SCISSOR_TEST);
+    StateCache_GLES::BindFramebuffer(GL_READ_FRAMEBUFFER, fbo_f);
+    StateCache_GLES::BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+    StateCache_GLES::Check("ResolveSceneTarget");
+    glBlitFramebuffer(0, 0, viewport.width, viewport.height, 0, 0, viewport.width, viewport.height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo_f);
+    if (scissor) StateCache_GLES::Enable(GL_SCISSOR_TEST);
+    EndGPURegion();
+}
+
+void Renderer_GLES::LoadAttachments(AttachmentLoad color, AttachmentLoad depth) {
+    InvalidateAttachments(color == AttachmentLoad::DontCare, depth == AttachmentLoad::DontCare);
+    GLbitfield clearBits = (color == AttachmentLoad::Clear ? GL_COLOR_BUFFER_BIT : 0) |
+                           (depth == AttachmentLoad::Clear ? GL_DEPTH_BUFFER_BIT : 0);
+    if (clearBits != 0) {
+        glClear(clearBits);
+    }
+}
+
+void Renderer_GLES::InvalidateAttachments(bool color, bool depth) {
+    // The default framebuffer names its buffers differently; absent
+    // attachments (stencil) are ignored
+    bool window = StateCache_GLES::GetFramebuffer(GL_DRAW_FRAMEBUFFER) == 0;
+    GLenum attachments[3];
+    GLsizei count = 0;
+    if (color) {
+        attachments[count++] = window ? GL_COLOR : GL_COLOR_ATTACHMENT0;
+    }
+    if (depth) {
+        attachments[count++] = window ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+        attachments[count++] = window ? GL_STENCIL : GL_STENCIL_ATTACHMENT;
+    }
+    if (count > 0) {
+        glInvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, count, attachments);
+    }
+}
+
+void Renderer_GLES::SetPostChain(const std::vector<PostEffect>& chain) {
+    postPasses = PlanPostPasses(chain);
+    postShaderSelect.clear();
+    if (fbo != 0) {
+        QueuePostShaders();
+    }
+}
+
+void Renderer_GLES::ReloadPostShaders() {
+    if (fbo != 0) {
+        QueuePostShaders();
+    }
+}
+
+// Keeps the current programs, so a reload swaps each pass over once its
+// replacement links and a failed edit leaves the running one in place
+void Renderer_GLES::QueuePostShaders() {
+    uint32_t generation = ++postGeneration;
+    postShaderSelect.resize(postPasses.size());
+    for (size_t i = 0; i < postPasses.size(); ++i) {
+        QueueShaderProgram("Post Shader (" + PostPassName(postPasses[i]) + ")", "ident.vert.glsl",
+                           "post.frag.glsl", PostPassDefines(postPasses[i]),
+            [this, i, generation](const std::shared_ptr<ShaderProgram_GLES>& shader) {
+                if (generation != postGeneration) return;
+                shader->RegisterAttributes({"VertCoord"});
+                shader->RegisterUniforms({"TextureSize", "InputScale", "SceneSize"});
+                shader->RegisterTextures({"Texture"});
+                postShaderSelect[i] = shader;
+            });
+    }
+}
+
+bool Renderer_GLES::RunPostPasses() {
+    if (postPasses.empty() || fbo_pp.size() < 2) return false;
+    for (const auto& shader : postShaderSelect) {
+        if (!shader) return false;
+    }
+
+    // Each target is sized exactly for the largest pass drawing into it
+    // (the render size when none does), so a shorter chain or a smaller
+    // render size frees memory, and chains alternating sizes on one target
+    // do not reallocate every frame
+    int32_t targetSize[2][2] = {{viewport.width, viewport.height}, {viewport.width, viewport.height}};
+    int32_t passWidth = viewport.width, passHeight = viewport.height;
+    for (size_t i = 0; i + 1 < postPasses.size(); ++i) {
+        passWidth *= postPasses[i].scale;
+        passHeight *= postPasses[i].scale;
+        int32_t* size = targetSize[i % 2];
+        size[0] = std::max(size[0], passWidth);
+        size[1] = std::max(size[1], passHeight);
+    }
+    for (int32_t target = 0; target < 2; ++target) {
+        if (!CreatePostTarget(target, targetSize[target][0], targetSize[target][1])) {
+            return false;
+        }
+    }
+
+    BeginGPURegion("PostProcess");
+    StateCache_GLES::Disable(GL_SCISSOR_TEST);
+    StateCache_GLES::Disable(GL_BLEND);
+    StateCache_GLES::Disable(GL_DEPTH_TEST);
+    StateCache_GLES::Disable(GL_CULL_FACE);
+
+    // Each pass reads the region of its source the previous pass drew; the
+    // last one draws straight to the output
+    uint32_t source = fbo_texture;
+    int32_t sourceWidth = viewport.width, sourceHeight = viewport.height;
+    int32_t textureWidth = viewport.width, textureHeight = viewport.height;
+    for (size_t i = 0; i < postPasses.size(); ++i) {
+        bool last = i + 1 == postPasses.size();
+        int32_t target = static_cast<int32_t>(i % 2);
+        int32_t width = last ? outputWidth : sourceWidth * postPasses[i].scale;
+        int32_t height = last ? outputHeight : sourceHeight * postPasses[i].scale;
+
+        const ShaderProgram_GLES& shader = *postShaderSelect[i];
+        StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, last ? 0 : fbo_pp[target]);
+        if (!last) {
+            InvalidateAttachments(true, false);
+        }
+        StateCache_GLES::Viewport(0, 0, width, height);
+        StateCache_GLES::UseProgram(shader.GetProgram());
+        int32_t unit = shader.GetTextureUnit("Texture");
+        StateCache_GLES::ActiveTexture(GL_TEXTURE0 + unit);
+        StateCache_GLES::BindTexture(GL_TEXTURE_2D, source);
+        glUniform1i(shader.GetUniformLocation("Texture"), unit);
+        glUniform2f(shader.GetUniformLocation("TextureSize"), static_cast<float>(sourceWidth),
+                    static_cast<float>(sourceHeight));
+        glUniform2f(shader.GetUniformLocation("InputScale"), static_cast<float>(sourceWidth) / textureWidth,
+                    static_cast<float>(sourceHeight) / textureHeight);
+        glUniform2f(shader.GetUniformLocation("SceneSize"), static_cast<float>(viewport.width),
+                    static_cast<float>(viewport.height));
+        DrawFullscreenQuad(shader);
+
+        source = fbo_pp_texture[target];
+        sourceWidth = width;
+        sourceHeight = height;
+        textureWidth = postTargetSize[target][0];
+        textureHeight = postTargetSize[target][1];
+    }
+    EndGPURegion();
+    return true;
+}
+
+bool Renderer_GLES::IsModelEnabled() const {
+    return enableModel;
+}
+
+bool Renderer_GLES::IsShadowEnabled() const {
+    return enableShadow;
+}
+
+void Renderer_GLES::BlendReset() {
+    StateCache_GLES::Disable(GL_BLEND);
+    glState.blendEquation = BlendEquation::Add;
+    glState.blendSrc = BlendFunc::One;
+    glState.blendDst = BlendFunc::Zero;
+}
+
+// glState keeps the values the model pipeline asked for; the release
+// functions change GL state behind it, so the setters always go to the
+// state cache, which drops what is already set
+void Renderer_GLES::SetBlending(BlendEquation eq, BlendFunc src, BlendFunc dst) {
+    glState.blendEquation = eq;
+    glState.blendSrc = src;
+    glState.blendDst = dst;
+
+    StateCache_GLES::Enable(GL_BLEND);
+    StateCache_GLES::BlendEquation(MapBlendEquation(eq));
+    StateCache_GLES::BlendFunc(MapBlendFunction(src), MapBlendFunction(dst));
+}
+
+void Renderer_GLES::SetDepthTest(bool depthTest) {
+    glState.depthTest = depthTest;
+    if (depthTest) {
+        StateCache_GLES::Enable(GL_DEPTH_TEST);
+    } else {
+        StateCache_GLES::Disable(GL_DEPTH_TEST);
+    }
+}
+
+void Renderer_GLES::SetDepthMask(bool depthMask) {
+    glState.depthMask = depthMask;
+    StateCache_GLES::DepthMask(depthMask ? GL_TRUE : GL_FALSE);
+}
+
+void Renderer_GLES::SetFrontFace(bool invertFrontFace) {
+    glState.invertFrontFace = invertFrontFace;
+    StateCache_GLES::FrontFace(invertFrontFace ? GL_CW : GL_CCW);
+}
+
+void Renderer_GLES::SetCullFace(bool doubleSided) {
+    glState.doubleSided = doubleSided;
+    if (doubleSided) {
+        StateCache_GLES::Disable(GL_CULL_FACE);
+    } else {
+        StateCache_GLES::Enable(GL_CULL_FACE);
+    }
+}
+
+void Renderer_GLES::SetPipeline(BlendEquation eq, BlendFunc src, BlendFunc dst) {
     if (!spriteShader) return;
+
+    // An instanced pipeline left unreleased must not leak its divisors
+    if (instancedPipeline) {
+        ReleaseSpriteInstanceAttributes();
+        instancedPipeline = false;
+    }
+    activeSpriteShader = spriteShader.get();
+    BindSpritePipeline(eq, src, dst);
+}
+
+void Renderer_GLES::BindSpritePipeline(BlendEquation eq, BlendFunc src, BlendFunc dst) {
+    BeginPassRegion(ProfilePassSprites);
+    StateCache_GLES::UseProgram(activeSpriteShader->GetProgram());
+    SetBlending(eq, src, dst);
+    SetDepthTest(false);
+    SetCullFace(true);
     
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferBatch);
+    SetupSpriteVertexAttributes();
+}
+
+void Renderer_GLES::SetPipelineBatch() {
+    if (!activeSpriteShader) return;
+
+    SetupSpriteVertexAttributes();
+}
+
+void Renderer_GLES::SetPipelineInstanced(BlendEquation eq, BlendFunc src, BlendFunc dst) {
+    // Without the INSTANCED program RenderQuadInstanced falls back to one
+    // draw per instance on the regular sprite program
+    if (!spriteShader) return;
+
+    instancedPipeline = spriteInstancedShader && capabilities.hasInstancedArrays;
+    activeSpriteShader = instancedPipeline ? spriteInstancedShader.get() : spriteShader.get();
+    BindSpritePipeline(eq, src, dst);
+}
+
+void Renderer_GLES::SetupSpriteVertexAttributes() {
+    // Bind the vertex stream and set up attributes
+    StateCache_GLES::BindBuffer(GL_ARRAY_BUFFER, vertexStream.GetHandle());
     
-    GLint stride = 5 * sizeof(float);
+    GLint stride = SpriteVertexStride;  // position(2) + uv(2) + palIndex(1)
     
-    GLint posLoc = spriteShader->GetAttributeLocation("position");
+    GLint posLoc = activeSpriteShader->GetAttributeLocation("position");
     if (posLoc >= 0) {
         glEnableVertexAttribArray(posLoc);
         glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
     }
     
-    GLint uvLoc = spriteShader->GetAttributeLocation("uv");
+    GLint uvLoc = activeSpriteShader->GetAttributeLocation("uv");
     if (uvLoc >= 0) {
         glEnableVertexAttribArray(uvLoc);
         glVertexAttribPointer(uvLoc, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(float)));
     }
     
-    GLint palIndexLoc = spriteShader->GetAttributeLocation("palIndex");
+    GLint palIndexLoc = activeSpriteShader->GetAttributeLocation("palIndex");
     if (palIndexLoc >= 0) {
         glEnableVertexAttribArray(palIndexLoc);
         glVertexAttribPointer(palIndexLoc, 1, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
     }
 }
 
+void Renderer_GLES::SetupSpriteInstanceAttributes(size_t offset) {
+    StateCache_GLES::BindBuffer(GL_ARRAY_BUFFER, instanceStream.GetHandle());
+    GLint stride = sizeof(SpriteInstance);
+
+    for (const auto& attr : SpriteInstanceAttributes) {
+        GLint loc = activeSpriteShader->GetAttributeLocation(attr.name);
+        if (loc < 0) continue;
+        for (int column = 0; column < attr.columns; ++column) {
+            glEnableVertexAttribArray(loc + column);
+            glVertexAttribPointer(loc + column, 4, GL_FLOAT, GL_FALSE, stride,
+                                  (void*)(offset + attr.offset + column * 4 * sizeof(float)));
+            glVertexAttribDivisor(loc + column, 1);
+        }
+    }
+}
+
+void Renderer_GLES::ReleaseSpriteInstanceAttributes() {
+    // The VAO is shared with the regular sprite program, so divisors must not leak
+    for (const auto& attr : SpriteInstanceAttributes) {
+        GLint loc = activeSpriteShader->GetAttributeLocation(attr.name);
+        if (loc < 0) continue;
+        for (int column = 0; column < attr.columns; ++column) {
+            glVertexAttribDivisor(loc + column, 0);
+            glDisableVertexAttribArray(loc + column);
+        }
+    }
+}
+
 void Renderer_GLES::ReleasePipeline() {
-    if (!spriteShader) return;
+    if (!activeSpriteShader) return;
     
-    GLint posLoc = spriteShader->GetAttributeLocation("position");
+    GLint posLoc = activeSpriteShader->GetAttributeLocation("position");
     if (posLoc >= 0) glDisableVertexAttribArray(posLoc);
     
-    GLint uvLoc = spriteShader->GetAttributeLocation("uv");
+    GLint uvLoc = activeSpriteShader->GetAttributeLocation("uv");
     if (uvLoc >= 0) glDisableVertexAttribArray(uvLoc);
     
-    GLint palIndexLoc = spriteShader->GetAttributeLocation("palIndex");
+    GLint palIndexLoc = activeSpriteShader->GetAttributeLocation("palIndex");
     if (palIndexLoc >= 0) glDisableVertexAttribArray(palIndexLoc);
+
+    if (instancedPipeline) {
+        ReleaseSpriteInstanceAttributes();
+        instancedPipeline = false;
+    }
+    // Setters between pipelines apply to the regular program
+    activeSpriteShader = spriteShader.get();
     
-    glUseProgram(0);
+    StateCache_GLES::UseProgram(0);
+    EndPassRegion(ProfilePassSprites);
 }
 
 void Renderer_GLES::prepareShadowMapPipeline(uint32_t bufferIndex) {
-    // OpenGL ES 3.1 doesn't support geometry shaders for shadow mapping
+    if (!IsShadowReady()) return;
+
+    BeginPassRegion(ProfilePassShadows);
+
+    StateCache_GLES::UseProgram(shadowMapShader->GetProgram());
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo_shadow);
+    StateCache_GLES::Viewport(0, 0, shadowAtlasSize, shadowAtlasSize);
+    StateCache_GLES::Disable(GL_BLEND);
+    StateCache_GLES::Enable(GL_DEPTH_TEST);
+    StateCache_GLES::DepthFunc(GL_LESS);
+    StateCache_GLES::DepthMask(GL_TRUE);
+    const RenderPassPolicy& policy = GetRenderPassPolicy(RenderPass::Shadows);
+    LoadAttachments(policy.colorLoad, policy.depthLoad);
+
+    // Each mesh's vertex array binds the buffers (setShadowMapPipeline)
+    modelBufferIndex = bufferIndex;
 }
 
 void Renderer_GLES::setShadowMapPipeline(bool doubleSided, bool invertFrontFace, 
                                          bool useUV, bool useNormal, bool useTangent,
                                          bool useVertColor, bool useJoint0, bool useJoint1,
                                          uint32_t numVertices, uint32_t vertAttrOffset) {
-    // TODO: Implement when shadow map shader is available
+    if (!shadowMapShader) return;
+
+    SetFrontFace(invertFrontFace);
+    SetCullFace(doubleSided);
+
+    glState.useUV = useUV;
+    glState.useJoint0 = useJoint0;
+    glState.useJoint1 = useJoint1;
+
+    // Only positions are read; the other attributes are skipped over
+    uint32_t features = (useUV ? ModelFeatureUV : 0) | (useNormal ? ModelFeatureNormal : 0) |
+                        (useTangent ? ModelFeatureTangent : 0) | (useVertColor ? ModelFeatureVertColor : 0) |
+                        (useJoint0 ? ModelFeatureJoint0 : 0) | (useJoint1 ? ModelFeatureJoint1 : 0);
+    BindModelVertexArray(features, numVertices, vertAttrOffset, true);
+}
+
+void Renderer_GLES::SetShadowAtlasView(int32_t x, int32_t y, int32_t size) {
+    if (!IsShadowReady()) return;
+
+    // The scissor limits the clear to the tile and keeps draws that miss
+    // the light's frustum out of the neighbouring ones
+    StateCache_GLES::Viewport(x, y, size, size);
+    StateCache_GLES::Enable(GL_SCISSOR_TEST);
+    StateCache_GLES::Scissor(x, y, size, size);
+    StateCache_GLES::DepthMask(GL_TRUE);
+    glClear(GL_DEPTH_BUFFER_BIT);
 }
 
 void Renderer_GLES::ReleaseShadowPipeline() {
-    // TODO: Implement when shadow map shader is available
+    if (GetRenderPassPolicy(RenderPass::Shadows).depthStore == AttachmentStore::DontCare) {
+        InvalidateAttachments(false, true);
+    }
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GLES::Viewport(viewport.x, viewport.y, viewport.width, viewport.height);
+    StateCache_GLES::Disable(GL_SCISSOR_TEST);
+    StateCache_GLES::BindVertexArray(vao);
+    StateCache_GLES::DepthMask(GL_TRUE);
+    StateCache_GLES::Disable(GL_DEPTH_TEST);
+    StateCache_GLES::Disable(GL_CULL_FACE);
+    StateCache_GLES::Disable(GL_BLEND);
+
+    glState.useUV = false;
+    glState.useJoint0 = false;
+    glState.useJoint1 = false;
+    EndPassRegion(ProfilePassShadows);
 }
 
 void Renderer_GLES::prepareModelPipeline(uint32_t bufferIndex, const Environment* env) {
-    // TODO: Implement when model shader is available
+    if (!modelShader) return;
+
+    BeginPassRegion(ProfilePassModels);
+
+    StateCache_GLES::UseProgram(modelShader->GetProgram());
+    boundModelProgram = modelShader->GetProgram();
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GLES::Viewport(viewport.x, viewport.y, viewport.width, viewport.height);
+    LoadAttachments(AttachmentLoad::Load, GetRenderPassPolicy(RenderPass::Models).depthLoad);
+    StateCache_GLES::Enable(GL_BLEND);
+
+    if (glState.depthTest) {
+        StateCache_GLES::Enable(GL_DEPTH_TEST);
+        StateCache_GLES::DepthFunc(GL_LESS);
+    } else {
+        StateCache_GLES::Disable(GL_DEPTH_TEST);
+    }
+
+    StateCache_GLES::DepthMask(glState.depthMask);
+    StateCache_GLES::FrontFace(glState.invertFrontFace ? GL_CW : GL_CCW);
+
+    if (!glState.doubleSided) {
+        StateCache_GLES::Enable(GL_CULL_FACE);
+        StateCache_GLES::CullFace(GL_BACK);
+    } else {
+        StateCache_GLES::Disable(GL_CULL_FACE);
+    }
+
+    StateCache_GLES::BlendEquation(MapBlendEquation(glState.blendEquation));
+    StateCache_GLES::BlendFunc(MapBlendFunction(glState.blendSrc), MapBlendFunction(glState.blendDst));
+
+    // model.frag skips image-based lighting at zero intensity
+    static const UniformID lambertianID = InternUniform("lambertianEnvSampler");
+    static const UniformID GGXID = InternUniform("GGXEnvSampler");
+    static const UniformID GGXLUTID = InternUniform("GGXLUT");
+    static const UniformID intensityID = InternUniform("environmentIntensity");
+    static const UniformID mipCountID = InternUniform("mipCount");
+    if (env && env->IsReady()) {
+        SetModelTexture(lambertianID, env->lambertianTexture);
+        SetModelTexture(GGXID, env->GGXTexture);
+        SetModelTexture(GGXLUTID, env->GGXLUT);
+        SetModelUniformF(intensityID, &env->intensity, 1);
+        SetModelUniformI(mipCountID, env->GetMipCount());
+        SetModelUniformMatrix3("environmentRotation", std::vector<float>(env->rotation, env->rotation + 9));
+    } else {
+        const float intensity = 0.0f;
+        SetModelUniformF(intensityID, &intensity, 1);
+    }
+
+    // ENABLE_SHADOW programs read every light's shadows from the atlas
+    static const UniformID shadowAtlasID = InternUniform("shadowAtlas");
+    int32_t shadowUnit = fbo_shadow_texture != 0 ? modelShader->GetTextureUnit(shadowAtlasID) : -1;
+    if (shadowUnit >= 0) {
+        StateCache_GLES::ActiveTexture(GL_TEXTURE0 + shadowUnit);
+        StateCache_GLES::BindTexture(GL_TEXTURE_2D, fbo_shadow_texture);
+    }
+
+    // Each mesh's vertex array binds the buffers (SetModelPipeline)
+    modelBufferIndex = bufferIndex;
 }
 
 void Renderer_GLES::SetModelPipeline(BlendEquation eq, BlendFunc src, BlendFunc dst,
@@ -758,7 +2245,40 @@ void Renderer_GLES::SetModelPipeline(BlendEquation eq, BlendFunc src, BlendFunc
                                      bool useTangent, bool useVertColor, bool useJoint0,
                                      bool useJoint1, bool useOutlineAttribute,
                                      uint32_t numVertices, uint32_t vertAttrOffset) {
-    // TODO: Implement when model shader is available
+    if (!modelShader) return;
+
+    SetDepthTest(depthTest);
+    SetDepthMask(depthMask);
+    SetFrontFace(invertFrontFace);
+    SetCullFace(doubleSided);
+    SetBlending(eq, src, dst);
+
+    // Vertex half of the permutation key
+    glState.useUV = useUV;
+    glState.useNormal = useNormal;
+    glState.useTangent = useTangent;
+    glState.useVertColor = useVertColor;
+    glState.useJoint0 = useJoint0;
+    glState.useJoint1 = useJoint1;
+    glState.useOutlineAttribute = useOutlineAttribute;
+
+    BindModelVertexArray(ModelVertexFeatures(glState), numVertices, vertAttrOffset, false);
+
+    // Generic attribute values are not vertex array state. Absent streams
+    // must read as neutral: the GL default (0,0,0,1) gives weights and the
+    // outline a w of 1, which the generic program takes as skinned and
+    // outlined vertices.
+    if (!useUV) glVertexAttrib2f(ModelLocationUV, 0.0f, 0.0f);
+    if (!useVertColor) glVertexAttrib4f(ModelLocationVertColor, 1.0f, 1.0f, 1.0f, 1.0f);
+    if (!useJoint0) {
+        glVertexAttrib4f(ModelLocationJoint0, 0.0f, 0.0f, 0.0f, 0.0f);
+        glVertexAttrib4f(ModelLocationWeight0, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+    if (!useJoint0 || !useJoint1) {
+        glVertexAttrib4f(ModelLocationJoint1, 0.0f, 0.0f, 0.0f, 0.0f);
+        glVertexAttrib4f(ModelLocationWeight1, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+    if (!useOutlineAttribute) glVertexAttrib4f(ModelLocationOutlineAttribute, 0.0f, 0.0f, 0.0f, 0.0f);
 }
 
 void Renderer_GLES::SetMeshOulinePipeline(bool invertFrontFace, float meshOutline) {
@@ -766,23 +2286,49 @@ void Renderer_GLES::SetMeshOulinePipeline(bool invertFrontFace, float meshOutlin
 }
 
 void Renderer_GLES::ReleaseModelPipeline() {
-    // TODO: Implement when model shader is available
+    if (!modelShader) return;
+
+    StateCache_GLES::DepthMask(true);
+    StateCache_GLES::Disable(GL_DEPTH_TEST);
+    StateCache_GLES::Disable(GL_CULL_FACE);
+    StateCache_GLES::BindVertexArray(vao);
+    boundModelProgram = 0;
+
+    glState.useUV = false;
+    glState.useNormal = false;
+    glState.useTangent = false;
+    glState.useVertColor = false;
+    glState.useJoint0 = false;
+    glState.useJoint1 = false;
+    glState.useOutlineAttribute = false;
+
+    // The next model pass clears the depth again
+    if (GetRenderPassPolicy(RenderPass::Models).depthStore == AttachmentStore::DontCare) {
+        StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+        InvalidateAttachments(false, true);
+    }
+    EndPassRegion(ProfilePassModels);
 }
 
+// Takes a top-left origin rectangle in output pixels
 void Renderer_GLES::Scissor(int32_t x, int32_t y, int32_t width, int32_t height) {
-    glEnable(GL_SCISSOR_TEST);
-    glScissor(x, y, width, height);
+    int32_t left = x * viewport.width / outputWidth;
+    int32_t right = (x + width) * viewport.width / outputWidth;
+    int32_t top = y * viewport.height / outputHeight;
+    int32_t bottom = (y + height) * viewport.height / outputHeight;
+    StateCache_GLES::Enable(GL_SCISSOR_TEST);
+    StateCache_GLES::Scissor(left, viewport.height - bottom, right - left, bottom - top);
 }
 
 void Renderer_GLES::DisableScissor() {
-    glDisable(GL_SCISSOR_TEST);
+    StateCache_GLES::Disable(GL_SCISSOR_TEST);
 }
 
 // Texture factory methods
 std::shared_ptr<ITexture> Renderer_GLES::newTexture(int32_t width, int32_t height, 
                                                          int32_t depth, bool filter) {
     GLuint handle = 0;
-    glActiveTexture(GL_TEXTURE0);
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0);
     glGenTextures(1, &handle);
     return std::make_shared<Texture_GLES>(width, height, depth, filter, handle);
 }
@@ -793,20 +2339,19 @@ std::shared_ptr<ITexture> Renderer_GLES::newPaletteTexture() {
 
 std::shared_ptr<ITexture> Renderer_GLES::newPaletteTextureArray(int32_t layers) {
     GLuint handle = 0;
-    glActiveTexture(GL_TEXTURE0);
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0);
     glGenTextures(1, &handle);
     
     auto tex = std::make_shared<Texture_GLES>(256, 1, layers, false, handle);
     
-    glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
-    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 256, 1, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    tex->Allocate(GL_TEXTURE_2D_ARRAY, GL_RGBA8, 1, layers);
     
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     
-    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D_ARRAY, 0);
     
     return tex;
 }
@@ -818,34 +2363,36 @@ std::shared_ptr<ITexture> Renderer_GLES::newModelTexture(int32_t width, int32_t
 
 std::shared_ptr<ITexture> Renderer_GLES::newDataTexture(int32_t width, int32_t height) {
     GLuint handle = 0;
-    glActiveTexture(GL_TEXTURE0);
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0);
     glGenTextures(1, &handle);
     
-    auto tex = std::make_shared<Texture_GLES>(width, height, 32, false, handle);
+    auto tex = std::make_shared<Texture_GLES>(width, height, 128, false, handle);
     
-    glBindTexture(GL_TEXTURE_2D, handle);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, handle);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
     
     return tex;
 }
 
 std::shared_ptr<ITexture> Renderer_GLES::newHDRTexture(int32_t width, int32_t height) {
     GLuint handle = 0;
-    glActiveTexture(GL_TEXTURE0);
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0);
     glGenTextures(1, &handle);
     
-    auto tex = std::make_shared<Texture_GLES>(width, height, 24, false, handle);
+    // Only read while baking the environment cubemaps; linear filtering of
+    // RGB32F needs OES_texture_float_linear
+    auto tex = std::make_shared<Texture_GLES>(width, height, 96, false, handle);
+    tex->Allocate(GL_TEXTURE_2D, iblPrecision == IBLPrecision::Half ? GL_RGB16F : GL_RGB32F, 1);
     
-    glBindTexture(GL_TEXTURE_2D, handle);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
     
     return tex;
 }
@@ -853,59 +2400,238 @@ std::shared_ptr<ITexture> Renderer_GLES::newHDRTexture(int32_t width, int32_t he
 std::shared_ptr<ITexture> Renderer_GLES::newCubeMapTexture(int32_t widthHeight, bool mipmap,
                                                                 int32_t lowestMipLevel) {
     GLuint handle = 0;
-    glActiveTexture(GL_TEXTURE0);
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0);
     glGenTextures(1, &handle);
     
     auto tex = std::make_shared<Texture_GLES>(widthHeight, widthHeight, 24, false, handle);
     
-    glBindTexture(GL_TEXTURE_CUBE_MAP, handle);
-    
-    // Allocate storage for all 6 faces
-    for (int i = 0; i < 6; i++) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 
-                    widthHeight, widthHeight, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    
+    // Mip levels stop at lowestMipLevel when it is set and run down to 1x1
+    // otherwise. RGBA16F rather than RGB16F: ES only renders to the former
+    // (EXT_color_buffer_half_float / EXT_color_buffer_float). Full
+    // precision renders to RGBA32F (EXT_color_buffer_float).
+    GLint levels = 1;
     if (mipmap) {
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, lowestMipLevel);
-    } else {
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        levels = MipLevelCount(widthHeight, widthHeight);
+        if (lowestMipLevel > 0) {
+            levels = std::min(levels, lowestMipLevel + 1);
+        }
     }
+    tex->Allocate(GL_TEXTURE_CUBE_MAP, iblPrecision == IBLPrecision::Half ? GL_RGBA16F : GL_RGBA32F, levels);
+    
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_CUBE_MAP, 0);
     
     return tex;
 }
 
+std::shared_ptr<ITexture> Renderer_GLES::newLUTTexture(int32_t widthHeight) {
+    GLuint handle = 0;
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &handle);
+
+    // model.frag reads the scale and bias from .rg only; RG16F renders with
+    // EXT_color_buffer_half_float, RGBA32F with EXT_color_buffer_float
+    auto tex = std::make_shared<Texture_GLES>(widthHeight, widthHeight, 128, false, handle);
+    tex->Allocate(GL_TEXTURE_2D, iblPrecision == IBLPrecision::Half ? GL_RG16F : GL_RGBA32F, 1);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
+
+    return tex;
+}
+
+// Every texture of this backend is a Texture_GLES (see newTexture)
+void Renderer_GLES::SetTextureData(const std::shared_ptr<ITexture>& tex, const std::vector<uint8_t>& data) {
+    if (!tex) return;
+    Texture_GLES* texture = static_cast<Texture_GLES*>(tex.get());
+
+    // Allocate level 0 now and let the texels follow through the ring
+    texture->SetData({});
+    if (!data.empty()) {
+        textureUploads.Upload(*texture, data, 0, 0, texture->GetWidth(), texture->GetHeight());
+    }
+}
+
+void Renderer_GLES::SetTextureSubData(const std::shared_ptr<ITexture>& tex, const std::vector<uint8_t>& data,
+                                      int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (!tex) return;
+    textureUploads.Upload(*static_cast<Texture_GLES*>(tex.get()), data, x, y, width, height);
+}
+
+bool Renderer_GLES::IsTextureReady(const std::shared_ptr<ITexture>& tex) const {
+    return tex && !textureUploads.IsPending(tex->GetHandle());
+}
+
+void Renderer_GLES::SetTexturePixelData(const std::shared_ptr<ITexture>& tex, const std::vector<float>& data) {
+    if (!tex) return;
+    static_cast<Texture_GLES*>(tex.get())->SetPixelData(data);
+}
+
+// ES has no glGetTexImage: each face is attached to fbo_env and read as
+// RGBA floats, then packed down to the components the format stores
+bool Renderer_GLES::ReadTextureLevel(const std::shared_ptr<ITexture>& tex, int32_t level, std::vector<uint8_t>& data) {
+    if (!tex) return false;
+    const Texture_GLES* texture = static_cast<const Texture_GLES*>(tex.get());
+    const int32_t components = TransferComponents(texture->GetInternalFormat());
+    GLenum target = texture->GetTarget();
+    if (components == 0 || target == GL_TEXTURE_2D_ARRAY || level < 0 || level >= texture->GetLevels()) {
+        return false;
+    }
+
+    const int32_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    const int32_t width = std::max(texture->GetWidth() >> level, 1);
+    const int32_t height = std::max(texture->GetHeight() >> level, 1);
+    const size_t texels = static_cast<size_t>(width) * height;
+    data.resize(texels * components * sizeof(float) * faces);
+
+    std::vector<float> rgba(texels * 4);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo_env);
+    for (int32_t face = 0; face < faces; ++face) {
+        GLenum image = faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, image, texture->GetHandle(), level);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, rgba.data());
+
+        float* out = reinterpret_cast<float*>(data.data()) + texels * components * face;
+        for (size_t i = 0; i < texels; ++i) {
+            for (int32_t c = 0; c < components; ++c) {
+                out[i * components + c] = rgba[i * 4 + c];
+            }
+        }
+    }
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    return true;
+}
+
+bool Renderer_GLES::WriteTextureLevel(const std::shared_ptr<ITexture>& tex, int32_t level, const std::vector<uint8_t>& data) {
+    if (!tex) return false;
+    const Texture_GLES* texture = static_cast<const Texture_GLES*>(tex.get());
+    const int32_t components = TransferComponents(texture->GetInternalFormat());
+    GLenum target = texture->GetTarget();
+    if (components == 0 || target == GL_TEXTURE_2D_ARRAY || level < 0 || level >= texture->GetLevels()) {
+        return false;
+    }
+
+    const int32_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    const int32_t width = std::max(texture->GetWidth() >> level, 1);
+    const int32_t height = std::max(texture->GetHeight() >> level, 1);
+    const size_t faceSize = static_cast<size_t>(width) * height * components * sizeof(float);
+    if (data.size() != faceSize * faces) return false;
+
+    GLenum format = components == 2 ? GL_RG : GL_RGBA;
+    StateCache_GLES::BindTexture(target, texture->GetHandle());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    for (int32_t face = 0; face < faces; ++face) {
+        GLenum image = faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+        glTexSubImage2D(image, level, 0, 0, width, height, format, GL_FLOAT, data.data() + faceSize * face);
+    }
+    StateCache_GLES::BindTexture(target, 0);
+    return true;
+}
+
+size_t Renderer_GLES::GetTextureMemory() const {
+    return Texture_GLES::GetAllocatedBytes();
+}
+
+// From the current target sizes; every attachment is created with the
+// formats counted here. With EXT_multisampled_render_to_texture the depth
+// renderbuffer holds the samples and fbo_texture only the resolved color.
+size_t Renderer_GLES::GetRenderTargetMemory() const {
+    const size_t color = TextureFormatBytes(GL_RGBA8);
+    const size_t depth = TextureFormatBytes(GL_DEPTH_COMPONENT16);
+    const size_t pixels = static_cast<size_t>(viewport.width) * viewport.height;
+    const bool renderToTexture = msaaLevel > 1 && framebufferTexture2DMultisampleEXT && fbo_f == 0;
+
+    size_t bytes = 0;
+    if (fbo_texture != 0) bytes += pixels * color;
+    if (rbo_depth != 0) bytes += pixels * depth * (renderToTexture ? msaaLevel : 1);
+    if (rbo_f_color != 0) bytes += pixels * color * msaaLevel;
+    if (rbo_f_depth != 0) bytes += pixels * depth * msaaLevel;
+    for (size_t i = 0; i < fbo_pp_texture.size(); ++i) {
+        if (fbo_pp_texture[i] != 0) {
+            bytes += static_cast<size_t>(postTargetSize[i][0]) * postTargetSize[i][1] * color;
+        }
+    }
+    if (fbo_shadow_texture != 0) {
+        bytes += static_cast<size_t>(shadowAtlasSize) * shadowAtlasSize * TextureFormatBytes(GL_DEPTH_COMPONENT24);
+    }
+    return bytes;
+}
+
+void Renderer_GLES::CopyTextureRegion(const std::shared_ptr<ITexture>& src, int32_t srcX, int32_t srcY,
+                                      const std::shared_ptr<ITexture>& dst, int32_t dstX, int32_t dstY,
+                                      int32_t width, int32_t height) {
+    if (!src || !dst || width <= 0 || height <= 0) return;
+
+    // Framebuffer blit: works for any color-renderable format
+    uint32_t previousRead = StateCache_GLES::GetFramebuffer(GL_READ_FRAMEBUFFER);
+    uint32_t previousDraw = StateCache_GLES::GetFramebuffer(GL_DRAW_FRAMEBUFFER);
+    bool scissor = StateCache_GLES::IsEnabled(GL_SCISSOR_TEST);
+    StateCache_GLES::Disable(GL_SCISSOR_TEST);
+
+    GLuint fbos[2] = {0, 0};
+    glGenFramebuffers(2, fbos);
+    StateCache_GLES::BindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src->GetHandle(), 0);
+    StateCache_GLES::BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dst->GetHandle(), 0);
+    glBlitFramebuffer(srcX, srcY, srcX + width, srcY + height, dstX, dstY, dstX + width, dstY + height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    StateCache_GLES::BindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+    StateCache_GLES::BindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+    StateCache_GLES::DeleteFramebuffers(2, fbos);
+    if (scissor) StateCache_GLES::Enable(GL_SCISSOR_TEST);
+}
+
+// Uploads a 1-4 component float uniform from raw memory
+static void UploadUniformF(int32_t loc, const float* values, int count) {
+    switch (count) {
+    case 1:
+        glUniform1fv(loc, 1, values);
+        break;
+    case 2:
+        glUniform2fv(loc, 1, values);
+        break;
+    case 3:
+        glUniform3fv(loc, 1, values);
+        break;
+    case 4:
+        glUniform4fv(loc, 1, values);
+        break;
+    }
+}
+
 void Renderer_GLES::SetTexture(const std::string& name, const std::shared_ptr<ITexture>& tex) {
-    if (!spriteShader || !tex) return;
+    if (!activeSpriteShader || !tex) return;
     
-    GLint unit = spriteShader->GetTextureUnit(name);
+    GLint unit = activeSpriteShader->GetTextureUnit(name);
     if (unit >= 0) {
-        glActiveTexture(GL_TEXTURE0 + unit);
-        if (tex->GetDepth() > 1 || name == "pal") {
-            glBindTexture(GL_TEXTURE_2D_ARRAY, tex->GetHandle());
+        StateCache_GLES::ActiveTexture(GL_TEXTURE0 + unit);
+        if (name == "pal" || (tex->GetDepth() > 1 && tex->GetHeight() == 1)) {
+            StateCache_GLES::BindTexture(GL_TEXTURE_2D_ARRAY, tex->GetHandle());
         } else {
-            glBindTexture(GL_TEXTURE_2D, tex->GetHandle());
+            StateCache_GLES::BindTexture(GL_TEXTURE_2D, tex->GetHandle());
         }
-        glUniform1i(spriteShader->GetUniformLocation(name), unit);
+        glUniform1i(activeSpriteShader->GetUniformLocation(name), unit);
     }
 }
 
 void Renderer_GLES::SetModelTexture(const std::string& name, const std::shared_ptr<ITexture>& tex) {
     if (!modelShader || !tex) return;
     
+    // Sampler units were assigned by RegisterModelInterface
     GLint unit = modelShader->GetTextureUnit(name);
     if (unit >= 0) {
-        glActiveTexture(GL_TEXTURE0 + unit);
-        glBindTexture(GL_TEXTURE_2D, tex->GetHandle());
-        glUniform1i(modelShader->GetUniformLocation(name), unit);
+        StateCache_GLES::ActiveTexture(GL_TEXTURE0 + unit);
+        StateCache_GLES::BindTexture(static_cast<const Texture_GLES*>(tex.get())->GetTarget(), tex->GetHandle());
     }
 }
 
@@ -914,21 +2640,49 @@ void Renderer_GLES::SetShadowMapTexture(const std::string& name, const std::shar
     
     GLint unit = shadowMapShader->GetTextureUnit(name);
     if (unit >= 0) {
-        glActiveTexture(GL_TEXTURE0 + unit);
-        glBindTexture(GL_TEXTURE_2D, tex->GetHandle());
+        StateCache_GLES::ActiveTexture(GL_TEXTURE0 + unit);
+        StateCache_GLES::BindTexture(GL_TEXTURE_2D, tex->GetHandle());
         glUniform1i(shadowMapShader->GetUniformLocation(name), unit);
     }
 }
 
+void Renderer_GLES::SetTexture(UniformID id, const std::shared_ptr<ITexture>& tex) {
+    static const UniformID palID = InternUniform("pal");
+    if (!activeSpriteShader || !tex) return;
+
+    int32_t unit = activeSpriteShader->GetTextureUnit(id);
+    if (unit < 0) return;
+
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0 + unit);
+    if (id == palID || (tex->GetDepth() > 1 && tex->GetHeight() == 1)) {
+        StateCache_GLES::BindTexture(GL_TEXTURE_2D_ARRAY, tex->GetHandle());
+    } else {
+        StateCache_GLES::BindTexture(GL_TEXTURE_2D, tex->GetHandle());
+    }
+    glUniform1i(activeSpriteShader->GetUniformLocation(id), unit);
+}
+
+void Renderer_GLES::SetModelTexture(UniformID id, const std::shared_ptr<ITexture>& tex) {
+    if (!modelShader || !tex) return;
+
+    int32_t unit = modelShader->GetTextureUnit(id);
+    if (unit < 0) return;
+
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0 + unit);
+    StateCache_GLES::BindTexture(static_cast<const Texture_GLES*>(tex.get())->GetTarget(), tex->GetHandle());
+}
+
 void Renderer_GLES::SetUniformI(const std::string& name, int val) {
-    if (!spriteShader) return;
-    GLint loc = spriteShader->GetUniformLocation(name);
+    if (!activeSpriteShader) return;
+    GLint loc = activeSpriteShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(activeSpriteShader, name, &val, sizeof(int), 1)) return;
     if (loc >= 0) glUniform1i(loc, val);
 }
 
 void Renderer_GLES::SetUniformF(const std::string& name, const std::vector<float>& values) {
-    if (!spriteShader) return;
-    GLint loc = spriteShader->GetUniformLocation(name);
+    if (!activeSpriteShader) return;
+    GLint loc = activeSpriteShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(activeSpriteShader, name, values.data(), static_cast<int>(values.size() * sizeof(float)), 1)) return;
     if (loc < 0) return;
     
     switch (values.size()) {
@@ -940,30 +2694,72 @@ void Renderer_GLES::SetUniformF(const std::string& name, const std::vector<float
 }
 
 void Renderer_GLES::SetUniformFv(const std::string& name, const std::vector<float>& values) {
-    if (!spriteShader || values.empty()) return;
-    GLint loc = spriteShader->GetUniformLocation(name);
+    if (!activeSpriteShader || values.empty()) return;
+    GLint loc = activeSpriteShader->GetUniformLocation(name);
+    if (loc < 0) {
+        // Up to 4 floats form one vector, longer inputs are vec4 arrays
+        int elementSize = static_cast<int>(std::min<size_t>(values.size(), 4) * sizeof(float));
+        int count = values.size() > 4 ? static_cast<int>(values.size() / 4) : 1;
+        if (StoreBlockUniform(activeSpriteShader, name, values.data(), elementSize, count)) return;
+    }
     if (loc >= 0) {
         glUniform1fv(loc, values.size(), values.data());
     }
 }
 
 void Renderer_GLES::SetUniformMatrix(const std::string& name, const std::vector<float>& value) {
-    if (!spriteShader || value.size() != 16) return;
-    GLint loc = spriteShader->GetUniformLocation(name);
+    if (!activeSpriteShader || value.size() != 16) return;
+    GLint loc = activeSpriteShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(activeSpriteShader, name, value.data(), 4 * sizeof(float), 4)) return;
     if (loc >= 0) {
         glUniformMatrix4fv(loc, 1, GL_FALSE, value.data());
     }
 }
 
+void Renderer_GLES::SetUniformI(UniformID id, int val) {
+    if (!activeSpriteShader) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        glUniform1i(loc, val);
+    } else {
+        activeSpriteShader->WriteBlockUniform(id, &val, sizeof(int), 1);
+    }
+}
+
+void Renderer_GLES::SetUniformF(UniformID id, const float* values, int count) {
+    if (!activeSpriteShader) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        UploadUniformF(loc, values, count);
+    } else {
+        activeSpriteShader->WriteBlockUniform(id, values, count * sizeof(float), 1);
+    }
+}
+
+void Renderer_GLES::SetUniformMatrix(UniformID id, const float* value) {
+    if (!activeSpriteShader) return;
+    int32_t loc = activeSpriteShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        glUniformMatrix4fv(loc, 1, GL_FALSE, value);
+    } else {
+        activeSpriteShader->WriteBlockUniform(id, value, 4 * sizeof(float), 4);
+    }
+}
+
 void Renderer_GLES::SetModelUniformI(const std::string& name, int val) {
     if (!modelShader) return;
+    if (uint32_t feature = ModelMaterialFeature(InternUniform(name))) {
+        modelMaterialFeatures = val ? (modelMaterialFeatures | feature) : (modelMaterialFeatures & ~feature);
+    }
     GLint loc = modelShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(modelShader.get(), name, &val, sizeof(int), 1)) return;
     if (loc >= 0) glUniform1i(loc, val);
 }
 
 void Renderer_GLES::SetModelUniformF(const std::string& name, const std::vector<float>& values) {
     if (!modelShader) return;
     GLint loc = modelShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(modelShader.get(), name, values.data(), static_cast<int>(values.size() * sizeof(float)), 1)) return;
     if (loc < 0) return;
     
     switch (values.size()) {
@@ -977,14 +2773,36 @@ void Renderer_GLES::SetModelUniformF(const std::string& name, const std::vector<
 void Renderer_GLES::SetModelUniformFv(const std::string& name, const std::vector<float>& values) {
     if (!modelShader || values.empty()) return;
     GLint loc = modelShader->GetUniformLocation(name);
-    if (loc >= 0) {
-        glUniform1fv(loc, values.size(), values.data());
+    if (loc < 0) {
+        // Up to 4 floats form one vector, longer inputs are vec4 arrays
+        int elementSize = static_cast<int>(std::min<size_t>(values.size(), 4) * sizeof(float));
+        int count = values.size() > 4 ? static_cast<int>(values.size() / 4) : 1;
+        if (StoreBlockUniform(modelShader.get(), name, values.data(), elementSize, count)) return;
+    }
+    if (loc < 0) return;
+
+    switch (values.size()) {
+    case 2:
+        glUniform2fv(loc, 1, values.data());
+        break;
+    case 3:
+        glUniform3fv(loc, 1, values.data());
+        break;
+    default:
+        // vec4 arrays: morphTargetWeight, shadowAtlasRects, shadowCascades
+        if (values.size() % 4 == 0) {
+            glUniform4fv(loc, static_cast<GLsizei>(values.size() / 4), values.data());
+        } else {
+            glUniform1fv(loc, static_cast<GLsizei>(values.size()), values.data());
+        }
+        break;
     }
 }
 
 void Renderer_GLES::SetModelUniformMatrix(const std::string& name, const std::vector<float>& value) {
     if (!modelShader || value.size() != 16) return;
     GLint loc = modelShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(modelShader.get(), name, value.data(), 4 * sizeof(float), 4)) return;
     if (loc >= 0) {
         glUniformMatrix4fv(loc, 1, GL_FALSE, value.data());
     }
@@ -993,11 +2811,45 @@ void Renderer_GLES::SetModelUniformMatrix(const std::string& name, const std::ve
 void Renderer_GLES::SetModelUniformMatrix3(const std::string& name, const std::vector<float>& value) {
     if (!modelShader || value.size() != 9) return;
     GLint loc = modelShader->GetUniformLocation(name);
+    if (loc < 0 && StoreBlockUniform(modelShader.get(), name, value.data(), 3 * sizeof(float), 3)) return;
     if (loc >= 0) {
         glUniformMatrix3fv(loc, 1, GL_FALSE, value.data());
     }
 }
 
+void Renderer_GLES::SetModelUniformI(UniformID id, int val) {
+    if (!modelShader) return;
+    if (uint32_t feature = ModelMaterialFeature(id)) {
+        modelMaterialFeatures = val ? (modelMaterialFeatures | feature) : (modelMaterialFeatures & ~feature);
+    }
+    int32_t loc = modelShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        glUniform1i(loc, val);
+    } else {
+        modelShader->WriteBlockUniform(id, &val, sizeof(int), 1);
+    }
+}
+
+void Renderer_GLES::SetModelUniformF(UniformID id, const float* values, int count) {
+    if (!modelShader) return;
+    int32_t loc = modelShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        UploadUniformF(loc, values, count);
+    } else {
+        modelShader->WriteBlockUniform(id, values, count * sizeof(float), 1);
+    }
+}
+
+void Renderer_GLES::SetModelUniformMatrix(UniformID id, const float* value) {
+    if (!modelShader) return;
+    int32_t loc = modelShader->GetUniformLocation(id);
+    if (loc >= 0) {
+        glUniformMatrix4fv(loc, 1, GL_FALSE, value);
+    } else {
+        modelShader->WriteBlockUniform(id, value, 4 * sizeof(float), 4);
+    }
+}
+
 void Renderer_GLES::SetShadowMapUniformI(const std::string& name, int val) {
     if (!shadowMapShader) return;
     GLint loc = shadowMapShader->GetUniformLocation(name);
@@ -1041,67 +2893,686 @@ void Renderer_GLES::SetShadowMapUniformMatrix3(const std::string& name, const st
     }
 }
 
-void Renderer_GLES::SetShadowFrameTexture(uint32_t i) {
-    // OpenGL ES 3.1 doesn't support this
+void Renderer_GLES::SetShadowAtlasSize(int32_t size) {
+    shadowAtlasSize = std::max(0, size);
+    enableShadow = shadowAtlasSize > 0;
 }
 
-void Renderer_GLES::SetShadowFrameCubeTexture(uint32_t i) {
-    // OpenGL ES 3.1 doesn't support this
-}
+int32_t Renderer_GLES::SetVertexData(const std::vector<float>& values) {
+    if (values.empty()) return vertexFirst;
 
-void Renderer_GLES::SetVertexData(const std::vector<float>& values) {
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, values.size() * sizeof(float), values.data(), GL_STREAM_DRAW);
+    // Offsets are stride-aligned so they map directly onto a first vertex
+    uint32_t generation = vertexStream.GetGeneration();
+    size_t offset = vertexStream.Append(values.data(), values.size() * sizeof(float), SpriteVertexStride);
+    if (vertexStream.GetGeneration() != generation && activeSpriteShader) {
+        // The ring was reallocated to fit this upload
+        SetupSpriteVertexAttributes();
+    }
+
+    vertexFirst = static_cast<int32_t>(offset / SpriteVertexStride);
+    return vertexFirst;
 }
 
-void Renderer_GLES::SetVertexDataArray(const std::vector<float>& values) {
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBufferBatch);
-    glBufferData(GL_ARRAY_BUFFER, values.size() * sizeof(float), values.data(), GL_STREAM_DRAW);
+int32_t Renderer_GLES::SetVertexDataArray(const std::vector<float>& values) {
+    return SetVertexData(values);
 }
 
 void Renderer_GLES::SetModelVertexData(uint32_t bufferIndex, const std::vector<uint8_t>& values) {
     if (bufferIndex > 1) return;
-    glBindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer[bufferIndex]);
+    // New contents come with new meshes
+    DeleteModelVertexArrays(bufferIndex);
+
+    StateCache_GLES::BindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer[bufferIndex]);
     glBufferData(GL_ARRAY_BUFFER, values.size(), values.data(), GL_STREAM_DRAW);
 }
 
-void Renderer_GLES::SetModelIndexData(uint32_t bufferIndex, const std::vector<uint32_t>& values) {
-    if (bufferIndex > 1) return;
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelIndexBuffer[bufferIndex]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, values.size() * sizeof(uint32_t), values.data(), GL_STREAM_DRAW);
-}
+void Renderer_GLES::SetModelIndexData(uint32_t bufferIndex, const std::vector<uint32_t>& values) {
+    if (bufferIndex > 1) return;
+    StateCache_GLES::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelIndexBuffer[bufferIndex]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, values.size() * sizeof(uint32_t), values.data(), GL_STREAM_DRAW);
+}
+
+void Renderer_GLES::FlushUniformBlocks(ShaderProgram_GLES* shader) {
+    if (shader && shader->blockOwner) {
+        shader = shader->blockOwner.get();
+    }
+    if (!useUniformBuffers || !shader || !shader->HasUniformBlocks()) {
+        return;
+    }
+
+    // A block is re-uploaded when it changed, on the first draw of each frame
+    // (its previous range lives in a segment that will be recycled) and after
+    // the ring was reallocated. Environment data set once per frame is thus
+    // uploaded exactly once per frame.
+    uint32_t generation = uniformStream.GetGeneration();
+    for (auto& block : shader->blocks) {
+        if (block.dirty || block.uploadFrame != frameIndex || block.uploadGeneration != generation) {
+            block.uploadOffset = uniformStream.Append(block.data.data(), block.data.size(), uniformBufferAlignment);
+            block.uploadFrame = frameIndex;
+            block.uploadGeneration = uniformStream.GetGeneration();
+            block.dirty = false;
+        }
+    }
+    if (uniformStream.GetGeneration() != generation) {
+        // The ring grew mid-flush, leaving earlier blocks in the old buffer
+        FlushUniformBlocks(shader);
+        return;
+    }
+
+    for (auto& block : shader->blocks) {
+        auto& bound = boundBlocks[block.binding];
+        if (bound.generation != block.uploadGeneration || bound.offset != block.uploadOffset) {
+            StateCache_GLES::BindBufferRange(GL_UNIFORM_BUFFER, block.binding, uniformStream.GetHandle(),
+                              block.uploadOffset, block.data.size());
+            bound.generation = block.uploadGeneration;
+            bound.offset = block.uploadOffset;
+        }
+    }
+}
+
+bool Renderer_GLES::StoreBlockUniform(ShaderProgram_GLES* shader, const std::string& name, const void* data,
+                                    int elementSize, int count) {
+    if (!shader->HasUniformBlocks()) {
+        return false;
+    }
+    return shader->WriteBlockUniform(InternUniform(name), data, elementSize, count);
+}
+
+void Renderer_GLES::RenderQuad() {
+    FlushUniformBlocks(activeSpriteShader);
+    StateCache_GLES::Check("RenderQuad");
+    glDrawArrays(GL_TRIANGLE_STRIP, vertexFirst, 4);
+}
+
+void Renderer_GLES::RenderQuadBatch(int32_t vertexCount) {
+    FlushUniformBlocks(activeSpriteShader);
+    StateCache_GLES::Check("RenderQuadBatch");
+    glDrawArrays(GL_TRIANGLES, vertexFirst, vertexCount);
+}
+
+void Renderer_GLES::RenderQuadInstanced(const SpriteInstance* instances, int32_t count) {
+    if (!instances || count <= 0 || !activeSpriteShader) return;
+
+    if (!instancedPipeline) {
+        // One draw per instance; palIndex becomes a constant attribute value
+        static const UniformID modelviewID = InternUniform("modelview");
+        static const UniformID tintID = InternUniform("tint");
+        static const UniformID addID = InternUniform("add");
+        static const UniformID multID = InternUniform("mult");
+        static const UniformID alphaID = InternUniform("alpha");
+
+        GLint palIndexLoc = activeSpriteShader->GetAttributeLocation("palIndex");
+        if (palIndexLoc >= 0) glDisableVertexAttribArray(palIndexLoc);
+        for (int32_t i = 0; i < count; ++i) {
+            const SpriteInstance& inst = instances[i];
+            SetUniformMatrix(modelviewID, inst.modelview);
+            SetUniformF(tintID, inst.tint, 4);
+            SetUniformF(addID, inst.add, 3);
+            SetUniformF(multID, inst.mult, 3);
+            SetUniformF(alphaID, &inst.alpha, 1);
+            if (palIndexLoc >= 0) glVertexAttrib1f(palIndexLoc, inst.palIndex);
+            RenderQuad();
+        }
+        if (palIndexLoc >= 0) glEnableVertexAttribArray(palIndexLoc);
+        return;
+    }
+
+    // Instance records are re-pointed per call since their offset in the
+    // ring changes; the base quad stays at vertexFirst
+    size_t offset = instanceStream.Append(instances, count * sizeof(SpriteInstance), 4 * sizeof(float));
+    SetupSpriteInstanceAttributes(offset);
+    FlushUniformBlocks(activeSpriteShader);
+    StateCache_GLES::Check("RenderQuadInstanced");
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, vertexFirst, 4, count);
+}
+
+void Renderer_GLES::RenderElements(PrimitiveMode mode, int count, int offset) {
+    if (!modelShader) return;
+
+    FlushUniformBlocks(modelShader.get());
+    BindModelProgram();
+    StateCache_GLES::Check("RenderElements");
+    glDrawElements(MapPrimitiveMode(mode), count, GL_UNSIGNED_INT,
+                   reinterpret_cast<const void*>(static_cast<uintptr_t>(offset)));
+}
+
+void Renderer_GLES::RenderElementsMultiDraw(PrimitiveMode mode, const ModelDraw* draws, int32_t count) {
+    if (!modelShader || !draws || count <= 0) return;
+
+    ShaderProgram_GLES* program = nullptr;
+    if (useDrawIndirect && modelShader != modelUnlitShader) {
+        program = FindModelPermutation(ModelVertexFeatures(glState) | modelMaterialFeatures | ModelFeatureMultiDraw);
+    }
+    if (!program) {
+        // One draw per primitive with its matrices as uniforms
+        static const UniformID modelID = InternUniform("model");
+        static const UniformID normalMatrixID = InternUniform("normalMatrix");
+        for (int32_t i = 0; i < count; ++i) {
+            mat4x4 model, inverse, normalMatrix;
+            memcpy(model, draws[i].model, sizeof(model));
+            mat4x4_invert(inverse, model);
+            mat4x4_transpose(normalMatrix, inverse);
+            SetModelUniformMatrix(modelID, draws[i].model);
+            SetModelUniformMatrix(normalMatrixID, &normalMatrix[0][0]);
+            RenderElements(mode, draws[i].count, draws[i].offset);
+        }
+        return;
+    }
+
+    // Records first: the commands are smaller, so their append cannot grow
+    // (reallocate) the stream under the records
+    size_t recordOffset = instanceStream.Append(draws, count * sizeof(ModelDraw), 4 * sizeof(float));
+    indirectCommands.resize(count);
+    for (int32_t i = 0; i < count; ++i) {
+        indirectCommands[i] = {static_cast<uint32_t>(draws[i].count), 1,
+                               static_cast<uint32_t>(draws[i].offset) / 4, 0, 0};
+    }
+    size_t commandOffset = instanceStream.Append(indirectCommands.data(),
+                                                 count * sizeof(DrawElementsIndirectCommand), sizeof(uint32_t));
+
+    FlushUniformBlocks(modelShader.get());
+    UseModelProgram(program);
+    StateCache_GLES::BindBuffer(GL_DRAW_INDIRECT_BUFFER, instanceStream.GetHandle());
+    SetupModelDrawAttributes(recordOffset);
+    StateCache_GLES::Check("RenderElementsMultiDraw");
+    for (int32_t i = 0; i < count; ++i) {
+        if (i > 0) {
+            // No baseInstance on ES: drawModel is moved to the record of draw i
+            for (uint32_t column = 0; column < 4; ++column) {
+                glVertexAttribPointer(ModelLocationDrawModel + column, 4, GL_FLOAT, GL_FALSE, sizeof(ModelDraw),
+                                      reinterpret_cast<const void*>(recordOffset + i * sizeof(ModelDraw) +
+                                                                    column * 4 * sizeof(float)));
+            }
+        }
+        glDrawElementsIndirect(MapPrimitiveMode(mode), GL_UNSIGNED_INT,
+                               reinterpret_cast<const void*>(commandOffset + i * sizeof(DrawElementsIndirectCommand)));
+    }
+    ReleaseModelDrawAttributes();
+}
+
+// drawModel of the MULTI_DRAW permutation, one record per instance. The
+// mesh vertex arrays are shared with RenderElements, so the attributes are
+// released again after the draw.
+void Renderer_GLES::SetupModelDrawAttributes(size_t offset) {
+    StateCache_GLES::BindBuffer(GL_ARRAY_BUFFER, instanceStream.GetHandle());
+    for (uint32_t column = 0; column < 4; ++column) {
+        uint32_t loc = ModelLocationDrawModel + column;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, sizeof(ModelDraw),
+                              reinterpret_cast<const void*>(offset + column * 4 * sizeof(float)));
+        glVertexAttribDivisor(loc, 1);
+    }
+}
+
+void Renderer_GLES::ReleaseModelDrawAttributes() {
+    for (uint32_t column = 0; column < 4; ++column) {
+        glVertexAttribDivisor(ModelLocationDrawModel + column, 0);
+        glDisableVertexAttribArray(ModelLocationDrawModel + column);
+    }
+}
+
+// Draws with the permutation for the current GLState and material switches;
+// the generic program covers it until it is ready
+void Renderer_GLES::BindModelProgram() {
+    ShaderProgram_GLES* program = nullptr;
+    if (useModelPermutations && modelShader != modelUnlitShader) {
+        program = FindModelPermutation(ModelVertexFeatures(glState) | modelMaterialFeatures);
+    }
+    UseModelProgram(program ? program : modelShader.get());
+}
+
+// The permutation for key once it has compiled, queueing it on first use
+ShaderProgram_GLES* Renderer_GLES::FindModelPermutation(uint32_t key) {
+    auto& entry = modelPermutations[key];
+    if (entry.state == ShaderPermutationTable<ShaderProgram_GLES>::State::Missing) {
+        QueueModelPermutation(key);
+    }
+    return entry.state == ShaderPermutationTable<ShaderProgram_GLES>::State::Ready ? entry.program.get() : nullptr;
+}
+
+void Renderer_GLES::UseModelProgram(ShaderProgram_GLES* program) {
+    if (program->GetProgram() != boundModelProgram) {
+        StateCache_GLES::UseProgram(program->GetProgram());
+        boundModelProgram = program->GetProgram();
+    }
+}
+
+// Binds the vertex array of one mesh, creating it on first use. Model
+// programs share the fixed ModelVertexLocation locations; shadow arrays use
+// the shadow program's own.
+void Renderer_GLES::BindModelVertexArray(uint32_t features, uint32_t numVertices, uint32_t vertAttrOffset, bool shadow) {
+    if (shadow && !shadowMapShader) return;
+
+    ModelVertexArrayKey key = {modelBufferIndex, features, numVertices, vertAttrOffset, shadow};
+    auto it = modelVertexArrays.find(key);
+    if (it != modelVertexArrays.end()) {
+        StateCache_GLES::BindVertexArray(it->second);
+        return;
+    }
+
+    GLuint array = 0;
+    glGenVertexArrays(1, &array);
+    StateCache_GLES::BindVertexArray(array);
+    StateCache_GLES::BindBuffer(GL_ARRAY_BUFFER, modelVertexBuffer[modelBufferIndex]);
+    StateCache_GLES::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, modelIndexBuffer[modelBufferIndex]);
+
+    size_t offset = vertAttrOffset;
+    for (int i = 0; i < ModelVertexAttributeCount; ++i) {
+        const ModelVertexAttribute& attr = ModelVertexAttributes[i];
+        if (!ModelVertexAttributePresent(attr, features)) continue;
+
+        int32_t loc = shadow ? shadowMapShader->GetAttributeLocation(attr.name) : i;
+        if (loc >= 0) {
+            // Integer data is converted, as the shaders declare float inputs
+            glEnableVertexAttribArray(loc);
+            glVertexAttribPointer(loc, attr.components, attr.integer ? GL_INT : GL_FLOAT, GL_FALSE, 0,
+                                  reinterpret_cast<const void*>(offset));
+        }
+        offset += size_t(attr.components) * 4 * numVertices;
+    }
+
+    modelVertexArrays[key] = array;
+}
+
+// bufferIndex < 0 deletes the arrays of both buffers
+void Renderer_GLES::DeleteModelVertexArrays(int32_t bufferIndex) {
+    for (auto it = modelVertexArrays.begin(); it != modelVertexArrays.end();) {
+        if (bufferIndex < 0 || it->first.bufferIndex == static_cast<uint32_t>(bufferIndex)) {
+            StateCache_GLES::DeleteVertexArrays(1, &it->second);
+            it = modelVertexArrays.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Renderer_GLES::QueueModelPermutation(uint32_t key) {
+    modelPermutations[key].state = ShaderPermutationTable<ShaderProgram_GLES>::State::Pending;
+
+    char id[48];
+    snprintf(id, sizeof(id), "Model Shader (permutation %03x)", key);
+    std::shared_ptr<ShaderProgram_GLES> base = modelShader;
+    QueueShaderProgram(id, "model.vert.glsl", "model.frag.glsl", modelDefines + ModelPermutationDefines(key),
+        [this, key, base](const std::shared_ptr<ShaderProgram_GLES>& shader) {
+            shader->ShareUniformBlocks(base);
+            RegisterModelInterface(*shader);
+            modelPermutations[key].program = shader;
+            modelPermutations[key].state = ShaderPermutationTable<ShaderProgram_GLES>::State::Ready;
+        });
+}
+
+void Renderer_GLES::RenderShadowMapElements(PrimitiveMode mode, int count, int offset) {
+    StateCache_GLES::Check("RenderShadowMapElements");
+    glDrawElements(MapPrimitiveMode(mode), count, GL_UNSIGNED_INT, (void*)(offset * sizeof(uint32_t)));
+}
+
+void Renderer_GLES::DrawFullscreenQuad(const ShaderProgram_GLES& shader) {
+    GLint loc = shader.GetAttributeLocation("VertCoord");
+    if (loc < 0) return;
+
+    StateCache_GLES::BindVertexArray(postVAO);
+    StateCache_GLES::BindBuffer(GL_ARRAY_BUFFER, postVertBuffer);
+    glEnableVertexAttribArray(loc);
+    glVertexAttribPointer(loc, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    StateCache_GLES::Check("DrawFullscreenQuad");
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    StateCache_GLES::BindVertexArray(vao);
+}
+
+void Renderer_GLES::RenderCubeMap(const std::shared_ptr<ITexture>& envTex, 
+                                  const std::shared_ptr<ITexture>& cubeTex) {
+    if (!envTex || !cubeTex || !panoramaToCubeMapShader) return;
+
+    int32_t textureSize = cubeTex->GetWidth();
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo_env);
+    StateCache_GLES::Viewport(0, 0, textureSize, textureSize);
+    StateCache_GLES::Disable(GL_BLEND);
+    StateCache_GLES::UseProgram(panoramaToCubeMapShader->GetProgram());
+
+    GLint unit = panoramaToCubeMapShader->GetTextureUnit("panorama");
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0 + unit);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, envTex->GetHandle());
+    glUniform1i(panoramaToCubeMapShader->GetUniformLocation("panorama"), unit);
+
+    GLint faceLoc = panoramaToCubeMapShader->GetUniformLocation("currentFace");
+    for (int i = 0; i < 6; ++i) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                               cubeTex->GetHandle(), 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glUniform1i(faceLoc, i);
+        DrawFullscreenQuad(*panoramaToCubeMapShader);
+    }
+
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GLES::BindTexture(GL_TEXTURE_CUBE_MAP, cubeTex->GetHandle());
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    StateCache_GLES::BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+void Renderer_GLES::RenderFilteredCubeMap(int32_t distribution, 
+                                          const std::shared_ptr<ITexture>& cubeTex,
+                                          const std::shared_ptr<ITexture>& filteredTex,
+                                          int32_t mipmapLevel, int32_t sampleCount, float roughness) {
+    if (!filteredTex) return;
+
+    int32_t currentTextureSize = std::max(filteredTex->GetWidth() >> mipmapLevel, 1);
+    for (int32_t face = 0; face < 6; ++face) {
+        RenderFilteredCubeMapRows(distribution, cubeTex, filteredTex, mipmapLevel, face,
+                                  0, currentTextureSize, sampleCount, roughness);
+    }
+}
+
+void Renderer_GLES::RenderFilteredCubeMapRows(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                                              const std::shared_ptr<ITexture>& filteredTex, int32_t mipmapLevel,
+                                              int32_t face, int32_t firstRow, int32_t rowCount,
+                                              int32_t sampleCount, float roughness) {
+    if (!cubeTex || !filteredTex || !cubemapFilteringShader) return;
+
+    int32_t currentTextureSize = std::max(filteredTex->GetWidth() >> mipmapLevel, 1);
+    // Runs mid-frame when a bake is spread over frames (Environment::Update)
+    int32_t frameViewport[4];
+    StateCache_GLES::GetViewport(frameViewport);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo_env);
+    StateCache_GLES::Viewport(0, 0, currentTextureSize, currentTextureSize);
+    StateCache_GLES::Disable(GL_BLEND);
+    StateCache_GLES::UseProgram(cubemapFilteringShader->GetProgram());
+
+    GLint unit = cubemapFilteringShader->GetTextureUnit("cubeMap");
+    StateCache_GLES::ActiveTexture(GL_TEXTURE0 + unit);
+    StateCache_GLES::BindTexture(GL_TEXTURE_CUBE_MAP, cubeTex->GetHandle());
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("cubeMap"), unit);
+
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("sampleCount"), sampleCount);
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("distribution"), distribution);
+    // Texel solid angle of the source, which picks the sampled mip level
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("width"), cubeTex->GetWidth());
+    glUniform1f(cubemapFilteringShader->GetUniformLocation("roughness"), roughness);
+    glUniform1f(cubemapFilteringShader->GetUniformLocation("intensityScale"), 1.0f);
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("isLUT"), 0);
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("currentFace"), face);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+                           filteredTex->GetHandle(), mipmapLevel);
+    DrawEnvironmentRows(*cubemapFilteringShader, currentTextureSize, firstRow, rowCount);
+
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GLES::Viewport(frameViewport[0], frameViewport[1], frameViewport[2], frameViewport[3]);
+    StateCache_GLES::BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
+void Renderer_GLES::RenderLUT(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                              const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount) {
+    if (!lutTex) return;
+    RenderLUTRows(distribution, cubeTex, lutTex, sampleCount, 0, lutTex->GetHeight());
+}
+
+void Renderer_GLES::RenderLUTRows(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                                  const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount,
+                                  int32_t firstRow, int32_t rowCount) {
+    if (!cubeTex || !lutTex || !cubemapFilteringShader) return;
+
+    int32_t textureSize = lutTex->GetWidth();
+    int32_t frameViewport[4];
+    StateCache_GLES::GetViewport(frameViewport);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo_env);
+    StateCache_GLES::Viewport(0, 0, textureSize, textureSize);
+    StateCache_GLES::Disable(GL_BLEND);
+    StateCache_GLES::UseProgram(cubemapFilteringShader->GetProgram());
+
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("sampleCount"), sampleCount);
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("distribution"), distribution);
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("width"), textureSize);
+    glUniform1f(cubemapFilteringShader->GetUniformLocation("roughness"), 0.0f);
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("currentFace"), 0);
+    glUniform1i(cubemapFilteringShader->GetUniformLocation("isLUT"), 1);
+
+    // No-op for a texture from newLUTTexture
+    static_cast<Texture_GLES*>(lutTex.get())->Allocate(GL_TEXTURE_2D,
+        iblPrecision == IBLPrecision::Half ? GL_RG16F : GL_RGBA32F, 1);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lutTex->GetHandle(), 0);
+    DrawEnvironmentRows(*cubemapFilteringShader, textureSize, firstRow, rowCount);
+
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, GetSceneFBO());
+    StateCache_GLES::Viewport(frameViewport[0], frameViewport[1], frameViewport[2], frameViewport[3]);
+}
+
+// Fills rows [firstRow, firstRow + rowCount) of the square fbo_env
+// attachment, scissoring off the rest
+void Renderer_GLES::DrawEnvironmentRows(const ShaderProgram_GLES& shader, int32_t size,
+                                        int32_t firstRow, int32_t rowCount) {
+    firstRow = std::max(firstRow, 0);
+    rowCount = std::min(rowCount, size - firstRow);
+    if (rowCount <= 0) return;
+
+    bool partial = firstRow > 0 || rowCount < size;
+    if (partial) {
+        StateCache_GLES::Enable(GL_SCISSOR_TEST);
+        StateCache_GLES::Scissor(0, firstRow, size, rowCount);
+    }
+    glClear(GL_COLOR_BUFFER_BIT);
+    DrawFullscreenQuad(shader);
+    if (partial) {
+        StateCache_GLES::Disable(GL_SCISSOR_TEST);
+    }
+}
+
+// ------------------------------------------------------------------
+// State Cache
+// ------------------------------------------------------------------
+
+void Renderer_GLES::InvalidateState() {
+    StateCache_GLES::Invalidate();
+}
+
+void Renderer_GLES::SetStateValidation(bool enabled) {
+    StateCache_GLES::SetValidation(enabled);
+}
+
+StateCacheStats Renderer_GLES::GetStateCacheStats() const {
+    return StateCache_GLES::GetStats();
+}
+
+void Renderer_GLES::ResetStateCacheStats() {
+    StateCache_GLES::ResetStats();
+}
+
+// ------------------------------------------------------------------
+// Multisampling
+// ------------------------------------------------------------------
+
+// EXT_multisampled_render_to_texture lets the main FBO's texture take
+// multisampled rendering directly; without it MSAA resolves with a blit
+void Renderer_GLES::InitMultisampledRenderToTexture() {
+    if (!IsGLESExtensionSupported("GL_EXT_multisampled_render_to_texture") || !procLoader) {
+        return;
+    }
+    renderbufferStorageMultisampleEXT = reinterpret_cast<RenderbufferStorageMultisampleEXTProc>(
+        procLoader("glRenderbufferStorageMultisampleEXT"));
+    framebufferTexture2DMultisampleEXT = reinterpret_cast<FramebufferTexture2DMultisampleEXTProc>(
+        procLoader("glFramebufferTexture2DMultisampleEXT"));
+    if (!renderbufferStorageMultisampleEXT || !framebufferTexture2DMultisampleEXT) {
+        renderbufferStorageMultisampleEXT = nullptr;
+        framebufferTexture2DMultisampleEXT = nullptr;
+    }
+}
+
+// ------------------------------------------------------------------
+// GPU Timer Queries
+// ------------------------------------------------------------------
+
+// ES 3.0 has no timer queries in core; EXT_disjoint_timer_query adds
+// them along with a flag for results spoiled by a GPU disjoint event
+void Renderer_GLES::InitTimerQueries() {
+    if (!IsGLESExtensionSupported("GL_EXT_disjoint_timer_query") || !procLoader) {
+        return;
+    }
+    queryCounterEXT = reinterpret_cast<QueryCounterEXTProc>(procLoader("glQueryCounterEXT"));
+    getQueryObjectui64vEXT = reinterpret_cast<GetQueryObjectui64vEXTProc>(procLoader("glGetQueryObjectui64vEXT"));
+    if (!queryCounterEXT || !getQueryObjectui64vEXT) {
+        queryCounterEXT = nullptr;
+        getQueryObjectui64vEXT = nullptr;
+    }
+}
+
+// Without the extension callers fall back to their own cost estimates
+uint32_t Renderer_GLES::BeginGPUTimer() {
+    if (!getQueryObjectui64vEXT) return 0;
+
+    if (freeTimerQueries.empty()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        timerQueries.push_back(query);
+        freeTimerQueries.push_back(query);
+    }
+    GLuint query = freeTimerQueries.back();
+    freeTimerQueries.pop_back();
+    glBeginQuery(GL_TIME_ELAPSED_EXT, query);
+    return query;
+}
+
+void Renderer_GLES::EndGPUTimer() {
+    if (!getQueryObjectui64vEXT) return;
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+}
+
+bool Renderer_GLES::ReadGPUTimer(uint32_t query, uint64_t& nanoseconds) {
+    if (query == 0) return false;
+
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+
+    GLuint64 elapsed = 0;
+    getQueryObjectui64vEXT(query, GL_QUERY_RESULT, &elapsed);
+    nanoseconds = elapsed;
+    freeTimerQueries.push_back(query);
+    return true;
+}
+
+// ------------------------------------------------------------------
+// GPU Profiling
+// ------------------------------------------------------------------
+
+static const char* const ProfilePassNames[] = {"Shadows", "Models", "Sprites"};
+const uint32_t Renderer_GLES::NoProfileRegion;
+
+void Renderer_GLES::BeginGPUProfileFrame() {
+    // Regions left open by a frame without EndFrame are never closed
+    profileStack.clear();
+    for (bool& open : profilePassOpen) {
+        open = false;
+    }
+
+    // A disjoint event (reading the flag clears it) spoils every timestamp
+    // still unresolved
+    GLint disjoint = GL_FALSE;
+    if (queryCounterEXT) {
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    }
+    if (disjoint) {
+        for (auto& slot : profileFrames) {
+            if (slot.pending && slot.frame != frameIndex) {
+                slot.pending = false;
+                gpuProfiler.DropFrame();
+            }
+        }
+    }
+
+    // Timestamps complete in submission order, so a frame is done once its
+    // last query is. Slots are visited oldest first, starting with the one
+    // this frame is about to reuse.
+    for (int i = 0; i < ProfileFrameCount; ++i) {
+        ProfileFrame& slot = profileFrames[(frameIndex + i) % ProfileFrameCount];
+        if (!slot.pending) continue;
+        if (slot.used > 0) {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(slot.queries[slot.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) break;
+
+            std::vector<GLuint64> stamps(slot.used);
+            for (uint32_t q = 0; q < slot.used; ++q) {
+                getQueryObjectui64vEXT(slot.queries[q], GL_QUERY_RESULT, &stamps[q]);
+            }
+            std::vector<GPUProfileSpan> spans;
+            spans.reserve(slot.regions.size());
+            for (const ProfileRegion& region : slot.regions) {
+                if (region.end == NoProfileRegion) continue;
+                spans.push_back(GPUProfileSpan{region.name, region.depth, stamps[region.begin], stamps[region.end]});
+            }
+            gpuProfiler.AddFrame(slot.frame, spans);
+        }
+        slot.pending = false;
+    }
+
+    if (!gpuProfiling || !queryCounterEXT) return;
 
-void Renderer_GLES::RenderQuad() {
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    ProfileFrame& slot = profileFrames[frameIndex % ProfileFrameCount];
+    if (slot.pending) {
+        // Still running ProfileFrameCount frames later; its queries are reissued
+        gpuProfiler.DropFrame();
+    }
+    slot.regions.clear();
+    slot.used = 0;
+    slot.frame = frameIndex;
+    slot.pending = true;
+    BeginGPURegion("Frame");
 }
 
-void Renderer_GLES::RenderQuadBatch(int32_t vertexCount) {
-    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+void Renderer_GLES::EndGPUProfileFrame() {
+    while (!profileStack.empty()) {
+        EndGPURegion();
+    }
+    for (bool& open : profilePassOpen) {
+        open = false;
+    }
 }
 
-void Renderer_GLES::RenderElements(PrimitiveMode mode, int count, int offset) {
-    glDrawArrays(MapPrimitiveMode(mode), offset, count);
+uint32_t Renderer_GLES::IssueTimestamp(ProfileFrame& slot) {
+    if (slot.used == slot.queries.size()) {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        slot.queries.push_back(query);
+    }
+    queryCounterEXT(slot.queries[slot.used], GL_TIMESTAMP_EXT);
+    return slot.used++;
 }
 
-void Renderer_GLES::RenderShadowMapElements(PrimitiveMode mode, int count, int offset) {
-    glDrawElements(MapPrimitiveMode(mode), count, GL_UNSIGNED_INT, (void*)(offset * sizeof(uint32_t)));
+void Renderer_GLES::BeginGPURegion(const char* name) {
+    // Untimed regions still take a stack entry so EndGPURegion stays paired
+    ProfileFrame& slot = profileFrames[frameIndex % ProfileFrameCount];
+    if (!gpuProfiling || !slot.pending || slot.frame != frameIndex) {
+        profileStack.push_back(NoProfileRegion);
+        return;
+    }
+    int32_t depth = static_cast<int32_t>(profileStack.size());
+    slot.regions.push_back(ProfileRegion{name, depth, IssueTimestamp(slot), NoProfileRegion});
+    profileStack.push_back(static_cast<uint32_t>(slot.regions.size() - 1));
 }
 
-void Renderer_GLES::RenderCubeMap(const std::shared_ptr<ITexture>& envTex, 
-                                  const std::shared_ptr<ITexture>& cubeTex) {
-    // TODO: Implement when panorama shader is available
+void Renderer_GLES::EndGPURegion() {
+    if (profileStack.empty()) return;
+
+    uint32_t index = profileStack.back();
+    profileStack.pop_back();
+    if (index == NoProfileRegion) return;
+
+    ProfileFrame& slot = profileFrames[frameIndex % ProfileFrameCount];
+    slot.regions[index].end = IssueTimestamp(slot);
 }
 
-void Renderer_GLES::RenderFilteredCubeMap(int32_t distribution, 
-                                          const std::shared_ptr<ITexture>& cubeTex,
-                                          const std::shared_ptr<ITexture>& filteredTex,
-                                          int32_t mipmapLevel, int32_t sampleCount, float roughness) {
-    // TODO: Implement when cubemap filtering shader is available
+void Renderer_GLES::BeginPassRegion(ProfilePass pass) {
+    // The sprite batcher sets the pipeline again for every blend change
+    // before a single release, so a pass is one region until released
+    if (profilePassOpen[pass]) return;
+    BeginGPURegion(ProfilePassNames[pass]);
+    profilePassOpen[pass] = true;
 }
 
-void Renderer_GLES::RenderLUT(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
-                              const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount) {
-    // TODO: Implement when cubemap filtering shader is available
+void Renderer_GLES::EndPassRegion(ProfilePass pass) {
+    if (!profilePassOpen[pass]) return;
+    EndGPURegion();
+    profilePassOpen[pass] = false;
 }
 
 void Renderer_GLES::ReadPixels(std::vector<uint8_t>& data, int width, int height) {
@@ -1165,13 +3636,36 @@ uint32_t Renderer_GLES::MapPrimitiveMode(PrimitiveMode mode) const {
 }
 
 uint32_t Renderer_GLES::compileShader(uint32_t shaderType, const std::string& src) {
+    GLuint shader = beginCompileShader(shaderType, src);
+    if (!finishCompileShader(shader)) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+uint32_t Renderer_GLES::linkProgram(const std::vector<uint32_t>& shaders) {
+    GLuint program = beginLinkProgram(shaders);
+    if (!finishLinkProgram(program)) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+uint32_t Renderer_GLES::beginCompileShader(uint32_t shaderType, const std::string& src) {
     GLuint shader = glCreateShader(shaderType);
     const char* srcPtr = src.c_str();
     GLint length = static_cast<GLint>(src.length());
     
     glShaderSource(shader, 1, &srcPtr, &length);
     glCompileShader(shader);
-    
+    return shader;
+}
+
+// Blocks until the driver is done with the shader unless
+// GL_COMPLETION_STATUS_KHR already reported it complete
+bool Renderer_GLES::finishCompileShader(uint32_t shader) {
     GLint success = 0;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (!success) {
@@ -1182,27 +3676,39 @@ uint32_t Renderer_GLES::compileShader(uint32_t shaderType, const std::string& sr
             glGetShaderInfoLog(shader, logLength, nullptr, log.data());
             std::cerr << "Shader compilation error: " << log.data() << std::endl;
         }
-        glDeleteShader(shader);
-        return 0;
+        return false;
     }
-    
-    return shader;
+    return true;
 }
 
-uint32_t Renderer_GLES::linkProgram(const std::vector<uint32_t>& shaders) {
+uint32_t Renderer_GLES::beginLinkProgram(const std::vector<uint32_t>& shaders) {
     GLuint program = glCreateProgram();
     
     for (uint32_t shader : shaders) {
         glAttachShader(program, shader);
     }
     
+    // Model programs share vertex arrays through fixed input locations. The
+    // names are simply unused by other programs, and explicit layout
+    // qualifiers take precedence.
+    for (int i = 0; i < ModelVertexAttributeCount; ++i) {
+        glBindAttribLocation(program, i, ModelVertexAttributes[i].name);
+    }
+    glBindAttribLocation(program, ModelLocationDrawModel, "drawModel");
+
+    if (binaryCache.IsEnabled()) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(program);
     
     // Mark shaders for deletion
     for (uint32_t shader : shaders) {
         glDeleteShader(shader);
     }
-    
+    return program;
+}
+
+bool Renderer_GLES::finishLinkProgram(uint32_t program) {
     GLint success = 0;
     glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success) {
@@ -1213,21 +3719,221 @@ uint32_t Renderer_GLES::linkProgram(const std::vector<uint32_t>& shaders) {
             glGetProgramInfoLog(program, logLength, nullptr, log.data());
             std::cerr << "Program link error: " << log.data() << std::endl;
         }
+        return false;
+    }
+    return true;
+}
+
+// ===== Asynchronous Shader Compilation =====
+
+void Renderer_GLES::InitParallelShaderCompile() {
+    parallelShaderCompile = IsGLESExtensionSupported("GL_KHR_parallel_shader_compile");
+    if (!parallelShaderCompile || !procLoader) {
+        return;
+    }
+
+    // 0xFFFFFFFF lets the driver pick the thread count
+    typedef void (GLAD_API_PTR *MaxShaderCompilerThreadsProc)(GLuint count);
+    auto maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(procLoader("glMaxShaderCompilerThreadsKHR"));
+    if (maxThreads) {
+        maxThreads(0xFFFFFFFFu);
+    }
+}
+
+bool Renderer_GLES::QueueShaderProgram(const std::string& id, const std::string& vertFile,
+                                       const std::string& fragFile, const std::string& defines,
+                                       std::function<void(const std::shared_ptr<ShaderProgram_GLES>&)> onReady) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::string vert = LoadShaderSource(shaderDirectory, vertFile);
+    std::string frag = LoadShaderSource(shaderDirectory, fragFile);
+    if (vert.empty() || frag.empty()) {
+        return false;
+    }
+    shaderStats.programs++;
+
+    std::vector<std::string> sources = PrepareShaderSources(vert, frag, defines);
+    uint64_t key = binaryCache.MakeKey(sources);
+    auto shader = FindCachedProgram(key);
+    if (shader) {
+        onReady(shader);
+    } else {
+        ShaderJob job;
+        job.id = id;
+        job.key = key;
+        job.program = 0;
+        job.onReady = std::move(onReady);
+        for (size_t i = 0; i < sources.size(); ++i) {
+            job.shaders.push_back(beginCompileShader(ShaderStages[i], sources[i]));
+        }
+        shaderJobs.push_back(std::move(job));
+    }
+
+    shaderStats.milliseconds += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+// Returns true once the job is finished, successfully or not. Without wait
+// it never blocks when completion can be polled.
+bool Renderer_GLES::AdvanceShaderJob(ShaderJob& job, bool wait) {
+    bool poll = !wait && parallelShaderCompile;
+
+    if (job.program == 0) {
+        if (poll) {
+            for (uint32_t shader : job.shaders) {
+                GLint done = GL_FALSE;
+                glGetShaderiv(shader, GL_COMPLETION_STATUS_KHR, &done);
+                if (done == GL_FALSE) {
+                    return false;
+                }
+            }
+        }
+
+        bool compiled = true;
+        for (uint32_t shader : job.shaders) {
+            compiled = finishCompileShader(shader) && compiled;
+        }
+        if (!compiled) {
+            for (uint32_t shader : job.shaders) {
+                glDeleteShader(shader);
+            }
+            job.shaders.clear();
+            std::cerr << "Failed to compile shader program: " << job.id << std::endl;
+            return true;
+        }
+
+        job.program = beginLinkProgram(job.shaders);
+        job.shaders.clear();
+        if (!wait) {
+            return false;
+        }
+    }
+
+    if (poll) {
+        GLint done = GL_FALSE;
+        glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &done);
+        if (done == GL_FALSE) {
+            return false;
+        }
+    }
+
+    uint32_t program = job.program;
+    job.program = 0;
+    if (!finishLinkProgram(program)) {
         glDeleteProgram(program);
+        std::cerr << "Failed to link shader program: " << job.id << std::endl;
+        return true;
+    }
+    shaderStats.compiled++;
+    StoreProgramBinary(job.key, program);
+
+    auto shader = std::make_shared<ShaderProgram_GLES>();
+    shader->program = program;
+    programCache[job.key] = shader;
+    job.onReady(shader);
+    return true;
+}
+
+void Renderer_GLES::PollShaderJobs() {
+    if (shaderJobs.empty()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // onReady callbacks only swap programs, so the vector is stable here
+    for (auto it = shaderJobs.begin(); it != shaderJobs.end();) {
+        it = AdvanceShaderJob(*it, false) ? shaderJobs.erase(it) : it + 1;
+        if (!parallelShaderCompile) {
+            break;
+        }
+    }
+
+    shaderStats.milliseconds += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    if (shaderJobs.empty()) {
+        shaderStats.Print("Shaders");
+    }
+}
+
+void Renderer_GLES::FinishShaderJobs() {
+    if (shaderJobs.empty()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto& job : shaderJobs) {
+        AdvanceShaderJob(job, true);
+    }
+    shaderJobs.clear();
+
+    shaderStats.milliseconds += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    shaderStats.Print("Shaders");
+}
+
+uint32_t Renderer_GLES::LoadProgramBinary(uint64_t key) {
+    uint32_t format;
+    std::vector<uint8_t> binary;
+    if (!binaryCache.Load(key, format, binary)) {
         return 0;
     }
-    
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    GLint success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Drivers may refuse binaries from an older build; recompile and
+        // replace the entry. Drops GL_INVALID_ENUM for a retired format.
+        glGetError();
+        glDeleteProgram(program);
+        binaryCache.Evict(key);
+        shaderStats.binaryRejects++;
+        return 0;
+    }
+
+    shaderStats.binaryHits++;
     return program;
 }
 
+void Renderer_GLES::StoreProgramBinary(uint64_t key, uint32_t program) {
+    if (!binaryCache.IsEnabled()) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<uint8_t> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+    binaryCache.Store(key, format, binary);
+}
+
 std::shared_ptr<ShaderProgram_GLES> Renderer_GLES::newShaderProgram(const std::string& vert,
                                                                      const std::string& frag,
                                                                      const std::string& geo,
                                                                      const std::string& id,
-                                                                     bool crashWhenFail) {
+                                                                     bool crashWhenFail,
+                                                                     const std::string& defines) {
+    shaderStats.programs++;
+
+    // Note: OpenGL ES 3.1 doesn't support geometry shaders
+    std::vector<std::string> sources = PrepareShaderSources(vert, frag, defines);
+    uint64_t key = binaryCache.MakeKey(sources);
+    auto shader = FindCachedProgram(key);
+    if (shader) {
+        return shader;
+    }
+
     std::vector<uint32_t> shaders;
-    
-    uint32_t vertShader = compileShader(GL_VERTEX_SHADER, vert);
+
+    uint32_t vertShader = compileShader(GL_VERTEX_SHADER, sources[0]);
     if (vertShader == 0) {
         if (crashWhenFail) {
             std::cerr << "Failed to compile vertex shader: " << id << std::endl;
@@ -1235,8 +3941,8 @@ std::shared_ptr<ShaderProgram_GLES> Renderer_GLES::newShaderProgram(const std::s
         return nullptr;
     }
     shaders.push_back(vertShader);
-    
-    uint32_t fragShader = compileShader(GL_FRAGMENT_SHADER, frag);
+
+    uint32_t fragShader = compileShader(GL_FRAGMENT_SHADER, sources[1]);
     if (fragShader == 0) {
         glDeleteShader(vertShader);
         if (crashWhenFail) {
@@ -1245,9 +3951,7 @@ std::shared_ptr<ShaderProgram_GLES> Renderer_GLES::newShaderProgram(const std::s
         return nullptr;
     }
     shaders.push_back(fragShader);
-    
-    // Note: OpenGL ES 3.1 doesn't support geometry shaders
-    
+
     uint32_t program = linkProgram(shaders);
     if (program == 0) {
         if (crashWhenFail) {
@@ -1255,13 +3959,74 @@ std::shared_ptr<ShaderProgram_GLES> Renderer_GLES::newShaderProgram(const std::s
         }
         return nullptr;
     }
+    shaderStats.compiled++;
+    StoreProgramBinary(key, program);
+
+    shader = std::make_shared<ShaderProgram_GLES>();
+    shader->program = program;
+    programCache[key] = shader;
     
+    return shader;
+}
+
+std::vector<std::string> Renderer_GLES::PrepareShaderSources(const std::string& vert, const std::string& frag,
+                                                             const std::string& defines) const {
+    std::vector<std::string> sources;
+    sources.push_back(PrepareShaderSource(vert, defines));
+    sources.push_back(PrepareShaderSource(frag, defines));
+    return sources;
+}
+
+std::shared_ptr<ShaderProgram_GLES> Renderer_GLES::FindCachedProgram(uint64_t key) {
+    // Identical variants share one program
+    auto cached = programCache.find(key);
+    if (cached != programCache.end()) {
+        shaderStats.memoryHits++;
+        return cached->second;
+    }
+
+    uint32_t program = LoadProgramBinary(key);
+    if (program == 0) {
+        return nullptr;
+    }
     auto shader = std::make_shared<ShaderProgram_GLES>();
     shader->program = program;
-    
+    programCache[key] = shader;
+    return shader;
+}
+
+std::shared_ptr<ShaderProgram_GLES> Renderer_GLES::LoadShaderProgram(const std::string& id,
+                                                                      const std::string& vertFile,
+                                                                      const std::string& fragFile,
+                                                                      const std::string& geoFile,
+                                                                      const std::string& defines) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::string vert = LoadShaderSource(shaderDirectory, vertFile);
+    std::string frag = LoadShaderSource(shaderDirectory, fragFile);
+    std::shared_ptr<ShaderProgram_GLES> shader;
+    if (!vert.empty() && !frag.empty()) {
+        shader = newShaderProgram(vert, frag, "", id, true, defines);
+    }
+
+    shaderStats.milliseconds += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
     return shader;
 }
 
+std::string Renderer_GLES::PrepareShaderSource(const std::string& src, const std::string& defines) const {
+    // The shared sources carry no #version or default precisions
+    std::string versioned = src;
+    if (versioned.compare(0, 8, "#version") != 0) {
+        versioned = (glVersionMinor >= 1 ? "#version 310 es\n" : "#version 300 es\n") + versioned;
+    }
+    return InsertAfterVersion(versioned,
+                              "precision highp float;\n"
+                              "precision highp int;\n"
+                              "precision highp sampler2DArray;\n"
+                              "precision highp samplerCube;\n" + shaderDefines + defines);
+}
+
 void Renderer_GLES::PrintGLESInfo() {
     const GLubyte* version = glGetString(GL_VERSION);
     const GLubyte* glslVersion = glGetString(GL_SHADING_LANGUAGE_VERSION);
@@ -1282,8 +4047,8 @@ void Renderer_GLES::DetectCapabilities() {
     capabilities.hasIndirectDispatch = true;
     capabilities.hasShaderImageLoadStore = true;
     
-    // Check for optional extensions
-    capabilities.hasInstancedArrays = IsGLESExtensionSupported("GL_EXT_instanced_arrays");
+    // Instanced arrays are core in ES 3.0
+    capabilities.hasInstancedArrays = glVersionMajor >= 3 || IsGLESExtensionSupported("GL_EXT_instanced_arrays");
 }
 
 bool Renderer_GLES::IsGLESExtensionSupported(const std::string& extension) {
@@ -1308,7 +4073,7 @@ bool Renderer_GLES::InitFramebuffer(uint32_t& fbo, uint32_t& texture, uint32_t&
                                     int32_t width, int32_t height, bool useMultisample) {
     // Generate texture
     glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, texture);
     
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -1316,26 +4081,30 @@ bool Renderer_GLES::InitFramebuffer(uint32_t& fbo, uint32_t& texture, uint32_t&
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     
     // Allocate texture storage
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, 
-                GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    AllocateTextureStorage(GL_TEXTURE_2D, GL_RGBA8, 1, width, height);
     
     // Generate depth renderbuffer
     glGenRenderbuffers(1, &rbo);
     glBindRenderbuffer(GL_RENDERBUFFER, rbo);
     
-    if (useMultisample && msaaLevel > 0) {
-        // Note: MSAA support is limited in GLES 3.1 without extensions
-        glRenderbufferStorageMultisample(GL_RENDERBUFFER, msaaLevel,
-                                        GL_DEPTH_COMPONENT16, width, height);
+    // Multisampling needs EXT_multisampled_render_to_texture here: the
+    // texture keeps one sample and the others live only on-chip
+    useMultisample = useMultisample && msaaLevel > 1 && framebufferTexture2DMultisampleEXT;
+    if (useMultisample) {
+        renderbufferStorageMultisampleEXT(GL_RENDERBUFFER, msaaLevel, GL_DEPTH_COMPONENT16, width, height);
     } else {
         glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
     }
     
     // Generate and configure framebuffer
     glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                          GL_TEXTURE_2D, texture, 0);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    if (useMultisample) {
+        framebufferTexture2DMultisampleEXT(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0, msaaLevel);
+    } else {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_TEXTURE_2D, texture, 0);
+    }
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
                              GL_RENDERBUFFER, rbo);
     
@@ -1343,114 +4112,221 @@ bool Renderer_GLES::InitFramebuffer(uint32_t& fbo, uint32_t& texture, uint32_t&
     GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
     if (status != GL_FRAMEBUFFER_COMPLETE) {
         std::cerr << "Framebuffer incomplete: " << std::hex << status << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, 0);
+        StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
         glBindRenderbuffer(GL_RENDERBUFFER, 0);
         return false;
     }
     
     // Unbind
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
     
     return true;
 }
 
+bool Renderer_GLES::InitMultisampleFramebuffer(uint32_t& fbo, uint32_t& color, uint32_t& depth,
+                                               int32_t width, int32_t height, int32_t samples) {
+    // Matches the resolve target's formats, as ES requires for the blit
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT16, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Multisample framebuffer incomplete: " << std::hex << status << std::dec << std::endl;
+        StateCache_GLES::DeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &color);
+        glDeleteRenderbuffers(1, &depth);
+        fbo = color = depth = 0;
+        return false;
+    }
+    return true;
+}
+
 bool Renderer_GLES::InitShadowFramebuffer() {
     if (!enableShadow) return true;
-    
-    // Generate shadow framebuffer
-    glGenFramebuffers(1, &fbo_shadow);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_shadow);
-    
-    // Generate cube map texture for point light shadows
-    glGenTextures(1, &fbo_shadow_cube_texture);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, fbo_shadow_cube_texture);
-    
-    // Allocate storage for all 6 faces
-    const int32_t shadowMapSize = 1024; // Default shadow map resolution
-    for (int i = 0; i < 6; i++) {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT16,
-                    shadowMapSize, shadowMapSize, 0,
-                    GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, nullptr);
+
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if (shadowAtlasSize > maxTextureSize) {
+        std::cerr << "Shadow atlas of " << shadowAtlasSize << " texels exceeds the maximum texture size, using "
+                  << maxTextureSize << std::endl;
+        shadowAtlasSize = maxTextureSize;
     }
-    
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    
-    // Attach first face as depth attachment
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                          GL_TEXTURE_CUBE_MAP_POSITIVE_X, fbo_shadow_cube_texture, 0);
-    
-    // Check framebuffer completeness
+
+    if (fbo_shadow == 0) {
+        glGenFramebuffers(1, &fbo_shadow);
+    }
+    if (fbo_shadow_texture != 0) {
+        StateCache_GLES::DeleteTextures(1, &fbo_shadow_texture);
+    }
+
+    // One depth texture for every light (ShadowAtlas.h); point and spot
+    // lights store linear distance, so 24 bits
+    glGenTextures(1, &fbo_shadow_texture);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, fbo_shadow_texture);
+    AllocateTextureStorage(GL_TEXTURE_2D, GL_DEPTH_COMPONENT24, 1, shadowAtlasSize, shadowAtlasSize);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Depth only
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo_shadow);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, fbo_shadow_texture, 0);
+    GLenum none = GL_NONE;
+    glDrawBuffers(1, &none);
+    glReadBuffer(GL_NONE);
+
     GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
     if (status != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Shadow framebuffer incomplete: " << std::hex << status << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        std::cerr << "Shadow framebuffer incomplete: " << std::hex << status << std::dec << std::endl;
+        StateCache_GLES::DeleteFramebuffers(1, &fbo_shadow);
+        StateCache_GLES::DeleteTextures(1, &fbo_shadow_texture);
+        fbo_shadow = fbo_shadow_texture = 0;
         return false;
     }
-    
-    // Unbind
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-    
+
+    // Tiles start out cleared
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo_shadow);
+    StateCache_GLES::Disable(GL_SCISSOR_TEST);
+    StateCache_GLES::DepthMask(true);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, 0);
     return true;
 }
 
-bool Renderer_GLES::InitPostProcessingFramebuffers() {
-    // Create 2 post-processing framebuffers for ping-pong rendering
-    fbo_pp.resize(2);
-    fbo_pp_texture.resize(2);
-    
-    for (int i = 0; i < 2; i++) {
-        // Generate texture
-        glGenTextures(1, &fbo_pp_texture[i]);
-        glBindTexture(GL_TEXTURE_2D, fbo_pp_texture[i]);
-        
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        
-        // Use RGBA32F for HDR post-processing
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, viewport.width, viewport.height,
-                    0, GL_RGBA, GL_FLOAT, nullptr);
-        
-        // Generate framebuffer
-        glGenFramebuffers(1, &fbo_pp[i]);
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo_pp[i]);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                              GL_TEXTURE_2D, fbo_pp_texture[i], 0);
-        
-        // Check framebuffer completeness
-        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-        if (status != GL_FRAMEBUFFER_COMPLETE) {
-            std::cerr << "Post-processing framebuffer " << i << " incomplete: "
-                     << std::hex << status << std::endl;
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            glBindTexture(GL_TEXTURE_2D, 0);
+bool Renderer_GLES::CreateRenderTargets() {
+    if (msaaLevel > 1) {
+        GLint maxSamples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);  // same enum as GL_MAX_SAMPLES_EXT
+        msaaLevel = std::min(msaaLevel, static_cast<int>(maxSamples));
+        if (msaaLevel < 2) {
+            std::cerr << "MSAA unavailable, rendering without it" << std::endl;
+            msaaLevel = 0;
+        }
+    }
+
+    // Tile-based GPUs resolve a multisampled-render-to-texture target when
+    // the tile is written back, so the samples never reach memory
+    bool renderToTexture = msaaLevel > 1 && framebufferTexture2DMultisampleEXT;
+    if (!InitFramebuffer(fbo, fbo_texture, rbo_depth, viewport.width, viewport.height, renderToTexture)) {
+        return false;
+    }
+
+    // Otherwise scenes draw into separate renderbuffers that
+    // ResolveSceneTarget blits into fbo_texture
+    if (msaaLevel > 1 && !renderToTexture &&
+        !InitMultisampleFramebuffer(fbo_f, rbo_f_color, rbo_f_depth, viewport.width, viewport.height, msaaLevel)) {
+        std::cerr << "MSAA unavailable, rendering without it" << std::endl;
+        msaaLevel = 0;
+    }
+
+    // Post-processing FBOs; RunPostPasses sizes them for the chain
+    fbo_pp.assign(2, 0);
+    fbo_pp_texture.assign(2, 0);
+    for (int32_t i = 0; i < 2; ++i) {
+        if (!CreatePostTarget(i, viewport.width, viewport.height)) {
             return false;
         }
     }
-    
-    // Unbind
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
     return true;
 }
 
+bool Renderer_GLES::CreatePostTarget(int32_t index, int32_t width, int32_t height) {
+    if (fbo_pp[index] != 0 && postTargetSize[index][0] == width && postTargetSize[index][1] == height) {
+        return true;
+    }
+
+    // Storage is immutable, so a resized target is a new texture
+    if (fbo_pp_texture[index] != 0) StateCache_GLES::DeleteTextures(1, &fbo_pp_texture[index]);
+    glGenTextures(1, &fbo_pp_texture[index]);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, fbo_pp_texture[index]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    AllocateTextureStorage(GL_TEXTURE_2D, GL_RGBA8, 1, width, height);
+    postTargetSize[index][0] = width;
+    postTargetSize[index][1] = height;
+
+    if (fbo_pp[index] == 0) glGenFramebuffers(1, &fbo_pp[index]);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, fbo_pp[index]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbo_pp_texture[index], 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    StateCache_GLES::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    StateCache_GLES::BindTexture(GL_TEXTURE_2D, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Post-processing framebuffer " << index << " incomplete: " << std::hex << status
+                  << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Renderer_GLES::DestroyRenderTargets() {
+    if (fbo != 0) StateCache_GLES::DeleteFramebuffers(1, &fbo);
+    if (fbo_texture != 0) StateCache_GLES::DeleteTextures(1, &fbo_texture);
+    if (rbo_depth != 0) glDeleteRenderbuffers(1, &rbo_depth);
+    fbo = fbo_texture = rbo_depth = 0;
+
+    if (fbo_f != 0) StateCache_GLES::DeleteFramebuffers(1, &fbo_f);
+    if (rbo_f_color != 0) glDeleteRenderbuffers(1, &rbo_f_color);
+    if (rbo_f_depth != 0) glDeleteRenderbuffers(1, &rbo_f_depth);
+    fbo_f = rbo_f_color = rbo_f_depth = 0;
+
+    for (auto tex : fbo_pp_texture) {
+        if (tex != 0) StateCache_GLES::DeleteTextures(1, &tex);
+    }
+    for (auto buf : fbo_pp) {
+        if (buf != 0) StateCache_GLES::DeleteFramebuffers(1, &buf);
+    }
+    fbo_pp_texture.clear();
+    fbo_pp.clear();
+    for (auto& size : postTargetSize) {
+        size[0] = size[1] = 0;
+    }
+}
+
+// Recreates the targets when the output size or render scale changes
+// their size. Before Init only the size is recorded.
+void Renderer_GLES::UpdateRenderTargets() {
+    int32_t width = GetRenderWidth();
+    int32_t height = GetRenderHeight();
+    if (fbo == 0) {
+        viewport = {0, 0, width, height};
+        return;
+    }
+    if (width == viewport.width && height == viewport.height) return;
+
+    DestroyRenderTargets();
+    viewport = {0, 0, width, height};
+    if (!CreateRenderTargets()) {
+        std::cerr << "Failed to resize render targets to " << width << "x" << height << std::endl;
+    }
+}
+
 void Renderer_GLES::CacheRenderState() {
     // Cache current OpenGL state to restore later
     // This is useful when temporarily changing state for specific operations
     
     // Save blend state
-    GLboolean blendEnabled = glIsEnabled(GL_BLEND);
+    bool blendEnabled = StateCache_GLES::IsEnabled(GL_BLEND);
     if (blendEnabled) {
         glState.blendEquation = BlendEquation::Add; // Default, would need to query actual value
         glState.blendSrc = BlendFunc::One;
@@ -1458,13 +4334,13 @@ void Renderer_GLES::CacheRenderState() {
     }
     
     // Save depth state
-    glState.depthTest = glIsEnabled(GL_DEPTH_TEST) == GL_TRUE;
+    glState.depthTest = StateCache_GLES::IsEnabled(GL_DEPTH_TEST);
     GLboolean depthWriteMask;
     glGetBooleanv(GL_DEPTH_WRITEMASK, &depthWriteMask);
     glState.depthMask = (depthWriteMask == GL_TRUE);
     
     // Save face culling state
-    glState.doubleSided = (glIsEnabled(GL_CULL_FACE) == GL_FALSE);
+    glState.doubleSided = !StateCache_GLES::IsEnabled(GL_CULL_FACE);
     
     // Save front face orientation
     GLint frontFaceMode;
@@ -1493,29 +4369,29 @@ void Renderer_GLES::ResetRenderState() {
     // Reset to default OpenGL ES state
     
     // Reset blend state
-    glDisable(GL_BLEND);
-    glBlendEquation(GL_FUNC_ADD);
-    glBlendFunc(GL_ONE, GL_ZERO);
+    StateCache_GLES::Disable(GL_BLEND);
+    StateCache_GLES::BlendEquation(GL_FUNC_ADD);
+    StateCache_GLES::BlendFunc(GL_ONE, GL_ZERO);
     glState.blendEquation = BlendEquation::Add;
     glState.blendSrc = BlendFunc::One;
     glState.blendDst = BlendFunc::Zero;
     
     // Reset depth state
-    glDisable(GL_DEPTH_TEST);
-    glDepthMask(GL_TRUE);
+    StateCache_GLES::Disable(GL_DEPTH_TEST);
+    StateCache_GLES::DepthMask(GL_TRUE);
     glState.depthTest = false;
     glState.depthMask = true;
     
     // Reset face culling
-    glDisable(GL_CULL_FACE);
+    StateCache_GLES::Disable(GL_CULL_FACE);
     glState.doubleSided = true;
     
     // Reset front face
-    glFrontFace(GL_CCW);
+    StateCache_GLES::FrontFace(GL_CCW);
     glState.invertFrontFace = false;
     
     // Reset scissor test
-    glDisable(GL_SCISSOR_TEST);
+    StateCache_GLES::Disable(GL_SCISSOR_TEST);
     
     // Reset vertex attribute state flags
     glState.useUV = false;
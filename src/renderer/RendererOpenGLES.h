@@ -2,11 +2,18 @@
 #define RENDERER_OPENGLES_H
 
 #include "RendererInterfaces.h"
+#include "ShaderCache.h"
+#include "ShaderPermutation.h"
+#include "ModelVertexLayout.h"
+#include "PostChain.h"
 #include <glad/gles2.h>
 #include <memory>
 #include <vector>
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
 
 // Forward declarations
 class Environment;
@@ -53,6 +60,23 @@ public:
     int32_t GetUniformLocation(const std::string& name) const;
     int32_t GetTextureUnit(const std::string& name) const;
 
+    // Handle-based accessors, backed by flat arrays indexed by UniformID
+    int32_t GetUniformLocation(UniformID id) const {
+        return (id >= 0 && id < static_cast<int32_t>(uniformsByID.size())) ? uniformsByID[id] : -1;
+    }
+    int32_t GetTextureUnit(UniformID id) const {
+        return (id >= 0 && id < static_cast<int32_t>(texturesByID.size())) ? texturesByID[id] : -1;
+    }
+
+    // Uniform blocks (USE_UBO path). Block members are written into a CPU
+    // copy of their block and uploaded by the renderer right before a draw.
+    bool HasUniformBlocks() const { return blockOwner ? blockOwner->HasUniformBlocks() : !blocks.empty(); }
+    bool WriteBlockUniform(UniformID id, const void* data, int elementSize, int count);
+    // Permutations of one source keep their block data in the base program:
+    // std140 gives every variant the same layout, so only the block
+    // bindings are set per program
+    void ShareUniformBlocks(const std::shared_ptr<ShaderProgram_GLES>& base);
+
     // OpenGL ES-specific accessors
     const std::map<std::string, int32_t>& GetAllAttributes() const { return attributes; }
     const std::map<std::string, int32_t>& GetAllUniforms() const { return uniforms; }
@@ -65,9 +89,37 @@ private:
     std::map<std::string, int32_t> attributes;  // vertex attributes
     std::map<std::string, int32_t> uniforms;    // uniform variables
     std::map<std::string, int32_t> textures;    // texture units
+    std::vector<int32_t> uniformsByID;          // uniform locations by UniformID
+    std::vector<int32_t> texturesByID;          // texture units by UniformID
+
+    struct UniformBlock {
+        uint32_t index;                 // GL block index
+        uint32_t binding;
+        std::vector<uint8_t> data;      // std140 shadow copy
+        bool dirty;
+        uint64_t uploadFrame;           // frame and stream generation of the
+        uint32_t uploadGeneration;      // last upload, so ranges are never
+        size_t uploadOffset;            // reused from a recycled segment
+    };
+    struct BlockMember {
+        int32_t block;                  // index into blocks, -1 if none
+        int32_t offset;
+        int32_t arrayStride;
+        int32_t matrixStride;
+    };
+    std::vector<UniformBlock> blocks;
+    std::vector<BlockMember> blockMembersByID;
+    bool blocksReflected;
+    std::shared_ptr<ShaderProgram_GLES> blockOwner;  // holds the block data when set
 
     // Private helpers
     uint8_t* glStr(const std::string& s);
+    static void StoreByID(std::vector<int32_t>& table, UniformID id, int32_t value);
+    void ReflectUniformBlocks();
+    void RegisterBlockMember(const std::string& name);
+#ifdef DEBUG
+    void CheckBlockArrays(const std::vector<std::string>& names);
+#endif
     
     // Shader info log retrieval
     std::string GetShaderInfoLog(uint32_t shader);
@@ -88,6 +140,8 @@ public:
     void SetData(const std::vector<uint8_t>& data);
     void SetSubData(const std::vector<uint8_t>& data, int32_t x, int32_t y, 
                     int32_t width, int32_t height);
+    // Same, reading from the bound GL_PIXEL_UNPACK_BUFFER at offset
+    void SetSubData(size_t offset, int32_t x, int32_t y, int32_t width, int32_t height);
     void SetDataG(const std::vector<uint8_t>& data, TextureSamplingParam mag,
                  TextureSamplingParam min, TextureSamplingParam ws, TextureSamplingParam wt);
     void SetPixelData(const std::vector<float>& data);
@@ -101,8 +155,20 @@ public:
     int32_t GetWidth() const { return width; }
     int32_t GetHeight() const { return height; }
     int32_t GetDepth() const { return depth; }
+    int32_t GetBytesPerPixel() const { return std::max(depth, 8) / 8; }
+    int32_t GetLevels() const { return levels; }
+    size_t GetMemorySize() const { return memorySize; }
     uint32_t GetHandle() const { return handle; }
     bool GetFilter() const { return filter; }
+    GLenum GetTarget() const { return textureTarget; }
+    GLenum GetInternalFormat() const { return internalFormat; }
+
+    // Allocates immutable storage for levels mip levels (layers slices of a
+    // GL_TEXTURE_2D_ARRAY) on the first call; later calls keep it
+    void Allocate(GLenum target, uint32_t internalFormat, int32_t levels, int32_t layers = 1);
+
+    // Bytes of storage held by all live textures of this backend
+    static size_t GetAllocatedBytes() { return allocatedBytes; }
 
     // Public serialization
     int SavePNG(const std::string& filename, const std::vector<uint32_t>* palette = nullptr);
@@ -118,14 +184,214 @@ private:
     int32_t depth;
     bool filter;
     uint32_t handle;
-    GLenum textureTarget;  // GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, etc.
+    GLenum textureTarget;  // GL_TEXTURE_2D until Allocate names another
+    GLenum internalFormat; // sized format of the storage, 0 until Allocate
+    int32_t levels;        // 0 until Allocate
+    size_t memorySize;
+    static size_t allocatedBytes;
 
     // Private helpers
     uint32_t MapInternalFormat(int32_t depth) const;
+    uint32_t MapSizedFormat(int32_t depth) const;
     int32_t MapTextureSamplingParam(TextureSamplingParam param) const;
     void SetTextureParameters();
 };
 
+// ==========================================
+// OpenGL ES-Specific Streaming Vertex Buffer
+// ==========================================
+
+// Triple-buffered ring for per-frame vertex data. ES 3.x has no core
+// persistent mapping, so appends go through glBufferSubData and the buffer
+// is orphaned whenever the ring wraps; the GPU keeps reading the old store
+// and the CPU never waits on it.
+class StreamBuffer_GLES {
+public:
+    static const int SegmentCount = 3;
+
+    // Constructor/Destructor
+    StreamBuffer_GLES();
+    ~StreamBuffer_GLES();
+
+    // Lifecycle
+    bool Init(GLenum target, size_t segmentSize);
+    void Destroy();
+
+    // Copies data into the current segment and returns its byte offset from
+    // the start of the buffer. The offset is a multiple of alignment.
+    size_t Append(const void* data, size_t size, size_t alignment);
+
+    // Moves on to the next segment, orphaning the buffer on wrap
+    void NextSegment();
+
+    // Accessors
+    uint32_t GetHandle() const { return handle; }
+    uint32_t GetGeneration() const { return generation; }   // bumped on reallocation
+
+private:
+    uint32_t handle;
+    GLenum target;
+    size_t segmentSize;
+    size_t cursor;      // absolute write position inside the current segment
+    int segment;
+    uint32_t generation;
+
+    void Grow(size_t minSegmentSize);
+};
+
+// ==========================================
+// OpenGL ES-Specific Texture Upload Queue
+// ==========================================
+
+// Stages texel data in a fenced ring of pixel unpack buffers, so
+// glTexSubImage2D reads from buffer memory and returns without waiting for
+// the copy. The uploads of one frame share a fence; a texture is ready
+// once the fence of its latest upload has signaled.
+class TextureUploadQueue_GLES {
+public:
+    // Constructor/Destructor
+    TextureUploadQueue_GLES();
+    ~TextureUploadQueue_GLES();
+
+    // Lifecycle
+    bool Init(size_t segmentSize);
+    void Destroy();
+
+    // Copies width x height texels into the ring and queues the transfer
+    // into level 0 of texture at (x, y)
+    void Upload(Texture_GLES& texture, const std::vector<uint8_t>& data,
+                int32_t x, int32_t y, int32_t width, int32_t height);
+
+    // Fences the uploads issued since the last call and retires batches
+    // whose fence has signaled; never blocks on the GPU
+    void NextFrame();
+
+    bool IsPending(uint32_t handle) const { return pending.count(handle) != 0; }
+    size_t GetPendingCount() const { return pending.size(); }
+
+private:
+    struct Batch {
+        uint64_t serial;
+        GLsync fence;
+    };
+
+    StreamBuffer_GLES ring;
+    uint64_t recording;     // serial of the batch being recorded
+    bool recorded;          // the recording batch has uploads
+    std::vector<Batch> inFlight;
+    std::unordered_map<uint32_t, uint64_t> pending;    // texture handle -> batch of its last upload
+};
+
+// ==========================================
+// OpenGL ES-Specific State Cache
+// ==========================================
+
+// Shadow copy of the context state the backend changes: program, vertex
+// array, buffer, texture and framebuffer bindings, viewport, scissor and the
+// fixed-function switches. Every state call of the backend goes through it
+// with the signature of the GL call it replaces, and calls that match the
+// cached value never reach the driver. Static like the single context it
+// mirrors; values are unknown (always issued) until first set.
+class StateCache_GLES {
+public:
+    static const int MaxTextureUnits = 32;  // higher units are not cached
+
+    // Forgets every value, for code outside the renderer that touched the
+    // context
+    static void Invalidate();
+
+    // ===== Bindings =====
+    static void UseProgram(uint32_t program);
+    static void BindVertexArray(uint32_t array);
+    // The element array binding is vertex array state; it is unknown again
+    // after a vertex array change
+    static void BindBuffer(GLenum target, uint32_t buffer);
+    // Also binds the generic target, as GL does
+    static void BindBufferRange(GLenum target, uint32_t index, uint32_t buffer, GLintptr offset, GLsizeiptr size);
+    static void ActiveTexture(GLenum unit);
+    static void BindTexture(GLenum target, uint32_t texture);   // on the active unit
+    static void BindFramebuffer(GLenum target, uint32_t framebuffer);
+
+    // Bound objects as cached, queried from GL when unknown
+    static uint32_t GetProgram();
+    static uint32_t GetFramebuffer(GLenum target);  // GL_READ_FRAMEBUFFER or GL_DRAW_FRAMEBUFFER
+    static void GetViewport(int32_t viewport[4]);
+    static bool IsEnabled(GLenum capability);
+
+    // ===== Fixed-Function State =====
+    static void Viewport(int32_t x, int32_t y, int32_t width, int32_t height);
+    static void Scissor(int32_t x, int32_t y, int32_t width, int32_t height);
+    static void Enable(GLenum capability);
+    static void Disable(GLenum capability);
+    static void BlendEquation(GLenum mode);
+    static void BlendFunc(GLenum src, GLenum dst);
+    static void DepthFunc(GLenum func);
+    static void DepthMask(GLboolean mask);
+    static void CullFace(GLenum mode);
+    static void FrontFace(GLenum mode);
+
+    // ===== Deletion =====
+    // Deleting a bound object reverts its bindings to 0, so the cache
+    // forgets it before the name can be reused
+    static void DeleteBuffers(GLsizei count, const uint32_t* buffers);
+    static void DeleteTextures(GLsizei count, const uint32_t* textures);
+    static void DeleteFramebuffers(GLsizei count, const uint32_t* framebuffers);
+    static void DeleteVertexArrays(GLsizei count, const uint32_t* arrays);
+
+    // ===== Validation & Statistics =====
+    // Debug mode: Check compares every cached value with glGet* and prints
+    // the mismatches; slow, as each query stalls the pipeline
+    static void SetValidation(bool enabled) { validation = enabled; }
+    static bool IsValidating() { return validation; }
+    static void Check(const char* where) { if (validation) Validate(where); }
+    static bool Validate(const char* where);
+
+    static const StateCacheStats& GetStats() { return stats; }
+    static void ResetStats();
+
+private:
+    static const uint32_t Unknown = 0xFFFFFFFFu;
+    enum {
+        BufferArray, BufferElementArray, BufferPixelPack, BufferPixelUnpack, BufferUniform, BufferDrawIndirect,
+        BufferTargetCount
+    };
+    enum { Texture2D, Texture2DArray, TextureCubeMap, TextureTargetCount };
+    enum { CapabilityBlend, CapabilityDepthTest, CapabilityCullFace, CapabilityScissorTest, CapabilityCount };
+
+    struct State {
+        uint32_t program;
+        uint32_t vertexArray;
+        uint32_t buffers[BufferTargetCount];
+        uint32_t activeUnit;                    // index, not GL_TEXTURE0 + index
+        uint32_t textures[MaxTextureUnits][TextureTargetCount];
+        uint32_t readFramebuffer;
+        uint32_t drawFramebuffer;
+        int32_t viewport[4];
+        int32_t scissor[4];
+        bool viewportKnown;
+        bool scissorKnown;
+        uint32_t capabilities[CapabilityCount]; // 0, 1 or Unknown
+        uint32_t blendEquation;
+        uint32_t blendSrc;
+        uint32_t blendDst;
+        uint32_t depthFunc;
+        uint32_t depthMask;
+        uint32_t cullFace;
+        uint32_t frontFace;
+    };
+    static State state;
+    static uint32_t usedUnits;                  // units bound since Invalidate, for Validate
+    static bool validation;
+    static StateCacheStats stats;
+
+    static int BufferIndex(GLenum target);
+    static int TextureIndex(GLenum target);
+    static int CapabilityIndex(GLenum capability);
+    // Counts a call of kind; returns true when cached matched value
+    static bool Redundant(StateCall kind, bool matches);
+    static void SetCapability(GLenum capability, bool enabled);
+};
+
 // ==========================================
 // OpenGL ES-Specific Renderer
 // ==========================================
@@ -147,6 +413,16 @@ public:
     void EndFrame();
     void Await();
 
+    // ===== Render Targets =====
+    void Resize(int32_t width, int32_t height);
+    void SetRenderScale(float scale);
+    void SetMSAASamples(int32_t samples);
+    int32_t GetMSAASamples() const { return msaaLevel; }
+
+    // ===== Post-Processing =====
+    void SetPostChain(const std::vector<PostEffect>& chain);
+    void ReloadPostShaders();
+
     // ===== Capabilities =====
     bool IsModelEnabled() const;
     bool IsShadowEnabled() const;
@@ -164,6 +440,7 @@ public:
     // ===== Pipeline Setup - Sprites =====
     void SetPipeline(BlendEquation eq, BlendFunc src, BlendFunc dst);
     void SetPipelineBatch();
+    void SetPipelineInstanced(BlendEquation eq, BlendFunc src, BlendFunc dst);
     void ReleasePipeline();
 
     // ===== Pipeline Setup - Models =====
@@ -197,16 +474,34 @@ public:
     std::shared_ptr<ITexture> newDataTexture(int32_t width, int32_t height);
     std::shared_ptr<ITexture> newHDRTexture(int32_t width, int32_t height);
     std::shared_ptr<ITexture> newCubeMapTexture(int32_t widthHeight, bool mipmap, int32_t lowestMipLevel);
+    std::shared_ptr<ITexture> newLUTTexture(int32_t widthHeight);
+    void SetTextureData(const std::shared_ptr<ITexture>& tex, const std::vector<uint8_t>& data);
+    void SetTextureSubData(const std::shared_ptr<ITexture>& tex, const std::vector<uint8_t>& data,
+                           int32_t x, int32_t y, int32_t width, int32_t height);
+    void CopyTextureRegion(const std::shared_ptr<ITexture>& src, int32_t srcX, int32_t srcY,
+                           const std::shared_ptr<ITexture>& dst, int32_t dstX, int32_t dstY,
+                           int32_t width, int32_t height);
+    bool IsTextureReady(const std::shared_ptr<ITexture>& tex) const;
+    void SetTexturePixelData(const std::shared_ptr<ITexture>& tex, const std::vector<float>& data);
+    bool ReadTextureLevel(const std::shared_ptr<ITexture>& tex, int32_t level, std::vector<uint8_t>& data);
+    bool WriteTextureLevel(const std::shared_ptr<ITexture>& tex, int32_t level, const std::vector<uint8_t>& data);
+    size_t GetTextureMemory() const;
+    size_t GetRenderTargetMemory() const;
 
     void SetTexture(const std::string& name, const std::shared_ptr<ITexture>& tex);
     void SetModelTexture(const std::string& name, const std::shared_ptr<ITexture>& tex);
     void SetShadowMapTexture(const std::string& name, const std::shared_ptr<ITexture>& tex);
+    void SetTexture(UniformID id, const std::shared_ptr<ITexture>& tex);
+    void SetModelTexture(UniformID id, const std::shared_ptr<ITexture>& tex);
 
     // ===== Uniform Operations - Sprite Shader =====
     void SetUniformI(const std::string& name, int val);
     void SetUniformF(const std::string& name, const std::vector<float>& values);
     void SetUniformFv(const std::string& name, const std::vector<float>& values);
     void SetUniformMatrix(const std::string& name, const std::vector<float>& value);
+    void SetUniformI(UniformID id, int val);
+    void SetUniformF(UniformID id, const float* values, int count);
+    void SetUniformMatrix(UniformID id, const float* value);
 
     // ===== Uniform Operations - Model Shader =====
     void SetModelUniformI(const std::string& name, int val);
@@ -214,6 +509,9 @@ public:
     void SetModelUniformFv(const std::string& name, const std::vector<float>& values);
     void SetModelUniformMatrix(const std::string& name, const std::vector<float>& value);
     void SetModelUniformMatrix3(const std::string& name, const std::vector<float>& value);
+    void SetModelUniformI(UniformID id, int val);
+    void SetModelUniformF(UniformID id, const float* values, int count);
+    void SetModelUniformMatrix(UniformID id, const float* value);
 
     // ===== Uniform Operations - Shadow Map Shader =====
     void SetShadowMapUniformI(const std::string& name, int val);
@@ -222,20 +520,24 @@ public:
     void SetShadowMapUniformMatrix(const std::string& name, const std::vector<float>& value);
     void SetShadowMapUniformMatrix3(const std::string& name, const std::vector<float>& value);
 
-    // ===== Shadow Frame Operations =====
-    void SetShadowFrameTexture(uint32_t i);
-    void SetShadowFrameCubeTexture(uint32_t i);
+    // ===== Shadow Atlas =====
+    void SetShadowAtlasSize(int32_t size);
+    int32_t GetShadowAtlasSize() const { return shadowAtlasSize; }
+    void SetShadowAtlasView(int32_t x, int32_t y, int32_t size);
+    bool IsShadowReady() const { return shadowMapShader && fbo_shadow != 0; }
 
     // ===== Vertex Data Operations =====
-    void SetVertexData(const std::vector<float>& values);
-    void SetVertexDataArray(const std::vector<float>& values);
+    int32_t SetVertexData(const std::vector<float>& values);
+    int32_t SetVertexDataArray(const std::vector<float>& values);
     void SetModelVertexData(uint32_t bufferIndex, const std::vector<uint8_t>& values);
     void SetModelIndexData(uint32_t bufferIndex, const std::vector<uint32_t>& values);
 
     // ===== Rendering Operations =====
     void RenderQuad();
     void RenderQuadBatch(int32_t vertexCount);
+    void RenderQuadInstanced(const SpriteInstance* instances, int32_t count);
     void RenderElements(PrimitiveMode mode, int count, int offset);
+    void RenderElementsMultiDraw(PrimitiveMode mode, const ModelDraw* draws, int32_t count);
     void RenderShadowMapElements(PrimitiveMode mode, int count, int offset);
 
     // ===== CubeMap & IBL Rendering =====
@@ -245,6 +547,28 @@ public:
                               int32_t mipmapLevel, int32_t sampleCount, float roughness);
     void RenderLUT(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
                    const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount);
+    void RenderFilteredCubeMapRows(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                              const std::shared_ptr<ITexture>& filteredTex, int32_t mipmapLevel, int32_t face,
+                              int32_t firstRow, int32_t rowCount, int32_t sampleCount, float roughness);
+    void RenderLUTRows(int32_t distribution, const std::shared_ptr<ITexture>& cubeTex,
+                   const std::shared_ptr<ITexture>& lutTex, int32_t sampleCount,
+                   int32_t firstRow, int32_t rowCount);
+    bool IsIBLReady() const { return panoramaToCubeMapShader && cubemapFilteringShader; }
+
+    // ===== GPU Timer Queries =====
+    uint32_t BeginGPUTimer();
+    void EndGPUTimer();
+    bool ReadGPUTimer(uint32_t query, uint64_t& nanoseconds);
+
+    // ===== GPU Profiling =====
+    void BeginGPURegion(const char* name);
+    void EndGPURegion();
+
+    // ===== State Cache =====
+    void InvalidateState();
+    void SetStateValidation(bool enabled);
+    StateCacheStats GetStateCacheStats() const;
+    void ResetStateCacheStats();
 
     // ===== Pixel Operations =====
     void ReadPixels(std::vector<uint8_t>& data, int width, int height);
@@ -272,10 +596,30 @@ public:
     // Get framebuffer texture
     uint32_t GetMainFBOTexture() const { return fbo_texture; }
 
+    // Framebuffer scenes draw into: the multisampled one while MSAA needs
+    // an explicit resolve, otherwise the main FBO
+    uint32_t GetSceneFBO() const { return fbo_f != 0 ? fbo_f : fbo; }
+    // Resolves the multisampled scene into the main FBO texture. EndFrame
+    // does this; call it before sampling that texture mid-frame.
+    void ResolveSceneTarget();
+
     // ===== Debugging & Info =====
     void PrintInfo();
     void PrintCapabilities();
 
+    // ===== Shader Loading =====
+    // Locations of the GLSL sources and of the program binary cache; set
+    // before Init
+    void SetShaderDirectory(const std::string& dir) { shaderDirectory = dir; }
+    void SetShaderCacheDirectory(const std::string& dir) { binaryCache.SetDirectory(dir); }
+    const ShaderLoadStats& GetShaderLoadStats() const { return shaderStats; }
+
+    // Programs queued by InitModelShader compile in the background and are
+    // swapped in by PollShaderJobs (run from BeginFrame) once linked
+    void PollShaderJobs();
+    void FinishShaderJobs();    // blocks until the queue is empty
+    bool HasPendingShaders() const { return !shaderJobs.empty(); }
+
     // ===== OpenGL ES Version Configuration =====
     void ConfigureForOpenGLESVersion();
 
@@ -285,18 +629,71 @@ public:
     uint32_t fbo_texture;
     uint32_t rbo_depth;
     
-    // MSAA rendering (optional on ES, platform dependent)
+    // MSAA rendering (optional on ES, platform dependent). With
+    // EXT_multisampled_render_to_texture the main FBO is multisampled
+    // itself and resolves on-chip, so fbo_f stays 0.
     uint32_t fbo_f;
     std::shared_ptr<ITexture> fbo_f_texture;
+    uint32_t rbo_f_color;
+    uint32_t rbo_f_depth;
     
     // Shadow mapping
     uint32_t fbo_shadow;
-    uint32_t fbo_shadow_cube_texture;
+    uint32_t fbo_shadow_texture;     // depth atlas of every light's shadow maps
+    int32_t shadowAtlasSize;         // 0 = shadows off
     uint32_t fbo_env;
     
     // Post-processing
     std::vector<uint32_t> fbo_pp;
     std::vector<uint32_t> fbo_pp_texture;
+    int32_t postTargetSize[2][2];   // allocated size of each fbo_pp texture
+    std::vector<PostPass> postPasses;
+    uint32_t postGeneration;        // bumped by QueuePostShaders; older programs are dropped
+
+    // EXT_disjoint_timer_query entry points (not in the bundled glad
+    // headers); null without the extension
+    typedef void (GLAD_API_PTR *QueryCounterEXTProc)(GLuint id, GLenum target);
+    typedef void (GLAD_API_PTR *GetQueryObjectui64vEXTProc)(GLuint id, GLenum pname, GLuint64* params);
+    QueryCounterEXTProc queryCounterEXT;
+    GetQueryObjectui64vEXTProc getQueryObjectui64vEXT;
+
+    // EXT_multisampled_render_to_texture entry points; null without the
+    // extension
+    typedef void (GLAD_API_PTR *RenderbufferStorageMultisampleEXTProc)(GLenum target, GLsizei samples,
+                                                                         GLenum internalformat, GLsizei width,
+                                                                         GLsizei height);
+    typedef void (GLAD_API_PTR *FramebufferTexture2DMultisampleEXTProc)(GLenum target, GLenum attachment,
+                                                                          GLenum textarget, GLuint texture,
+                                                                          GLint level, GLsizei samples);
+    RenderbufferStorageMultisampleEXTProc renderbufferStorageMultisampleEXT;
+    FramebufferTexture2DMultisampleEXTProc framebufferTexture2DMultisampleEXT;
+
+    // Timer queries of BeginGPUTimer; timerQueries holds every name
+    std::vector<uint32_t> timerQueries;
+    std::vector<uint32_t> freeTimerQueries;
+
+    // GPU profiler timestamps, one slot per frame in flight. A region holds
+    // the indices of its two queries in the slot; profileStack has the
+    // regions open in the current frame (NoProfileRegion when not timed).
+    static const int ProfileFrameCount = 3;
+    static const uint32_t NoProfileRegion = 0xFFFFFFFFu;
+    struct ProfileRegion {
+        std::string name;
+        int32_t depth;
+        uint32_t begin;
+        uint32_t end;
+    };
+    struct ProfileFrame {
+        std::vector<uint32_t> queries;      // grown on demand, reused by later frames
+        std::vector<ProfileRegion> regions;
+        uint32_t used;                      // queries issued this frame
+        uint64_t frame;
+        bool pending;                       // issued and not yet resolved
+    };
+    ProfileFrame profileFrames[ProfileFrameCount];
+    std::vector<uint32_t> profileStack;
+    enum ProfilePass { ProfilePassShadows, ProfilePassModels, ProfilePassSprites, ProfilePassCount };
+    bool profilePassOpen[ProfilePassCount];
     
     // Shader programs (using smart pointers for automatic cleanup)
     std::shared_ptr<ShaderProgram_GLES> spriteShader;
@@ -304,25 +701,97 @@ public:
     std::shared_ptr<ShaderProgram_GLES> shadowMapShader;
     std::shared_ptr<ShaderProgram_GLES> panoramaToCubeMapShader;
     std::shared_ptr<ShaderProgram_GLES> cubemapFilteringShader;
-    std::vector<std::shared_ptr<ShaderProgram_GLES>> postShaderSelect;
+    std::vector<std::shared_ptr<ShaderProgram_GLES>> postShaderSelect;  // one per post pass, null until linked
 
     // Vertex buffers
-    uint32_t postVertBuffer;
-    uint32_t vertexBuffer;
-    uint32_t vertexBufferBatch;
+    uint32_t postVertBuffer;    // fullscreen triangle strip, read through postVAO
+    uint32_t postVAO;
     uint32_t modelVertexBuffer[2];
     uint32_t modelIndexBuffer[2];
     uint32_t vao;
 
+    // Sprite vertex streaming (shared by single quads and batches)
+    static const size_t SpriteVertexStride = 20;            // 5 floats * 4 bytes
+    static const size_t SpriteStreamSegmentSize = 4 << 20;  // 4 MiB per frame
+    StreamBuffer_GLES vertexStream;
+    int32_t vertexFirst;    // first vertex of the most recent upload
+
+    // Instanced sprites (INSTANCED variant of the sprite program)
+    static const size_t InstanceStreamSegmentSize = 1 << 20;  // 1 MiB per frame
+    std::shared_ptr<ShaderProgram_GLES> spriteInstancedShader;
+    StreamBuffer_GLES instanceStream;
+    bool instancedPipeline;
+    // Program the sprite uniform and texture setters and draws apply to:
+    // spriteInstancedShader while the instanced pipeline is set, otherwise
+    // spriteShader. Both members stay fixed.
+    ShaderProgram_GLES* activeSpriteShader;
+
+    // Texture uploads staged through pixel unpack buffers
+    static const size_t TextureUploadSegmentSize = 4 << 20; // 4 MiB per frame, grows on demand
+    TextureUploadQueue_GLES textureUploads;
+
+    // Uniform block streaming (USE_UBO path)
+    static const size_t UniformStreamSegmentSize = 1 << 20; // 1 MiB per frame
+    StreamBuffer_GLES uniformStream;
+    bool useUniformBuffers;
+    size_t uniformBufferAlignment;
+    uint64_t frameIndex;
+    std::string shaderDefines;      // injected after the #version line
+    struct {
+        uint32_t generation;
+        size_t offset;
+    } boundBlocks[static_cast<int>(UniformBlockBinding::Count)];
+
+    // Shader loading
+    std::string shaderDirectory;
+    ProgramBinaryCache binaryCache;
+    std::unordered_map<uint64_t, std::shared_ptr<ShaderProgram_GLES>> programCache;  // by source key
+    ShaderLoadStats shaderStats;
+
+    // Asynchronous compilation. With KHR_parallel_shader_compile jobs are
+    // advanced only once GL_COMPLETION_STATUS_KHR reports them done; without
+    // it each poll advances a single job by one stage.
+    struct ShaderJob {
+        std::string id;
+        uint64_t key;
+        std::vector<uint32_t> shaders;  // compiling; released once linking starts
+        uint32_t program;               // 0 until linking starts
+        std::function<void(const std::shared_ptr<ShaderProgram_GLES>&)> onReady;
+    };
+    std::vector<ShaderJob> shaderJobs;
+    std::shared_ptr<ShaderProgram_GLES> modelUnlitShader;  // stands in for modelShader
+    bool parallelShaderCompile;
+
+    // Model permutations (USE_UBO path). Uniforms are still written through
+    // modelShader, whose blocks the permutations share; RenderElements binds
+    // the permutation matching the GLState and material switches.
+    ShaderPermutationTable<ShaderProgram_GLES> modelPermutations;
+    std::string modelDefines;
+    uint32_t modelMaterialFeatures;     // material switches last set on modelShader
+    uint32_t boundModelProgram;
+    bool useModelPermutations;
+
+    // RenderElementsMultiDraw (ES 3.1): per-draw records and their commands
+    // are appended to instanceStream, which doubles as the draw indirect
+    // buffer; ES has no baseInstance, so each draw re-points drawModel
+    bool useDrawIndirect;
+    std::vector<DrawElementsIndirectCommand> indirectCommands;
+
+    // Vertex arrays of model meshes, keyed by buffer, stored attributes and
+    // mesh position; created on first use and dropped when the buffer is refilled
+    std::unordered_map<ModelVertexArrayKey, uint32_t, ModelVertexArrayKeyHash> modelVertexArrays;
+    uint32_t modelBufferIndex;  // buffer of the current model or shadow pass
+
     // Configuration
     bool enableModel;
     bool enableShadow;
-    int msaaLevel;  // 0 = disabled, 2, 4, 8 for MSAA levels
+    int msaaLevel;  // 0 = disabled, otherwise samples (at most GL_MAX_SAMPLES)
     
     // Render state tracking
     GLState glState;
     
-    // Screen dimensions (for scissor and viewport calculations)
+    // Size of the render targets (output size times render scale), for
+    // viewports and scissor rectangles
     struct {
         int32_t x, y, width, height;
     } viewport;
@@ -342,15 +811,73 @@ public:
     // Shader compilation and linking (ES-specific)
     std::shared_ptr<ShaderProgram_GLES> newShaderProgram(const std::string& vert, const std::string& frag,
                                                         const std::string& geo, const std::string& id,
-                                                        bool crashWhenFail);
+                                                        bool crashWhenFail, const std::string& defines = "");
+    std::shared_ptr<ShaderProgram_GLES> LoadShaderProgram(const std::string& id, const std::string& vertFile,
+                                                         const std::string& fragFile, const std::string& geoFile,
+                                                         const std::string& defines = "");
+    std::string PrepareShaderSource(const std::string& src, const std::string& defines) const;
+    std::vector<std::string> PrepareShaderSources(const std::string& vert, const std::string& frag,
+                                                  const std::string& defines) const;
+    std::shared_ptr<ShaderProgram_GLES> FindCachedProgram(uint64_t key);
     uint32_t compileShader(uint32_t shaderType, const std::string& src);
     uint32_t linkProgram(const std::vector<uint32_t>& shaders);
+    uint32_t beginCompileShader(uint32_t shaderType, const std::string& src);
+    bool finishCompileShader(uint32_t shader);
+    uint32_t beginLinkProgram(const std::vector<uint32_t>& shaders);
+    bool finishLinkProgram(uint32_t program);
+    bool QueueShaderProgram(const std::string& id, const std::string& vertFile, const std::string& fragFile,
+                            const std::string& defines,
+                            std::function<void(const std::shared_ptr<ShaderProgram_GLES>&)> onReady);
+    bool AdvanceShaderJob(ShaderJob& job, bool wait);
+    void InitParallelShaderCompile();
+    void InitTimerQueries();
+    void InitMultisampledRenderToTexture();
+    void QueueModelPermutation(uint32_t key);
+    void BindModelVertexArray(uint32_t features, uint32_t numVertices, uint32_t vertAttrOffset, bool shadow);
+    void DeleteModelVertexArrays(int32_t bufferIndex);
+    void BindModelProgram();
+    ShaderProgram_GLES* FindModelPermutation(uint32_t key);
+    void UseModelProgram(ShaderProgram_GLES* program);
+    void SetupModelDrawAttributes(size_t offset);
+    void ReleaseModelDrawAttributes();
+    uint32_t LoadProgramBinary(uint64_t key);
+    void StoreProgramBinary(uint64_t key, uint32_t program);
+    bool InitSpriteShaders();
     
     // Framebuffer operations
     bool InitFramebuffer(uint32_t& fbo, uint32_t& texture, uint32_t& rbo, 
                         int32_t width, int32_t height, bool useMultisample = false);
+    // Color and depth renderbuffers with the given sample count; deletes
+    // what it created on failure
+    bool InitMultisampleFramebuffer(uint32_t& fbo, uint32_t& color, uint32_t& depth,
+                                    int32_t width, int32_t height, int32_t samples);
     bool InitShadowFramebuffer();
-    bool InitPostProcessingFramebuffers();
+    // Main and post-processing targets at the render size; recreated by
+    // UpdateRenderTargets when it changes
+    bool CreateRenderTargets();
+    void DestroyRenderTargets();
+    void UpdateRenderTargets();
+    // Render pass load/store (SetRenderPassPolicy) on the bound draw
+    // framebuffer: clears or invalidates right after the bind, and
+    // invalidates what a pass leaves unused when it ends
+    void LoadAttachments(AttachmentLoad color, AttachmentLoad depth);
+    void InvalidateAttachments(bool color, bool depth);
+    // Ping-pong target of the post chain, reallocated at exactly the given size
+    bool CreatePostTarget(int32_t index, int32_t width, int32_t height);
+    void QueuePostShaders();
+    // Draws the post passes into the default framebuffer; false when the
+    // chain is empty or still compiling
+    bool RunPostPasses();
+    // Draws postVertBuffer with the bound program and framebuffer
+    void DrawFullscreenQuad(const ShaderProgram_GLES& shader);
+    void DrawEnvironmentRows(const ShaderProgram_GLES& shader, int32_t size, int32_t firstRow, int32_t rowCount);
+
+    // GPU profiler frames and the passes timed between prepare and release
+    void BeginGPUProfileFrame();    // resolves finished frames and opens "Frame"
+    void EndGPUProfileFrame();      // closes every region still open
+    uint32_t IssueTimestamp(ProfileFrame& slot);
+    void BeginPassRegion(ProfilePass pass);
+    void EndPassRegion(ProfilePass pass);
     
     // State management
     void CacheRenderState();
@@ -363,7 +890,15 @@ public:
     uint32_t MapPrimitiveMode(PrimitiveMode mode) const;
     uint32_t MapTextureTarget(const std::shared_ptr<ITexture>& tex) const;
     
+    // Uniform block upload
+    void FlushUniformBlocks(ShaderProgram_GLES* shader);
+    bool StoreBlockUniform(ShaderProgram_GLES* shader, const std::string& name, const void* data, int elementSize, int count);
+
     // Vertex attribute setup
+    void BindSpritePipeline(BlendEquation eq, BlendFunc src, BlendFunc dst);
+    void SetupSpriteVertexAttributes();
+    void SetupSpriteInstanceAttributes(size_t offset);
+    void ReleaseSpriteInstanceAttributes();
     void SetupVertexAttributes(const std::shared_ptr<ShaderProgram_GLES>& shader, 
                              uint32_t stride, const std::vector<std::string>& attributes);
     
@@ -379,11 +914,11 @@ public:
 // ==========================================
 
 inline void Texture_GLES::Bind(GLenum target) const {
-    glBindTexture(target, handle);
+    StateCache_GLES::BindTexture(target, handle);
 }
 
 inline void Texture_GLES::Unbind(GLenum target) const {
-    glBindTexture(target, 0);
+    StateCache_GLES::BindTexture(target, 0);
 }
 
 inline uint32_t Renderer_GLES::GetSpriteShaderProgram() const {
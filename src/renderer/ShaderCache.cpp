@@ -0,0 +1,189 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Shader Source Loading and Program Binary Cache Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "ShaderCache.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// ==========================================
+// Shader Sources
+// ==========================================
+
+std::string LoadShaderSource(const std::string& dir, const std::string& name) {
+    std::ifstream file(dir + name, std::ios::in | std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open shader source: " << dir << name << std::endl;
+        return "";
+    }
+
+    std::stringstream source;
+    source << file.rdbuf();
+    if (source.str().empty()) {
+        std::cerr << "Shader source is empty: " << dir << name << std::endl;
+    }
+    return source.str();
+}
+
+std::string InsertAfterVersion(const std::string& src, const std::string& text) {
+    if (src.compare(0, 8, "#version") != 0) {
+        return text + src;
+    }
+
+    std::string result = src;
+    size_t lineEnd = result.find('\n');
+    result.insert(lineEnd == std::string::npos ? result.size() : lineEnd + 1, text);
+    return result;
+}
+
+// ==========================================
+// Shader Load Statistics
+// ==========================================
+
+void ShaderLoadStats::Print(const std::string& label) const {
+    printf("%s (%s start): %u programs in %.1f ms - %u compiled, %u from binary cache, "
+           "%u shared, %u stale binaries\n",
+           label.c_str(), IsWarm() ? "warm" : "cold", programs, milliseconds,
+           compiled, binaryHits, memoryHits, binaryRejects);
+}
+
+// ==========================================
+// ProgramBinaryCache Implementation
+// ==========================================
+
+// File layout: header followed by the driver's binary blob
+struct ProgramBinaryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+};
+
+static const uint32_t ProgramBinaryMagic = 0x42504B49;  // "IKPB"
+static const uint32_t ProgramBinaryVersion = 2;  // 2: fixed model attribute locations
+
+// FNV-1a, continued across calls
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+ProgramBinaryCache::ProgramBinaryCache()
+    : directory("save/shadercache/"), enabled(false), directoryReady(false) {
+}
+
+void ProgramBinaryCache::SetDirectory(const std::string& dir) {
+    directory = dir;
+    if (!directory.empty() && directory.back() != '/') {
+        directory += '/';
+    }
+    directoryReady = false;
+}
+
+uint64_t ProgramBinaryCache::MakeKey(const std::vector<std::string>& sources) const {
+    uint64_t hash = 14695981039346656037ull;
+    hash = HashBytes(hash, driverIdentity.data(), driverIdentity.size());
+    for (const auto& source : sources) {
+        // Lengths keep ("ab", "c") and ("a", "bc") apart
+        uint64_t length = source.size();
+        hash = HashBytes(hash, &length, sizeof(length));
+        hash = HashBytes(hash, source.data(), source.size());
+    }
+    return hash;
+}
+
+std::string ProgramBinaryCache::PathFor(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return directory + name;
+}
+
+bool ProgramBinaryCache::Load(uint64_t key, uint32_t& format, std::vector<uint8_t>& binary) const {
+    if (!enabled) {
+        return false;
+    }
+
+    std::ifstream file(PathFor(key), std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    ProgramBinaryHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != ProgramBinaryMagic || header.version != ProgramBinaryVersion ||
+        header.key != key || header.size == 0) {
+        return false;
+    }
+
+    binary.resize(header.size);
+    if (!file.read(reinterpret_cast<char*>(binary.data()), header.size)) {
+        binary.clear();
+        return false;
+    }
+    format = header.format;
+    return true;
+}
+
+bool ProgramBinaryCache::Store(uint64_t key, uint32_t format, const std::vector<uint8_t>& binary) {
+    if (!enabled || binary.empty()) {
+        return false;
+    }
+
+    if (!directoryReady) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            std::cerr << "Failed to create shader cache directory " << directory << ": "
+                      << error.message() << std::endl;
+            return false;
+        }
+        directoryReady = true;
+    }
+
+    // Write to a temporary file first so a crash never leaves a torn entry
+    std::string path = PathFor(key);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Failed to write shader cache entry: " << tempPath << std::endl;
+            return false;
+        }
+
+        ProgramBinaryHeader header;
+        header.magic = ProgramBinaryMagic;
+        header.version = ProgramBinaryVersion;
+        header.key = key;
+        header.format = format;
+        header.size = static_cast<uint32_t>(binary.size());
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+        if (!file) {
+            std::cerr << "Failed to write shader cache entry: " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+void ProgramBinaryCache::Evict(uint64_t key) {
+    std::error_code error;
+    std::filesystem::remove(PathFor(key), error);
+}
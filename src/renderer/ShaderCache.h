@@ -0,0 +1,81 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Shader Source Loading and Program Binary Cache
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ==========================================
+// Shader Sources
+// ==========================================
+
+// Reads dir + name. Returns an empty string (and logs) when the file is
+// missing or empty.
+std::string LoadShaderSource(const std::string& dir, const std::string& name);
+
+// Inserts text right after the #version line of src, or prepends it when
+// src has no #version line
+std::string InsertAfterVersion(const std::string& src, const std::string& text);
+
+// ==========================================
+// Shader Load Statistics
+// ==========================================
+
+struct ShaderLoadStats {
+    uint32_t programs;          // programs requested
+    uint32_t memoryHits;        // served by the in-memory program cache
+    uint32_t binaryHits;        // loaded from a cached program binary
+    uint32_t binaryRejects;     // cached binaries the driver refused
+    uint32_t compiled;          // compiled and linked from source
+    double milliseconds;        // wall time spent in the loader
+
+    ShaderLoadStats() { Reset(); }
+    void Reset() {
+        programs = memoryHits = binaryHits = binaryRejects = compiled = 0;
+        milliseconds = 0.0;
+    }
+    // A start is warm when nothing had to be compiled
+    bool IsWarm() const { return compiled == 0 && programs > 0; }
+    void Print(const std::string& label) const;
+};
+
+// ==========================================
+// Program Binary Cache
+// ==========================================
+
+// On-disk cache of linked program binaries. Entries are keyed by a hash of
+// the driver identity and the final shader sources (including injected
+// #defines), so editing a shader or updating the driver simply misses.
+// Binaries the driver still refuses are evicted by the caller.
+class ProgramBinaryCache {
+public:
+    ProgramBinaryCache();
+
+    // Configuration
+    void SetDirectory(const std::string& dir);
+    void SetDriverIdentity(const std::string& identity) { driverIdentity = identity; }
+    void SetEnabled(bool enable) { enabled = enable; }
+    bool IsEnabled() const { return enabled; }
+
+    // Entry access
+    uint64_t MakeKey(const std::vector<std::string>& sources) const;
+    bool Load(uint64_t key, uint32_t& format, std::vector<uint8_t>& binary) const;
+    bool Store(uint64_t key, uint32_t format, const std::vector<uint8_t>& binary);
+    void Evict(uint64_t key);
+
+private:
+    std::string directory;
+    std::string driverIdentity;
+    bool enabled;
+    bool directoryReady;
+
+    std::string PathFor(uint64_t key) const;
+};
+
+#endif // SHADER_CACHE_H
@@ -0,0 +1,65 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Model Shader Permutations Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "ShaderPermutation.h"
+
+// ==========================================
+// Model Feature Flags
+// ==========================================
+
+static const struct {
+    uint32_t flag;
+    const char* define;
+} ModelFeatureDefines[ModelFeatureCount] = {
+    {ModelFeatureUV, "PERM_UV"},
+    {ModelFeatureNormal, "PERM_NORMAL"},
+    {ModelFeatureTangent, "PERM_TANGENT"},
+    {ModelFeatureVertColor, "PERM_VERT_COLOR"},
+    {ModelFeatureJoint0, "PERM_JOINT0"},
+    {ModelFeatureJoint1, "PERM_JOINT1"},
+    {ModelFeatureOutlineAttribute, "PERM_OUTLINE_ATTRIBUTE"},
+    {ModelFeatureTexture, "PERM_TEXTURE"},
+    {ModelFeatureNormalMap, "PERM_NORMAL_MAP"},
+    {ModelFeatureMetallicRoughnessMap, "PERM_METALLIC_ROUGHNESS_MAP"},
+    {ModelFeatureEmissionMap, "PERM_EMISSION_MAP"},
+    {ModelFeatureUnlit, "PERM_UNLIT"},
+    {ModelFeatureMultiDraw, "PERM_MULTI_DRAW"},
+};
+
+uint32_t ModelVertexFeatures(const GLState& state) {
+    return (state.useUV ? ModelFeatureUV : 0) |
+           (state.useNormal ? ModelFeatureNormal : 0) |
+           (state.useTangent ? ModelFeatureTangent : 0) |
+           (state.useVertColor ? ModelFeatureVertColor : 0) |
+           (state.useJoint0 ? ModelFeatureJoint0 : 0) |
+           (state.useJoint1 ? ModelFeatureJoint1 : 0) |
+           (state.useOutlineAttribute ? ModelFeatureOutlineAttribute : 0);
+}
+
+uint32_t ModelMaterialFeature(UniformID id) {
+    static const UniformID useTextureID = InternUniform("useTexture");
+    static const UniformID useNormalMapID = InternUniform("useNormalMap");
+    static const UniformID useMetallicRoughnessMapID = InternUniform("useMetallicRoughnessMap");
+    static const UniformID useEmissionMapID = InternUniform("useEmissionMap");
+    static const UniformID unlitID = InternUniform("unlit");
+
+    if (id == useTextureID) return ModelFeatureTexture;
+    if (id == useNormalMapID) return ModelFeatureNormalMap;
+    if (id == useMetallicRoughnessMapID) return ModelFeatureMetallicRoughnessMap;
+    if (id == useEmissionMapID) return ModelFeatureEmissionMap;
+    if (id == unlitID) return ModelFeatureUnlit;
+    return 0;
+}
+
+std::string ModelPermutationDefines(uint32_t features) {
+    std::string defines = "#define PERMUTATION\n";
+    for (const auto& feature : ModelFeatureDefines) {
+        defines += "#define ";
+        defines += feature.define;
+        defines += (features & feature.flag) ? " 1\n" : " 0\n";
+    }
+    return defines;
+}
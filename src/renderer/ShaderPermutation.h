@@ -0,0 +1,83 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Model Shader Permutations
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef SHADER_PERMUTATION_H
+#define SHADER_PERMUTATION_H
+
+#include "RendererInterfaces.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// ==========================================
+// Model Feature Flags
+// ==========================================
+
+// Switches the model shaders otherwise evaluate at runtime. The low bits are
+// the vertex attribute switches of GLState, the high bits the material
+// switches model.frag reads from uniforms. MultiDraw takes the model matrix
+// from a per-draw attribute (RenderElementsMultiDraw).
+enum ModelFeatureFlag : uint32_t {
+    ModelFeatureUV                   = 1 << 0,    // useUV
+    ModelFeatureNormal               = 1 << 1,    // useNormal
+    ModelFeatureTangent              = 1 << 2,    // useTangent
+    ModelFeatureVertColor            = 1 << 3,    // useVertColor
+    ModelFeatureJoint0               = 1 << 4,    // useJoint0
+    ModelFeatureJoint1               = 1 << 5,    // useJoint1
+    ModelFeatureOutlineAttribute     = 1 << 6,    // useOutlineAttribute
+    ModelFeatureTexture              = 1 << 7,    // useTexture
+    ModelFeatureNormalMap            = 1 << 8,    // useNormalMap
+    ModelFeatureMetallicRoughnessMap = 1 << 9,    // useMetallicRoughnessMap
+    ModelFeatureEmissionMap          = 1 << 10,   // useEmissionMap
+    ModelFeatureUnlit                = 1 << 11,   // unlit
+    ModelFeatureMultiDraw            = 1 << 12    // drawModel attribute
+};
+
+static const int ModelFeatureCount = 13;
+
+// Vertex part of a permutation key
+uint32_t ModelVertexFeatures(const GLState& state);
+
+// Material flag driven by the model uniform id (an int 0/1), or 0 when the
+// uniform is not one of the material switches
+uint32_t ModelMaterialFeature(UniformID id);
+
+// "#define PERMUTATION" followed by one PERM_<FEATURE> 0/1 line per flag;
+// the model shaders then treat the switches as constants
+std::string ModelPermutationDefines(uint32_t features);
+
+// ==========================================
+// Permutation Table
+// ==========================================
+
+// Programs indexed directly by their feature key, so looking one up is a
+// single array access. Entries are built lazily: the renderer queues a
+// Missing entry for compilation and keeps drawing with the generic program
+// until it turns Ready. An entry whose compilation failed stays Pending.
+template <typename Program>
+class ShaderPermutationTable {
+public:
+    enum class State : uint8_t {
+        Missing,
+        Pending,
+        Ready
+    };
+
+    struct Entry {
+        std::shared_ptr<Program> program;
+        State state = State::Missing;
+    };
+
+    ShaderPermutationTable() : entries(size_t(1) << ModelFeatureCount) {}
+
+    Entry& operator[](uint32_t key) { return entries[key]; }
+    void Clear() { entries.assign(entries.size(), Entry()); }
+
+private:
+    std::vector<Entry> entries;
+};
+
+#endif // SHADER_PERMUTATION_H
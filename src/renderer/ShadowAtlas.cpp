@@ -0,0 +1,269 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Shadow Map Atlas Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "ShadowAtlas.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// ==========================================
+// ShadowAtlas Implementation
+// ==========================================
+
+ShadowAtlas::ShadowAtlas(int32_t size, int32_t minTile, float cascadeRatio)
+    : size(size), minTile(std::min(minTile, size)), cascadeRatio(cascadeRatio), repacks(0), invalid(true) {
+    memset(slots, 0, sizeof(slots));
+    rects.assign(MaxShadowLights * MaxShadowViews * 4, 0.0f);
+    cascades.assign(MaxShadowLights * MaxShadowCascades * 4, 0.0f);
+}
+
+void ShadowAtlas::Invalidate() {
+    invalid = true;
+}
+
+int32_t ShadowAtlas::GetViewCount(int32_t light) const {
+    return light >= 0 && light < MaxShadowLights ? slots[light].viewCount : 0;
+}
+
+const ShadowAtlasView& ShadowAtlas::GetView(int32_t light, int32_t view) const {
+    return slots[light].views[view];
+}
+
+bool ShadowAtlas::NeedsRender(int32_t light) const {
+    return light >= 0 && light < MaxShadowLights && slots[light].viewCount > 0 && slots[light].dirty;
+}
+
+const float* ShadowAtlas::GetCascade(int32_t light, int32_t cascade) const {
+    return slots[light].cascades[cascade];
+}
+
+// Largest power of two at most half the atlas scaled by sqrt(importance),
+// so the tile area follows the screen area
+int32_t ShadowAtlas::WantedTileSize(float importance) const {
+    if (!(importance > 0.0f)) {
+        return 0;
+    }
+    float wanted = size * 0.5f * std::sqrt(std::min(importance, 1.0f));
+    int32_t tile = minTile;
+    while (tile * 2 <= wanted && tile * 2 <= size / 2) {
+        tile *= 2;
+    }
+    return tile;
+}
+
+// Largest tiles first, lights in index order among equals
+bool ShadowAtlas::Pack(const int32_t tileSizes[MaxShadowLights], const int32_t viewCounts[MaxShadowLights],
+                       ShadowAtlasView views[MaxShadowLights][MaxShadowViews]) {
+    int32_t order[MaxShadowLights];
+    for (int32_t i = 0; i < MaxShadowLights; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order, order + MaxShadowLights,
+                     [&](int32_t a, int32_t b) { return tileSizes[a] > tileSizes[b]; });
+
+    SkylinePacker packer;
+    packer.Reset(size, size);
+    for (int32_t light : order) {
+        for (int32_t v = 0; v < viewCounts[light]; ++v) {
+            ShadowAtlasView& view = views[light][v];
+            view.size = tileSizes[light];
+            if (!packer.Insert(view.size, view.size, view.x, view.y)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Nested squares around the focus, the last covering the whole light area;
+// origins snap to an eighth of the square so small camera moves keep them
+void ShadowAtlas::FitCascades(const ShadowLight& light, float out[MaxShadowCascades][4]) const {
+    memset(out, 0, sizeof(float) * MaxShadowCascades * 4);
+    int32_t count = std::max(1, std::min(light.cascades, MaxShadowCascades));
+    for (int32_t c = 0; c < count; ++c) {
+        float extent = std::pow(cascadeRatio, static_cast<float>(count - 1 - c));
+        float step = extent / 8.0f;
+        out[c][0] = out[c][1] = 1.0f / extent;
+        for (int axis = 0; axis < 2; ++axis) {
+            float origin = std::floor((light.focus[axis] - extent * 0.5f) / step + 0.5f) * step;
+            origin = std::max(0.0f, std::min(origin, 1.0f - extent));
+            out[c][2 + axis] = -origin / extent;
+        }
+    }
+}
+
+void ShadowAtlas::Update(const std::vector<ShadowLight>& lights) {
+    int32_t tileSizes[MaxShadowLights];
+    int32_t viewCounts[MaxShadowLights];
+    float importance[MaxShadowLights];
+    for (int32_t i = 0; i < MaxShadowLights; ++i) {
+        const ShadowLight* light = i < static_cast<int32_t>(lights.size()) ? &lights[i] : nullptr;
+        int32_t wanted = light ? WantedTileSize(light->importance) : 0;
+        importance[i] = wanted > 0 ? light->importance : 0.0f;
+        viewCounts[i] = 0;
+        if (wanted > 0) {
+            switch (light->type) {
+            case ShadowLightType::Directional:
+                viewCounts[i] = std::max(1, std::min(light->cascades, MaxShadowCascades));
+                break;
+            case ShadowLightType::Point:
+                viewCounts[i] = 6;
+                break;
+            case ShadowLightType::Spot:
+                viewCounts[i] = 1;
+                break;
+            }
+        }
+        // Keep the current tile unless it is too small or over twice as large
+        int32_t current = slots[i].tileSize;
+        tileSizes[i] = current > 0 && wanted > 0 && current >= wanted && current <= wanted * 2 ? current : wanted;
+    }
+
+    // Same tiles as last frame: nothing moves
+    bool samePlan = true;
+    for (int32_t i = 0; i < MaxShadowLights; ++i) {
+        if (tileSizes[i] != slots[i].tileSize || viewCounts[i] != slots[i].viewCount) {
+            samePlan = false;
+        }
+    }
+
+    ShadowAtlasView views[MaxShadowLights][MaxShadowViews];
+    memset(views, 0, sizeof(views));
+    if (samePlan) {
+        for (int32_t i = 0; i < MaxShadowLights; ++i) {
+            memcpy(views[i], slots[i].views, sizeof(views[i]));
+        }
+    } else {
+        while (!Pack(tileSizes, viewCounts, views)) {
+            // Halve the least important light still above minTile, or drop
+            // the least important one when all are at minTile
+            int32_t shrink = -1, drop = -1;
+            for (int32_t i = 0; i < MaxShadowLights; ++i) {
+                if (viewCounts[i] == 0) continue;
+                if (tileSizes[i] > minTile && (shrink < 0 || importance[i] < importance[shrink])) {
+                    shrink = i;
+                }
+                if (drop < 0 || importance[i] < importance[drop]) {
+                    drop = i;
+                }
+            }
+            if (shrink >= 0) {
+                tileSizes[shrink] /= 2;
+            } else {
+                tileSizes[drop] = viewCounts[drop] = 0;
+            }
+            memset(views, 0, sizeof(views));
+        }
+    }
+
+    bool anyMoved = false;
+    for (int32_t i = 0; i < MaxShadowLights; ++i) {
+        Slot& slot = slots[i];
+        float fitted[MaxShadowCascades][4];
+        memset(fitted, 0, sizeof(fitted));
+        if (viewCounts[i] > 0 && lights[i].type == ShadowLightType::Directional) {
+            FitCascades(lights[i], fitted);
+        }
+
+        bool moved = tileSizes[i] != slot.tileSize || viewCounts[i] != slot.viewCount ||
+                     memcmp(views[i], slot.views, sizeof(views[i])) != 0;
+        bool changed = viewCounts[i] > 0 && (lights[i].type != slot.type ||
+                       lights[i].casterVersion != slot.casterVersion ||
+                       memcmp(fitted, slot.cascades, sizeof(fitted)) != 0);
+        slot.dirty = viewCounts[i] > 0 && (invalid || moved || changed);
+        anyMoved = anyMoved || moved;
+
+        slot.tileSize = tileSizes[i];
+        slot.viewCount = viewCounts[i];
+        memcpy(slot.views, views[i], sizeof(slot.views));
+        memcpy(slot.cascades, fitted, sizeof(slot.cascades));
+        if (viewCounts[i] > 0) {
+            slot.type = lights[i].type;
+            slot.casterVersion = lights[i].casterVersion;
+        }
+
+        for (int32_t v = 0; v < MaxShadowViews; ++v) {
+            float* rect = &rects[(i * MaxShadowViews + v) * 4];
+            const ShadowAtlasView& view = slot.views[v];
+            bool used = v < slot.viewCount;
+            rect[0] = used ? float(view.x) / size : 0.0f;
+            rect[1] = used ? float(view.y) / size : 0.0f;
+            rect[2] = rect[3] = used ? float(view.size) / size : 0.0f;
+        }
+        memcpy(&cascades[i * MaxShadowCascades * 4], slot.cascades, sizeof(slot.cascades));
+    }
+    if (anyMoved) {
+        repacks++;
+    }
+    invalid = false;
+}
+
+ShadowAtlasStats ShadowAtlas::GetStats() const {
+    ShadowAtlasStats stats;
+    for (const Slot& slot : slots) {
+        if (slot.viewCount == 0) continue;
+        stats.lights++;
+        stats.views += slot.viewCount;
+        stats.usedTexels += int64_t(slot.viewCount) * slot.tileSize * slot.tileSize;
+        if (slot.dirty) {
+            stats.renderedViews += slot.viewCount;
+        }
+    }
+    stats.repacks = repacks;
+    return stats;
+}
+
+// ==========================================
+// Light Views
+// ==========================================
+
+float ShadowImportance(const float position[3], float range, mat4x4 const view, mat4x4 const projection) {
+    vec4 center = {position[0], position[1], position[2], 1.0f};
+    vec4 eye;
+    mat4x4_mul_vec4(eye, view, center);
+    float depth = -eye[2];
+    if (depth <= range) {
+        // Around or behind the camera: covers the screen unless wholly behind
+        return depth + range > 0.0f ? 1.0f : 0.0f;
+    }
+
+    // Projected ellipse, in NDC units (the screen spans 2 x 2)
+    float rx = range * projection[0][0] / depth;
+    float ry = range * projection[1][1] / depth;
+    float cx = eye[0] * projection[0][0] / depth;
+    float cy = eye[1] * projection[1][1] / depth;
+    if (std::fabs(cx) - rx > 1.0f || std::fabs(cy) - ry > 1.0f) {
+        return 0.0f;
+    }
+    return std::min(1.0f, 3.14159265f * rx * ry / 4.0f);
+}
+
+void ShadowCubeFaceMatrix(mat4x4 out, const float position[3], float nearPlane, float farPlane, int32_t face) {
+    static const float forward[6][3] = {
+        {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f},
+        {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}
+    };
+    // model.frag picks the same up vector for the face
+    vec3 up = {0.0f, forward[face][1] != 0.0f ? 0.0f : 1.0f, forward[face][1] != 0.0f ? 1.0f : 0.0f};
+    vec3 eye = {position[0], position[1], position[2]};
+    vec3 center = {eye[0] + forward[face][0], eye[1] + forward[face][1], eye[2] + forward[face][2]};
+
+    mat4x4 viewMatrix, projection;
+    mat4x4_look_at(viewMatrix, eye, center, up);
+    mat4x4_perspective(projection, 1.5707963f, 1.0f, nearPlane, farPlane);
+    mat4x4_mul(out, projection, viewMatrix);
+}
+
+// uv * scale + offset in 0..1 is NDC * scale + (scale + 2 * offset - 1)
+void ShadowCascadeMatrix(mat4x4 out, mat4x4 const lightMatrix, const float cascade[4]) {
+    mat4x4 crop;
+    mat4x4_identity(crop);
+    crop[0][0] = cascade[0];
+    crop[1][1] = cascade[1];
+    crop[3][0] = cascade[0] + 2.0f * cascade[2] - 1.0f;
+    crop[3][1] = cascade[1] + 2.0f * cascade[3] - 1.0f;
+    mat4x4_mul(out, crop, lightMatrix);
+}
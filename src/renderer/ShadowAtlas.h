@@ -0,0 +1,143 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Shadow Map Atlas
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include "RendererInterfaces.h"
+#include "SpriteAtlas.h"
+
+// ==========================================
+// Shadow Lights
+// ==========================================
+
+// model.frag.glsl shades four lights. A point light renders its six cube
+// faces and a directional light up to four cascades, each into its own
+// tile; a spot light needs one.
+static const int MaxShadowLights = 4;
+static const int MaxShadowViews = 6;
+static const int MaxShadowCascades = 4;
+
+// Same values as model.frag's LightType_ constants
+enum class ShadowLightType {
+    Directional = 0,
+    Point = 1,
+    Spot = 2
+};
+
+struct ShadowLight {
+    ShadowLightType type;
+    float importance;       // 0..1 (ShadowImportance); 0 casts no shadow
+    int32_t cascades;       // directional lights: 1..MaxShadowCascades
+    float focus[2];         // directional lights: camera position in the light's 0..1 projected area
+    uint64_t casterVersion; // changed whenever the light or a caster in its reach moves
+
+    ShadowLight()
+        : type(ShadowLightType::Directional), importance(0.0f), cascades(1), focus{0.5f, 0.5f},
+          casterVersion(0) {}
+};
+
+// One tile, in texels from the bottom left of the atlas
+struct ShadowAtlasView {
+    int32_t x, y, size;
+};
+
+struct ShadowAtlasStats {
+    uint32_t lights;            // lights holding tiles
+    uint32_t views;
+    uint32_t renderedViews;     // views of the lights NeedsRender returned true for
+    uint32_t repacks;           // Updates that moved tiles
+    int64_t usedTexels;
+
+    ShadowAtlasStats() : lights(0), views(0), renderedViews(0), repacks(0), usedTexels(0) {}
+};
+
+// ==========================================
+// Shadow Atlas
+// ==========================================
+
+// Packs the shadow maps of all lights into one square depth texture
+// (IRenderer::SetShadowAtlasSize) instead of a cube map per light, so
+// point, spot and directional lights render without a geometry shader:
+// every view is an ordinary draw into its tile (SetShadowAtlasView).
+//
+// Tiles are powers of two sized by the light's screen importance. They
+// grow at once but shrink only past twice the wanted size, and the
+// skyline is repacked only when a size changes, so tiles stay put from
+// frame to frame. The atlas persists between frames: a light is rendered
+// again only when its casterVersion, its tiles or its cascades change.
+// When everything does not fit, the least important lights are halved
+// first, down to minTile, then dropped.
+class ShadowAtlas {
+public:
+    explicit ShadowAtlas(int32_t size = 4096, int32_t minTile = 128, float cascadeRatio = 0.35f);
+
+    // Plans one frame; lights[i] is model light i
+    void Update(const std::vector<ShadowLight>& lights);
+    // The atlas contents were lost (resized or recreated): Update renders
+    // every light again
+    void Invalidate();
+
+    int32_t GetSize() const { return size; }
+    int32_t GetViewCount(int32_t light) const;
+    const ShadowAtlasView& GetView(int32_t light, int32_t view) const;
+    bool NeedsRender(int32_t light) const;
+
+    // Cascade c of a directional light as vec4(scale.xy, offset.xy): its
+    // tile covers light area uv where uv * scale + offset is in 0..1
+    const float* GetCascade(int32_t light, int32_t cascade) const;
+
+    // model.frag's shadowAtlasRects: tile offset.xy and size.zw in 0..1 for
+    // view v of light i at i * MaxShadowViews + v; zero size casts no shadow
+    const std::vector<float>& GetRects() const { return rects; }
+    // model.frag's shadowCascades, light i cascade c at i * MaxShadowCascades + c
+    const std::vector<float>& GetCascades() const { return cascades; }
+
+    ShadowAtlasStats GetStats() const;
+
+private:
+    struct Slot {
+        ShadowLightType type;
+        int32_t viewCount;
+        int32_t tileSize;
+        uint64_t casterVersion;
+        float cascades[MaxShadowCascades][4];
+        ShadowAtlasView views[MaxShadowViews];
+        bool dirty;
+    };
+
+    int32_t size;
+    int32_t minTile;
+    float cascadeRatio;
+    Slot slots[MaxShadowLights];
+    std::vector<float> rects;
+    std::vector<float> cascades;
+    uint32_t repacks;
+    bool invalid;
+
+    int32_t WantedTileSize(float importance) const;
+    bool Pack(const int32_t tileSizes[MaxShadowLights], const int32_t viewCounts[MaxShadowLights],
+              ShadowAtlasView views[MaxShadowLights][MaxShadowViews]);
+    void FitCascades(const ShadowLight& light, float out[MaxShadowCascades][4]) const;
+};
+
+// ==========================================
+// Light Views
+// ==========================================
+
+// Share of the screen the sphere of radius range around position covers,
+// 0..1; 1 when the camera is inside it
+float ShadowImportance(const float position[3], float range, mat4x4 const view, mat4x4 const projection);
+
+// View-projection of cube face 0..5 (+X, -X, +Y, -Y, +Z, -Z) of a point
+// light, matching the face model.frag samples
+void ShadowCubeFaceMatrix(mat4x4 out, const float position[3], float nearPlane, float farPlane, int32_t face);
+
+// View-projection that renders a cascade (GetCascade) through the light's
+// matrix; depth is left as lightMatrix produces it
+void ShadowCascadeMatrix(mat4x4 out, mat4x4 const lightMatrix, const float cascade[4]);
+
+#endif // SHADOW_ATLAS_H
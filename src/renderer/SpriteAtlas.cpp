@@ -0,0 +1,354 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Dynamic Sprite Texture Atlas Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "SpriteAtlas.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+// ==========================================
+// SkylinePacker Implementation
+// ==========================================
+
+void SkylinePacker::Reset(int32_t w, int32_t h) {
+    width = w;
+    height = h;
+    usedArea = 0;
+    skyline.assign(1, Segment{0, 0, w});
+}
+
+int32_t SkylinePacker::FitAt(size_t index, int32_t w, int32_t h) const {
+    if (skyline[index].x + w > width) {
+        return -1;
+    }
+
+    // The segments ahead span at least w because the last one ends at width
+    int32_t top = 0;
+    int32_t remaining = w;
+    for (size_t i = index; remaining > 0; ++i) {
+        top = std::max(top, skyline[i].y);
+        if (top + h > height) {
+            return -1;
+        }
+        remaining -= skyline[i].width;
+    }
+    return top;
+}
+
+bool SkylinePacker::Insert(int32_t w, int32_t h, int32_t& x, int32_t& y) {
+    if (w <= 0 || h <= 0 || skyline.empty()) {
+        return false;
+    }
+
+    size_t best = skyline.size();
+    int32_t bestTop = INT_MAX, bestBottom = INT_MAX, bestWidth = INT_MAX;
+    for (size_t i = 0; i < skyline.size(); ++i) {
+        int32_t top = FitAt(i, w, h);
+        if (top < 0) continue;
+        if (top + h < bestBottom || (top + h == bestBottom && skyline[i].width < bestWidth)) {
+            best = i;
+            bestTop = top;
+            bestBottom = top + h;
+            bestWidth = skyline[i].width;
+        }
+    }
+    if (best == skyline.size()) {
+        return false;
+    }
+
+    x = skyline[best].x;
+    y = bestTop;
+    skyline.insert(skyline.begin() + best, Segment{x, bestBottom, w});
+
+    // Cut the segments now covered by the new one
+    for (size_t i = best + 1; i < skyline.size();) {
+        int32_t coveredEnd = skyline[i - 1].x + skyline[i - 1].width;
+        if (skyline[i].x >= coveredEnd) break;
+
+        int32_t shrink = coveredEnd - skyline[i].x;
+        if (skyline[i].width <= shrink) {
+            skyline.erase(skyline.begin() + i);
+            continue;
+        }
+        skyline[i].x += shrink;
+        skyline[i].width -= shrink;
+        break;
+    }
+
+    // Neighbours at the same height become one segment
+    for (size_t i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+
+    usedArea += static_cast<int64_t>(w) * h;
+    return true;
+}
+
+// ==========================================
+// SpriteAtlas Implementation
+// ==========================================
+
+SpriteAtlas::SpriteAtlas(IRenderer* renderer, int32_t pageSize, int32_t maxPages)
+    : renderer(renderer), pageSize(pageSize), maxPages(std::max(maxPages, 1)), frame(1), nextHandle(1),
+      uploads(0), evictions(0), repacks(0) {
+}
+
+std::shared_ptr<ITexture> SpriteAtlas::NewPageTexture() {
+    // Cleared to index 0 so padding and free space read as transparent
+    std::shared_ptr<ITexture> texture = renderer->newTexture(pageSize, pageSize, 8, false);
+    renderer->SetTextureData(texture, std::vector<uint8_t>(static_cast<size_t>(pageSize) * pageSize, 0));
+    return texture;
+}
+
+SpriteAtlasHandle SpriteAtlas::Add(const std::vector<uint8_t>& pixels, int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0 || width + Padding > pageSize || height + Padding > pageSize) {
+        std::cerr << "SpriteAtlas: " << width << "x" << height << " sprite does not fit a "
+                  << pageSize << "x" << pageSize << " page" << std::endl;
+        return 0;
+    }
+    if (pixels.size() < static_cast<size_t>(width) * height) {
+        std::cerr << "SpriteAtlas: sprite data is smaller than " << width << "x" << height << std::endl;
+        return 0;
+    }
+
+    int32_t page = 0, x = 0, y = 0;
+    if (!Allocate(width + Padding, height + Padding, page, x, y)) {
+        std::cerr << "SpriteAtlas: no room for a " << width << "x" << height
+                  << " sprite among the sprites drawn this frame" << std::endl;
+        return 0;
+    }
+
+    // The padding column and row are uploaded with the sprite so they stay
+    // clear whatever the space held before
+    const int32_t paddedWidth = width + Padding;
+    const int32_t paddedHeight = height + Padding;
+    std::vector<uint8_t> padded(static_cast<size_t>(paddedWidth) * paddedHeight, 0);
+    for (int32_t row = 0; row < height; ++row) {
+        std::memcpy(&padded[static_cast<size_t>(row) * paddedWidth], &pixels[static_cast<size_t>(row) * width],
+                    width);
+    }
+    renderer->SetTextureSubData(pages[page].texture, padded, x, y, paddedWidth, paddedHeight);
+
+    SpriteAtlasHandle handle = nextHandle++;
+    entries[handle] = Entry{page, x, y, width, height, frame};
+    pages[page].livePixels += static_cast<int64_t>(width) * height;
+    pages[page].lastUsed = frame;
+    uploads++;
+    return handle;
+}
+
+void SpriteAtlas::Remove(SpriteAtlasHandle handle) {
+    auto it = entries.find(handle);
+    if (it == entries.end()) return;
+
+    Page& page = pages[it->second.page];
+    page.livePixels -= static_cast<int64_t>(it->second.width) * it->second.height;
+    entries.erase(it);
+
+    // An emptied page is reusable at once; partial holes wait for a repack
+    if (page.livePixels == 0) {
+        page.packer.Reset(pageSize, pageSize);
+    }
+}
+
+bool SpriteAtlas::Lookup(SpriteAtlasHandle handle, SpriteAtlasRegion& region) const {
+    auto it = entries.find(handle);
+    if (it == entries.end()) return false;
+
+    const Entry& e = it->second;
+    const float scale = 1.0f / pageSize;
+    region.page = e.page;
+    region.x = e.x;
+    region.y = e.y;
+    region.width = e.width;
+    region.height = e.height;
+    region.uvRect[0] = e.x * scale;
+    region.uvRect[1] = e.y * scale;
+    region.uvRect[2] = (e.x + e.width) * scale;
+    region.uvRect[3] = (e.y + e.height) * scale;
+    return true;
+}
+
+void SpriteAtlas::Touch(SpriteAtlasHandle handle) {
+    auto it = entries.find(handle);
+    if (it == entries.end()) return;
+
+    it->second.lastUsed = frame;
+    pages[it->second.page].lastUsed = frame;
+}
+
+bool SpriteAtlas::Allocate(int32_t width, int32_t height, int32_t& page, int32_t& x, int32_t& y) {
+    for (size_t i = 0; i < pages.size(); ++i) {
+        if (pages[i].packer.Insert(width, height, x, y)) {
+            page = static_cast<int32_t>(i);
+            return true;
+        }
+    }
+
+    if (static_cast<int32_t>(pages.size()) < maxPages) {
+        Page fresh;
+        fresh.texture = NewPageTexture();
+        fresh.packer.Reset(pageSize, pageSize);
+        fresh.livePixels = 0;
+        fresh.lastUsed = frame;
+        pages.push_back(fresh);
+
+        page = static_cast<int32_t>(pages.size()) - 1;
+        return pages[page].packer.Insert(width, height, x, y);
+    }
+
+    // A compacted page holds only sprites drawn this frame and has nothing
+    // left to reclaim, so each page is tried at most once
+    while (EvictPage()) {
+        for (size_t i = 0; i < pages.size(); ++i) {
+            if (pages[i].packer.Insert(width, height, x, y)) {
+                page = static_cast<int32_t>(i);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool SpriteAtlas::EvictPage() {
+    // Texels a compaction would give back: the space of sprites not drawn
+    // this frame and the holes Remove left behind
+    std::vector<int64_t> reclaimable(pages.size());
+    for (size_t i = 0; i < pages.size(); ++i) {
+        reclaimable[i] = pages[i].packer.GetUsedArea();
+    }
+    for (const auto& entry : entries) {
+        const Entry& e = entry.second;
+        if (e.lastUsed == frame) {
+            reclaimable[e.page] -= static_cast<int64_t>(e.width + Padding) * (e.height + Padding);
+        }
+    }
+
+    // The least recently drawn page goes first, so whole pages of stale
+    // sprites are dropped before partly live ones are repacked; among
+    // equals, the one that frees the most
+    int32_t victim = -1;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        if (reclaimable[i] <= 0) continue;
+        if (victim < 0 || pages[i].lastUsed < pages[victim].lastUsed ||
+            (pages[i].lastUsed == pages[victim].lastUsed && reclaimable[i] > reclaimable[victim])) {
+            victim = static_cast<int32_t>(i);
+        }
+    }
+    if (victim < 0) return false;
+
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.page == victim && it->second.lastUsed < frame) {
+            it = entries.erase(it);
+            evictions++;
+        } else {
+            ++it;
+        }
+    }
+    Repack({victim});
+    return true;
+}
+
+void SpriteAtlas::Repack(const std::vector<int32_t>& sourcePages) {
+    std::vector<int32_t> slot(pages.size(), -1);
+    for (size_t i = 0; i < sourcePages.size(); ++i) {
+        slot[sourcePages[i]] = static_cast<int32_t>(i);
+    }
+
+    // Tallest first keeps the skyline flat; the handle makes ties stable
+    std::vector<SpriteAtlasHandle> moving;
+    for (const auto& entry : entries) {
+        if (slot[entry.second.page] >= 0) moving.push_back(entry.first);
+    }
+    std::sort(moving.begin(), moving.end(), [this](SpriteAtlasHandle a, SpriteAtlasHandle b) {
+        const Entry& ea = entries.at(a);
+        const Entry& eb = entries.at(b);
+        if (ea.height != eb.height) return ea.height > eb.height;
+        if (ea.width != eb.width) return ea.width > eb.width;
+        return a < b;
+    });
+
+    // Old pages stay alive until every sprite has been copied out of them
+    std::vector<std::shared_ptr<ITexture>> old(sourcePages.size());
+    for (size_t i = 0; i < sourcePages.size(); ++i) {
+        Page& page = pages[sourcePages[i]];
+        old[i] = page.texture;
+        page.texture = NewPageTexture();
+        page.packer.Reset(pageSize, pageSize);
+        page.livePixels = 0;
+        page.lastUsed = 0;
+        repacks++;
+    }
+
+    for (SpriteAtlasHandle handle : moving) {
+        Entry& e = entries[handle];
+        const int32_t paddedWidth = e.width + Padding;
+        const int32_t paddedHeight = e.height + Padding;
+
+        bool placed = false;
+        for (int32_t target : sourcePages) {
+            int32_t x = 0, y = 0;
+            Page& page = pages[target];
+            if (!page.packer.Insert(paddedWidth, paddedHeight, x, y)) continue;
+
+            renderer->CopyTextureRegion(old[slot[e.page]], e.x, e.y, page.texture, x, y, paddedWidth, paddedHeight);
+            e.page = target;
+            e.x = x;
+            e.y = y;
+            page.livePixels += static_cast<int64_t>(e.width) * e.height;
+            page.lastUsed = std::max(page.lastUsed, e.lastUsed);
+            placed = true;
+            break;
+        }
+        if (!placed) {
+            entries.erase(handle);
+            evictions++;
+        }
+    }
+}
+
+void SpriteAtlas::Defragment() {
+    if (pages.empty()) return;
+
+    std::vector<int32_t> all(pages.size());
+    for (size_t i = 0; i < pages.size(); ++i) {
+        all[i] = static_cast<int32_t>(i);
+    }
+    Repack(all);
+
+    // Sprites fill the pages in order, so the empty ones are at the end
+    while (!pages.empty() && pages.back().livePixels == 0) {
+        pages.pop_back();
+    }
+}
+
+SpriteAtlasStats SpriteAtlas::GetStats() const {
+    SpriteAtlasStats stats;
+    stats.pages = static_cast<uint32_t>(pages.size());
+    stats.sprites = static_cast<uint32_t>(entries.size());
+    stats.uploads = uploads;
+    stats.evictions = evictions;
+    stats.repacks = repacks;
+    for (const Page& page : pages) {
+        stats.livePixels += page.livePixels;
+        stats.allocatedPixels += page.packer.GetUsedArea();
+    }
+    return stats;
+}
+
+void SpriteAtlas::MapVertices(const SpriteAtlasRegion& region, float vertices[20]) {
+    for (int v = 0; v < 4; ++v) {
+        float* uv = &vertices[v * 5 + 2];
+        uv[0] = region.uvRect[0] + uv[0] * (region.uvRect[2] - region.uvRect[0]);
+        uv[1] = region.uvRect[1] + uv[1] * (region.uvRect[3] - region.uvRect[1]);
+    }
+}
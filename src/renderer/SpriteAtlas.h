@@ -0,0 +1,142 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Dynamic Sprite Texture Atlas
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef SPRITE_ATLAS_H
+#define SPRITE_ATLAS_H
+
+#include "RendererInterfaces.h"
+#include <unordered_map>
+
+// ==========================================
+// Skyline Packer
+// ==========================================
+
+// Bottom-left skyline rectangle packer. The upper envelope of everything
+// placed so far is kept as a list of horizontal segments; a new rectangle
+// goes where its top edge ends lowest, ties broken by the narrower segment.
+class SkylinePacker {
+public:
+    SkylinePacker() : width(0), height(0), usedArea(0) {}
+
+    void Reset(int32_t width, int32_t height);
+    bool Insert(int32_t w, int32_t h, int32_t& x, int32_t& y);
+    int64_t GetUsedArea() const { return usedArea; }
+
+private:
+    struct Segment {
+        int32_t x, y, width;
+    };
+
+    int32_t width;
+    int32_t height;
+    int64_t usedArea;
+    std::vector<Segment> skyline;
+
+    // Top of the skyline under [segments[index].x, +w), or -1 when w x h
+    // does not fit there
+    int32_t FitAt(size_t index, int32_t w, int32_t h) const;
+};
+
+// ==========================================
+// Sprite Atlas
+// ==========================================
+
+// Stable name of a packed sprite; 0 is never handed out. The region behind
+// it moves when the atlas is defragmented, so look it up every frame.
+typedef uint32_t SpriteAtlasHandle;
+
+struct SpriteAtlasRegion {
+    int32_t page;                   // index for GetPage
+    int32_t x, y, width, height;    // texels
+    float uvRect[4];                // u1, v1, u2, v2 as sprite.vert's uvRect
+};
+
+struct SpriteAtlasStats {
+    uint32_t pages;
+    uint32_t sprites;
+    uint32_t uploads;           // sprites added since creation
+    uint32_t evictions;         // sprites dropped to make room
+    uint32_t repacks;           // pages rebuilt by eviction or Defragment
+    int64_t livePixels;         // texels covered by live sprites
+    int64_t allocatedPixels;    // texels claimed by the skylines
+
+    SpriteAtlasStats()
+        : pages(0), sprites(0), uploads(0), evictions(0), repacks(0), livePixels(0), allocatedPixels(0) {}
+};
+
+// Packs indexed-color (8-bit) sprites into a few large single-channel
+// pages instead of one texture each. Sprites on the same page share a
+// texture, so once their uvRect is baked into the vertices (MapVertices,
+// useUV left at 0) the SpriteBatcher merges them into one draw.
+//
+// When every page is full a page is compacted: its sprites not touched
+// this frame are evicted and the rest are copied GPU-side into a fresh
+// skyline, which also closes the holes left by Remove. Pages least
+// recently drawn from go first, so partly live pages are only repacked
+// once no page is entirely stale. Evicted handles stop resolving and must
+// be added again. Defragment repacks all pages at once, tallest
+// sprites first, and releases pages left empty at the end.
+class SpriteAtlas {
+public:
+    SpriteAtlas(IRenderer* renderer, int32_t pageSize = 2048, int32_t maxPages = 8);
+
+    // pixels holds width * height palette indices, rows top first.
+    // Returns 0 when the sprite is too large or nothing can be evicted.
+    SpriteAtlasHandle Add(const std::vector<uint8_t>& pixels, int32_t width, int32_t height);
+    void Remove(SpriteAtlasHandle handle);
+    bool Lookup(SpriteAtlasHandle handle, SpriteAtlasRegion& region) const;
+
+    // Marks a sprite drawn this frame so eviction keeps it
+    void Touch(SpriteAtlasHandle handle);
+    void NextFrame() { frame++; }
+
+    void Defragment();
+
+    const std::shared_ptr<ITexture>& GetPage(int32_t page) const { return pages[page].texture; }
+    int32_t GetPageCount() const { return static_cast<int32_t>(pages.size()); }
+    int32_t GetPageSize() const { return pageSize; }
+    SpriteAtlasStats GetStats() const;
+
+    // Remaps the 0..1 uv of 4 RenderQuad vertices (x, y, u, v, palIndex)
+    // into the region
+    static void MapVertices(const SpriteAtlasRegion& region, float vertices[20]);
+
+private:
+    // One empty texel column and row after every sprite keeps linear
+    // filtering from picking up a neighbour
+    static const int32_t Padding = 1;
+
+    struct Entry {
+        int32_t page;
+        int32_t x, y, width, height;
+        uint64_t lastUsed;
+    };
+
+    struct Page {
+        std::shared_ptr<ITexture> texture;
+        SkylinePacker packer;
+        int64_t livePixels;
+        uint64_t lastUsed;
+    };
+
+    IRenderer* renderer;
+    int32_t pageSize;
+    int32_t maxPages;
+    uint64_t frame;
+    SpriteAtlasHandle nextHandle;
+    std::vector<Page> pages;
+    std::unordered_map<SpriteAtlasHandle, Entry> entries;
+    uint32_t uploads;
+    uint32_t evictions;
+    uint32_t repacks;
+
+    std::shared_ptr<ITexture> NewPageTexture();
+    bool Allocate(int32_t width, int32_t height, int32_t& page, int32_t& x, int32_t& y);
+    bool EvictPage();
+    void Repack(const std::vector<int32_t>& sourcePages);
+};
+
+#endif // SPRITE_ATLAS_H
@@ -0,0 +1,267 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Frame-Level Sprite Batcher Implementation
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#include "SpriteBatcher.h"
+#include <algorithm>
+#include <cstring>
+
+// ==========================================
+// SpriteParams Implementation
+// ==========================================
+
+SpriteParams::SpriteParams() {
+    // Zero everything first so that byte-wise hashing and comparison are stable
+    std::memset(this, 0, sizeof(SpriteParams));
+    modelview[0] = modelview[5] = modelview[10] = modelview[15] = 1.0f;
+    uvRect[2] = uvRect[3] = 1.0f;
+    mult[0] = mult[1] = mult[2] = 1.0f;
+    alpha = 1.0f;
+}
+
+// FNV-1a over the raw parameter bytes
+static uint64_t HashSpriteParams(const SpriteParams& p) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&p);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(SpriteParams); ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// ==========================================
+// SpriteBatcher Implementation
+// ==========================================
+
+bool SpriteBatcher::QueuedQuad::SameState(const QueuedQuad& other) const {
+    return layer == other.layer &&
+           blendEquation == other.blendEquation &&
+           blendSrc == other.blendSrc &&
+           blendDst == other.blendDst &&
+           textureIndex == other.textureIndex &&
+           paletteIndex == other.paletteIndex &&
+           shaderFlags == other.shaderFlags &&
+           paramsIndex == other.paramsIndex;
+}
+
+SpriteBatcher::SpriteBatcher(IRenderer* renderer)
+    : renderer(renderer) {
+    u.tex = InternUniform("tex");
+    u.pal = InternUniform("pal");
+    u.isFlat = InternUniform("isFlat");
+    u.isRgba = InternUniform("isRgba");
+    u.isTrapez = InternUniform("isTrapez");
+    u.neg = InternUniform("neg");
+    u.modelview = InternUniform("modelview");
+    u.uvRect = InternUniform("uvRect");
+    u.useUV = InternUniform("useUV");
+    u.x1x2x4x3 = InternUniform("x1x2x4x3");
+    u.tint = InternUniform("tint");
+    u.add = InternUniform("add");
+    u.mult = InternUniform("mult");
+    u.alpha = InternUniform("alpha");
+    u.gray = InternUniform("gray");
+    u.hue = InternUniform("hue");
+    u.mask = InternUniform("mask");
+}
+
+void SpriteBatcher::Begin() {
+    quads.clear();
+    order.clear();
+    params.clear();
+    paramsIndices.clear();
+    textures.clear();
+    textureIndices.clear();
+
+    // Index 0 is reserved for "no texture"
+    textures.push_back(nullptr);
+    stats.Reset();
+}
+
+void SpriteBatcher::End() {
+    Flush();
+    lastStats = stats;
+
+    // Drop texture references so they can be released between frames
+    textures.clear();
+    textureIndices.clear();
+}
+
+void SpriteBatcher::Draw(int32_t layer, BlendEquation eq, BlendFunc src, BlendFunc dst,
+                         const std::shared_ptr<ITexture>& texture, const std::shared_ptr<ITexture>& palette,
+                         uint32_t shaderFlags, const SpriteParams& p, const float vertices[20]) {
+    QueuedQuad quad;
+    quad.layer = layer;
+    quad.blendEquation = static_cast<uint8_t>(eq);
+    quad.blendSrc = static_cast<uint8_t>(src);
+    quad.blendDst = static_cast<uint8_t>(dst);
+    quad.textureIndex = InternTexture(texture);
+    quad.paletteIndex = (shaderFlags & (SpriteFlagRgba | SpriteFlagFlat)) ? 0 : InternTexture(palette);
+    quad.shaderFlags = shaderFlags;
+    quad.paramsIndex = InternParams(p);
+    std::memcpy(quad.vertices, vertices, sizeof(quad.vertices));
+    stats.submittedChanges += ChangedState(quads.empty() ? nullptr : &quads.back(), quad);
+
+    order.push_back(static_cast<uint32_t>(quads.size()));
+    quads.push_back(quad);
+    stats.quads++;
+}
+
+uint32_t SpriteBatcher::InternTexture(const std::shared_ptr<ITexture>& tex) {
+    if (!tex) {
+        return 0;
+    }
+
+    auto it = textureIndices.find(tex.get());
+    if (it != textureIndices.end()) {
+        return it->second;
+    }
+
+    uint32_t index = static_cast<uint32_t>(textures.size());
+    textures.push_back(tex);
+    textureIndices[tex.get()] = index;
+    return index;
+}
+
+uint32_t SpriteBatcher::InternParams(const SpriteParams& p) {
+    // Consecutive sprites usually share their parameters
+    if (!params.empty() && std::memcmp(&params.back(), &p, sizeof(SpriteParams)) == 0) {
+        return static_cast<uint32_t>(params.size() - 1);
+    }
+
+    uint64_t hash = HashSpriteParams(p);
+    auto range = paramsIndices.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (std::memcmp(&params[it->second], &p, sizeof(SpriteParams)) == 0) {
+            return it->second;
+        }
+    }
+
+    uint32_t index = static_cast<uint32_t>(params.size());
+    params.push_back(p);
+    paramsIndices.emplace(hash, index);
+    return index;
+}
+
+// State changes drawing quad right after bound costs, by the rules Flush
+// applies between runs
+uint32_t SpriteBatcher::ChangedState(const QueuedQuad* bound, const QueuedQuad& quad) const {
+    uint32_t changes = 0;
+    if (!bound || quad.blendEquation != bound->blendEquation ||
+        quad.blendSrc != bound->blendSrc || quad.blendDst != bound->blendDst) {
+        changes++;
+    }
+    if ((!bound || quad.textureIndex != bound->textureIndex) && textures[quad.textureIndex]) {
+        changes++;
+    }
+    if ((!bound || quad.paletteIndex != bound->paletteIndex) && textures[quad.paletteIndex]) {
+        changes++;
+    }
+    if (!bound || quad.shaderFlags != bound->shaderFlags) {
+        changes++;
+    }
+    if (!bound || quad.paramsIndex != bound->paramsIndex) {
+        changes++;
+    }
+    return changes;
+}
+
+void SpriteBatcher::Flush() {
+    if (quads.empty() || !renderer) {
+        return;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        const QueuedQuad& qa = quads[a];
+        const QueuedQuad& qb = quads[b];
+        if (qa.layer != qb.layer) return qa.layer < qb.layer;
+        if (qa.blendEquation != qb.blendEquation) return qa.blendEquation < qb.blendEquation;
+        if (qa.blendSrc != qb.blendSrc) return qa.blendSrc < qb.blendSrc;
+        if (qa.blendDst != qb.blendDst) return qa.blendDst < qb.blendDst;
+        if (qa.textureIndex != qb.textureIndex) return qa.textureIndex < qb.textureIndex;
+        if (qa.paletteIndex != qb.paletteIndex) return qa.paletteIndex < qb.paletteIndex;
+        if (qa.shaderFlags != qb.shaderFlags) return qa.shaderFlags < qb.shaderFlags;
+        return qa.paramsIndex < qb.paramsIndex;
+    });
+
+    const QueuedQuad* bound = nullptr;
+    size_t runStart = 0;
+    while (runStart < order.size()) {
+        const QueuedQuad& head = quads[order[runStart]];
+        size_t runEnd = runStart + 1;
+        while (runEnd < order.size() && quads[order[runEnd]].SameState(head)) {
+            ++runEnd;
+        }
+
+        // Only touch the state that differs from the previous run
+        if (!bound || head.blendEquation != bound->blendEquation ||
+            head.blendSrc != bound->blendSrc || head.blendDst != bound->blendDst) {
+            renderer->SetPipeline(static_cast<BlendEquation>(head.blendEquation),
+                                  static_cast<BlendFunc>(head.blendSrc),
+                                  static_cast<BlendFunc>(head.blendDst));
+            stats.pipelineChanges++;
+        }
+        if ((!bound || head.textureIndex != bound->textureIndex) && textures[head.textureIndex]) {
+            renderer->SetTexture(u.tex, textures[head.textureIndex]);
+            stats.textureChanges++;
+        }
+        if ((!bound || head.paletteIndex != bound->paletteIndex) && textures[head.paletteIndex]) {
+            renderer->SetTexture(u.pal, textures[head.paletteIndex]);
+            stats.textureChanges++;
+        }
+        if (!bound || head.shaderFlags != bound->shaderFlags) {
+            ApplyFlags(head.shaderFlags);
+            stats.flagChanges++;
+        }
+        if (!bound || head.paramsIndex != bound->paramsIndex) {
+            ApplyParams(params[head.paramsIndex]);
+            stats.paramChanges++;
+        }
+        bound = &head;
+
+        // Expand each strip (0,1,2,3) into two triangles (0,1,2) (2,1,3)
+        static const int stripToTriangles[6] = {0, 1, 2, 2, 1, 3};
+        runVertices.clear();
+        runVertices.reserve((runEnd - runStart) * 6 * 5);
+        for (size_t i = runStart; i < runEnd; ++i) {
+            const float* v = quads[order[i]].vertices;
+            for (int corner : stripToTriangles) {
+                runVertices.insert(runVertices.end(), v + corner * 5, v + corner * 5 + 5);
+            }
+        }
+
+        renderer->SetVertexDataArray(runVertices);
+        renderer->RenderQuadBatch(static_cast<int32_t>((runEnd - runStart) * 6));
+        stats.drawCalls++;
+
+        runStart = runEnd;
+    }
+
+    renderer->ReleasePipeline();
+    quads.clear();
+    order.clear();
+}
+
+void SpriteBatcher::ApplyFlags(uint32_t flags) {
+    renderer->SetUniformI(u.isFlat, (flags & SpriteFlagFlat) ? 1 : 0);
+    renderer->SetUniformI(u.isRgba, (flags & SpriteFlagRgba) ? 1 : 0);
+    renderer->SetUniformI(u.isTrapez, (flags & SpriteFlagTrapez) ? 1 : 0);
+    renderer->SetUniformI(u.neg, (flags & SpriteFlagNeg) ? 1 : 0);
+}
+
+void SpriteBatcher::ApplyParams(const SpriteParams& p) {
+    renderer->SetUniformMatrix(u.modelview, p.modelview);
+    renderer->SetUniformF(u.uvRect, p.uvRect, 4);
+    renderer->SetUniformI(u.useUV, p.useUV);
+    renderer->SetUniformF(u.x1x2x4x3, p.x1x2x4x3, 4);
+    renderer->SetUniformF(u.tint, p.tint, 4);
+    renderer->SetUniformF(u.add, p.add, 3);
+    renderer->SetUniformF(u.mult, p.mult, 3);
+    renderer->SetUniformF(u.alpha, &p.alpha, 1);
+    renderer->SetUniformF(u.gray, &p.gray, 1);
+    renderer->SetUniformF(u.hue, &p.hue, 1);
+    renderer->SetUniformI(u.mask, p.mask);
+}
@@ -0,0 +1,149 @@
+//========================================================================
+// Ikemen "Fighting Engine" Port for C++
+// Frame-Level Sprite Batcher
+// Copyright (c) 2026 leonkasovan@gmail.com
+//========================================================================
+
+#ifndef SPRITE_BATCHER_H
+#define SPRITE_BATCHER_H
+
+#include "RendererInterfaces.h"
+#include <unordered_map>
+
+// ==========================================
+// Sprite Shader Flags
+// ==========================================
+
+// Boolean switches of the sprite fragment shader
+enum SpriteShaderFlag : uint32_t {
+    SpriteFlagFlat   = 1 << 0,   // isFlat
+    SpriteFlagRgba   = 1 << 1,   // isRgba
+    SpriteFlagTrapez = 1 << 2,   // isTrapez
+    SpriteFlagNeg    = 1 << 3    // neg
+};
+
+// ==========================================
+// Sprite Parameters
+// ==========================================
+
+// Per-sprite uniforms of the sprite shader. Sprites only share a draw when
+// these match exactly, so transforms that vary per sprite should be baked
+// into the vertices and the modelview left at identity.
+struct SpriteParams {
+    float modelview[16];
+    float uvRect[4];
+    float x1x2x4x3[4];
+    float tint[4];
+    float add[3];
+    float mult[3];
+    float alpha;
+    float gray;
+    float hue;
+    int32_t mask;
+    int32_t useUV;
+
+    SpriteParams();
+};
+
+// ==========================================
+// Sprite Batch Statistics
+// ==========================================
+
+struct SpriteBatchStats {
+    uint32_t quads;             // sprites submitted
+    uint32_t drawCalls;         // RenderQuadBatch calls issued
+    uint32_t pipelineChanges;   // SetPipeline calls (blend state)
+    uint32_t textureChanges;    // tex/pal rebinds
+    uint32_t flagChanges;       // shader flag uniform updates
+    uint32_t paramChanges;      // per-sprite uniform block updates
+    uint32_t submittedChanges;  // the same changes counted in submission order
+
+    SpriteBatchStats() { Reset(); }
+    void Reset() {
+        quads = drawCalls = pipelineChanges = 0;
+        textureChanges = flagChanges = paramChanges = 0;
+        submittedChanges = 0;
+    }
+    // State changes of the sorted frame. Drawing each sprite as submitted
+    // costs quads draw calls and submittedChanges state changes instead.
+    uint32_t StateChanges() const {
+        return pipelineChanges + textureChanges + flagChanges + paramChanges;
+    }
+};
+
+// ==========================================
+// Sprite Batcher
+// ==========================================
+
+// Collects sprite quads for a frame, stable-sorts them by (layer, blend,
+// texture, palette, shader flags, params) and flushes every run of equal
+// state with a single RenderQuadBatch. Palettes are selected per vertex via
+// palIndex, so sprites using different rows of the same palette array merge.
+//
+// Draw order is preserved between layers and between sprites sharing the
+// same state. Sprites that overlap and must keep their submission order
+// despite differing state belong on different layers.
+class SpriteBatcher {
+public:
+    explicit SpriteBatcher(IRenderer* renderer);
+
+    // Frame lifecycle
+    void Begin();
+    void End();
+
+    // Queues one quad. vertices holds 4 vertices in triangle-strip order,
+    // 5 floats each (x, y, u, v, palIndex), as consumed by RenderQuad.
+    void Draw(int32_t layer, BlendEquation eq, BlendFunc src, BlendFunc dst,
+              const std::shared_ptr<ITexture>& texture, const std::shared_ptr<ITexture>& palette,
+              uint32_t shaderFlags, const SpriteParams& params, const float vertices[20]);
+
+    // Counters of the last completed frame
+    const SpriteBatchStats& GetStats() const { return lastStats; }
+
+private:
+    struct QueuedQuad {
+        int32_t layer;
+        uint8_t blendEquation;
+        uint8_t blendSrc;
+        uint8_t blendDst;
+        uint32_t textureIndex;
+        uint32_t paletteIndex;
+        uint32_t shaderFlags;
+        uint32_t paramsIndex;
+        float vertices[20];
+
+        bool SameState(const QueuedQuad& other) const;
+    };
+
+    IRenderer* renderer;
+    std::vector<QueuedQuad> quads;
+    std::vector<uint32_t> order;
+    std::vector<float> runVertices;
+
+    // Textures and params are interned per frame so keys are small integers
+    // assigned in submission order, which keeps sorting deterministic
+    std::vector<std::shared_ptr<ITexture>> textures;
+    std::unordered_map<const ITexture*, uint32_t> textureIndices;
+    std::vector<SpriteParams> params;
+    std::unordered_multimap<uint64_t, uint32_t> paramsIndices;
+
+    SpriteBatchStats stats;
+    SpriteBatchStats lastStats;
+
+    // Sprite shader uniforms, interned once
+    struct {
+        UniformID tex, pal;
+        UniformID isFlat, isRgba, isTrapez, neg;
+        UniformID modelview, uvRect, useUV, x1x2x4x3;
+        UniformID tint, add, mult, alpha, gray, hue, mask;
+    } u;
+
+    uint32_t InternTexture(const std::shared_ptr<ITexture>& tex);
+    uint32_t InternParams(const SpriteParams& p);
+    uint32_t ChangedState(const QueuedQuad* bound, const QueuedQuad& quad) const;
+    void Flush();
+    void ApplyParams(const SpriteParams& p);
+    void ApplyFlags(uint32_t flags);
+};
+
+#endif // SPRITE_BATCHER_H